@@ -201,6 +201,9 @@ IPlugControls::IPlugControls(const InstanceInfo& info)
     pGraphics->AttachControl(new IVMeterControl<2>(nextCell(), "IVMeterControl - Lin", style.WithColor(kFG, COLOR_WHITE.WithOpacity(0.3f)), EDirection::Vertical, {"L", "R"}), kCtrlTagMeter, "vcontrols");
     pGraphics->AttachControl(new IVPeakAvgMeterControl<2>(nextCell(), "IVPeakAvgMeterControl - Log", style.WithColor(kFG, COLOR_WHITE.WithOpacity(0.3f))), kCtrlTagPeakAvgMeter, "vcontrols");
     pGraphics->AttachControl(new IVScopeControl<2, kScopeBufferSize*2>(nextCell(), "IVScopeControl", style.WithColor(kFG, COLOR_BLACK)), kCtrlTagScope, "vcontrols");
+#if IPLUG_DSP && !defined OS_WEB
+    pGraphics->GetControlWithTag(kCtrlTagScope)->As<IVScopeControl<2, kScopeBufferSize*2>>()->SetRingBufferSender(&mScopeSender);
+#endif
     pGraphics->AttachControl(new IVDisplayControl(nextCell(), "IVDisplayControl", style, EDirection::Vertical, -1., 1., 0., 512), kCtrlTagDisplay, "vcontrols");
     pGraphics->AttachControl(new IVLabelControl(nextCell().SubRectVertical(3, 0).GetMidVPadded(10.f), "IVLabelControl"), kNoTag, "vcontrols");
     pGraphics->AttachControl(new IVColorSwatchControl(sameCell().SubRectVertical(3, 1), "IVColorSwatchControl", [](int, IColor){}, style, IVColorSwatchControl::ECellLayout::kHorizontal, {kX1, kX2, kX3}, {"", "", ""}), kNoTag, "vcontrols");
@@ -570,7 +573,9 @@ void IPlugControls::OnUIClose()
 #if IPLUG_DSP
 void IPlugControls::OnIdle()
 {
+#ifdef OS_WEB
   mScopeSender.TransmitData(*this);
+#endif
   mMeterSender.TransmitData(*this);
   mRTTextSender.TransmitData(*this);
   mDisplaySender.TransmitData(*this);
@@ -600,7 +605,11 @@ void IPlugControls::ProcessBlock(sample** inputs, sample** outputs, int nFrames)
   }
   
   mDisplaySender.ProcessBlock(outputs, nFrames, kCtrlTagDisplay);
+#ifdef OS_WEB
   mScopeSender.ProcessBlock(outputs, nFrames, kCtrlTagScope);
+#else
+  mScopeSender.ProcessBlock(outputs, nFrames);
+#endif
   mMeterSender.ProcessBlock(outputs, nFrames, kCtrlTagMeter);
   mPeakAvgMeterSender.ProcessBlock(outputs, nFrames, kCtrlTagPeakAvgMeter);
 
@@ -61,7 +61,11 @@ public:
   void OnReset() override;
 private:
   
+#ifdef OS_WEB
   IBufferSender<2, kScopeBufferSize, kScopeBufferSize*2> mScopeSender;
+#else
+  IRingBufferSender mScopeSender {2, kScopeBufferSize*2}; // read directly by the scope control
+#endif
   IBufferSender<1> mDisplaySender;
   IPeakSender<2> mMeterSender;
   ISender<1> mRTTextSender;
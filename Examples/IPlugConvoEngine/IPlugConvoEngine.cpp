@@ -67,7 +67,11 @@ void IPlugConvoEngine::OnReset()
     }
     
     // Tie the impulse response to the convolution engine.
+#if defined USE_THREADED_CONVOLUTION
+    mEngine.SetImpulse(&mImpulse, GetBlockSize(), 0, 1);
+#else
     mEngine.SetImpulse(&mImpulse);
+#endif
     
     SetLatency(mEngine.GetLatency());
   }
@@ -11,6 +11,10 @@
 
 #include "convoengine.h"
 
+#if defined USE_THREADED_CONVOLUTION
+  #include "ThreadedConvolutionEngine.h"
+#endif
+
 #if defined USE_WDL_RESAMPLER
   #include "resample.h"
 #elif defined USE_R8BRAIN
@@ -49,8 +53,13 @@ private:
   static const float mIR[512];
 
   WDL_ImpulseBuffer mImpulse;
-//  WDL_ConvolutionEngine_Div mEngine; // < low latency version
+#if defined USE_THREADED_CONVOLUTION
+  ThreadedConvolutionEngine mEngine; // < zero latency, long tails convolved on a worker thread
+#elif defined USE_DIV_CONVOLUTION
+  WDL_ConvolutionEngine_Div mEngine; // < low latency version
+#else
   WDL_ConvolutionEngine mEngine;
+#endif
   
   static constexpr int mBlockLength = 64;
 
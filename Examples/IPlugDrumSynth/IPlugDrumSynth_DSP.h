@@ -10,6 +10,7 @@ static constexpr double kFreqDiff = 100.; //Hz
 static constexpr double kPitchEnvRange = 100.; //Hz
 static constexpr double kAmpDecayTime = 300; //Ms
 static constexpr double kPitchDecayTime = 50.; //Ms
+static constexpr int kMaxChunkSize = 64; // envelopes are rendered in blocks of up to this many samples
 
 using namespace iplug;
 
@@ -22,6 +23,8 @@ public:
     ADSREnvelope<sample> mAmpEnv {"amp", nullptr, false};
     FastSinOscillator<sample> mOsc;
     double mBaseFreq;
+    sample mPitchEnvBuf[kMaxChunkSize] = {};
+    sample mAmpEnvBuf[kMaxChunkSize] = {};
     
     DrumVoice(double baseFreq)
     : mBaseFreq(baseFreq)
@@ -33,9 +36,16 @@ public:
       mPitchEnv.SetStageTime(ADSREnvelope<sample>::kDecay, kPitchDecayTime);
     }
     
-    inline sample Process()
+    // Add nFrames (at most kMaxChunkSize) of the drum to pOutput
+    void ProcessBlockAccumulating(sample* pOutput, int nFrames)
     {
-      return mOsc.Process(mBaseFreq + mPitchEnv.Process()) * mAmpEnv.Process();
+      mPitchEnv.ProcessBlock(mPitchEnvBuf, nFrames);
+      mAmpEnv.ProcessBlock(mAmpEnvBuf, nFrames);
+
+      for(int s=0;s<nFrames;s++)
+      {
+        pOutput[s] += mOsc.Process(mBaseFreq + mPitchEnvBuf[s]) * mAmpEnvBuf[s];
+      }
     }
     
     void Trigger(double amp)
@@ -68,7 +78,9 @@ public:
   
   void ProcessBlock(sample** outputs, int nFrames)
   {
-    for(int s=0;s<nFrames;s++)
+    int s = 0;
+
+    while(s < nFrames)
     {
       while (!mMidiQueue.Empty())
       {
@@ -86,33 +98,41 @@ public:
         mMidiQueue.Remove();
       }
 
+      // render up to the next MIDI message
+      const int chunkEnd = mMidiQueue.Empty() ? nFrames : std::min(mMidiQueue.Peek().mOffset, nFrames);
+      const int chunkSize = std::min(chunkEnd - s, kMaxChunkSize);
+
       if(mMultiOut)
       {
         int channel=0;
         for(int d=0;d<kNumDrums;d++)
         {
-          outputs[channel][s] = 0.;
+          sample* pOutput = outputs[channel] + s;
+          std::fill(pOutput, pOutput + chunkSize, 0.);
 
           if(mDrums[d].IsActive())
-            outputs[channel][s] = mDrums[d].Process();
+            mDrums[d].ProcessBlockAccumulating(pOutput, chunkSize);
           
-          outputs[channel + 1][s] = outputs[channel][s];
+          std::copy(pOutput, pOutput + chunkSize, outputs[channel + 1] + s);
 
           channel += 2;
         }
       }
       else
       {
-        outputs[0][s] = 0.;
+        sample* pOutput = outputs[0] + s;
+        std::fill(pOutput, pOutput + chunkSize, 0.);
         
         for(int d=0;d<kNumDrums;d++)
         {
           if(mDrums[d].IsActive())
-            outputs[0][s] += mDrums[d].Process();
+            mDrums[d].ProcessBlockAccumulating(pOutput, chunkSize);
         }
         
-        outputs[1][s] = outputs[0][s];
+        std::copy(pOutput, pOutput + chunkSize, outputs[1] + s);
       }
+
+      s += chunkSize;
     }
     mMidiQueue.Flush(nFrames);
   }
@@ -8,6 +8,11 @@ IPlugVisualizer::IPlugVisualizer(const InstanceInfo& info)
 : iplug::Plugin(info, MakeConfig(kNumParams, kNumPresets))
 {
   GetParam(kOctaveGain)->InitDouble("OctaveGain", 0.0, 0., 12.0, 0.1, "dB");
+
+#if IPLUG_DSP && !defined OS_WEB
+  // calculate the spectrum on a worker thread, so the UI thread only receives a magnitude per pixel
+  mSender.StartAnalysisThread();
+#endif
   
 #if IPLUG_EDITOR // http://bit.ly/2S64BDd
   mMakeGraphicsFunc = [&]() {
@@ -49,6 +54,11 @@ bool IPlugVisualizer::OnMessage(int msgTag, int ctrlTag, int dataSize, const voi
     mSender.SetFFTSize(fftSize);
     return true;
   }
+  else if (msgTag == IVSpectrumAnalyzerControl<>::kMsgTagColumnLayout)
+  {
+    mSender.SetColumnLayout(*reinterpret_cast<const ISpectrumColumnLayout*>(pData));
+    return true;
+  }
 
   return false;
 }
@@ -284,7 +284,7 @@ protected:
 
     if(pCaller != mCaller)
     {
-      mRECT = mBubbleBounds;
+      SetRECT(mBubbleBounds);
       GetUI()->SetAllControlsDirty();
     }
     
@@ -862,7 +862,7 @@ void IPopupMenuControl::OnEndAnimation()
   }
   else if(mState == kCollapsing)
   {
-    mTargetRECT = mSpecifiedCollapsedBounds;
+    SetTargetRECT(mSpecifiedCollapsedBounds);
     
     for (auto i = 0; i < mMenuPanels.GetSize(); i++) {
       mMenuPanels.Get(i)->mBlend.mWeight = 0.;
@@ -880,7 +880,7 @@ void IPopupMenuControl::OnEndAnimation()
     GetUI()->UpdateTooltips(); // will enable the tooltips
     
     mMenuPanels.Empty(true);
-    mRECT = mSpecifiedCollapsedBounds;
+    SetRECT(mSpecifiedCollapsedBounds);
     mState = kCollapsed;
   }
   
@@ -85,7 +85,7 @@ public:
     if (bounds.W() <= 0.0)
     {
       mRECT.R = mRECT.L + mRECT.H();
-      mTargetRECT = mRECT;
+      SetTargetRECT(mRECT);
     }
 
     SetNoteRange(minNote, maxNote, keepWidth);
@@ -196,7 +196,7 @@ public:
       *pKeyL = mRECT.L + d * r + dx;
     }
 
-    mTargetRECT = mRECT;
+    SetTargetRECT(mRECT);
     RecreateKeyBounds(true);
     SetDirty(false);
   }
@@ -437,7 +437,7 @@ public:
     float r = h / mRECT.H();
     mRECT.B = mRECT.T + mRECT.H() * r;
 
-    mTargetRECT = mRECT;
+    SetTargetRECT(mRECT);
 
     if (keepAspectRatio)
       SetWidth(mRECT.W() * r);
@@ -457,7 +457,7 @@ public:
       *pKeyL = mRECT.L + d * r;
     }
 
-    mTargetRECT = mRECT;
+    SetTargetRECT(mRECT);
 
     if (keepAspectRatio)
       SetHeight(mRECT.H() * r);
@@ -593,7 +593,7 @@ private:
       }
     }
 
-    mTargetRECT = mRECT;
+    SetTargetRECT(mRECT);
     SetDirty(false);
   }
 
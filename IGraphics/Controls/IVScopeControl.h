@@ -57,12 +57,32 @@ public:
     
     IRECT r = mWidgetBounds.GetPadded(-mPadding);
 
+    if (mRingSender)
+    {
+      ReadRingSender();
+
+      for (int c=0; c<mRingNChans; c++)
+      {
+        g.DrawDataDecimated(GetColor(kFG), r.FracRectVertical(0.5, true), mRingBuf.data() + c * mRingLength, mRingLength, nullptr, &mBlend, mTrackSize);
+      }
+      return;
+    }
+
     for (int c=0; c<mBuf.nChans; c++)
     {
       // drawdata expects normalized values and buffer contains unnormalized, so draw in the top half
       g.DrawData(GetColor(kFG), r.FracRectVertical(0.5, true), mBuf.vals[c].data(), mBufferSize, nullptr, &mBlend, mTrackSize);
     }
   }
+
+  bool IsDirty() override
+  {
+    // in ring mode the animation function only polls the sender, and marks the control dirty when it has new data
+    if (mRingSender)
+      return mDirty;
+
+    return IControl::IsDirty();
+  }
   
   void OnResize() override
   {
@@ -90,8 +110,59 @@ public:
     mBufferSize = bufferSize;
   }
 
+  /** Draw the history of an IRingBufferSender, reading it directly when the control is drawn rather than receiving copies from an IBufferSender.
+   * The number of channels and the number of points drawn follow the sender. The sender must outlive the control, see IRingBufferSender
+   * @param pSender The sender, or nullptr to go back to drawing the data sent with kUpdateMessage */
+  void SetRingBufferSender(const IRingBufferSender* pSender)
+  {
+    mRingSender = pSender;
+    mRingWriteCount = 0;
+    mRingNChans = 0;
+
+    if (pSender)
+    {
+      SetAnimation([](IControl* pCaller) {
+        IVScopeControl* pScope = static_cast<IVScopeControl*>(pCaller);
+
+        if (!pScope->IsDisabled() && pScope->mRingSender->GetWriteCount() != pScope->mRingWriteCount)
+          pScope->SetDirty(false);
+      });
+    }
+    else
+      SetAnimation(nullptr);
+
+    SetDirty(false);
+  }
+
 private:
+  void ReadRingSender()
+  {
+    const int nChans = mRingSender->NChans();
+    const int length = mRingSender->GetHistoryLength();
+
+    if (nChans != mRingNChans || length != mRingLength)
+    {
+      mRingBuf.assign(static_cast<size_t>(nChans) * length, 0.f);
+      mRingPtrs.resize(nChans);
+      mRingNChans = nChans;
+      mRingLength = length;
+
+      for (int c=0; c<nChans; c++)
+        mRingPtrs[c] = mRingBuf.data() + c * length;
+    }
+
+    // if the audio thread overwrote the window, keep the last one and try again on the next frame
+    if (IsDisabled() || !mRingSender->ReadLatest(mRingPtrs.data(), nChans, length, mRingWriteCount))
+      mRingWriteCount = 0;
+  }
+
   ISenderData<MAXNC, std::array<float, MAXBUF>> mBuf;
+  const IRingBufferSender* mRingSender = nullptr;
+  std::vector<float> mRingBuf;
+  std::vector<float*> mRingPtrs;
+  uint64_t mRingWriteCount = 0;
+  int mRingNChans = 0;
+  int mRingLength = 0;
   float mPadding = 2.f;
   int mBufferSize = MAXBUF;
 };
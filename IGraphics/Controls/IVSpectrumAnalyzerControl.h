@@ -26,8 +26,10 @@ BEGIN_IGRAPHICS_NAMESPACE
 /** Vectorial multi-channel capable spectrum analyzer control
  * @ingroup IControls
  * Derived from work by Alex Harker and Matthew Witmer
+ * The control draws either full spectra from an ISpectrumSender, or when the sender's analysis thread is running, the per-pixel
+ * columns it prepares. In that case forward the kMsgTagColumnLayout messages from this control to ISpectrumSender::SetColumnLayout()
  */
-template <int MAXNC = 2, int MAX_FFT_SIZE = 4096>
+template <int MAXNC = 2, int MAX_FFT_SIZE = 4096, int MAX_COLUMNS = 1024>
 class IVSpectrumAnalyzerControl : public IControl
                                 , public IVectorBase
 {
@@ -38,11 +40,13 @@ public:
     kMsgTagFFTSize,
     kMsgTagOverlap,
     kMsgTagWindowType,
-    kMsgTagOctaveGain
+    kMsgTagOctaveGain,
+    kMsgTagColumnLayout
   };
   
   static constexpr auto numExtraPoints = 2;
   using TDataPacket = std::array<float, MAX_FFT_SIZE>;
+  using TColumnData = ISpectrumColumnData<MAXNC, MAX_COLUMNS>;
   enum class EChannelType { Left = 0, Right, LeftAndRight };
   enum class EFrequencyScale { Linear, Log };
   enum class EAmplitudeScale { Linear, Decibel };
@@ -147,6 +151,7 @@ public:
   void OnResize() override
   {
     SetTargetRECT(MakeRects(mRECT));
+    SendColumnLayout();
     SetDirty(false);
   }
   
@@ -158,10 +163,22 @@ public:
     {
       ISenderData<MAXNC, TDataPacket> d;
       stream.Get(&d, 0);
+      SetNumColumns(0);
       
       for (auto c = d.chanOffset; c < (d.chanOffset + d.nChans); c++)
       {
-        CalculateYPoints(c, d.vals[c]);
+        CalculateYPoints(c, d.vals[c].data());
+      }
+    }
+    else if (!IsDisabled() && msgTag == ISpectrumSender<MAXNC>::kColumnsMessage)
+    {
+      TColumnData d;
+      stream.Get(&d, 0);
+      SetNumColumns(d.nColumns);
+      
+      for (auto c = d.chanOffset; c < (d.chanOffset + d.nChans); c++)
+      {
+        CalculateYPoints(c, d.vals[c].data());
       }
     }
     else if (msgTag == kMsgTagSampleRate)
@@ -258,7 +275,7 @@ private:
       
       int nPoints = NumPoints();
       IColor fillColor = mChannelColors[c].WithOpacity(mFillOpacity);
-      g.DrawData(mChannelColors[c], mWidgetBounds, mYPoints[c].data(), nPoints, mXPoints.data(), 0, mCurveThickness, &fillColor);
+      g.DrawDataDecimated(mChannelColors[c], mWidgetBounds, mYPoints[c].data(), nPoints, mXPoints.data(), 0, mCurveThickness, &fillColor);
     }
   }
 
@@ -307,6 +324,7 @@ private:
   {
     mFreqLo = freqLo;
     mFreqHi = freqHi;
+    SendColumnLayout();
     SetDirty(false);
   }
   
@@ -314,8 +332,34 @@ private:
   {
     mFreqScale = scale;
     CalculateXPoints();
+    SendColumnLayout();
     SetDirty(false);
   }
+
+  /** Switch between drawing a point per bin (0) and a point per column prepared by the sender */
+  void SetNumColumns(int nColumns)
+  {
+    if (nColumns == mNumColumns)
+      return;
+
+    mNumColumns = nColumns;
+    ResizePoints();
+    CalculateXPoints();
+  }
+
+  /** Tell the delegate the columns that a sender with an analysis thread should prepare, one per pixel across the widget */
+  void SendColumnLayout()
+  {
+    if (!GetDelegate())
+      return;
+
+    ISpectrumColumnLayout layout;
+    layout.nColumns = Clip(static_cast<int>(mWidgetBounds.W()), 2, MAX_COLUMNS);
+    layout.freqLo = static_cast<float>(mFreqLo / NyquistFreq());
+    layout.freqHi = static_cast<float>(mFreqHi / NyquistFreq());
+    layout.logScale = mFreqScale == EFrequencyScale::Log;
+    GetDelegate()->SendArbitraryMsgFromUI(kMsgTagColumnLayout, kNoTag, sizeof(ISpectrumColumnLayout), &layout);
+  }
   
   void SetAmpRange(float ampLo, float ampHi)
   {
@@ -367,7 +411,23 @@ protected:
   
   void CalculateXPoints()
   {
-    const auto numBins = NumBins();
+    const auto numBins = NumValues();
+
+    if (mNumColumns) // the sender has already mapped the columns to the frequency scale
+    {
+      for (auto i = 0; i < numBins; i++)
+      {
+        mXPoints[i] = static_cast<float>(i) / static_cast<float>(numBins - 1);
+      }
+
+      if (FillCurves())
+      {
+        mXPoints[numBins] = mXPoints[numBins-1];
+        mXPoints[numBins+1] = mXPoints[0];
+      }
+      return;
+    }
+
     const auto xIncr = (1.0f / static_cast<float>(numBins-1)) * NyquistFreq();
     mXPoints[0] = 0.0f;
     for (auto i = 1; i < numBins; i++)
@@ -379,9 +439,9 @@ protected:
     mXPoints[numBins+1] = mXPoints[0];
   }
   
-  void CalculateYPoints(int ch, const TDataPacket& powerSpectrum)
+  void CalculateYPoints(int ch, const float* powerSpectrum)
   {
-    const auto numBins = NumBins();
+    const auto numBins = NumValues();
 
     for (auto i = 0; i < numBins; i++)
     {
@@ -465,8 +525,9 @@ protected:
     }
   }
 
-  int NumPoints() const { return FillCurves() ? NumBins() + numExtraPoints : NumBins(); }
+  int NumPoints() const { return FillCurves() ? NumValues() + numExtraPoints : NumValues(); }
   int NumBins() const { return mFFTSize / 2; }
+  int NumValues() const { return mNumColumns ? mNumColumns : NumBins(); }
   double FirstBinFreq() const { return NyquistFreq()/mFFTSize; }
   double NyquistFreq() const { return mSampleRate * 0.5; }
   bool FillCurves() const { return mFillOpacity > 0.0f; }
@@ -478,6 +539,7 @@ private:
 
   double mSampleRate = 44100.0;
   int mFFTSize = 1024;
+  int mNumColumns = 0; // 0 when drawing full spectra
   float mOctaveGain = 0.0;
   float mFreqLo = 20.0;
   float mFreqHi = 22050.0;
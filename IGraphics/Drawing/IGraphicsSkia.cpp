@@ -1,6 +1,14 @@
 #include <cmath>
 #include <map>
 
+#ifdef IGRAPHICS_CPU
+  #include <atomic>
+  #include <condition_variable>
+  #include <mutex>
+  #include <thread>
+  #include <vector>
+#endif
+
 #include "IGraphicsSkia.h"
 
 #pragma warning(push)
@@ -80,6 +88,10 @@
 
 #endif
 
+#if defined IGRAPHICS_CPU && !defined IGRAPHICS_SKIA_CPU_RENDER_THREADS
+  #define IGRAPHICS_SKIA_CPU_RENDER_THREADS 1
+#endif
+
 using namespace iplug;
 using namespace igraphics;
 
@@ -349,6 +361,132 @@ sk_sp<SkUnicode> GetUnicode()
 }
 #endif
 
+#ifdef IGRAPHICS_CPU
+/** A pool of threads that play back a recorded frame into horizontal tiles of a raster surface in parallel.
+ * The calling thread renders tiles too, and Render() returns once every tile is done. The tiles are disjoint, so no two threads write the same pixels */
+class IGraphicsSkia::TileRenderer
+{
+public:
+  /** Tiles are at least this many pixel rows tall, so that small dirty areas are not split up */
+  static constexpr int kMinTileHeight = 32;
+
+  /** The dirty area is split into up to this many tiles per thread, so that threads that finish early can pick up more work */
+  static constexpr int kTilesPerThread = 2;
+
+  TileRenderer(int nThreads)
+  : mNThreads(std::max(nThreads, 1))
+  {
+    for (auto t = 1; t < mNThreads; t++)
+      mWorkers.emplace_back([this]() { WorkerLoop(); });
+  }
+
+  ~TileRenderer()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mQuit = true;
+    }
+
+    mWorkCV.notify_all();
+
+    for (auto& worker : mWorkers)
+      worker.join();
+  }
+
+  TileRenderer(const TileRenderer&) = delete;
+  TileRenderer& operator=(const TileRenderer&) = delete;
+
+  int NThreads() const { return mNThreads; }
+
+  /** Play back picture into the bounds region of pixmap, which the picture's coordinates map directly onto */
+  void Render(const SkPicture& picture, const SkPixmap& pixmap, const SkIRect& bounds)
+  {
+    mPicture = &picture;
+    mPixmap = pixmap;
+    mBounds = bounds;
+    mNTiles = Clip(bounds.height() / kMinTileHeight, 1, mNThreads * kTilesPerThread);
+    mNextTile.store(0, std::memory_order_relaxed);
+
+    if (mNTiles == 1)
+    {
+      RenderTiles();
+      return;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mGeneration++;
+      mNWorkersDone = 0;
+    }
+
+    mWorkCV.notify_all();
+    RenderTiles();
+
+    // Wait for every worker, not just every tile, so that none of them is still reading this job when the next one is set up
+    std::unique_lock<std::mutex> lock(mMutex);
+    mDoneCV.wait(lock, [this]() { return mNWorkersDone == mNThreads - 1; });
+  }
+
+private:
+  void RenderTiles()
+  {
+    for (auto t = mNextTile.fetch_add(1, std::memory_order_relaxed); t < mNTiles; t = mNextTile.fetch_add(1, std::memory_order_relaxed))
+    {
+      const int top = mBounds.fTop + (mBounds.height() * t) / mNTiles;
+      const int bottom = mBounds.fTop + (mBounds.height() * (t + 1)) / mNTiles;
+      SkPixmap tile;
+
+      if (!mPixmap.extractSubset(&tile, SkIRect::MakeLTRB(mBounds.fLeft, top, mBounds.fRight, bottom)))
+        continue;
+
+      auto pCanvas = SkCanvas::MakeRasterDirect(tile.info(), tile.writable_addr(), tile.rowBytes());
+
+      if (!pCanvas)
+        continue;
+
+      pCanvas->translate(static_cast<float>(-mBounds.fLeft), static_cast<float>(-top));
+      pCanvas->drawPicture(mPicture);
+    }
+  }
+
+  void WorkerLoop()
+  {
+    uint32_t lastGeneration = 0;
+    std::unique_lock<std::mutex> lock(mMutex);
+
+    while (true)
+    {
+      mWorkCV.wait(lock, [&]() { return mQuit || mGeneration != lastGeneration; });
+
+      if (mQuit)
+        return;
+
+      lastGeneration = mGeneration;
+      lock.unlock();
+      RenderTiles();
+      lock.lock();
+
+      if (++mNWorkersDone == mNThreads - 1)
+        mDoneCV.notify_one();
+    }
+  }
+
+  const int mNThreads;
+  const SkPicture* mPicture = nullptr;
+  SkPixmap mPixmap;
+  SkIRect mBounds;
+  int mNTiles = 0;
+  std::atomic<int> mNextTile{0};
+  std::vector<std::thread> mWorkers;
+  std::mutex mMutex;
+  std::condition_variable mWorkCV;
+  std::condition_variable mDoneCV;
+  uint32_t mGeneration = 0; // guarded by mMutex
+  int mNWorkersDone = 0; // guarded by mMutex
+  bool mQuit = false; // guarded by mMutex
+};
+#endif
+
 IGraphicsSkia::IGraphicsSkia(IGEditorDelegate& dlg, int w, int h, int fps, float scale)
   : IGraphics(dlg, w, h, fps, scale)
 {
@@ -356,6 +494,7 @@ IGraphicsSkia::IGraphicsSkia(IGEditorDelegate& dlg, int w, int h, int fps, float
 
 #if defined IGRAPHICS_CPU
   DBGMSG("IGraphics Skia CPU @ %i FPS\n", fps);
+  SetNumRenderThreads(IGRAPHICS_SKIA_CPU_RENDER_THREADS);
 #elif defined IGRAPHICS_METAL
   DBGMSG("IGraphics Skia METAL @ %i FPS\n", fps);
 #elif defined IGRAPHICS_GL
@@ -564,6 +703,14 @@ void IGraphicsSkia::BeginFrame()
     mMTLDrawable = (void*)drawable;
     assert(mScreenSurface);
   }
+#elif defined IGRAPHICS_CPU
+  if (mTileRenderer && mSurface)
+  {
+    mCanvas = mRecorder.beginRecording(SkRect::MakeIWH(mSurface->width(), mSurface->height()), &mRTreeFactory);
+    mCanvas->save();
+    mRecordedBounds.setEmpty();
+    mRecording = true;
+  }
 #endif
 
   IGraphics::BeginFrame();
@@ -572,6 +719,12 @@ void IGraphicsSkia::BeginFrame()
 void IGraphicsSkia::EndFrame()
 {
 #ifdef IGRAPHICS_CPU
+  if (mRecording)
+    RenderRecording();
+
+  if (!mPresent)
+    return;
+
   #if defined OS_MAC || defined OS_IOS
   SkPixmap pixmap;
   mSurface->peekPixels(&pixmap);
@@ -613,6 +766,48 @@ void IGraphicsSkia::EndFrame()
 #endif
 }
 
+#ifdef IGRAPHICS_CPU
+void IGraphicsSkia::SetNumRenderThreads(int nThreads)
+{
+  if (nThreads == GetNumRenderThreads())
+    return;
+
+  mTileRenderer.reset(nThreads > 1 ? new TileRenderer(nThreads) : nullptr);
+}
+
+int IGraphicsSkia::GetNumRenderThreads() const
+{
+  return mTileRenderer ? mTileRenderer->NThreads() : 1;
+}
+
+void IGraphicsSkia::DrawOffscreen(IRECTList& rects)
+{
+  mPresent = false;
+  Draw(rects);
+  mPresent = true;
+}
+
+void IGraphicsSkia::RenderRecording()
+{
+  mRecording = false;
+  sk_sp<SkPicture> picture = mRecorder.finishRecordingAsPicture();
+  mCanvas = mSurface->getCanvas();
+
+  SkIRect bounds = mRecordedBounds;
+
+  if (!bounds.intersect(SkIRect::MakeWH(mSurface->width(), mSurface->height())))
+    return;
+
+  // We write the pixels directly, so any snapshot of the surface must be detached first
+  mSurface->notifyContentWillChange(SkSurface::kRetain_ContentChangeMode);
+
+  SkPixmap pixmap;
+
+  if (mSurface->peekPixels(&pixmap))
+    mTileRenderer->Render(*picture, pixmap, bounds);
+}
+#endif
+
 void IGraphicsSkia::DrawBitmap(const IBitmap& bitmap, const IRECT& dest, int srcX, int srcY, const IBlend* pBlend)
 {
   SkPaint p;
@@ -677,7 +872,13 @@ IColor IGraphicsSkia::GetPoint(int x, int y)
 {
   SkBitmap bitmap;
   bitmap.allocPixels(SkImageInfo::MakeN32Premul(1, 1));
+#ifdef IGRAPHICS_CPU
+  // A recording canvas has no pixels to read
+  SkCanvas* pCanvas = (mRecording && mLayers.empty()) ? mSurface->getCanvas() : mCanvas;
+  pCanvas->readPixels(bitmap, x, y);
+#else
   mCanvas->readPixels(bitmap, x, y);
+#endif
   auto color = bitmap.getColor(0, 0);
   return IColor(SkColorGetA(color), SkColorGetR(color), SkColorGetG(color), SkColorGetB(color));
 }
@@ -1047,6 +1248,12 @@ void IGraphicsSkia::SetClipRegion(const IRECT& r)
   mCanvas->setMatrix(mClipMatrix);
   mCanvas->clipRect(SkiaRect(r));
   mCanvas->setMatrix(mFinalMatrix);
+
+#ifdef IGRAPHICS_CPU
+  // All drawing to the main surface is clipped to these regions, so their union is the area that needs to be played back
+  if (mRecording && mLayers.empty())
+    mRecordedBounds.join(mClipMatrix.mapRect(SkiaRect(r)).roundOut());
+#endif
 }
 
 APIBitmap* IGraphicsSkia::CreateAPIBitmap(int width, int height, float scale, double drawScale, bool cacheable, int MSAASampleCount)
@@ -1099,7 +1306,18 @@ APIBitmap* IGraphicsSkia::CreateAPIBitmap(int width, int height, float scale, do
   return new Bitmap(std::move(surface), width, height, scale, drawScale);
 }
 
-void IGraphicsSkia::UpdateLayer() { mCanvas = mLayers.empty() ? mSurface->getCanvas() : mLayers.top()->GetAPIBitmap()->GetBitmap()->mSurface->getCanvas(); }
+void IGraphicsSkia::UpdateLayer()
+{
+#ifdef IGRAPHICS_CPU
+  if (mLayers.empty() && mRecording)
+  {
+    mCanvas = mRecorder.getRecordingCanvas();
+    return;
+  }
+#endif
+
+  mCanvas = mLayers.empty() ? mSurface->getCanvas() : mLayers.top()->GetAPIBitmap()->GetBitmap()->mSurface->getCanvas();
+}
 
 static size_t CalcRowBytes(int width)
 {
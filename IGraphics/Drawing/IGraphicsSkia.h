@@ -19,8 +19,15 @@
 #include "include/core/SkPath.h"
 #include "include/core/SkSurface.h"
 #include "include/gpu/GrDirectContext.h"
+#ifdef IGRAPHICS_CPU
+  #include "include/core/SkBBHFactory.h"
+  #include "include/core/SkPicture.h"
+  #include "include/core/SkPictureRecorder.h"
+#endif
 #pragma warning(pop)
 
+#include <memory>
+
 #if !defined IGRAPHICS_NO_SKIA_SKPARAGRAPH
   #include "modules/skparagraph/include/FontCollection.h"
   #include "modules/skparagraph/include/TypefaceFontProvider.h" // <-- ADD THIS LINE
@@ -56,6 +63,9 @@ class IGraphicsSkia : public IGraphics
 private:
   class Bitmap;
   struct Font;
+#ifdef IGRAPHICS_CPU
+  class TileRenderer;
+#endif
 
 public:
   IGraphicsSkia(IGEditorDelegate& dlg, int w, int h, int fps, float scale);
@@ -131,6 +141,22 @@ public:
 
   void DrawMultiLineText(const IText& text, const char* str, const IRECT& bounds, const IBlend* pBlend) override;
 
+#ifdef IGRAPHICS_CPU
+  /** Set the number of threads used to rasterize each frame. With more than one thread, each frame is recorded into an SkPicture,
+   * which is then played back in parallel into disjoint horizontal tiles of the dirty area of the backing surface.
+   * While recording, GetPoint() reads from the previous frame. Must be called on the UI thread, and not while drawing.
+   * The default is IGRAPHICS_SKIA_CPU_RENDER_THREADS, which is 1 unless defined otherwise
+   * @param nThreads The total number of render threads including the UI thread, or 1 to draw directly on the UI thread */
+  void SetNumRenderThreads(int nThreads);
+
+  /** @return The total number of render threads including the UI thread */
+  int GetNumRenderThreads() const;
+
+  /** Draw the dirty regions into the backing surface without presenting it to the window, for headless rendering and benchmarking
+   * @param rects The regions to draw, for instance as returned by IsDirty() */
+  void DrawOffscreen(IRECTList& rects);
+#endif
+
 protected:
   void CleanUpSkiaStatics();
   float DoMeasureText(const IText& text, const char* str, IRECT& bounds) const override;
@@ -149,6 +175,10 @@ private:
 
   void RenderPath(SkPaint& paint);
 
+#ifdef IGRAPHICS_CPU
+  void RenderRecording();
+#endif
+
   sk_sp<SkSurface> mSurface;
   SkCanvas* mCanvas = nullptr;
   SkPath mMainPath;
@@ -160,6 +190,15 @@ private:
   WDL_TypedBuf<uint8_t> mSurfaceMemory;
 #endif
 
+#ifdef IGRAPHICS_CPU
+  std::unique_ptr<TileRenderer> mTileRenderer;
+  SkPictureRecorder mRecorder;
+  SkRTreeFactory mRTreeFactory;
+  SkIRect mRecordedBounds; // pixel bounds of the main surface regions drawn while recording
+  bool mRecording = false;
+  bool mPresent = true;
+#endif
+
 #ifndef IGRAPHICS_CPU
   sk_sp<GrDirectContext> mGrContext;
   sk_sp<SkSurface> mScreenSurface;
@@ -115,10 +115,41 @@ int IControl::GetParamIdx(int valIdx) const
 void IControl::SetParamIdx(int paramIdx, int valIdx)
 {
   assert(valIdx > kNoValIdx && valIdx < NVals());
+  const int prevParamIdx = mVals.at(valIdx).idx;
   mVals.at(valIdx).idx = paramIdx;
+
+  if (mGraphics && paramIdx != prevParamIdx)
+    mGraphics->OnControlParamIdxChanged(this, valIdx, prevParamIdx);
+
   SetDirty(false);
 }
 
+void IControl::SetNVals(int nVals)
+{
+  assert(nVals > 0);
+
+  // Unlink any values that are about to be removed, so that the IGraphics parameter index doesn't refer to them
+  for (auto v = nVals; v < NVals(); v++)
+  {
+    const int prevParamIdx = mVals[v].idx;
+    mVals[v].idx = kNoParameter;
+
+    if (mGraphics && prevParamIdx > kNoParameter)
+      mGraphics->OnControlParamIdxChanged(this, v, prevParamIdx);
+  }
+
+  mVals.resize(nVals);
+}
+
+void IControl::SetWantsMidi(bool enable)
+{
+  const bool changed = (enable != mWantsMidi);
+  mWantsMidi = enable;
+
+  if (mGraphics && changed)
+    mGraphics->OnControlWantsMidiChanged(this);
+}
+
 const IParam* IControl::GetParam(int valIdx) const
 {
   int paramIdx = GetParamIdx(valIdx);
@@ -203,6 +234,9 @@ void IControl::SetDirty(bool triggerAction, int valIdx)
   ForValIdx(valIdx, setValue);
   
   mDirty = true;
+
+  if (mGraphics)
+    mGraphics->OnControlDirty(this);
   
   if (triggerAction)
   {
@@ -222,6 +256,20 @@ void IControl::SetDirty(bool triggerAction, int valIdx)
   }
 }
 
+void IControl::SetAnimation(IAnimationFunction func)
+{
+  mAnimationFunc = func;
+
+  if (mGraphics && func)
+    mGraphics->OnControlDirty(this);
+}
+
+void IControl::OnBoundsChanged()
+{
+  if (mGraphics)
+    mGraphics->OnControlBoundsChanged();
+}
+
 void IControl::Animate()
 {
   if (GetAnimationFunction())
@@ -101,6 +101,7 @@ void IGraphics::Resize(int w, int h, float scale, bool needsPlatformResize)
   mDrawScale = scale;
   mWidth = w;
   mHeight = h;
+  mSpatialIndexValid = false;
   
   if (mCornerResizer)
     mCornerResizer->OnRescale();
@@ -131,7 +132,12 @@ void IGraphics::SetScaleConstraints(float lo, float hi)
 
 void IGraphics::RemoveControlWithTag(int ctrlTag)
 {
-  mControls.DeletePtr(GetControlWithTag(ctrlTag), true);
+  IControl* pControl = GetControlWithTag(ctrlTag);
+
+  if (pControl)
+    RemoveFromControlIndexes(pControl);
+
+  mControls.DeletePtr(pControl, true);
   mCtrlTags.erase(ctrlTag);
   SetAllControlsDirty();
 }
@@ -158,6 +164,7 @@ void IGraphics::RemoveControls(int fromIdx)
     if(pControl->GetTag() > kNoTag)
       mCtrlTags.erase(pControl->GetTag());
     
+    RemoveFromControlIndexes(pControl);
     mControls.Delete(idx--, true);
   }
   
@@ -186,6 +193,7 @@ void IGraphics::RemoveControl(IControl* pControl)
   if(pControl->GetTag() > kNoTag)
     mCtrlTags.erase(pControl->GetTag());
   
+  RemoveFromControlIndexes(pControl);
   mControls.DeletePtr(pControl, true);
   
   SetAllControlsDirty();
@@ -208,6 +216,11 @@ void IGraphics::RemoveAllControls()
   mBubbleControls.Empty(true);
   
   mCtrlTags.clear();
+  mParamControls.clear();
+  mMidiControls.Empty();
+  mDirtyControls.clear();
+  mDirtyTrackedControls.clear();
+  mSpatialIndexValid = false;
   mControls.Empty(true);
 }
 
@@ -290,6 +303,7 @@ void IGraphics::AttachBackground(const char* fileName)
   IControl* pBG = new IBitmapControl(0, 0, LoadBitmap(fileName, 1, false), kNoParameter, EBlend::Default);
   pBG->SetDelegate(*GetDelegate());
   mControls.Insert(0, pBG);
+  AddToControlIndexes(pBG);
 }
 
 void IGraphics::AttachSVGBackground(const char* fileName)
@@ -297,6 +311,7 @@ void IGraphics::AttachSVGBackground(const char* fileName)
   IControl* pBG = new ISVGControl(GetBounds(), LoadSVG(fileName), true);
   pBG->SetDelegate(*GetDelegate());
   mControls.Insert(0, pBG);
+  AddToControlIndexes(pBG);
 }
 
 void IGraphics::AttachPanelBackground(const IPattern& color)
@@ -304,6 +319,7 @@ void IGraphics::AttachPanelBackground(const IPattern& color)
   IControl* pBG = new IPanelControl(GetBounds(), color);
   pBG->SetDelegate(*GetDelegate());
   mControls.Insert(0, pBG);
+  AddToControlIndexes(pBG);
 }
 
 IControl* IGraphics::AttachControl(IControl* pControl, int ctrlTag, const char* group, int zIndex)
@@ -331,6 +347,7 @@ IControl* IGraphics::AttachControl(IControl* pControl, int ctrlTag, const char*
     mControls.Insert(zIdx, pControl);
   }
 
+  AddToControlIndexes(pControl);
   pControl->OnAttached();
   return pControl;
 }
@@ -485,17 +502,12 @@ IControl* IGraphics::GetControlWithTag(int ctrlTag) const
 
 IControl* IGraphics::GetControlWithParamIdx(int paramIdx)
 {
-  for (auto c = 0; c < NControls(); c++)
-  {
-    IControl* pControl = GetControl(c);
+  auto it = mParamControls.find(paramIdx);
 
-    if (pControl->LinkedToParam(paramIdx) > kNoValIdx)
-    {
-      return pControl;
-    }
-  }
-  
-  return nullptr;
+  if (it == mParamControls.end() || it->second.empty())
+    return nullptr;
+
+  return it->second.front().first;
 }
 
 void IGraphics::HideControl(int paramIdx, bool hide)
@@ -510,33 +522,234 @@ void IGraphics::DisableControl(int paramIdx, bool disable)
 
 void IGraphics::ForControlWithParam(int paramIdx, IControlFunction func)
 {
-  for (auto c = 0; c < NControls(); c++)
+  ForControlValueWithParam(paramIdx, [paramIdx, &func](IControl* pControl, int valIdx) {
+    // Only visit a control once, even if several of its values are linked to the parameter
+    if (pControl->LinkedToParam(paramIdx) == valIdx)
+      func(pControl);
+  });
+}
+
+void IGraphics::ForControlWithParam(const std::initializer_list<int>& params, IControlFunction func)
+{
+  for (auto param : params)
   {
-    IControl* pControl = GetControl(c);
+    ForControlWithParam(param, func);
+  }
+}
+
+void IGraphics::ForControlValueWithParam(int paramIdx, const std::function<void(IControl* pControl, int valIdx)>& func)
+{
+  auto it = mParamControls.find(paramIdx);
+
+  if (it == mParamControls.end())
+    return;
+
+  // func may relink controls, so index rather than iterate. Entries for a paramIdx are never erased from the map, so the reference stays valid
+  const auto& entries = it->second;
+
+  for (size_t e = 0; e < entries.size(); e++)
+  {
+    func(entries[e].first, entries[e].second);
+  }
+}
+
+void IGraphics::ForMidiControls(IControlFunction func)
+{
+  for (auto c = 0; c < mMidiControls.GetSize(); c++)
+  {
+    func(mMidiControls.Get(c));
+  }
+}
+
+void IGraphics::OnControlParamIdxChanged(IControl* pControl, int valIdx, int prevParamIdx)
+{
+  const bool wasIndexed = RemoveFromParamIndex(pControl, valIdx, prevParamIdx);
+  const int paramIdx = pControl->GetParamIdx(valIdx);
+
+  // If the value wasn't linked before, only index it if the control is in the main control stack
+  if (paramIdx > kNoParameter && (wasIndexed || mControls.Find(pControl) > -1))
+  {
+    mParamControls[paramIdx].push_back(std::make_pair(pControl, valIdx));
+  }
+}
+
+void IGraphics::OnControlWantsMidiChanged(IControl* pControl)
+{
+  const int idx = mMidiControls.Find(pControl);
+
+  if (pControl->GetWantsMidi())
+  {
+    if (idx < 0 && mControls.Find(pControl) > -1)
+      mMidiControls.Add(pControl);
+  }
+  else if (idx > -1)
+  {
+    mMidiControls.Delete(idx);
+  }
+}
+
+void IGraphics::AddToControlIndexes(IControl* pControl)
+{
+  for (auto v = 0; v < pControl->NVals(); v++)
+  {
+    const int paramIdx = pControl->GetParamIdx(v);
+
+    if (paramIdx > kNoParameter)
+      mParamControls[paramIdx].push_back(std::make_pair(pControl, v));
+  }
+
+  if (pControl->GetWantsMidi())
+    mMidiControls.Add(pControl);
+
+  if (mEnableDirtyTracking)
+  {
+    mDirtyTrackedControls[pControl] = true;
+    mDirtyControls.push_back(pControl);
+  }
+
+  mSpatialIndexValid = false;
+}
+
+void IGraphics::RemoveFromControlIndexes(IControl* pControl)
+{
+  for (auto v = 0; v < pControl->NVals(); v++)
+  {
+    RemoveFromParamIndex(pControl, v, pControl->GetParamIdx(v));
+  }
+
+  mMidiControls.DeletePtr(pControl);
+
+  if (mEnableDirtyTracking)
+  {
+    auto it = mDirtyTrackedControls.find(pControl);
 
-    if (pControl->LinkedToParam(paramIdx) > kNoValIdx)
+    if (it != mDirtyTrackedControls.end())
     {
-      func(pControl);
-      // Could be more than one, don't break until we check them all.
+      if (it->second)
+        mDirtyControls.erase(std::find(mDirtyControls.begin(), mDirtyControls.end(), pControl));
+
+      mDirtyTrackedControls.erase(it);
     }
   }
+
+  mSpatialIndexValid = false;
 }
 
-void IGraphics::ForControlWithParam(const std::initializer_list<int>& params, IControlFunction func)
+void IGraphics::OnControlDirty(IControl* pControl)
+{
+  if (!mEnableDirtyTracking)
+    return;
+
+  // Special controls and controls that are not yet attached are not tracked
+  auto it = mDirtyTrackedControls.find(pControl);
+
+  if (it != mDirtyTrackedControls.end() && !it->second)
+  {
+    it->second = true;
+    mDirtyControls.push_back(pControl);
+  }
+}
+
+void IGraphics::EnableDirtyTracking(bool enable)
 {
+  mEnableDirtyTracking = enable;
+  mDirtyControls.clear();
+  mDirtyTrackedControls.clear();
+
+  if (enable)
+  {
+    // Start with every control tracked, the clean ones drop out on the next frame
+    for (auto c = 0; c < NControls(); c++)
+    {
+      IControl* pControl = GetControl(c);
+      mDirtyTrackedControls[pControl] = true;
+      mDirtyControls.push_back(pControl);
+    }
+  }
+}
+
+void IGraphics::EnableSpatialIndex(bool enable)
+{
+  mEnableSpatialIndex = enable;
+  mSpatialIndexValid = false;
+
+  if (!enable)
+    mSpatialIndexCells.clear();
+}
+
+void IGraphics::RebuildSpatialIndex()
+{
+  mSpatialIndexCols = std::max(1, static_cast<int>(std::ceil(Width() / SPATIAL_INDEX_CELL_SIZE)));
+  mSpatialIndexRows = std::max(1, static_cast<int>(std::ceil(Height() / SPATIAL_INDEX_CELL_SIZE)));
+  mSpatialIndexCells.resize(mSpatialIndexCols * mSpatialIndexRows);
+
+  for (auto& cell : mSpatialIndexCells)
+    cell.clear();
+
   for (auto c = 0; c < NControls(); c++)
   {
     IControl* pControl = GetControl(c);
+    const IRECT bounds = pControl->GetRECT().Union(pControl->GetTargetRECT());
+
+    if (bounds.Empty() || bounds.R < 0.f || bounds.B < 0.f || bounds.L >= Width() || bounds.T >= Height())
+      continue;
+
+    // Inclusive of the right and bottom edges, so that the cells are conservative
+    const int l = Clip(static_cast<int>(std::floor(bounds.L / SPATIAL_INDEX_CELL_SIZE)), 0, mSpatialIndexCols - 1);
+    const int r = Clip(static_cast<int>(std::floor(bounds.R / SPATIAL_INDEX_CELL_SIZE)), 0, mSpatialIndexCols - 1);
+    const int t = Clip(static_cast<int>(std::floor(bounds.T / SPATIAL_INDEX_CELL_SIZE)), 0, mSpatialIndexRows - 1);
+    const int b = Clip(static_cast<int>(std::floor(bounds.B / SPATIAL_INDEX_CELL_SIZE)), 0, mSpatialIndexRows - 1);
 
-    for (auto param : params)
+    for (auto row = t; row <= b; row++)
     {
-      if (pControl->LinkedToParam(param) > kNoValIdx)
-      {
-        func(pControl);
-        // Could be more than one, don't break until we check them all.
-      }
+      for (auto col = l; col <= r; col++)
+        mSpatialIndexCells[row * mSpatialIndexCols + col].push_back(c);
+    }
+  }
+
+  mSpatialIndexValid = true;
+}
+
+const std::vector<int>* IGraphics::GetSpatialIndexCell(float x, float y)
+{
+  if (!mSpatialIndexValid)
+    RebuildSpatialIndex();
+
+  // Points outside the grid fall back to a linear search
+  if (x < 0.f || y < 0.f)
+    return nullptr;
+
+  const int col = static_cast<int>(x / SPATIAL_INDEX_CELL_SIZE);
+  const int row = static_cast<int>(y / SPATIAL_INDEX_CELL_SIZE);
+
+  if (col >= mSpatialIndexCols || row >= mSpatialIndexRows)
+    return nullptr;
+
+  return &mSpatialIndexCells[row * mSpatialIndexCols + col];
+}
+
+bool IGraphics::RemoveFromParamIndex(IControl* pControl, int valIdx, int paramIdx)
+{
+  if (paramIdx <= kNoParameter)
+    return false;
+
+  auto it = mParamControls.find(paramIdx);
+
+  if (it == mParamControls.end())
+    return false;
+
+  auto& entries = it->second;
+
+  for (auto e = entries.begin(); e != entries.end(); ++e)
+  {
+    if (e->first == pControl && e->second == valIdx)
+    {
+      entries.erase(e);
+      return true;
     }
   }
+
+  return false;
 }
 
 void IGraphics::ForControlInGroup(const char* group, IControlFunction func)
@@ -563,7 +776,11 @@ void IGraphics::ForStandardControlsFunc(IControlFunction func)
 void IGraphics::ForAllControlsFunc(IControlFunction func)
 {
   ForStandardControlsFunc(func);
-  
+  ForSpecialControlsFunc(func);
+}
+
+void IGraphics::ForSpecialControlsFunc(IControlFunction func)
+{
   if (mPerfDisplay)
     func(mPerfDisplay.get());
   
@@ -609,7 +826,16 @@ void IGraphics::SetAllControlsDirty()
 
 void IGraphics::SetAllControlsClean()
 {
-  ForAllControls(&IControl::SetClean);
+  if (mEnableDirtyTracking)
+  {
+    // Untracked controls are already clean
+    for (auto* pControl : mDirtyControls)
+      pControl->SetClean();
+
+    ForSpecialControlsFunc([](IControl* pControl) { pControl->SetClean(); });
+  }
+  else
+    ForAllControls(&IControl::SetClean);
 }
 
 void IGraphics::AssignParamNameToolTips()
@@ -623,7 +849,7 @@ void IGraphics::AssignParamNameToolTips()
   ForStandardControlsFunc(func);
 }
 
-void IGraphics::UpdatePeers(IControl* pCaller, int callerValIdx) // TODO: this could be really slow
+void IGraphics::UpdatePeers(IControl* pCaller, int callerValIdx)
 {
   double value = pCaller->GetValue(callerValIdx);
   int paramIdx = pCaller->GetParamIdx(callerValIdx);
@@ -639,7 +865,7 @@ void IGraphics::UpdatePeers(IControl* pCaller, int callerValIdx) // TODO: this c
     }
   };
     
-  ForStandardControlsFunc(func);
+  ForControlWithParam(paramIdx, func);
 }
 
 void IGraphics::PromptUserInput(IControl& control, const IRECT& bounds, int valIdx)
@@ -845,32 +1071,69 @@ void IGraphics::PathRadialLine(float cx, float cy, float angle, float rMin, floa
   PathLine(data[0][0], data[0][1], data[1][0], data[1][1]);
 }
 
+bool IGraphics::AddDirtyRect(IControl* pControl, IRECTList& rects)
+{
+  if (!pControl->IsDirty())
+    return false;
+
+  // N.B padding outlines for single line outlines
+  auto rectToAdd = pControl->GetRECT().GetPadded(0.75);
+
+  if (pControl->GetParent())
+  {
+    rectToAdd.Clank(pControl->GetParent()->GetRECT().GetPadded(0.75));
+  }
+
+  rects.Add(rectToAdd);
+  return true;
+}
+
 bool IGraphics::IsDirty(IRECTList& rects)
 {
   if (mDisplayTickFunc)
     mDisplayTickFunc();
 
-  ForAllControlsFunc([](IControl* pControl) { pControl->Animate(); } );
-
   bool dirty = false;
-    
-  auto func = [&dirty, &rects](IControl* pControl) {
-    if (pControl->IsDirty())
+
+  auto func = [this, &dirty, &rects](IControl* pControl) {
+    if (AddDirtyRect(pControl, rects))
+      dirty = true;
+  };
+
+  if (mEnableDirtyTracking)
+  {
+    // Indexed loops, since animations may dirty other controls, adding to mDirtyControls
+    for (size_t i = 0; i < mDirtyControls.size(); i++)
+      mDirtyControls[i]->Animate();
+
+    ForSpecialControlsFunc([](IControl* pControl) { pControl->Animate(); });
+
+    // Controls stay tracked until they are neither dirty nor animating
+    size_t nTracked = 0;
+
+    for (size_t i = 0; i < mDirtyControls.size(); i++)
     {
-      // N.B padding outlines for single line outlines
-      auto rectToAdd = pControl->GetRECT().GetPadded(0.75);
-      
-      if (pControl->GetParent())
+      IControl* pControl = mDirtyControls[i];
+
+      if (AddDirtyRect(pControl, rects))
       {
-        rectToAdd.Clank(pControl->GetParent()->GetRECT().GetPadded(0.75));
+        mDirtyControls[nTracked++] = pControl;
+        dirty = true;
       }
-      
-      rects.Add(rectToAdd);
-      dirty = true;
+      else if (pControl->GetAnimationFunction())
+        mDirtyControls[nTracked++] = pControl;
+      else
+        mDirtyTrackedControls[pControl] = false;
     }
-  };
-    
-  ForAllControlsFunc(func);
+
+    mDirtyControls.resize(nTracked);
+    ForSpecialControlsFunc(func);
+  }
+  else
+  {
+    ForAllControlsFunc([](IControl* pControl) { pControl->Animate(); } );
+    ForAllControlsFunc(func);
+  }
 
 #ifdef USE_IDLE_CALLS
   if (dirty)
@@ -1312,11 +1575,9 @@ int IGraphics::GetMouseControlIdx(float x, float y, bool mouseOver)
 {
   if (!mouseOver || mEnableMouseOver)
   {
-    // Search from front to back
-    for (auto c = NControls() - 1; c >= (mouseOver ? 1 : 0); --c)
-    {
-      IControl* pControl = GetControl(c);
+    const int minIdx = mouseOver ? 1 : 0;
 
+    auto isHit = [&](IControl* pControl) {
 #ifndef NDEBUG
       if(!mLiveEdit)
       {
@@ -1325,19 +1586,38 @@ int IGraphics::GetMouseControlIdx(float x, float y, bool mouseOver)
         {
           if ((!pControl->IsDisabled() || (mouseOver ? pControl->GetMouseOverWhenDisabled() : pControl->GetMouseEventsWhenDisabled())))
           {
-            if (pControl->IsHit(x, y))
-            {
-              return c;
-            }
+            return pControl->IsHit(x, y);
           }
         }
 #ifndef NDEBUG
       }
       else if (pControl->GetRECT().Contains(x, y) && pControl->GetParent() == nullptr)
       {
-        return c;
+        return true;
       }
 #endif
+      return false;
+    };
+
+    const std::vector<int>* pCell = mEnableSpatialIndex ? GetSpatialIndexCell(x, y) : nullptr;
+
+    if (pCell)
+    {
+      // Cells are in z-order, search from front to back
+      for (auto i = static_cast<int>(pCell->size()) - 1; i >= 0 && (*pCell)[i] >= minIdx; --i)
+      {
+        if (isHit(GetControl((*pCell)[i])))
+          return (*pCell)[i];
+      }
+
+      return -1;
+    }
+
+    // Search from front to back
+    for (auto c = NControls() - 1; c >= minIdx; --c)
+    {
+      if (isHit(GetControl(c)))
+        return c;
     }
   }
   
@@ -2504,6 +2784,77 @@ void IGraphics::DrawData(const IColor& color, const IRECT& bounds, float* normYP
   PathStroke(color, thickness, IStrokeOptions(), pBlend);
 }
 
+// Build the path for DrawDataDecimated() from the points DecimateMinMax() keeps
+template <typename ValueFunc, typename MinMaxFunc>
+static void PathDecimatedData(IGraphics& g, const IRECT& bounds, int nPoints, const float* normXPoints, int nColumns, ValueFunc&& value, MinMaxFunc&& minMax)
+{
+  g.PathClear();
+
+  bool first = true;
+
+  DecimateMinMax(nPoints, normXPoints, nColumns, value, minMax, [&](float normX, float normY) {
+    const float x = bounds.L + (bounds.W() * normX);
+    const float y = bounds.B - (bounds.H() * normY);
+
+    if (first)
+      g.PathMoveTo(x, y);
+    else
+      g.PathLineTo(x, y);
+
+    first = false;
+  });
+}
+
+void IGraphics::DrawDataDecimated(const IColor& color, const IRECT& bounds, const float* normYPoints, int nPoints, const float* normXPoints, const IBlend* pBlend, float thickness, const IColor* pFillColor)
+{
+  const int nColumns = std::max(1, static_cast<int>(std::ceil(bounds.W() * GetBackingPixelScale())));
+
+  // with few points per column decimation saves nothing
+  if (nPoints <= 4 * nColumns)
+  {
+    DrawData(color, bounds, const_cast<float*>(normYPoints), nPoints, const_cast<float*>(normXPoints), pBlend, thickness, pFillColor);
+    return;
+  }
+
+  PathDecimatedData(*this, bounds, nPoints, normXPoints, nColumns,
+    [normYPoints](int idx) { return normYPoints[idx]; },
+    [normYPoints](int start, int end, float& min, float& max) { FindMinMax(normYPoints + start, end - start, min, max); });
+
+  if (pFillColor)
+  {
+    PathFill(*pFillColor, IFillOptions(true), pBlend);
+  }
+
+  PathStroke(color, thickness, IStrokeOptions(), pBlend);
+}
+
+void IGraphics::DrawDataDecimated(const IColor& color, const IRECT& bounds, const IDataLODPyramid& data, int startIdx, int endIdx, const IBlend* pBlend, float thickness, const IColor* pFillColor)
+{
+  startIdx = Clip(startIdx, 0, data.NPoints());
+  endIdx = Clip(endIdx, startIdx, data.NPoints());
+
+  const int nPoints = endIdx - startIdx;
+  const float* pData = data.GetData() + startIdx;
+  const int nColumns = std::max(1, static_cast<int>(std::ceil(bounds.W() * GetBackingPixelScale())));
+
+  if (nPoints <= 4 * nColumns)
+  {
+    DrawData(color, bounds, const_cast<float*>(pData), nPoints, nullptr, pBlend, thickness, pFillColor);
+    return;
+  }
+
+  PathDecimatedData(*this, bounds, nPoints, nullptr, nColumns,
+    [pData](int idx) { return pData[idx]; },
+    [&data, startIdx](int start, int end, float& min, float& max) { data.GetMinMax(startIdx + start, startIdx + end, min, max); });
+
+  if (pFillColor)
+  {
+    PathFill(*pFillColor, IFillOptions(true), pBlend);
+  }
+
+  PathStroke(color, thickness, IStrokeOptions(), pBlend);
+}
+
 void IGraphics::DrawDottedLine(const IColor& color, float x1, float y1, float x2, float y2, const IBlend* pBlend, float thickness, float dashLen)
 {
   PathClear();
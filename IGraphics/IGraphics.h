@@ -47,6 +47,7 @@
 #include "IGraphicsConstants.h"
 #include "IGraphicsStructs.h"
 #include "IGraphicsPopupMenu.h"
+#include "IGraphicsDecimation.h"
 #include "IGraphicsEditorDelegate.h"
 
 #include "nanosvg.h"
@@ -498,6 +499,31 @@ public:
    * @param thickness Optional line thickness
    * @param pFillColor Optional color for the fill area */
   virtual void DrawData(const IColor& color, const IRECT& bounds, float* normYPoints, int nPoints, float* normXPoints = nullptr, const IBlend* pBlend = 0, float thickness = 1.f, const IColor* pFillColor = nullptr);
+
+  /** Draw a line between a collection of normalized points, reduced to the first, smallest, largest and last point in each pixel column.
+   * Use this rather than DrawData() when there are many more points than pixels, e.g. for long waveforms or large FFTs.
+   * The path has at most four points per pixel column and covers the same pixels as DrawData(), to within a pixel, see DecimateMinMax()
+   * @param color The color to draw the line with
+   * @param bounds The rectangular region to draw the line in
+   * @param normYPoints Ptr to float array - the normalized Y positions of the points
+   * @param nPoints The number of points in the normYPoints / normXPoints
+   * @param normXPoints Optional normalized X positions of the points
+   * @param pBlend Optional blend method
+   * @param thickness Optional line thickness
+   * @param pFillColor Optional color for the fill area */
+  virtual void DrawDataDecimated(const IColor& color, const IRECT& bounds, const float* normYPoints, int nPoints, const float* normXPoints = nullptr, const IBlend* pBlend = 0, float thickness = 1.f, const IColor* pFillColor = nullptr);
+
+  /** Draw a range of a static data series, decimated like DrawDataDecimated() but using the extremes cached in an IDataLODPyramid,
+   * so that the cost depends on the width of the bounds rather than on the length of the range, e.g. when zooming into a waveform
+   * @param color The color to draw the line with
+   * @param bounds The rectangular region to draw the line in
+   * @param data The data series, holding normalized Y positions
+   * @param startIdx The index of the point drawn at the left of the bounds
+   * @param endIdx One past the index of the point drawn at the right of the bounds
+   * @param pBlend Optional blend method
+   * @param thickness Optional line thickness
+   * @param pFillColor Optional color for the fill area */
+  virtual void DrawDataDecimated(const IColor& color, const IRECT& bounds, const IDataLODPyramid& data, int startIdx, int endIdx, const IBlend* pBlend = 0, float thickness = 1.f, const IColor* pFillColor = nullptr);
   
   /** Load a font to be used by the graphics context
    * @param fontID A CString that will be used to reference the font
@@ -1301,6 +1327,31 @@ public:
    * @param func A std::function to perform on each control */
   void ForControlWithParam(const std::initializer_list<int>& params, IControlFunction func);
 
+  /** For each value of each standard control in the main control stack that is linked to a specific parameter, execute a function
+   * @param paramIdx The parameter index to match
+   * @param func A std::function to call with each control and the index of its value that is linked to paramIdx */
+  void ForControlValueWithParam(int paramIdx, const std::function<void(IControl* pControl, int valIdx)>& func);
+
+  /** For all standard controls in the main control stack that want MIDI messages, execute a function
+   * @param func A std::function to perform on each control */
+  void ForMidiControls(IControlFunction func);
+
+  /** Used internally by IControl::SetParamIdx() and IControl::SetNVals() to keep the parameter to control index up to date
+   * @param pControl The control whose value has changed parameter
+   * @param valIdx The value index within the control
+   * @param prevParamIdx The parameter the value was linked to before */
+  void OnControlParamIdxChanged(IControl* pControl, int valIdx, int prevParamIdx);
+
+  /** Used internally by IControl::SetWantsMidi() to keep the list of MIDI controls up to date */
+  void OnControlWantsMidiChanged(IControl* pControl);
+
+  /** Used internally by IControl when its draw or target bounds change, to invalidate the spatial index. See EnableSpatialIndex() */
+  void OnControlBoundsChanged() { mSpatialIndexValid = false; }
+
+  /** Used internally by IControl::SetDirty() and IControl::SetAnimation() to keep the list of tracked controls up to date. See EnableDirtyTracking()
+   * @param pControl The control that has become dirty or started animating */
+  void OnControlDirty(IControl* pControl);
+
   /** For all standard controls in the main control stack that are linked to a group, execute a function
    * @param group CString specifying the group name
    * @param func A std::function to perform on each control */
@@ -1484,7 +1535,7 @@ public:
   /** Calls SetDirty() on every control */
   void SetAllControlsDirty();
   
-  /** Calls SetClean() on every control */
+  /** Calls SetClean() on every control, or only on the controls that may be dirty if EnableDirtyTracking() is used */
   void SetAllControlsClean();
     
   /** Reposition a control, redrawing the interface correctly
@@ -1605,6 +1656,26 @@ public:
   /** @return \c true if the context has mouse overs enabled */
   bool MouseOverEnabled() const { return mEnableMouseOver; }
 
+  /** Enable a uniform grid over the bounds of the controls in the main control stack, so that finding the control under the mouse
+   * only tests the controls that overlap the grid cell containing the mouse, rather than every control. Worthwhile for UIs with very many controls.
+   * The grid is rebuilt lazily, the next time it is needed after a control is attached, removed, or changes bounds.
+   * NOTE: when enabled, a control will only receive mouse events at points within the union of its draw and target RECTs, whatever its IsHit() returns
+   * @param enable Set \c true to use the spatial index */
+  void EnableSpatialIndex(bool enable);
+
+  /** @return \c true if the context uses a spatial index to find the control under the mouse */
+  bool SpatialIndexEnabled() const { return mEnableSpatialIndex; }
+
+  /** Enable tracking of dirty and animating controls, so that each frame IsDirty() only visits the controls in the main control stack that have
+   * been marked dirty or have an animation, rather than every control. Worthwhile for UIs with very many controls.
+   * NOTE: when enabled, a control that overrides IControl::IsDirty() must call SetDirty() when it first becomes dirty, after which it will be polled until IsDirty() returns \c false.
+   * A control with an animation function stays tracked, so its animation can poll for changes and call SetDirty() itself, see IVScopeControl::SetRingBufferSender()
+   * @param enable Set \c true to track dirty controls */
+  void EnableDirtyTracking(bool enable);
+
+  /** @return \c true if the context tracks dirty and animating controls */
+  bool DirtyTrackingEnabled() const { return mEnableDirtyTracking; }
+
   /** @return An integer representing the control index in IGraphics::mControls which the mouse is over, or -1 if it is not */
   inline int GetMouseOver() const { return mMouseOverIdx; }
 
@@ -1805,8 +1876,23 @@ private:
     mMouseOverIdx = -1;
   }
   
+  void AddToControlIndexes(IControl* pControl);
+  void RemoveFromControlIndexes(IControl* pControl);
+  bool RemoveFromParamIndex(IControl* pControl, int valIdx, int paramIdx);
+  void ForSpecialControlsFunc(IControlFunction func);
+  void RebuildSpatialIndex();
+  const std::vector<int>* GetSpatialIndexCell(float x, float y);
+  bool AddDirtyRect(IControl* pControl, IRECTList& rects);
+
   WDL_PtrList<IControl> mControls;
   std::unordered_map<int, IControl*> mCtrlTags;
+  std::unordered_map<int, std::vector<std::pair<IControl*, int>>> mParamControls; // paramIdx -> (control, valIdx) for all the values in mControls linked to a parameter
+  WDL_PtrList<IControl> mMidiControls; // controls in mControls that want MIDI
+  std::vector<std::vector<int>> mSpatialIndexCells; // indexes into mControls, in z-order, for the controls overlapping each grid cell
+  int mSpatialIndexCols = 0;
+  int mSpatialIndexRows = 0;
+  std::vector<IControl*> mDirtyControls; // controls in mControls that may be dirty or animating, only used with dirty tracking
+  std::unordered_map<IControl*, bool> mDirtyTrackedControls; // all controls in mControls, and whether they are in mDirtyControls
 
   // Order (front-to-back) ToolTip / PopUp / TextEntry / LiveEdit / Corner / PerfDisplay
   std::unique_ptr<ICornerResizerControl> mCornerResizer;
@@ -1856,6 +1942,9 @@ private:
   bool mResizingInProcess = false;
   bool mLayoutOnResize = false;
   bool mEnableMultiTouch = false;
+  bool mEnableSpatialIndex = false;
+  bool mSpatialIndexValid = false;
+  bool mEnableDirtyTracking = false;
   EUIResizerMode mGUISizeMode = EUIResizerMode::Scale;
   double mPrevTimestamp = 0.;
   IKeyHandlerFunc mKeyHandlerFunc = nullptr;
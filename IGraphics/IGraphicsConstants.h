@@ -23,6 +23,9 @@ static constexpr int IDLE_TICKS = 20;
 
 static constexpr int DEFAULT_ANIMATION_DURATION = 100;
 
+// Size in points of the cells in the grid used to find the control under the mouse, if EnableSpatialIndex() is used.
+static constexpr float SPATIAL_INDEX_CELL_SIZE = 32.f;
+
 #ifndef CONTROL_BOUNDS_COLOR
 #define CONTROL_BOUNDS_COLOR COLOR_GREEN
 #endif
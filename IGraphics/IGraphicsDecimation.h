@@ -0,0 +1,332 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @brief Min/max decimation of data series to pixel columns, used by IGraphics::DrawDataDecimated()
+ * Define IPLUG_SIMDE at project level in order to use SSE2 instructions for the min/max search, and if on non-x86_64
+ * include the SIMDE library in your search paths in order to translate intel intrinsics to e.g. arm64.
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+#if defined IPLUG_SIMDE
+  #if defined(__arm64__)
+    #define SIMDE_ENABLE_NATIVE_ALIASES
+    #include "simde/x86/sse2.h"
+  #else
+    #include <emmintrin.h>
+  #endif
+#endif
+
+#include "IPlugPlatform.h"
+
+BEGIN_IPLUG_NAMESPACE
+BEGIN_IGRAPHICS_NAMESPACE
+
+/** Find the smallest and largest of a range of values, four at a time, using SSE2 instructions with IPLUG_SIMDE
+ * @param pData The values
+ * @param n The number of values, at least one
+ * @param min Set to the smallest value
+ * @param max Set to the largest value */
+static inline void FindMinMax(const float* pData, int n, float& min, float& max)
+{
+  assert(n > 0);
+
+  int i = 0;
+  float lo = pData[0];
+  float hi = pData[0];
+
+#ifdef IPLUG_SIMDE
+  if (n >= 8)
+  {
+    __m128 vLo = _mm_loadu_ps(pData);
+    __m128 vHi = vLo;
+
+    for (i = 4; i + 4 <= n; i += 4)
+    {
+      const __m128 v = _mm_loadu_ps(pData + i);
+      vLo = _mm_min_ps(vLo, v);
+      vHi = _mm_max_ps(vHi, v);
+    }
+
+    vLo = _mm_min_ps(vLo, _mm_movehl_ps(vLo, vLo));
+    vLo = _mm_min_ss(vLo, _mm_shuffle_ps(vLo, vLo, 1));
+    vHi = _mm_max_ps(vHi, _mm_movehl_ps(vHi, vHi));
+    vHi = _mm_max_ss(vHi, _mm_shuffle_ps(vHi, vHi, 1));
+    lo = _mm_cvtss_f32(vLo);
+    hi = _mm_cvtss_f32(vHi);
+  }
+#else
+  if (n >= 8)
+  {
+    // four independent lanes, so the comparisons don't wait on each other
+    float vLo[4] = {pData[0], pData[1], pData[2], pData[3]};
+    float vHi[4] = {pData[0], pData[1], pData[2], pData[3]};
+
+    for (i = 4; i + 4 <= n; i += 4)
+    {
+      for (int k = 0; k < 4; k++)
+      {
+        vLo[k] = std::min(vLo[k], pData[i + k]);
+        vHi[k] = std::max(vHi[k], pData[i + k]);
+      }
+    }
+
+    lo = std::min(std::min(vLo[0], vLo[1]), std::min(vLo[2], vLo[3]));
+    hi = std::max(std::max(vHi[0], vHi[1]), std::max(vHi[2], vHi[3]));
+  }
+#endif
+
+  for (; i < n; i++)
+  {
+    lo = std::min(lo, pData[i]);
+    hi = std::max(hi, pData[i]);
+  }
+
+  min = lo;
+  max = hi;
+}
+
+/** IDataLODPyramid keeps a copy of a static data series, e.g. a sample waveform, together with the minimum and maximum of every
+ * aligned block of 16, 32, 64... values. The extremes of any range can then be found in O(log n), so drawing a zoomed view with
+ * IGraphics::DrawDataDecimated() costs O(pixels) rather than O(values). Build it once, not on every draw */
+class IDataLODPyramid
+{
+public:
+  IDataLODPyramid() = default;
+
+  /** Constructs an IDataLODPyramid from a data series, see SetData() */
+  IDataLODPyramid(const float* pData, int nPoints)
+  {
+    SetData(pData, nPoints);
+  }
+
+  /** Copy a data series and build the pyramid. This allocates, so call it when the data changes rather than when drawing
+   * @param pData The values, normalized if they will be drawn with IGraphics::DrawDataDecimated()
+   * @param nPoints The number of values */
+  void SetData(const float* pData, int nPoints)
+  {
+    mData.assign(pData, pData + nPoints);
+    mLevels.clear();
+
+    // level 0 holds the extremes of blocks of kBaseBlockSize values, each further level halves the number of blocks
+    int nBlocks = (nPoints + kBaseBlockSize - 1) / kBaseBlockSize;
+
+    if (nBlocks < 2)
+      return;
+
+    mLevels.emplace_back(2 * nBlocks);
+
+    for (int b = 0; b < nBlocks; b++)
+    {
+      const int start = b * kBaseBlockSize;
+      FindMinMax(pData + start, std::min(kBaseBlockSize, nPoints - start), mLevels[0][2 * b], mLevels[0][2 * b + 1]);
+    }
+
+    while (nBlocks > 1)
+    {
+      const std::vector<float>& below = mLevels.back();
+      const int nBelow = nBlocks;
+      nBlocks = (nBlocks + 1) / 2;
+      std::vector<float> level(2 * nBlocks);
+
+      for (int b = 0; b < nBlocks; b++)
+      {
+        const int b2 = std::min(2 * b + 1, nBelow - 1);
+        level[2 * b] = std::min(below[4 * b], below[2 * b2]);
+        level[2 * b + 1] = std::max(below[4 * b + 1], below[2 * b2 + 1]);
+      }
+
+      mLevels.push_back(std::move(level));
+    }
+  }
+
+  /** @return The number of values */
+  int NPoints() const { return static_cast<int>(mData.size()); }
+
+  /** @return The values */
+  const float* GetData() const { return mData.data(); }
+
+  /** Find the smallest and largest values in a range
+   * @param start The first index of the range
+   * @param end One past the last index of the range, greater than start
+   * @param min Set to the smallest value
+   * @param max Set to the largest value */
+  void GetMinMax(int start, int end, float& min, float& max) const
+  {
+    assert(start >= 0 && start < end && end <= NPoints());
+
+    int blockStart = (start + kBaseBlockSize - 1) / kBaseBlockSize;
+    int blockEnd = end / kBaseBlockSize;
+
+    if (blockEnd - blockStart < 2 || mLevels.empty())
+    {
+      FindMinMax(mData.data() + start, end - start, min, max);
+      return;
+    }
+
+    // the unaligned ends come from the values, the aligned middle from the largest blocks that fit
+    FindMinMax(mData.data() + blockStart * kBaseBlockSize, kBaseBlockSize, min, max);
+    float lo, hi;
+
+    auto merge = [&](float blockLo, float blockHi) {
+      min = std::min(min, blockLo);
+      max = std::max(max, blockHi);
+    };
+
+    if (start < blockStart * kBaseBlockSize)
+    {
+      FindMinMax(mData.data() + start, blockStart * kBaseBlockSize - start, lo, hi);
+      merge(lo, hi);
+    }
+
+    if (blockEnd * kBaseBlockSize < end)
+    {
+      FindMinMax(mData.data() + blockEnd * kBaseBlockSize, end - blockEnd * kBaseBlockSize, lo, hi);
+      merge(lo, hi);
+    }
+
+    for (size_t l = 0; l < mLevels.size() && blockStart < blockEnd; l++)
+    {
+      const std::vector<float>& level = mLevels[l];
+
+      if (blockStart & 1)
+      {
+        merge(level[2 * blockStart], level[2 * blockStart + 1]);
+        blockStart++;
+      }
+
+      if (blockEnd & 1)
+      {
+        blockEnd--;
+        merge(level[2 * blockEnd], level[2 * blockEnd + 1]);
+      }
+
+      blockStart >>= 1;
+      blockEnd >>= 1;
+    }
+  }
+
+private:
+  static constexpr int kBaseBlockSize = 16;
+
+  std::vector<float> mData;
+  std::vector<std::vector<float>> mLevels; // interleaved min, max of each block, the blocks of level l are kBaseBlockSize << l values long
+};
+
+/** Reduce a data series to at most four points per pixel column: the first, smallest, largest and last value that falls in the column.
+ * Because the points where the line enters and leaves each column are kept exactly, and the line within a column still spans
+ * its smallest and largest value, drawing the result covers the same pixels as drawing every point, to within a pixel.
+ * @param nPoints The number of points in the series
+ * @param normXPoints Optional normalized X positions of the points, if nullptr the points are evenly spaced from 0 to 1
+ * @param nColumns The number of pixel columns that normalized X positions 0 to 1 span
+ * @param value A function float(int idx) returning the Y value of a point
+ * @param minMax A function void(int start, int end, float& min, float& max) finding the extremes of the Y values in [start, end)
+ * @param addPoint A function void(float normX, float y) called for each point of the reduced series, in order */
+template <typename ValueFunc, typename MinMaxFunc, typename PointFunc>
+void DecimateMinMax(int nPoints, const float* normXPoints, int nColumns, ValueFunc&& value, MinMaxFunc&& minMax, PointFunc&& addPoint)
+{
+  if (nPoints <= 0)
+    return;
+
+  if (nPoints == 1)
+  {
+    addPoint(normXPoints ? normXPoints[0] : 0.f, value(0));
+    return;
+  }
+
+  const float xScale = 1.f / static_cast<float>(nPoints - 1);
+
+  auto getX = [&](int idx) {
+    return normXPoints ? normXPoints[idx] : static_cast<float>(idx) * xScale;
+  };
+
+  auto addColumn = [&](int start, int end) {
+    if (end - start <= 4)
+    {
+      for (int i = start; i < end; i++)
+        addPoint(getX(i), value(i));
+
+      return;
+    }
+
+    float lo, hi;
+    minMax(start, end, lo, hi);
+    const float first = value(start);
+    const float last = value(end - 1);
+    const float xFirst = getX(start);
+    const float xLast = getX(end - 1);
+    const float xMid = 0.5f * (xFirst + xLast);
+
+    addPoint(xFirst, first);
+
+    // visit the extremes in whichever order makes the shorter line
+    if ((first - lo) + (hi - last) <= (hi - first) + (last - lo))
+    {
+      addPoint(xMid, lo);
+      addPoint(xMid, hi);
+    }
+    else
+    {
+      addPoint(xMid, hi);
+      addPoint(xMid, lo);
+    }
+
+    addPoint(xLast, last);
+  };
+
+  if (!normXPoints)
+  {
+    // column c starts at the first point i with i * nColumns >= c * (nPoints - 1)
+    const int64_t spanX = nPoints - 1;
+    int start = 0;
+
+    for (int c = 0; c < nColumns; c++)
+    {
+      const int end = (c == nColumns - 1) ? nPoints : static_cast<int>(((c + 1) * spanX + nColumns - 1) / nColumns);
+
+      if (end > start)
+        addColumn(start, end);
+
+      start = end;
+    }
+  }
+  else
+  {
+    // group runs of consecutive points that fall in the same column, so X positions need not be sorted
+    auto getColumn = [&](int idx) {
+      return std::min(std::max(static_cast<int>(normXPoints[idx] * nColumns), 0), nColumns - 1);
+    };
+
+    int start = 0;
+    int column = getColumn(0);
+
+    for (int i = 1; i <= nPoints; i++)
+    {
+      const int nextColumn = (i < nPoints) ? getColumn(i) : -1;
+
+      if (nextColumn != column)
+      {
+        addColumn(start, i);
+        start = i;
+        column = nextColumn;
+      }
+    }
+  }
+}
+
+END_IGRAPHICS_NAMESPACE
+END_IPLUG_NAMESPACE
@@ -111,22 +111,9 @@ void IGEditorDelegate::SendParameterValueFromDelegate(int paramIdx, double value
     if (!normalized)
       value = GetParam(paramIdx)->ToNormalized(value);
 
-    for (int c = 0; c < mGraphics->NControls(); c++)
-    {
-      IControl* pControl = mGraphics->GetControl(c);
-      
-      int nVals = pControl->NVals();
-      
-      for(int v = 0; v < nVals; v++)
-      {
-        if (pControl->GetParamIdx(v) == paramIdx)
-        {
-          pControl->SetValueFromDelegate(value, v);
-          // Could be more than one, don't break until we check them all.
-        }
-      }
-
-    }
+    mGraphics->ForControlValueWithParam(paramIdx, [value](IControl* pControl, int valIdx) {
+      pControl->SetValueFromDelegate(value, valIdx);
+    });
   }
   
   IEditorDelegate::SendParameterValueFromDelegate(paramIdx, value, normalized);
@@ -136,15 +123,9 @@ void IGEditorDelegate::SendMidiMsgFromDelegate(const IMidiMsg& msg)
 {
   if(mGraphics)
   {
-    for (auto c = 0; c < mGraphics->NControls(); c++) // TODO: could keep a map
-    {
-      IControl* pControl = mGraphics->GetControl(c);
-      
-      if (pControl->GetWantsMidi())
-      {
-        pControl->OnMidi(msg);
-      }
-    }
+    mGraphics->ForMidiControls([&msg](IControl* pControl) {
+      pControl->OnMidi(msg);
+    });
   }
   
   IEditorDelegate::SendMidiMsgFromDelegate(msg);
@@ -16,6 +16,7 @@
  * @{
  */
 
+#include <algorithm>
 #include <functional>
 #include <chrono>
 #include <numeric>
@@ -1894,104 +1895,162 @@ public:
     return true;
   }
   
-  /** Remove rects that are contained by other rects and intersections and merge any rects that can be merged */
+  /** Replace the rects with a set of non-overlapping rects covering exactly the same area.
+   * The area is split into horizontal bands at the top and bottom edges of the rects. Within each band the overlapping and touching spans of the rects are merged,
+   * and a span that matches a span in the band directly above extends that band's rect downwards, so columns and rows of adjacent rects are coalesced. */
   void Optimize()
   {
-    for (int i = 0; i < Size(); i++)
+    if (Size() < 2)
+      return;
+
+    mInput.Resize(0, false);
+    mEdges.Resize(0, false);
+
+    for (auto i = 0; i < Size(); i++)
     {
-      for (int j = i + 1; j < Size(); j++)
+      const IRECT& r = Get(i);
+
+      if (r.W() > 0.f && r.H() > 0.f)
       {
-        if (Get(i).Contains(Get(j)))
-        {
-          mRects.Delete(j);
-          j--;
-        }
-        else if (Get(j).Contains(Get(i)))
-        {
-          mRects.Delete(i);
-          i--;
-          break;
-        }
-        else if (Get(i).Intersects(Get(j)))
-        {
-          IRECT intersection = Get(i).Intersect(Get(j));
-            
-          if (Get(i).Mergeable(intersection))
-            Set(i, Shrink(Get(i), intersection));
-          else if (Get(j).Mergeable(intersection))
-            Set(j, Shrink(Get(j), intersection));
-          else if (Get(i).Area() < Get(j).Area())
-            Set(i, Split(Get(i), intersection));
-          else
-            Set(j, Split(Get(j), intersection));
-        }
+        mInput.Add(r);
+        mEdges.Add(r.T);
+        mEdges.Add(r.B);
       }
     }
-    
-    for (int i = 0; i < Size(); i++)
+
+    auto compareL = [](const IRECT& a, const IRECT& b) { return a.L < b.L; };
+    IRECT* pInput = mInput.Get();
+    float* pEdges = mEdges.Get();
+    const int nInput = mInput.GetSize();
+    std::sort(pInput, pInput + nInput, [](const IRECT& a, const IRECT& b) { return a.T < b.T || (a.T == b.T && a.L < b.L); });
+    std::sort(pEdges, pEdges + mEdges.GetSize());
+    const int nEdges = static_cast<int>(std::unique(pEdges, pEdges + mEdges.GetSize()) - pEdges);
+
+    mRects.Resize(0, false);
+    mActive.Resize(0, false);
+    mPrevSpans.Resize(0, false);
+
+    int nextInput = 0;
+
+    for (auto e = 0; e < nEdges - 1; e++)
     {
-      for (int j = i + 1; j < Size(); j++)
+      const float top = pEdges[e];
+      const float bottom = pEdges[e + 1];
+
+      // Update the rects that span this band, keeping them sorted by L. The edges include every top, so rects start exactly at the top of a band
+      int nActive = 0;
+
+      for (auto a = 0; a < mActive.GetSize(); a++)
       {
-        if (Get(i).Mergeable(Get(j)))
-        {
-          Set(j, Get(i).Union(Get(j)));
-          mRects.Delete(i);
-          i = -1;
-          break;
-        }
+        if (mActive.Get()[a].B > top)
+          mActive.Get()[nActive++] = mActive.Get()[a];
       }
-    }
-  }
-  
-private:
-  /** \todo 
-   * @param r \todo
-   * @param i \todo
-   * @return IRECT \todo */
-  IRECT Shrink(const IRECT &r, const IRECT &i)
-  {
-    if (i.L != r.L)
-      return IRECT(r.L, r.T, i.L, r.B);
-    if (i.T != r.T)
-      return IRECT(r.L, r.T, r.R, i.T);
-    if (i.R != r.R)
-      return IRECT(i.R, r.T, r.R, r.B);
-    return IRECT(r.L, i.B, r.R, r.B);
-  }
-  
-  /** \todo 
-   * @param r \todo
-   * @param i \todo
-   * @return IRECT \todo */
-  IRECT Split(const IRECT r, const IRECT &i)
-  {
-    if (r.L == i.L)
-    {
-      if (r.T == i.T)
+
+      mActive.Resize(nActive, false);
+
+      const int firstNew = nActive;
+
+      while (nextInput < nInput && pInput[nextInput].T <= top)
+        mActive.Add(pInput[nextInput++]);
+
+      IRECT* pActive = mActive.Get();
+      nActive = mActive.GetSize();
+
+      // New rects arrive sorted by L, so insert them into the sorted rects from the back
+      for (auto a = firstNew; a < nActive; a++)
       {
-        Add(IRECT(i.R, r.T, r.R, i.B));
-        return IRECT(r.L, i.B, r.R, r.B);
+        const IRECT r = pActive[a];
+        auto b = a;
+
+        for (; b > 0 && compareL(r, pActive[b - 1]); b--)
+          pActive[b] = pActive[b - 1];
+
+        pActive[b] = r;
       }
-      else
+
+      // Merge the spans of the active rects, extending the rects of matching spans in the band above (which must touch this one, or be empty)
+      mSpans.Resize(0, false);
+      int prevSpan = 0;
+      const int nPrevSpans = mPrevSpans.GetSize();
+
+      auto addSpan = [&](float l, float r) {
+        while (prevSpan < nPrevSpans && mPrevSpans.Get()[prevSpan].L < l)
+          prevSpan++;
+
+        IRECT span(l, top, r, bottom);
+
+        if (prevSpan < nPrevSpans && mPrevSpans.Get()[prevSpan].L == l && mPrevSpans.Get()[prevSpan].R == r)
+        {
+          // For a matching span, T holds the index of the rect to extend
+          const int rectIdx = static_cast<int>(mPrevSpans.Get()[prevSpan].T);
+          mRects.Get()[rectIdx].B = bottom;
+          span.T = static_cast<float>(rectIdx);
+        }
+        else
+        {
+          span.T = static_cast<float>(Size());
+          Add(IRECT(l, top, r, bottom));
+        }
+
+        mSpans.Add(span);
+      };
+
+      if (nActive)
       {
-        Add(IRECT(r.L, r.T, r.R, i.T));
-        return IRECT(i.R, i.T, r.R, r.B);
+        float spanL = pActive[0].L;
+        float spanR = pActive[0].R;
+        float spanRBottom = pActive[0].B; // the lowest bottom of the rects reaching spanR
+        int nKept = 1;
+
+        for (auto a = 1; a < nActive; a++)
+        {
+          const IRECT& r = pActive[a];
+
+          if (r.L <= spanR)
+          {
+            // A rect inside the span that ends no lower than a rect reaching spanR adds nothing to any later band either, so drop it
+            if (r.R < spanR || (r.R == spanR && r.B <= spanRBottom))
+            {
+              if (r.B <= spanRBottom)
+                continue;
+            }
+            else
+            {
+              spanR = r.R;
+              spanRBottom = r.B;
+            }
+
+            if (r.R == spanR)
+              spanRBottom = std::max(spanRBottom, r.B);
+          }
+          else
+          {
+            addSpan(spanL, spanR);
+            spanL = r.L;
+            spanR = r.R;
+            spanRBottom = r.B;
+          }
+
+          pActive[nKept++] = r;
+        }
+
+        addSpan(spanL, spanR);
+        mActive.Resize(nKept, false);
       }
-    }
-    
-    if (r.T == i.T)
-    {
-      Add(IRECT(r.L, r.T, i.L, i.B));
-      return IRECT(r.L, i.B, r.R, r.B);
-    }
-    else
-    {
-      Add(IRECT(r.L, r.T, r.R, i.T));
-      return IRECT(r.L, i.T, i.L, r.B);
+
+      mPrevSpans.Resize(0, false);
+      mPrevSpans.Add(mSpans.Get(), mSpans.GetSize());
     }
   }
   
+private:
   WDL_TypedBuf<IRECT> mRects;
+  // Scratch storage for Optimize(), kept to avoid allocating each frame
+  WDL_TypedBuf<IRECT> mInput;
+  WDL_TypedBuf<IRECT> mActive;
+  WDL_TypedBuf<IRECT> mSpans;
+  WDL_TypedBuf<IRECT> mPrevSpans;
+  WDL_TypedBuf<float> mEdges;
 };
 
 /** Used to store transformation matrices */
@@ -361,6 +361,7 @@ void IPlugAAX::RenderAudio(AAX_SIPlugRenderInfo* pRenderInfo, const TParamValPai
       ProcessMidiMsg(msg);
     }
     
+    APPLY_PARAMS_SNAPSHOT
     ENTER_PARAMS_MUTEX
     ProcessBuffers(0.0f, numSamples);
     LEAVE_PARAMS_MUTEX
@@ -166,6 +166,7 @@ void IPlugAPP::AppProcess(double** inputs, double** outputs, int nFrames)
 
   //Do not handle Sysex messages here - SendSysexMsgFromUI overridden
 
+  APPLY_PARAMS_SNAPSHOT
   ENTER_PARAMS_MUTEX
   ProcessBuffers(0.0, GetBlockSize());
   LEAVE_PARAMS_MUTEX
@@ -1754,6 +1754,7 @@ OSStatus IPlugAU::RenderProc(void* pPlug, AudioUnitRenderActionFlags* pFlags, co
       }
       
       _this->PreProcess();
+      APPLY_PARAMS_SNAPSHOT_STATIC
       ENTER_PARAMS_MUTEX_STATIC
       _this->ProcessBuffers((AudioSampleType) 0, nFrames);
       LEAVE_PARAMS_MUTEX_STATIC
@@ -2262,6 +2263,7 @@ OSStatus IPlugAU::DoInitialize(IPlugAU* _this)
   _this->mActive = true;
   _this->OnParamReset(kReset);
   _this->OnActivate(true);
+  SET_PARAMS_SNAPSHOT_PROCESSING_STATIC(true)
   
   return noErr;
 }
@@ -2271,6 +2273,7 @@ OSStatus IPlugAU::DoUninitialize(IPlugAU* _this)
 {
   _this->mActive = false;
   _this->OnActivate(false);
+  SET_PARAMS_SNAPSHOT_PROCESSING_STATIC(false)
   return noErr;
 }
 
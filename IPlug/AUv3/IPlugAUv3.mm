@@ -172,6 +172,7 @@ void IPlugAUv3::ProcessWithEvents(AudioTimeStamp const* pTimestamp, uint32_t fra
     }
   }
 
+  APPLY_PARAMS_SNAPSHOT
   ENTER_PARAMS_MUTEX;
   ProcessBuffers(0.f, framesRemaining); // what about bufferOffset
   LEAVE_PARAMS_MUTEX;
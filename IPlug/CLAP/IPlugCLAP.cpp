@@ -143,6 +143,20 @@ bool IPlugCLAP::SendSysEx(const ISysEx& msg)
   return true;
 }
 
+void IPlugCLAP::ApplyParamEvent(const IParamEvent& event)
+{
+  IParam* pParam = GetParam(event.idx);
+  const bool isDoubleType = pParam->Type() == IParam::kTypeDouble;
+  
+  if (isDoubleType)
+    pParam->SetNormalized(event.value);
+  else
+    pParam->Set(event.value);
+  
+  SendParameterValueFromAPI(event.idx, event.value, isDoubleType);
+  OnParamChange(event.idx, EParamSource::kHost, event.offset);
+}
+
 // clap_plugin
 bool IPlugCLAP::init() noexcept
 {
@@ -158,6 +172,7 @@ bool IPlugCLAP::activate(double sampleRate, uint32_t minFrameCount, uint32_t max
   OnActivate(true);
   OnParamReset(kReset);
   OnReset();
+  SET_PARAMS_SNAPSHOT_PROCESSING(true)
 
   mHostHasTail = GetClapHost().canUseTail();
   mTailCount = 0;
@@ -168,6 +183,7 @@ bool IPlugCLAP::activate(double sampleRate, uint32_t minFrameCount, uint32_t max
 void IPlugCLAP::deactivate() noexcept
 {
   OnActivate(false);
+  SET_PARAMS_SNAPSHOT_PROCESSING(false)
   
   if (mLatencyUpdate)
   {
@@ -235,8 +251,10 @@ clap_process_status IPlugCLAP::process(const clap_process* pProcess) noexcept
     SetTimeInfo(timeInfo);
   }
   
+  APPLY_PARAMS_SNAPSHOT
+
   // Input Events
-  ProcessInputEvents(pProcess->in_events);
+  ProcessInputEvents(pProcess->in_events, true);
   
   while (mMidiMsgsFromEditor.Pop(msg))
   {
@@ -518,7 +536,7 @@ void IPlugCLAP::paramsFlush(const clap_input_events* pInputParamChanges, const c
   ProcessOutputParams(pOutputParamChanges);
 }
 
-void IPlugCLAP::ProcessInputEvents(const clap_input_events* pInputEvents) noexcept
+void IPlugCLAP::ProcessInputEvents(const clap_input_events* pInputEvents, bool inProcess) noexcept
 {
   IMidiMsg msg;
 
@@ -578,16 +596,9 @@ void IPlugCLAP::ProcessInputEvents(const clap_input_events* pInputEvents) noexce
           int paramIdx = pParamValue->param_id;
           double value = pParamValue->value;
           
-          IParam* pParam = GetParam(paramIdx);
-          const bool isDoubleType = pParam->Type() == IParam::kTypeDouble;
-          
-          if (isDoubleType)
-            pParam->SetNormalized(value);
-          else
-            pParam->Set(value);
-          
-          SendParameterValueFromAPI(paramIdx, value, isDoubleType);
-          OnParamChange(paramIdx, EParamSource::kHost, pEvent->time);
+          // When sample accurate, the change is applied between sub-blocks in ProcessBuffers()
+          if (!(inProcess && EnqueueParamEvent(paramIdx, value, pEvent->time)))
+            ApplyParamEvent(IParamEvent(paramIdx, value, pEvent->time));
           break;
         }
           
@@ -96,6 +96,7 @@ public:
   void SetLatency(int samples) override;
   bool SendMidiMsg(const IMidiMsg& msg) override;
   bool SendSysEx(const ISysEx& msg) override;
+  void ApplyParamEvent(const IParamEvent& event) override;
 
 private:
   // clap_plugin
@@ -179,7 +180,7 @@ private:
   void FlushParamsIfNeeded();
 
   // Parameter Helpers
-  void ProcessInputEvents(const clap_input_events* pInputEvents) noexcept;
+  void ProcessInputEvents(const clap_input_events* pInputEvents, bool inProcess = false) noexcept;
   void ProcessOutputParams(const clap_output_events* pOutputParamChanges) noexcept;
   void ProcessOutputEvents(const clap_output_events* pOutputEvents, int nFrames) noexcept;
 
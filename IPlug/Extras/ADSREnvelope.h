@@ -13,8 +13,10 @@
 #include "IPlugPlatform.h"
 #include "IPlugUtilities.h"
 
-#include <functional>
+#include <algorithm>
+#include <climits>
 #include <cmath>
+#include <limits>
 
 BEGIN_IPLUG_NAMESPACE
 
@@ -22,6 +24,10 @@ template <typename T>
 class ADSREnvelope
 {
 public:
+  /** A hook called on the audio thread by the envelope, see SetResetFunc() and SetEndReleaseFunc()
+   * @param pContext The context pointer that was supplied with the hook */
+  using HookFunc = void(*)(void* pContext);
+
   enum EStage
   {
     kReleasedToEndEarly = -3,
@@ -63,18 +69,22 @@ private:
   bool mReleased = true;
   bool mSustainEnabled = true; // when false env is AD only
   
-  std::function<void()> mResetFunc = nullptr; // reset func
-  std::function<void()> mEndReleaseFunc = nullptr; // end release func
+  HookFunc mResetFunc = nullptr; // reset func
+  HookFunc mEndReleaseFunc = nullptr; // end release func
+  void* mResetContext = nullptr;
+  void* mEndReleaseContext = nullptr;
 
 public:
   /** Constructs an ADSREnvelope object 
   * @param name CString to identify the envelope in debug mode, when DEBUG_ENV=1 is set as a global preprocessor macro
   * @param resetFunc A function to call when the envelope gets retriggered, called when the fade out ramp is at zero, useful for example to reset an oscillator's phase
-  * @param sustainEnabled if true the envelope is an ADSR envelope. If false, it's is an AD envelope (suitable for drums). */
-  ADSREnvelope(const char* name = "", std::function<void()> resetFunc = nullptr, bool sustainEnabled = true)
+  * @param sustainEnabled if true the envelope is an ADSR envelope. If false, it's is an AD envelope (suitable for drums).
+  * @param pResetContext The pointer passed to resetFunc */
+  ADSREnvelope(const char* name = "", HookFunc resetFunc = nullptr, bool sustainEnabled = true, void* pResetContext = nullptr)
   : mName(name)
-  , mResetFunc(resetFunc)
   , mSustainEnabled(sustainEnabled)
+  , mResetFunc(resetFunc)
+  , mResetContext(pResetContext)
   {
     SetSampleRate(44100.);
   }
@@ -200,14 +210,23 @@ public:
   }
 
   /** Sets a function to call when the envelope gets retriggered, called when the fade out ramp is at zero, useful for example to reset an oscillator's phase
-   * WARNING: don't call this on the audio thread, std::function can malloc
-   * @param func the reset function, or nullptr for none */
-  void SetResetFunc(std::function<void()> func) { mResetFunc = func; }
+   * @param func the reset function, or nullptr for none
+   * @param pContext the pointer passed to func, e.g. the voice that owns the envelope */
+  void SetResetFunc(HookFunc func, void* pContext = nullptr) { mResetFunc = func; mResetContext = pContext; }
+
+  /** Sets a member function of pObject to call when the envelope gets retriggered, e.g. SetResetFunc<Voice, &Voice::ResetPhase>(this)
+   * The call is resolved at compile time, through a trampoline */
+  template <class C, void (C::*Method)()>
+  void SetResetFunc(C* pObject) { SetResetFunc(&CallMember<C, Method>, pObject); }
   
   /** Sets a function to call when the envelope gets released, called when the ramp is at zero
-   * WARNING: don't call this on the audio thread, std::function can malloc
-   * @param func the release function, or nullptr for none */
-  void SetEndReleaseFunc(std::function<void()> func) { mEndReleaseFunc = func; }
+   * @param func the release function, or nullptr for none
+   * @param pContext the pointer passed to func */
+  void SetEndReleaseFunc(HookFunc func, void* pContext = nullptr) { mEndReleaseFunc = func; mEndReleaseContext = pContext; }
+
+  /** Sets a member function of pObject to call when the envelope gets released, e.g. SetEndReleaseFunc<Voice, &Voice::Free>(this) */
+  template <class C, void (C::*Method)()>
+  void SetEndReleaseFunc(C* pObject) { SetEndReleaseFunc(&CallMember<C, Method>, pObject); }
   
   /** Process the envelope, returning the value according to the current envelope stage
   * @param sustainLevel Since the sustain level could be changed during processing, it is supplied as an argument, so that it can be smoothed extenally if nessecary, to avoid discontinuities */
@@ -255,7 +274,7 @@ public:
           mEnvValue = 0.;
           
           if(mEndReleaseFunc)
-            mEndReleaseFunc();
+            mEndReleaseFunc(mEndReleaseContext);
         }
         result = mEnvValue * mReleaseLevel;
         break;
@@ -270,7 +289,7 @@ public:
           mReleaseLevel = 0.;
           
           if(mResetFunc)
-            mResetFunc();
+            mResetFunc(mResetContext);
         }
         result = mEnvValue * mReleaseLevel;
         break;
@@ -284,7 +303,7 @@ public:
           mPrevResult = 0.;
           mReleaseLevel = 0.;
           if(mEndReleaseFunc)
-            mEndReleaseFunc();
+            mEndReleaseFunc(mEndReleaseContext);
         }
         result = mEnvValue * mReleaseLevel;
         break;
@@ -298,7 +317,186 @@ public:
     return mPrevOutput;
   }
 
+  /** Process a block of the envelope. Gives the same output as calling Process() for each sample, but each stage is rendered
+   * with a tight loop for as many samples as it can't end in, so the stage logic only runs at the stage boundaries
+   * @param pOutput The output buffer, nFrames long
+   * @param sustainLevel The sustain level, constant for the block */
+  void ProcessBlock(T* pOutput, int nFrames, T sustainLevel = 0.)
+  {
+    ProcessBlock(pOutput, nFrames, &sustainLevel, 0);
+  }
+
+  /** Process a block of the envelope, with a per-sample sustain level, e.g. from a smoother
+   * @param pOutput The output buffer, nFrames long
+   * @param pSustainLevels The sustain level for each sample, nFrames long */
+  void ProcessBlock(T* pOutput, int nFrames, const T* pSustainLevels)
+  {
+    ProcessBlock(pOutput, nFrames, pSustainLevels, 1);
+  }
+
+  /** Process a block of several envelopes, e.g. one per voice. Envelopes that are idle for the whole block are only filled
+   * @param envelopes nEnvelopes envelopes
+   * @param outputs One buffer of nFrames per envelope. Envelopes with a nullptr buffer are skipped, and don't advance
+   * @param sustainLevel The sustain level, constant for the block
+   * @return The number of envelopes that are still busy at the end of the block */
+  static int ProcessBlocks(ADSREnvelope* envelopes, T* const* outputs, int nEnvelopes, int nFrames, T sustainLevel = 0.)
+  {
+    int nBusy = 0;
+
+    for (auto e = 0; e < nEnvelopes; e++)
+    {
+      if (!outputs[e])
+        continue;
+
+      envelopes[e].ProcessBlock(outputs[e], nFrames, sustainLevel);
+      nBusy += envelopes[e].GetBusy();
+    }
+
+    return nBusy;
+  }
+
 private:
+  template <class C, void (C::*Method)()>
+  static void CallMember(void* pObject)
+  {
+    (static_cast<C*>(pObject)->*Method)();
+  }
+
+  void ProcessBlock(T* pOutput, int nFrames, const T* pSustain, int sustainStride)
+  {
+    int s = 0;
+
+    while (s < nFrames)
+    {
+      const int run = std::min(GetSafeRunLength(), nFrames - s);
+
+      if (run > 0)
+      {
+        RenderRun(pOutput + s, run, pSustain + (s * sustainStride), sustainStride);
+        s += run;
+      }
+
+      // the stage may end on this sample, so let Process() handle the transition
+      if (s < nFrames)
+      {
+        pOutput[s] = Process(pSustain[s * sustainStride]);
+        s++;
+      }
+    }
+  }
+
+  /** @return The number of samples that the current stage can be rendered for without any chance of meeting its end condition.
+   * The bounds allow for the rounding of one epsilon per sample, so RenderRun() never overshoots a stage boundary */
+  int GetSafeRunLength() const
+  {
+    constexpr double eps = 4. * std::numeric_limits<T>::epsilon();
+    const double env = mEnvValue;
+    double run = 0.;
+
+    switch (mStage)
+    {
+      case kIdle:
+      case kSustain:
+        return INT_MAX;
+      case kAttack:
+        if (mAttackIncr != 0.)
+          run = (ENV_VALUE_HIGH - env) / (static_cast<double>(mAttackIncr * mScalar) + eps);
+        break;
+      case kDecay:
+      case kRelease:
+      {
+        const T incr = (mStage == kDecay) ? mDecayIncr : mReleaseIncr;
+        const double ratio = (1. - static_cast<double>(incr * mScalar)) * (1. - eps);
+
+        if (incr != 0. && ratio > 0. && env > ENV_VALUE_LOW)
+          run = std::log(ENV_VALUE_LOW / env) / std::log(ratio);
+        break;
+      }
+      case kReleasedToRetrigger:
+        run = (env - ENV_VALUE_LOW) / (static_cast<double>(mRetriggerReleaseIncr) + eps);
+        break;
+      case kReleasedToEndEarly:
+        run = (env - ENV_VALUE_LOW) / (static_cast<double>(mEarlyReleaseIncr) + eps);
+        break;
+      default:
+        break;
+    }
+
+    return (run > 1.) ? static_cast<int>(std::min(run - 1., static_cast<double>(INT_MAX))) : 0;
+  }
+
+  /** Render nFrames of the current stage, which must not end within them, see GetSafeRunLength() */
+  void RenderRun(T* pOutput, int nFrames, const T* pSustain, int sustainStride)
+  {
+    T env = mEnvValue;
+    T result = 0.;
+
+    switch (mStage)
+    {
+      case kAttack:
+      {
+        const T incr = mAttackIncr * mScalar;
+
+        for (auto s = 0; s < nFrames; s++)
+        {
+          env += incr;
+          pOutput[s] = env * mLevel;
+        }
+
+        result = env;
+        break;
+      }
+      case kDecay:
+        for (auto s = 0; s < nFrames; s++)
+        {
+          const T sustainLevel = pSustain[s * sustainStride];
+          env -= ((mDecayIncr * env) * mScalar);
+          result = (env * (1. - sustainLevel)) + sustainLevel;
+          pOutput[s] = result * mLevel;
+        }
+        break;
+      case kSustain:
+        for (auto s = 0; s < nFrames; s++)
+        {
+          result = pSustain[s * sustainStride];
+          pOutput[s] = result * mLevel;
+        }
+        break;
+      case kRelease:
+        for (auto s = 0; s < nFrames; s++)
+        {
+          env -= ((mReleaseIncr * env) * mScalar);
+          pOutput[s] = (env * mReleaseLevel) * mLevel;
+        }
+
+        result = env * mReleaseLevel;
+        break;
+      case kReleasedToRetrigger:
+      case kReleasedToEndEarly:
+      {
+        const T incr = (mStage == kReleasedToRetrigger) ? mRetriggerReleaseIncr : mEarlyReleaseIncr;
+
+        for (auto s = 0; s < nFrames; s++)
+        {
+          env -= incr;
+          pOutput[s] = (env * mReleaseLevel) * mLevel;
+        }
+
+        result = env * mReleaseLevel;
+        break;
+      }
+      case kIdle:
+      default:
+        result = env;
+        std::fill(pOutput, pOutput + nFrames, result * mLevel);
+        break;
+    }
+
+    mEnvValue = env;
+    mPrevResult = result;
+    mPrevOutput = result * mLevel;
+  }
+
   inline T CalcIncrFromTimeLinear(T timeMS, T sr) const
   {
     if (timeMS <= 0.) return 0.;
@@ -0,0 +1,163 @@
+/*
+MultiDownsampler2x.h
+
+Downsamples by a factor 2 several channels at once, one channel per SIMD
+lane. Produces the same output as one Downsampler2xFPU per channel.
+
+Template parameters:
+- NC: number of coefficients, > 0
+- T: sample type, float or double
+
+--- Legal stuff ---
+
+This program is free software. It comes without any warranty, to
+the extent permitted by applicable law. You can redistribute it
+and/or modify it under the terms of the Do What The Fuck You Want
+To Public License, Version 2, as published by Sam Hocevar. See
+http://sam.zoy.org/wtfpl/COPYING for more details.
+
+*/
+
+#pragma once
+
+#include <cassert>
+#include "MultiStageProc.h"
+
+namespace hiir
+{
+
+template <int NC, typename T>
+class Downsampler2xMulti
+{
+public:
+
+  enum { NBR_COEFS = NC };
+  enum { NBR_CHANS = LaneVec <T>::NBR_LANES };
+
+  Downsampler2xMulti ();
+
+  /*
+  Name: set_coefs
+  Description:
+  Sets filter coefficients, for all channels. Generate them with the
+  PolyphaseIir2Designer class.
+  Call this function before doing any processing.
+  Input parameters:
+  - coef_arr: Array of coefficients. There should be as many coefficients as
+  mentioned in the class template parameter.
+  */
+  void set_coefs (const double coef_arr [NBR_COEFS]);
+
+  /*
+  Name: process_block
+  Description:
+  Downsamples (x2) NBR_CHANS non-interleaved blocks of samples.
+  Input and output blocks of a channel may overlap, as for
+  Downsampler2xFPU::process_block().
+  Input parameters:
+  - in_ptr_arr: NBR_CHANS input arrays, containing nbr_spl * 2 samples each.
+  - nbr_spl: Number of samples to output, > 0
+  Output parameters:
+  - out_ptr_arr: NBR_CHANS output arrays, capacity: nbr_spl samples each.
+  */
+  void process_block (T * const out_ptr_arr [], const T * const in_ptr_arr [], long nbr_spl);
+
+  /*
+  Name: clear_buffers
+  Description:
+  Clears filter memory, as if it processed silence since an infinite amount
+  of time.
+  */
+  void clear_buffers ();
+
+private:
+  typedef LaneVec <T> LV;
+  typedef typename LV::Vec Vec;
+
+  T _coef [NBR_COEFS * NBR_CHANS];
+  T _x [NBR_COEFS * NBR_CHANS];
+  T _y [NBR_COEFS * NBR_CHANS];
+
+private:
+  bool operator == (const Downsampler2xMulti &other);
+  bool operator != (const Downsampler2xMulti &other);
+
+};  // class Downsampler2xMulti
+
+template <int NC, typename T>
+Downsampler2xMulti <NC, T>::Downsampler2xMulti ()
+{
+  for (int i = 0; i < NBR_COEFS * NBR_CHANS; ++i)
+  {
+    _coef [i] = 0;
+  }
+  clear_buffers ();
+}
+
+template <int NC, typename T>
+void Downsampler2xMulti <NC, T>::set_coefs (const double coef_arr [NBR_COEFS])
+{
+  assert (coef_arr != 0);
+
+  for (int i = 0; i < NBR_COEFS; ++i)
+  {
+    for (int c = 0; c < NBR_CHANS; ++c)
+    {
+      _coef [i * NBR_CHANS + c] = static_cast <T> (coef_arr [i]);
+    }
+  }
+}
+
+template <int NC, typename T>
+void Downsampler2xMulti <NC, T>::process_block (T * const out_ptr_arr [], const T * const in_ptr_arr [], long nbr_spl)
+{
+  assert (out_ptr_arr != 0);
+  assert (in_ptr_arr != 0);
+  assert (nbr_spl > 0);
+
+  Vec coef [NBR_COEFS];
+  Vec x [NBR_COEFS];
+  Vec y [NBR_COEFS];
+
+  for (int i = 0; i < NBR_COEFS; ++i)
+  {
+    coef [i] = LV::load (&_coef [i * NBR_CHANS]);
+    x [i] = LV::load (&_x [i * NBR_CHANS]);
+    y [i] = LV::load (&_y [i * NBR_CHANS]);
+  }
+
+  const Vec half = LV::set1 (static_cast <T> (0.5f));
+  T lanes [NBR_CHANS];
+
+  for (long pos = 0; pos < nbr_spl; ++pos)
+  {
+    Vec spl_0 = LV::gather (in_ptr_arr, pos * 2 + 1);
+    Vec spl_1 = LV::gather (in_ptr_arr, pos * 2);
+
+    StageProcMulti <NBR_COEFS, T>::process_sample_pos (spl_0, spl_1, coef, x, y);
+
+    LV::store (lanes, LV::mul (half, LV::add (spl_0, spl_1)));
+    for (int c = 0; c < NBR_CHANS; ++c)
+    {
+      out_ptr_arr [c] [pos] = lanes [c];
+    }
+  }
+
+  for (int i = 0; i < NBR_COEFS; ++i)
+  {
+    LV::store (&_x [i * NBR_CHANS], x [i]);
+    LV::store (&_y [i * NBR_CHANS], y [i]);
+  }
+}
+
+template <int NC, typename T>
+void Downsampler2xMulti <NC, T>::clear_buffers ()
+{
+  for (int i = 0; i < NBR_COEFS * NBR_CHANS; ++i)
+  {
+    _x [i] = 0;
+    _y [i] = 0;
+  }
+}
+
+} // namespace hiir
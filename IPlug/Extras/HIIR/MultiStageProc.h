@@ -0,0 +1,168 @@
+/*
+        MultiStageProc.h
+
+Multi-channel versions of the StageProcFPU allpass chains. Each SIMD lane
+holds one channel, so a single pass through the chain filters NBR_LANES
+channels at once. The arithmetic is identical to StageProcFPU, lane by lane.
+
+Define IPLUG_SIMDE at project level in order to use SSE2 (or AVX, if the
+compiler targets it) and, if on non-x86_64, include the SIMDE library in
+your search paths in order to translate intel intrinsics to e.g. arm64 NEON.
+Without IPLUG_SIMDE, LaneVec<T>::NBR_LANES is 1 and the multi-channel
+classes are plain scalar filters.
+
+Template parameters:
+  - T: sample type, float or double
+
+  --- Legal stuff ---
+
+This program is free software. It comes without any warranty, to
+the extent permitted by applicable law. You can redistribute it
+and/or modify it under the terms of the Do What The Fuck You Want
+To Public License, Version 2, as published by Sam Hocevar. See
+http://sam.zoy.org/wtfpl/COPYING for more details.
+
+*/
+
+#pragma once
+
+#if defined IPLUG_SIMDE
+  #if defined(__arm64__)
+    #define SIMDE_ENABLE_NATIVE_ALIASES
+    #include "simde/x86/sse2.h"
+  #elif defined(__AVX__)
+    #include <immintrin.h>
+  #else
+    #include <emmintrin.h>
+  #endif
+#endif
+
+namespace hiir
+{
+
+/*
+LaneVec<T> wraps the widest available vector of T. Loads and stores are
+unaligned. gather() builds a vector from sample pos of NBR_LANES separate
+channel buffers.
+*/
+template <typename T>
+struct LaneVec
+{
+  enum { NBR_LANES = 1 };
+  typedef T Vec;
+  static inline Vec load (const T *ptr) { return *ptr; }
+  static inline Vec gather (const T * const ptr_arr [], long pos) { return ptr_arr [0] [pos]; }
+  static inline void store (T *ptr, Vec v) { *ptr = v; }
+  static inline Vec set1 (T val) { return val; }
+  static inline Vec add (Vec a, Vec b) { return a + b; }
+  static inline Vec sub (Vec a, Vec b) { return a - b; }
+  static inline Vec mul (Vec a, Vec b) { return a * b; }
+};
+
+#if defined IPLUG_SIMDE
+#if defined(__AVX__) && !defined(__arm64__)
+template <>
+struct LaneVec <float>
+{
+  enum { NBR_LANES = 8 };
+  typedef __m256 Vec;
+  static inline Vec load (const float *ptr) { return _mm256_loadu_ps (ptr); }
+  static inline Vec gather (const float * const p [], long pos) { return _mm256_set_ps (p [7] [pos], p [6] [pos], p [5] [pos], p [4] [pos], p [3] [pos], p [2] [pos], p [1] [pos], p [0] [pos]); }
+  static inline void store (float *ptr, Vec v) { _mm256_storeu_ps (ptr, v); }
+  static inline Vec set1 (float val) { return _mm256_set1_ps (val); }
+  static inline Vec add (Vec a, Vec b) { return _mm256_add_ps (a, b); }
+  static inline Vec sub (Vec a, Vec b) { return _mm256_sub_ps (a, b); }
+  static inline Vec mul (Vec a, Vec b) { return _mm256_mul_ps (a, b); }
+};
+
+template <>
+struct LaneVec <double>
+{
+  enum { NBR_LANES = 4 };
+  typedef __m256d Vec;
+  static inline Vec load (const double *ptr) { return _mm256_loadu_pd (ptr); }
+  static inline Vec gather (const double * const p [], long pos) { return _mm256_set_pd (p [3] [pos], p [2] [pos], p [1] [pos], p [0] [pos]); }
+  static inline void store (double *ptr, Vec v) { _mm256_storeu_pd (ptr, v); }
+  static inline Vec set1 (double val) { return _mm256_set1_pd (val); }
+  static inline Vec add (Vec a, Vec b) { return _mm256_add_pd (a, b); }
+  static inline Vec sub (Vec a, Vec b) { return _mm256_sub_pd (a, b); }
+  static inline Vec mul (Vec a, Vec b) { return _mm256_mul_pd (a, b); }
+};
+#else
+template <>
+struct LaneVec <float>
+{
+  enum { NBR_LANES = 4 };
+  typedef __m128 Vec;
+  static inline Vec load (const float *ptr) { return _mm_loadu_ps (ptr); }
+  static inline Vec gather (const float * const p [], long pos) { return _mm_set_ps (p [3] [pos], p [2] [pos], p [1] [pos], p [0] [pos]); }
+  static inline void store (float *ptr, Vec v) { _mm_storeu_ps (ptr, v); }
+  static inline Vec set1 (float val) { return _mm_set1_ps (val); }
+  static inline Vec add (Vec a, Vec b) { return _mm_add_ps (a, b); }
+  static inline Vec sub (Vec a, Vec b) { return _mm_sub_ps (a, b); }
+  static inline Vec mul (Vec a, Vec b) { return _mm_mul_ps (a, b); }
+};
+
+template <>
+struct LaneVec <double>
+{
+  enum { NBR_LANES = 2 };
+  typedef __m128d Vec;
+  static inline Vec load (const double *ptr) { return _mm_loadu_pd (ptr); }
+  static inline Vec gather (const double * const p [], long pos) { return _mm_set_pd (p [1] [pos], p [0] [pos]); }
+  static inline void store (double *ptr, Vec v) { _mm_storeu_pd (ptr, v); }
+  static inline Vec set1 (double val) { return _mm_set1_pd (val); }
+  static inline Vec add (Vec a, Vec b) { return _mm_add_pd (a, b); }
+  static inline Vec sub (Vec a, Vec b) { return _mm_sub_pd (a, b); }
+  static inline Vec mul (Vec a, Vec b) { return _mm_mul_pd (a, b); }
+};
+#endif
+#endif
+
+/*
+Runs the two interleaved allpass chains of StageProcFPU::process_sample_pos
+on vectors of channels: spl_0 goes through the even coefficients, spl_1
+through the odd ones. The state arrays hold one vector per coefficient.
+*/
+template <int NC, typename T>
+class StageProcMulti
+{
+public:
+  typedef LaneVec <T> LV;
+  typedef typename LV::Vec Vec;
+
+  static inline void process_sample_pos (Vec &spl_0, Vec &spl_1, const Vec coef [], Vec x [], Vec y [])
+  {
+    int cnt = 0;
+
+    for (; cnt + 1 < NC; cnt += 2)
+    {
+      const Vec temp_0 = LV::add (LV::mul (LV::sub (spl_0, y [cnt + 0]), coef [cnt + 0]), x [cnt + 0]);
+      const Vec temp_1 = LV::add (LV::mul (LV::sub (spl_1, y [cnt + 1]), coef [cnt + 1]), x [cnt + 1]);
+
+      x [cnt + 0] = spl_0;
+      x [cnt + 1] = spl_1;
+
+      y [cnt + 0] = temp_0;
+      y [cnt + 1] = temp_1;
+
+      spl_0 = temp_0;
+      spl_1 = temp_1;
+    }
+
+    if (NC & 1)
+    {
+      const Vec temp = LV::add (LV::mul (LV::sub (spl_0, y [NC - 1]), coef [NC - 1]), x [NC - 1]);
+      x [NC - 1] = spl_0;
+      y [NC - 1] = temp;
+      spl_0 = temp;
+    }
+  }
+
+private:
+  StageProcMulti ();
+  StageProcMulti (const StageProcMulti &other);
+  StageProcMulti& operator = (const StageProcMulti &other);
+};
+
+} // namespace hiir
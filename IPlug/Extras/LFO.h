@@ -12,9 +12,11 @@
 
 /**
  * @file
- * @brief Basic unoptimized tempo-syncable LFO implementation
+ * @brief Tempo-syncable LFO implementation, and a bank of LFOs
  */
 
+#include <vector>
+
 #include "Oscillator.h"
 
 BEGIN_IPLUG_NAMESPACE
@@ -109,37 +111,82 @@ public:
     return DoProcess(IOscillator<T>::mPhase);
   }
 
-  /* Block process function */
+  /** Block process function. The phase of each frame is computed directly from the phase at the start of the block,
+   * then a kernel specialized for the shape and polarity is run over the block, so both loops are branch-free and can auto-vectorize */
   void ProcessBlock(T* pOutput, int nFrames, double qnPos = 0., bool transportIsRunning = false, double tempo = 120.)
   {
-    T oneOverQNScalar = 1./mQNScalar;
-    T phase = IOscillator<T>::mPhase;
+    if (nFrames <= 0)
+      return;
     
     if(mRateMode == ERateMode::kBPM && !transportIsRunning)
       IOscillator<T>::SetFreqCPS(tempo/60.);
     
-    double samplesPerBeat = IOscillator<T>::mSampleRate * (60.0 / (tempo == 0.0 ? 1.0 : tempo)); // samples per beat
+    double start, incr;
+    GetBlockPhase(IOscillator<T>::mPhase, IOscillator<T>::mPhaseIncr, IOscillator<T>::mSampleRate, mQNScalar, mRateMode, qnPos, transportIsRunning, tempo, start, incr);
     
-    T phaseIncr = IOscillator<T>::mPhaseIncr;
-
-    for (int s=0; s<nFrames; s++)
+    IOscillator<T>::mPhase = FillPhases(pOutput, nFrames, start, incr);
+    RenderShape(pOutput, nFrames, mShape, mPolarity, mLevelScalar);
+    mLastOutput = pOutput[nFrames - 1];
+  }
+  
+  /** Get the phase of the first frame of a block, and the per-frame phase increment
+   * @param phase The phase at the end of the previous block
+   * @param phaseIncr The per-frame phase increment in Hz mode, or for 1 quarter note per second in BPM mode */
+  static inline void GetBlockPhase(double phase, double phaseIncr, double sampleRate, T qnScalar, ERateMode rateMode, double qnPos, bool transportIsRunning, double tempo, double& start, double& incr)
+  {
+    if (rateMode == ERateMode::kBPM)
     {
-      double sampleAccurateQnPos = qnPos + ((double) s / samplesPerBeat);
-
-      if(mRateMode == ERateMode::kBPM)
+      if (transportIsRunning)
       {
-        if(transportIsRunning)
-          phase = std::fmod(sampleAccurateQnPos, oneOverQNScalar) / oneOverQNScalar;
-        else
-          phase = WrapPhase(phase + (phaseIncr * mQNScalar));
+        // Locked to the transport, the first frame is at qnPos rather than one increment on from the previous block
+        const double samplesPerBeat = sampleRate * (60.0 / (tempo == 0.0 ? 1.0 : tempo));
+        start = WrapPhaseFast(qnPos * qnScalar);
+        incr = qnScalar / samplesPerBeat;
+        return;
       }
-      else
-        phase = WrapPhase(phase + phaseIncr);
       
-      pOutput[s] = DoProcess(phase);
+      phaseIncr *= qnScalar;
     }
     
-    IOscillator<T>::mPhase = phase;
+    start = WrapPhaseFast(phase + phaseIncr);
+    incr = phaseIncr;
+  }
+  
+  /** Fill pPhase with the phase of each frame, wrapped to [0, 1)
+   * @return The phase of the last frame */
+  static inline double FillPhases(T* pPhase, int nFrames, double start, double incr)
+  {
+    for (int s=0; s<nFrames; s++)
+      pPhase[s] = (T) WrapPhaseFast(start + ((double) s * incr));
+    
+    return WrapPhaseFast(start + ((double) (nFrames - 1) * incr));
+  }
+  
+  /** Replace the phases in pBuffer with the LFO output for the given shape and polarity, scaled by scalar */
+  static void RenderShape(T* pBuffer, int nFrames, EShape shape, EPolarity polarity, T scalar)
+  {
+    if(polarity == EPolarity::kUnipolar)
+    {
+      switch (shape) {
+        case kTriangle: ShapeKernel<kTriangle, false>(pBuffer, nFrames, scalar); break;
+        case kSquare:   ShapeKernel<kSquare, false>(pBuffer, nFrames, scalar); break;
+        case kRampUp:   ShapeKernel<kRampUp, false>(pBuffer, nFrames, scalar); break;
+        case kRampDown: ShapeKernel<kRampDown, false>(pBuffer, nFrames, scalar); break;
+        case kSine:     ShapeKernel<kSine, false>(pBuffer, nFrames, scalar); break;
+        default: break;
+      }
+    }
+    else
+    {
+      switch (shape) {
+        case kTriangle: ShapeKernel<kTriangle, true>(pBuffer, nFrames, scalar); break;
+        case kSquare:   ShapeKernel<kSquare, true>(pBuffer, nFrames, scalar); break;
+        case kRampUp:   ShapeKernel<kRampUp, true>(pBuffer, nFrames, scalar); break;
+        case kRampDown: ShapeKernel<kRampDown, true>(pBuffer, nFrames, scalar); break;
+        case kSine:     ShapeKernel<kSine, true>(pBuffer, nFrames, scalar); break;
+        default: break;
+      }
+    }
   }
   
   void SetShape(int lfoShape)
@@ -177,6 +224,27 @@ public:
     return mLastOutput;
   }
   
+  /** Wrap a phase to [0, 1) without a loop. Valid for |x| < 2^31 */
+  static inline double WrapPhaseFast(double x)
+  {
+    const double f = x - (double) static_cast<int>(x);
+    return f < 0. ? f + 1. : f;
+  }
+  
+  /** The LFO value for a phase in [0, 1), before scaling. Branch-free, so that it can be vectorized over a block */
+  template <EShape shape, bool bipolar>
+  static inline T Shape(T x)
+  {
+    switch (shape) {
+      case kTriangle: return bipolar ? (T) ((2. * (1. - std::abs((WrapPhaseOnce(x + (T) 0.25) * 2.) - 1.))) - 1.) : (T) (1. - std::abs((x * 2.) - 1.));
+      case kSquare:   return bipolar ? (x < (T) 0.5 ? (T) -1. : (T) 1.) : (x < (T) 0.5 ? (T) 0. : (T) 1.);
+      case kRampUp:   return bipolar ? (T) ((x * 2.) - 1.) : x;
+      case kRampDown: return bipolar ? (T) (((1. - x) * 2.) - 1.) : (T) (1. - x);
+      case kSine:     return bipolar ? Sin2Pi(x) : (T) ((Sin2Pi(x) * 0.5) + 0.5);
+      default:        return 0.;
+    }
+  }
+  
 private:
   static inline T WrapPhase (T x, T lo = 0., T hi = 1.)
   {
@@ -187,38 +255,52 @@ private:
     return x;
   };
   
+  /** Wrap a phase in [0, 2) to [0, 1) */
+  static inline T WrapPhaseOnce(T x)
+  {
+    return x >= (T) 1. ? x - (T) 1. : x;
+  }
+  
+  /** sin(2 * pi * x) for x in [0, 1), folded to [-pi/2, pi/2] and evaluated as a Taylor series to x^11 (max error ~6e-8) */
+  static inline T Sin2Pi(T x)
+  {
+    T a = (x - (T) 0.5) * (T) 6.283185307179586; // sin(2 * pi * x) = -sin(a)
+    a = a > (T) 1.5707963267948966 ? (T) 3.141592653589793 - a : a;
+    a = a < (T) -1.5707963267948966 ? (T) -3.141592653589793 - a : a;
+    const T a2 = a * a;
+    return -a * ((T) 1. + a2 * ((T) (-1. / 6.) + a2 * ((T) (1. / 120.) + a2 * ((T) (-1. / 5040.) + a2 * ((T) (1. / 362880.) + a2 * (T) (-1. / 39916800.))))));
+  }
+  
+  template <EShape shape, bool bipolar>
+  static void ShapeKernel(T* pBuffer, int nFrames, T scalar)
+  {
+    for (int s=0; s<nFrames; s++)
+      pBuffer[s] = Shape<shape, bipolar>(pBuffer[s]) * scalar;
+  }
+  
   inline T DoProcess(T phase)
   {
-    auto triangle         = [](T x){ return (2. * (1. - std::abs((WrapPhase(x + 0.25) * 2.) -1.))) - 1.; };
-    auto triangleUnipolar = [](T x){ return 1. - std::abs((x * 2.) - 1. ); };
-    auto square           = [](T x){ return std::copysign(1., x - 0.5); };
-    auto squareUnipolar   = [](T x){ return std::copysign(0.5, x - 0.5) + 0.5; };
-    auto rampup           = [](T x){ return (x * 2.) - 1.; };
-    auto rampupUnipolar   = [](T x){ return x; };
-    auto rampdown         = [](T x){ return ((1. - x) * 2.) - 1.; };
-    auto rampdownUnipolar = [](T x){ return 1. - x; };
-    
     T output = 0.;
     
     if(mPolarity == EPolarity::kUnipolar)
     {
       switch (mShape) {
-        case kTriangle: output = triangleUnipolar(phase); break;
-        case kSquare:   output = squareUnipolar(phase); break;
-        case kRampUp:   output = rampupUnipolar(phase); break;
-        case kRampDown: output = rampdownUnipolar(phase); break;
-        case kSine:     output = (std::sin(phase * 6.283185307179586) * 0.5) + 0.5; break;
+        case kTriangle: output = Shape<kTriangle, false>(phase); break;
+        case kSquare:   output = Shape<kSquare, false>(phase); break;
+        case kRampUp:   output = Shape<kRampUp, false>(phase); break;
+        case kRampDown: output = Shape<kRampDown, false>(phase); break;
+        case kSine:     output = Shape<kSine, false>(phase); break;
         default: break;
       }
     }
     else
     {
       switch (mShape) {
-        case kTriangle: output = triangle(phase); break;
-        case kSquare:   output = square(phase); break;
-        case kRampUp:   output = rampup(phase); break;
-        case kRampDown: output = rampdown(phase); break;
-        case kSine:     output = std::sin(phase * 6.283185307179586); break;
+        case kTriangle: output = Shape<kTriangle, true>(phase); break;
+        case kSquare:   output = Shape<kSquare, true>(phase); break;
+        case kRampUp:   output = Shape<kRampUp, true>(phase); break;
+        case kRampDown: output = Shape<kRampDown, true>(phase); break;
+        case kSine:     output = Shape<kSine, true>(phase); break;
         default: break;
       }
     }
@@ -237,4 +319,128 @@ private:
   ERateMode mRateMode = ERateMode::kHz;
 };
 
+/** A bank of LFOs, with their state stored in structure-of-arrays form, for modulation matrices that need many LFOs per voice.
+ * ProcessBlock() and ProcessValues() first advance the phases of all LFOs in one branch-free pass over the arrays.
+ * ProcessBlock() then renders each LFO with the same block kernels as LFO::ProcessBlock().
+ * ProcessValues() only renders the value at the last frame of the block, for control-rate modulation.
+ * As with LFO, an LFO in BPM mode runs free at the tempo rate while the transport is stopped. Unlike LFO, it does not overwrite
+ * the rate set with SetFreqCPS() to do so, so that rate still applies when the LFO is switched back to Hz mode */
+template<typename T = double>
+class LFOBank
+{
+public:
+  using LFOType = LFO<T>;
+  using EShape = typename LFOType::EShape;
+  using EPolarity = typename LFOType::EPolarity;
+  
+  /** @param nLFOs The number of LFOs in the bank. Allocates */
+  LFOBank(int nLFOs = 0)
+  {
+    Resize(nLFOs);
+  }
+  
+  /** Set the number of LFOs in the bank. New LFOs are 1Hz unipolar triangles. Allocates, so must not be called on the audio thread */
+  void Resize(int nLFOs)
+  {
+    mPhase.resize(nLFOs, 0.);
+    mStartPhase.resize(nLFOs, 0.);
+    mFreqHz.resize(nLFOs, 1.);
+    mStart.resize(nLFOs, 0.);
+    mIncr.resize(nLFOs, 0.);
+    mQNScalar.resize(nLFOs, 1.);
+    mLevelScalar.resize(nLFOs, 1.);
+    mSync.resize(nLFOs, 0);
+    mShape.resize(nLFOs, LFOType::kTriangle);
+    mPolarity.resize(nLFOs, EPolarity::kUnipolar);
+  }
+  
+  int NLFOs() const { return static_cast<int>(mPhase.size()); }
+  
+  void SetSampleRate(double sampleRate)
+  {
+    mSampleRate = sampleRate;
+  }
+  
+  /** Reset all LFOs to their start phase */
+  void Reset()
+  {
+    mPhase = mStartPhase;
+  }
+  
+  void SetStartPhase(int idx, double phase) { mStartPhase[idx] = phase; }
+  void SetPhase(int idx, double phase) { mPhase[idx] = phase; }
+  void SetFreqCPS(int idx, double freqHz) { mFreqHz[idx] = freqHz; }
+  void SetShape(int idx, int lfoShape) { mShape[idx] = (EShape) Clip(lfoShape, 0, LFOType::kNumShapes-1); }
+  void SetPolarity(int idx, bool bipolar) { mPolarity[idx] = bipolar ? EPolarity::kBipolar : EPolarity::kUnipolar; }
+  void SetScalar(int idx, T scalar) { mLevelScalar[idx] = scalar; }
+  void SetQNScalar(int idx, T scalar) { mQNScalar[idx] = scalar; }
+  void SetQNScalarFromDivision(int idx, int division) { mQNScalar[idx] = LFOType::GetQNScalar(static_cast<typename LFOType::ETempoDivison>(Clip(division, 0, (int) LFOType::kNumDivisions - 1))); }
+  void SetRateMode(int idx, bool sync) { mSync[idx] = sync ? 1 : 0; }
+  
+  /** Render a block of every LFO in the bank
+   * @param outputs One buffer of nFrames per LFO */
+  void ProcessBlock(T** outputs, int nFrames, double qnPos = 0., bool transportIsRunning = false, double tempo = 120.)
+  {
+    if (nFrames <= 0)
+      return;
+    
+    AdvancePhases(nFrames, qnPos, transportIsRunning, tempo);
+    
+    for (auto i = 0; i < NLFOs(); i++)
+    {
+      LFOType::FillPhases(outputs[i], nFrames, mStart[i], mIncr[i]);
+      LFOType::RenderShape(outputs[i], nFrames, mShape[i], mPolarity[i], mLevelScalar[i]);
+    }
+  }
+  
+  /** Advance every LFO in the bank by a block, rendering only the value at the last frame
+   * @param pValues One value per LFO */
+  void ProcessValues(T* pValues, int nFrames, double qnPos = 0., bool transportIsRunning = false, double tempo = 120.)
+  {
+    if (nFrames <= 0)
+      return;
+    
+    AdvancePhases(nFrames, qnPos, transportIsRunning, tempo);
+    
+    for (auto i = 0; i < NLFOs(); i++)
+    {
+      pValues[i] = (T) mPhase[i];
+      LFOType::RenderShape(pValues + i, 1, mShape[i], mPolarity[i], mLevelScalar[i]);
+    }
+  }
+  
+private:
+  /** Compute the start phase and increment of each LFO for this block and move its phase to the last frame, in one pass over the arrays */
+  void AdvancePhases(int nFrames, double qnPos, bool transportIsRunning, double tempo)
+  {
+    const double oneOverSR = 1. / mSampleRate;
+    const double oneOverSamplesPerBeat = (tempo == 0.0 ? 1.0 : tempo) / (60. * mSampleRate);
+    const double lastFrame = (double) (nFrames - 1);
+    const int nLFOs = NLFOs();
+    
+    for (auto i = 0; i < nLFOs; i++)
+    {
+      const bool sync = mSync[i] != 0;
+      const double qnScalar = (double) mQNScalar[i];
+      const double incr = sync ? qnScalar * oneOverSamplesPerBeat : mFreqHz[i] * oneOverSR;
+      const double start = (sync && transportIsRunning) ? (qnPos * qnScalar) : (mPhase[i] + incr);
+      mStart[i] = LFOType::WrapPhaseFast(start);
+      mIncr[i] = incr;
+      mPhase[i] = LFOType::WrapPhaseFast(mStart[i] + (lastFrame * incr));
+    }
+  }
+  
+  double mSampleRate = 44100.;
+  std::vector<double> mPhase;
+  std::vector<double> mStartPhase;
+  std::vector<double> mFreqHz;
+  std::vector<double> mStart;
+  std::vector<double> mIncr;
+  std::vector<T> mQNScalar;
+  std::vector<T> mLevelScalar;
+  std::vector<uint8_t> mSync;
+  std::vector<EShape> mShape;
+  std::vector<EPolarity> mPolarity;
+};
+
 END_IPLUG_NAMESPACE
@@ -64,21 +64,159 @@
   #if defined(__arm64__)
     #define SIMDE_ENABLE_NATIVE_ALIASES
     #include "simde/x86/sse2.h"
+  #elif defined(__AVX__)
+    #include <immintrin.h>
   #else
     #include <emmintrin.h>
   #endif
 #endif
 
+#include "heapbuf.h"
+
 #include "IPlugConstants.h"
 
 namespace iplug
 {
+/* LanczosLanes
+ *
+ * The vector type used for the filter kernel, scalar unless IPLUG_SIMDE is defined.
+ * With IPLUG_SIMDE the widest available instruction set is used: AVX-512 (16 floats/8 doubles),
+ * AVX with FMA if the compiler targets it (8 floats/4 doubles), or SSE2 (4 floats/2 doubles),
+ * which SIMDE translates to NEON on arm64
+ */
+template<typename T>
+struct LanczosLanes
+{
+  static constexpr size_t kNLanes = 1;
+  using Vec = T;
+  static inline Vec Load(const T* ptr) { return *ptr; }
+  static inline void Store(T* ptr, Vec v) { *ptr = v; }
+  static inline Vec Set1(T val) { return val; }
+  static inline Vec Zero() { return T(0); }
+  static inline Vec Add(Vec a, Vec b) { return a + b; }
+  static inline Vec MulAdd(Vec a, Vec b, Vec c) { return a * b + c; }
+  static inline T Sum(Vec v) { return v; }
+};
+
+#if defined IPLUG_SIMDE
+#if defined(__AVX512F__) && !defined(__arm64__)
+template<>
+struct LanczosLanes<float>
+{
+  static constexpr size_t kNLanes = 16;
+  using Vec = __m512;
+  static inline Vec Load(const float* ptr) { return _mm512_loadu_ps(ptr); }
+  static inline void Store(float* ptr, Vec v) { _mm512_storeu_ps(ptr, v); }
+  static inline Vec Set1(float val) { return _mm512_set1_ps(val); }
+  static inline Vec Zero() { return _mm512_setzero_ps(); }
+  static inline Vec Add(Vec a, Vec b) { return _mm512_add_ps(a, b); }
+  static inline Vec MulAdd(Vec a, Vec b, Vec c) { return _mm512_fmadd_ps(a, b, c); }
+  static inline float Sum(Vec v) { return _mm512_reduce_add_ps(v); }
+};
+
+template<>
+struct LanczosLanes<double>
+{
+  static constexpr size_t kNLanes = 8;
+  using Vec = __m512d;
+  static inline Vec Load(const double* ptr) { return _mm512_loadu_pd(ptr); }
+  static inline void Store(double* ptr, Vec v) { _mm512_storeu_pd(ptr, v); }
+  static inline Vec Set1(double val) { return _mm512_set1_pd(val); }
+  static inline Vec Zero() { return _mm512_setzero_pd(); }
+  static inline Vec Add(Vec a, Vec b) { return _mm512_add_pd(a, b); }
+  static inline Vec MulAdd(Vec a, Vec b, Vec c) { return _mm512_fmadd_pd(a, b, c); }
+  static inline double Sum(Vec v) { return _mm512_reduce_add_pd(v); }
+};
+#elif defined(__AVX__) && !defined(__arm64__)
+template<>
+struct LanczosLanes<float>
+{
+  static constexpr size_t kNLanes = 8;
+  using Vec = __m256;
+  static inline Vec Load(const float* ptr) { return _mm256_loadu_ps(ptr); }
+  static inline void Store(float* ptr, Vec v) { _mm256_storeu_ps(ptr, v); }
+  static inline Vec Set1(float val) { return _mm256_set1_ps(val); }
+  static inline Vec Zero() { return _mm256_setzero_ps(); }
+  static inline Vec Add(Vec a, Vec b) { return _mm256_add_ps(a, b); }
+#if defined(__FMA__)
+  static inline Vec MulAdd(Vec a, Vec b, Vec c) { return _mm256_fmadd_ps(a, b, c); }
+#else
+  static inline Vec MulAdd(Vec a, Vec b, Vec c) { return _mm256_add_ps(_mm256_mul_ps(a, b), c); }
+#endif
+  static inline float Sum(Vec v)
+  {
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+    return _mm_cvtss_f32(s);
+  }
+};
+
+template<>
+struct LanczosLanes<double>
+{
+  static constexpr size_t kNLanes = 4;
+  using Vec = __m256d;
+  static inline Vec Load(const double* ptr) { return _mm256_loadu_pd(ptr); }
+  static inline void Store(double* ptr, Vec v) { _mm256_storeu_pd(ptr, v); }
+  static inline Vec Set1(double val) { return _mm256_set1_pd(val); }
+  static inline Vec Zero() { return _mm256_setzero_pd(); }
+  static inline Vec Add(Vec a, Vec b) { return _mm256_add_pd(a, b); }
+#if defined(__FMA__)
+  static inline Vec MulAdd(Vec a, Vec b, Vec c) { return _mm256_fmadd_pd(a, b, c); }
+#else
+  static inline Vec MulAdd(Vec a, Vec b, Vec c) { return _mm256_add_pd(_mm256_mul_pd(a, b), c); }
+#endif
+  static inline double Sum(Vec v)
+  {
+    __m128d s = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+    s = _mm_add_sd(s, _mm_unpackhi_pd(s, s));
+    return _mm_cvtsd_f64(s);
+  }
+};
+#else
+template<>
+struct LanczosLanes<float>
+{
+  static constexpr size_t kNLanes = 4;
+  using Vec = __m128;
+  static inline Vec Load(const float* ptr) { return _mm_loadu_ps(ptr); }
+  static inline void Store(float* ptr, Vec v) { _mm_storeu_ps(ptr, v); }
+  static inline Vec Set1(float val) { return _mm_set1_ps(val); }
+  static inline Vec Zero() { return _mm_setzero_ps(); }
+  static inline Vec Add(Vec a, Vec b) { return _mm_add_ps(a, b); }
+  static inline Vec MulAdd(Vec a, Vec b, Vec c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+  static inline float Sum(Vec v)
+  {
+    __m128 s = _mm_add_ps(v, _mm_movehl_ps(v, v));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+    return _mm_cvtss_f32(s);
+  }
+};
+
+template<>
+struct LanczosLanes<double>
+{
+  static constexpr size_t kNLanes = 2;
+  using Vec = __m128d;
+  static inline Vec Load(const double* ptr) { return _mm_loadu_pd(ptr); }
+  static inline void Store(double* ptr, Vec v) { _mm_storeu_pd(ptr, v); }
+  static inline Vec Set1(double val) { return _mm_set1_pd(val); }
+  static inline Vec Zero() { return _mm_setzero_pd(); }
+  static inline Vec Add(Vec a, Vec b) { return _mm_add_pd(a, b); }
+  static inline Vec MulAdd(Vec a, Vec b, Vec c) { return _mm_add_pd(_mm_mul_pd(a, b), c); }
+  static inline double Sum(Vec v) { return _mm_cvtsd_f64(_mm_add_sd(v, _mm_unpackhi_pd(v, v))); }
+};
+#endif
+#endif
+
 /* LanczosResampler
  *
  * A class that implements Lanczos resampling, optionally using SIMD instructions.
  * Define IPLUG_SIMDE at project level in order to use SIMD and if on non-x86_64
  * include the SIMDE library in your search paths in order to translate intel
- * intrinsics to e.g. arm64
+ * intrinsics to e.g. arm64. Both float and double are supported, see LanczosLanes
+ * for the instruction sets used.
  *
  * See https://en.wikipedia.org/wiki/Lanczos_resampling
  *
@@ -92,29 +230,39 @@ template<typename T = double, int NCHANS=2, size_t A=12>
 class LanczosResampler
 {
 private:
-#if IPLUG_SIMDE
-  static_assert(std::is_same<T, float>::value, "LanczosResampler requires T to be float when using SIMD instructions");
-#endif
+  using Lanes = LanczosLanes<T>;
 
-  // The buffer size. This needs to be at least as large as the largest block of samples
-  // that the input side will see.
-  static constexpr size_t kBufferSize = 4096;
   // The filter width. 2x because the filter goes from -A to A
   static constexpr size_t kFilterWidth = A * 2;
+  // The filter width rounded up to a whole number of SIMD vectors. The extra taps are zero
+  static constexpr size_t kKernelSize = ((kFilterWidth + Lanes::kNLanes - 1) / Lanes::kNLanes) * Lanes::kNLanes;
   // The discretization resolution for the filter table.
   static constexpr size_t kTablePoints = 8192;
   static constexpr double kDeltaX = 1.0 / (kTablePoints);
 
 public:
+  // The default buffer size, used by the constructor if none is given
+  static constexpr size_t kDefaultBufferSize = 4096;
+
   /** Constructor
     * @param inputRate The input sample rate
     * @param outputRate The output sample rate
+    * @param bufferSize The buffer size, rounded up to a power of two. This needs to be at least
+    * as large as the largest block of samples that the input side will see, plus 4 * A
     */
-  LanczosResampler(float inputRate, float outputRate)
+  LanczosResampler(float inputRate, float outputRate, size_t bufferSize = kDefaultBufferSize)
   : mInputSampleRate(inputRate)
   , mOutputSamplerate(outputRate)
   , mPhaseOutIncr(mInputSampleRate / mOutputSamplerate)
   {
+    mBufferSize = 1;
+    while (mBufferSize < std::max(bufferSize, kFilterWidth * 2))
+      mBufferSize <<= 1;
+
+    // Each channel holds two copies of the ring buffer so a filter window never wraps, plus the zero taps of the last vector
+    mChannelStride = mBufferSize * 2 + kKernelSize;
+    mInputBuffer.Resize(static_cast<int>(NCHANS * mChannelStride));
+
     ClearBuffer();
     
     auto kernel = [](double x) {
@@ -168,19 +316,30 @@ public:
     return static_cast<size_t>(std::max(res + 1.0, 0.0));
   }
   
+  /** @return The buffer size in samples, per channel */
+  size_t GetBufferSize() const { return mBufferSize; }
+
   inline void PushBlock(T** inputs, size_t nFrames, int nChans)
   {
-    for (auto s=0; s<nFrames; s++)
+    assert(nFrames <= mBufferSize && "Block larger than the resampler buffer size");
+
+    const size_t firstPart = std::min(nFrames, mBufferSize - mWritePos);
+
+    for (auto c=0; c<nChans; c++)
     {
-      for (auto c=0; c<nChans; c++)
-      {
-        mInputBuffer[c][mWritePos] = inputs[c][s];
-        mInputBuffer[c][mWritePos + kBufferSize] = inputs[c][s]; // this way we can always wrap
-      }
-      
-      mWritePos = (mWritePos + 1) & (kBufferSize - 1);
-      mPhaseIn += mPhaseInIncr;
+      T* pBuffer = GetChannel(c);
+
+      // write both copies, this way we can always wrap
+      memcpy(pBuffer + mWritePos, inputs[c], firstPart * sizeof(T));
+      memcpy(pBuffer + mWritePos + mBufferSize, inputs[c], firstPart * sizeof(T));
+      memcpy(pBuffer, inputs[c] + firstPart, (nFrames - firstPart) * sizeof(T));
+      memcpy(pBuffer + mBufferSize, inputs[c] + firstPart, (nFrames - firstPart) * sizeof(T));
     }
+
+    mWritePos = (mWritePos + nFrames) & (mBufferSize - 1);
+
+    for (auto s=0; s<nFrames; s++)
+      mPhaseIn += mPhaseInIncr;
   }
   
   size_t PopBlock(T** outputs, size_t max, int nChans)
@@ -208,117 +367,71 @@ public:
   
   void ClearBuffer()
   {
-    memset(mInputBuffer, 0, NCHANS * kBufferSize * 2 * sizeof(T));
+    memset(mInputBuffer.Get(), 0, mInputBuffer.GetSize() * sizeof(T));
   }
   
 private:
-#ifdef IPLUG_SIMDE
+  inline T* GetChannel(int chan) { return mInputBuffer.Get() + chan * mChannelStride; }
+
+  inline const T* GetChannel(int chan) const { return mInputBuffer.Get() + chan * mChannelStride; }
+
   inline void ReadSamples(double xBack, T** outputs, int s, int nChans) const
   {
-    float bufferReadPosition = static_cast<float>(mWritePos - xBack);
+    const double bufferReadPosition = mWritePos - xBack;
     int bufferReadIndex = static_cast<int>(std::floor(bufferReadPosition));
-    float bufferFracPosition = 1.0f - (bufferReadPosition - static_cast<float>(bufferReadIndex));
-    
-    bufferReadIndex = (bufferReadIndex + kBufferSize) & (kBufferSize - 1);
-    bufferReadIndex += (bufferReadIndex <= static_cast<int>(A)) * kBufferSize;
+    const double bufferFracPosition = 1.0 - (bufferReadPosition - bufferReadIndex);
     
-    float tablePosition = bufferFracPosition * kTablePoints;
-    int tableIndex = static_cast<int>(tablePosition);
-    float tableFracPosition = (tablePosition - tableIndex);
-    
-    __m128 sum[NCHANS];
-    for (auto & v : sum) {
-      v = _mm_setzero_ps(); // Initialize sum vectors to zero
-    }
-    
-    for (int i=0; i<A; i+=4) // Process four samples at a time
-    {
-      // Load filter coefficients and input samples into SSE registers
-      __m128 f0 = _mm_load_ps(&sTable[tableIndex][i]);
-      __m128 df0 = _mm_load_ps(&sDeltaTable[tableIndex][i]);
-      __m128 f1 = _mm_load_ps(&sTable[tableIndex][A + i]);
-      __m128 df1 = _mm_load_ps(&sDeltaTable[tableIndex][A + i]);
-      
-      // Interpolate filter coefficients
-      __m128 tfp = _mm_set1_ps(tableFracPosition);
-      f0 = _mm_add_ps(f0, _mm_mul_ps(df0, tfp));
-      f1 = _mm_add_ps(f1, _mm_mul_ps(df1, tfp));
-      
-      for (int c=0; c<nChans; c++)
-      {
-        // Load input data
-        __m128 d0 = _mm_set_ps(mInputBuffer[c][bufferReadIndex - A + i + 3],
-                               mInputBuffer[c][bufferReadIndex - A + i + 2],
-                               mInputBuffer[c][bufferReadIndex - A + i + 1],
-                               mInputBuffer[c][bufferReadIndex - A + i]);
-        __m128 d1 = _mm_set_ps(mInputBuffer[c][bufferReadIndex + i + 3],
-                               mInputBuffer[c][bufferReadIndex + i + 2],
-                               mInputBuffer[c][bufferReadIndex + i + 1],
-                               mInputBuffer[c][bufferReadIndex + i]);
-        
-        // Perform multiplication and accumulate
-        __m128 result0 = _mm_mul_ps(f0, d0);
-        __m128 result1 = _mm_mul_ps(f1, d1);
-        sum[c] = _mm_add_ps(sum[c], _mm_add_ps(result0, result1));
-      }
-    }
+    const int bufferSize = static_cast<int>(mBufferSize);
+    bufferReadIndex = (bufferReadIndex + bufferSize) & (bufferSize - 1);
+    bufferReadIndex += (bufferReadIndex <= static_cast<int>(A)) * bufferSize;
     
-    // Extract the final sums and store them in the output
-    for (int c=0; c<nChans; c++)
-    {
-      float sumArray[4];
-      _mm_store_ps(sumArray, sum[c]);
-      outputs[c][s] = sumArray[0] + sumArray[1] + sumArray[2] + sumArray[3];
-    }
-  }
-#else // scalar
-  inline void ReadSamples(double xBack, T** outputs, int s, int nChans) const
-  {
-    double bufferReadPosition = mWritePos - xBack;
-    int bufferReadIndex = std::floor(bufferReadPosition);
-    double bufferFracPosition = 1.0 - (bufferReadPosition - bufferReadIndex);
-
-    bufferReadIndex = (bufferReadIndex + kBufferSize) & (kBufferSize - 1);
-    bufferReadIndex += (bufferReadIndex <= static_cast<int>(A)) * kBufferSize;
+    const double tablePosition = bufferFracPosition * kTablePoints;
+    const int tableIndex = static_cast<int>(tablePosition);
+    const auto tableFracPosition = Lanes::Set1(static_cast<T>(tablePosition - tableIndex));
+    const T* pTable = sTable[tableIndex];
+    const T* pDeltaTable = sDeltaTable[tableIndex];
+    constexpr size_t kNLanes = Lanes::kNLanes;
 
-    double tablePosition = bufferFracPosition * kTablePoints;
-    int tableIndex = static_cast<int>(tablePosition);
-    double tableFracPosition = (tablePosition - tableIndex);
+    // Interpolate the filter coefficients once, then apply them to every channel
+    alignas(64) T filter[kKernelSize];
 
-    T sum[NCHANS] = {0.0};
+    for (size_t i=0; i<kKernelSize; i+=kNLanes)
+    {
+      Lanes::Store(&filter[i], Lanes::MulAdd(Lanes::Load(pDeltaTable + i), tableFracPosition, Lanes::Load(pTable + i)));
+    }
 
-    for (auto i=0; i<A; i++)
+    for (auto c=0; c<nChans; c++)
     {
-      auto f0 = sTable[tableIndex][i];
-      const auto df0 = sDeltaTable[tableIndex][i];
-      f0 += df0 * tableFracPosition;
+      const T* pInput = GetChannel(c) + bufferReadIndex - A;
 
-      auto f1 = sTable[tableIndex][A+i];
-      const auto df1 = sDeltaTable[tableIndex][A+i];
-      f1 += df1 * tableFracPosition;
+      // Two vectors of taps per iteration, into separate sums, so that consecutive multiply-adds don't wait on each other
+      auto sum0 = Lanes::Zero();
+      auto sum1 = Lanes::Zero();
+      size_t i = 0;
 
-      for (auto c=0; c<nChans;c++)
+      for (; i + 2 * kNLanes <= kKernelSize; i += 2 * kNLanes)
       {
-        const auto d0 = mInputBuffer[c][bufferReadIndex - A + i];
-        const auto d1 = mInputBuffer[c][bufferReadIndex + i];
-        const auto rv = (f0 * d0) + (f1 * d1);
-        sum[c] += rv;
+        sum0 = Lanes::MulAdd(Lanes::Load(&filter[i]), Lanes::Load(pInput + i), sum0);
+        sum1 = Lanes::MulAdd(Lanes::Load(&filter[i + kNLanes]), Lanes::Load(pInput + i + kNLanes), sum1);
       }
-    }
 
-    for (auto c=0; c<nChans;c++)
-    {
-      outputs[c][s] = sum[c];
+      if (i < kKernelSize)
+      {
+        sum0 = Lanes::MulAdd(Lanes::Load(&filter[i]), Lanes::Load(pInput + i), sum0);
+      }
+
+      outputs[c][s] = Lanes::Sum(Lanes::Add(sum0, sum1));
     }
   }
-#endif
-  
-  static T sTable alignas(16)[kTablePoints + 1][kFilterWidth];
-  static T sDeltaTable alignas(16)[kTablePoints + 1][kFilterWidth];
+
+  static T sTable alignas(64)[kTablePoints + 1][kKernelSize];
+  static T sDeltaTable alignas(64)[kTablePoints + 1][kKernelSize];
   static bool sTablesInitialized;
   
-  T mInputBuffer[NCHANS][kBufferSize * 2];
-  int mWritePos = 0;
+  WDL_TypedBuf<T> mInputBuffer;
+  size_t mBufferSize = kDefaultBufferSize;
+  size_t mChannelStride = 0;
+  size_t mWritePos = 0;
   const float mInputSampleRate;
   const float mOutputSamplerate;
   double mPhaseIn = 0.0;
@@ -328,13 +441,12 @@ private:
 } WDL_FIXALIGN;
 
 template<typename T, int NCHANS, size_t A>
-T LanczosResampler<T, NCHANS, A>::sTable alignas(16) [LanczosResampler<T, NCHANS, A>::kTablePoints + 1][LanczosResampler::kFilterWidth];
+T LanczosResampler<T, NCHANS, A>::sTable alignas(64) [LanczosResampler<T, NCHANS, A>::kTablePoints + 1][LanczosResampler::kKernelSize];
 
 template<typename T, int NCHANS, size_t A>
-T LanczosResampler<T, NCHANS, A>::sDeltaTable alignas(16) [LanczosResampler<T, NCHANS, A>::kTablePoints + 1][LanczosResampler::kFilterWidth];
+T LanczosResampler<T, NCHANS, A>::sDeltaTable alignas(64) [LanczosResampler<T, NCHANS, A>::kTablePoints + 1][LanczosResampler::kKernelSize];
 
 template<typename T, int NCHANS, size_t A>
 bool LanczosResampler<T, NCHANS, A>::sTablesInitialized{false};
 
 } // namespace iplug
-
@@ -9,10 +9,455 @@
 */
 
 #pragma once
+
+/**
+ * @file
+ * Multi-channel delay lines.
+ * MultiTapDelayLine is a power-of-two ring buffer per channel, written a block at a time and read with any number of integer
+ * or fractional taps (linear, 4-point Lagrange or first order Thiran allpass interpolation), e.g. for chorus or reverb networks.
+ * NChanDelayLine wraps it as the fixed integer delay used to delay bypassed signals to match the plug-in latency.
+ * Define IPLUG_SIMDE at project level in order to use SSE2 instructions for the fixed-delay taps, and if on non-x86_64
+ * include the SIMDE library in your search paths in order to translate intel intrinsics to e.g. arm64.
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#if defined IPLUG_SIMDE
+  #if defined(__arm64__)
+    #define SIMDE_ENABLE_NATIVE_ALIASES
+    #include "simde/x86/sse2.h"
+  #else
+    #include <emmintrin.h>
+  #endif
+#endif
+
+#include "heapbuf.h"
+
 #include "IPlugPlatform.h"
+#include "IPlugConstants.h"
+#include "IPlugUtilities.h"
 
 BEGIN_IPLUG_NAMESPACE
 
+#if defined IPLUG_SIMDE
+/** SSE2 vectors of delay line samples, used by the tap kernels */
+template<typename T>
+struct DelayLineLanes;
+
+template<>
+struct DelayLineLanes<float>
+{
+  static constexpr int kNLanes = 4;
+  using Vec = __m128;
+  static inline Vec Load(const float* ptr) { return _mm_loadu_ps(ptr); }
+  static inline void Store(float* ptr, Vec v) { _mm_storeu_ps(ptr, v); }
+  static inline Vec Set1(float val) { return _mm_set1_ps(val); }
+  static inline Vec Add(Vec a, Vec b) { return _mm_add_ps(a, b); }
+  static inline Vec Mul(Vec a, Vec b) { return _mm_mul_ps(a, b); }
+};
+
+template<>
+struct DelayLineLanes<double>
+{
+  static constexpr int kNLanes = 2;
+  using Vec = __m128d;
+  static inline Vec Load(const double* ptr) { return _mm_loadu_pd(ptr); }
+  static inline void Store(double* ptr, Vec v) { _mm_storeu_pd(ptr, v); }
+  static inline Vec Set1(double val) { return _mm_set1_pd(val); }
+  static inline Vec Add(Vec a, Vec b) { return _mm_add_pd(a, b); }
+  static inline Vec Mul(Vec a, Vec b) { return _mm_mul_pd(a, b); }
+};
+#endif
+
+/** A multi-channel, multi-tap delay line with fractional delays.
+ * Call Write() with a block of input, then read that block back delayed with any number of taps. A delay of 0 reads the
+ * input just written. Each channel is a power-of-two ring buffer followed by a copy of its first maxBlockSize + 3 samples,
+ * so a block read never wraps and fixed-delay taps are plain loops over contiguous memory.
+ * @tparam T the sample type */
+template<typename T = double>
+class MultiTapDelayLine
+{
+public:
+  /** Interpolation used to read between samples */
+  enum EInterp
+  {
+    kInterpNone = 0, // Delay is rounded down to whole samples
+    kInterpLinear,   // 2-point linear
+    kInterpLagrange, // 4-point, 3rd order Lagrange. The minimum delay is 1 sample
+    kInterpThiran,   // 1st order Thiran allpass, flat magnitude response. Needs state, so only available for Taps. The minimum delay is 0.5 samples
+    kNumInterps
+  };
+
+  /** A fixed read tap, see ReadTaps(). Taps are per channel, since a Thiran tap keeps its allpass state here */
+  struct Tap
+  {
+    double delay = 0.; // in samples
+    T gain = 1.;
+    EInterp interp = kInterpLinear;
+    T thiranState = 0.;
+  };
+
+  /** Constructor
+   * @param nChans The number of channels
+   * @param maxDelaySamples The longest delay that can be read, in samples
+   * @param maxBlockSize The largest number of frames passed to Write() */
+  MultiTapDelayLine(int nChans = 1, int maxDelaySamples = 0, int maxBlockSize = DEFAULT_BLOCK_SIZE)
+  {
+    Resize(nChans, maxDelaySamples, maxBlockSize);
+  }
+
+  /** Allocates the ring buffers and clears them. Not realtime safe
+   * @param nChans The number of channels
+   * @param maxDelaySamples The longest delay that can be read, in samples
+   * @param maxBlockSize The largest number of frames passed to Write() */
+  void Resize(int nChans, int maxDelaySamples, int maxBlockSize = DEFAULT_BLOCK_SIZE)
+  {
+    mNChans = std::max(nChans, 0);
+    mMaxDelay = std::max(maxDelaySamples, 0);
+    mMaxBlockSize = std::max(maxBlockSize, 1);
+
+    // The oldest sample read is maxDelay + 2 behind the start of a block (Lagrange), the newest is the end of the block
+    int ringSize = 1;
+    while (ringSize < mMaxDelay + mMaxBlockSize + 3)
+      ringSize <<= 1;
+
+    mMask = ringSize - 1;
+    mGuardSize = mMaxBlockSize + 3;
+    mChanStride = ringSize + mGuardSize;
+    mBuffer.Resize(mNChans * mChanStride);
+    mScratch.Resize(mMaxBlockSize);
+    Clear();
+  }
+
+  /** Clears the delayed signal */
+  void Clear()
+  {
+    memset(mBuffer.Get(), 0, mBuffer.GetSize() * sizeof(T));
+    mWritePos = 0;
+    mBlockStart = 0;
+  }
+
+  int NChans() const { return mNChans; }
+
+  int GetMaxDelay() const { return mMaxDelay; }
+
+  int GetMaxBlockSize() const { return mMaxBlockSize; }
+
+  /** Appends a block of input to every channel. The Read methods then refer to this block, until the next call
+   * @param inputs NChans() input buffers
+   * @param nFrames The number of frames, at most GetMaxBlockSize() */
+  void Write(const T* const* inputs, int nFrames)
+  {
+    assert(nFrames <= mMaxBlockSize);
+
+    for (auto c = 0; c < mNChans; c++)
+      WriteChannel(c, inputs[c], nFrames);
+
+    Advance(nFrames);
+  }
+
+  /** Reads the last written block of a channel, delayed by a whole number of samples
+   * @param chan The channel
+   * @param pOut Output buffer for nFrames samples
+   * @param nFrames The number of frames, at most the size of the last written block
+   * @param delay The delay in samples, clipped to 0...GetMaxDelay() */
+  void ReadInteger(int chan, T* pOut, int nFrames, int delay) const
+  {
+    memcpy(pOut, GetReadPtr(chan, Clip(delay, 0, mMaxDelay)), nFrames * sizeof(T));
+  }
+
+  /** Reads the last written block of a channel with a fixed fractional delay
+   * @param chan The channel
+   * @param pOut Output buffer for nFrames samples
+   * @param nFrames The number of frames, at most the size of the last written block
+   * @param delay The delay in samples, clipped to the minimum of the interpolation and GetMaxDelay()
+   * @param interp kInterpNone, kInterpLinear or kInterpLagrange */
+  void Read(int chan, T* pOut, int nFrames, double delay, EInterp interp = kInterpLinear) const
+  {
+    assert(interp != kInterpThiran && "Thiran interpolation needs a Tap");
+    ReadFixed<false>(chan, pOut, nFrames, delay, T(1.), interp);
+  }
+
+  /** Reads the last written block of a channel with a fixed delay tap, optionally adding it to pOut
+   * @param chan The channel
+   * @param pOut Output buffer for nFrames samples
+   * @param nFrames The number of frames, at most the size of the last written block
+   * @param tap The tap. Its thiranState is updated
+   * @param accumulate If \c true the tap is added to pOut, otherwise it replaces it */
+  void ReadTap(int chan, T* pOut, int nFrames, Tap& tap, bool accumulate = false)
+  {
+    if (tap.interp == kInterpThiran)
+    {
+      if (accumulate)
+        ReadThiran<true>(chan, pOut, nFrames, tap);
+      else
+        ReadThiran<false>(chan, pOut, nFrames, tap);
+    }
+    else
+    {
+      if (accumulate)
+        ReadFixed<true>(chan, pOut, nFrames, tap.delay, tap.gain, tap.interp);
+      else
+        ReadFixed<false>(chan, pOut, nFrames, tap.delay, tap.gain, tap.interp);
+    }
+  }
+
+  /** Writes the sum of several taps on one channel to pOut, e.g. for early reflections or a multi-voice chorus with fixed delays
+   * @param chan The channel
+   * @param pOut Output buffer for nFrames samples
+   * @param nFrames The number of frames, at most the size of the last written block
+   * @param pTaps nTaps taps, gains included
+   * @param nTaps The number of taps. With no taps pOut is cleared */
+  void ReadTaps(int chan, T* pOut, int nFrames, Tap* pTaps, int nTaps)
+  {
+    if (nTaps <= 0)
+    {
+      memset(pOut, 0, nFrames * sizeof(T));
+      return;
+    }
+
+    for (auto i = 0; i < nTaps; i++)
+      ReadTap(chan, pOut, nFrames, pTaps[i], i > 0);
+  }
+
+  /** Reads the last written block of a channel with a delay per sample, e.g. for a chorus or flanger
+   * @param chan The channel
+   * @param pOut Output buffer for nFrames samples
+   * @param nFrames The number of frames, at most the size of the last written block
+   * @param pDelays nFrames delays in samples, clipped to the minimum of the interpolation and GetMaxDelay()
+   * @param interp kInterpNone, kInterpLinear or kInterpLagrange */
+  void ReadModulated(int chan, T* pOut, int nFrames, const T* pDelays, EInterp interp = kInterpLinear) const
+  {
+    const T* pChan = mBuffer.Get() + chan * mChanStride;
+    const double maxDelay = static_cast<double>(mMaxDelay);
+
+    switch (interp)
+    {
+      case kInterpNone:
+        for (auto s = 0; s < nFrames; s++)
+        {
+          const int delay = static_cast<int>(Clip(static_cast<double>(pDelays[s]), 0., maxDelay));
+          pOut[s] = pChan[(mBlockStart + s - delay) & mMask];
+        }
+        break;
+      case kInterpLagrange:
+        for (auto s = 0; s < nFrames; s++)
+        {
+          const double delay = Clip(static_cast<double>(pDelays[s]), 1., maxDelay);
+          const int whole = static_cast<int>(delay);
+          T coeffs[4];
+          LagrangeCoeffs(static_cast<T>(delay - whole), T(1.), coeffs);
+          const T* p = pChan + ((mBlockStart + s - whole - 2) & mMask);
+          pOut[s] = coeffs[0] * p[0] + coeffs[1] * p[1] + coeffs[2] * p[2] + coeffs[3] * p[3];
+        }
+        break;
+      default:
+        assert(interp == kInterpLinear && "Modulated reads support kInterpNone, kInterpLinear and kInterpLagrange");
+        for (auto s = 0; s < nFrames; s++)
+        {
+          const double delay = Clip(static_cast<double>(pDelays[s]), 0., maxDelay);
+          const int whole = static_cast<int>(delay);
+          const T frac = static_cast<T>(delay - whole);
+          const T* p = pChan + ((mBlockStart + s - whole - 1) & mMask);
+          pOut[s] = frac * p[0] + (T(1.) - frac) * p[1];
+        }
+        break;
+    }
+  }
+
+  /** Delays NChans() channels by a whole number of samples, for any block size. inputs and outputs may be the same buffers
+   * @param inputs NChans() input buffers
+   * @param outputs NChans() output buffers
+   * @param nFrames The number of frames
+   * @param delay The delay in samples, clipped to 0...GetMaxDelay() */
+  void ProcessBlock(T** inputs, T** outputs, int nFrames, int delay)
+  {
+    delay = Clip(delay, 0, mMaxDelay);
+
+    for (auto offset = 0; offset < nFrames; offset += mMaxBlockSize)
+    {
+      const int n = std::min(nFrames - offset, mMaxBlockSize);
+
+      for (auto c = 0; c < mNChans; c++)
+        WriteChannel(c, inputs[c] + offset, n);
+
+      Advance(n);
+
+      for (auto c = 0; c < mNChans; c++)
+        ReadInteger(c, outputs[c] + offset, n, delay);
+    }
+  }
+
+private:
+  /** Copies a block into the ring at the write position, and into the guard copy if it lands in the first mGuardSize samples */
+  void WriteChannel(int chan, const T* pIn, int nFrames)
+  {
+    T* pChan = mBuffer.Get() + chan * mChanStride;
+    const int ringSize = mMask + 1;
+    const int firstPart = std::min(nFrames, ringSize - mWritePos);
+
+    WriteSegment(pChan, mWritePos, pIn, firstPart);
+
+    if (firstPart < nFrames)
+      WriteSegment(pChan, 0, pIn + firstPart, nFrames - firstPart);
+  }
+
+  void WriteSegment(T* pChan, int pos, const T* pIn, int nFrames)
+  {
+    memcpy(pChan + pos, pIn, nFrames * sizeof(T));
+
+    if (pos < mGuardSize)
+      memcpy(pChan + mMask + 1 + pos, pIn, std::min(nFrames, mGuardSize - pos) * sizeof(T));
+  }
+
+  void Advance(int nFrames)
+  {
+    mBlockStart = mWritePos;
+    mWritePos = (mWritePos + nFrames) & mMask;
+  }
+
+  /** @return A pointer to the sample delay samples before the first frame of the last written block. At least mGuardSize samples can be read from it */
+  const T* GetReadPtr(int chan, int delay) const
+  {
+    return mBuffer.Get() + chan * mChanStride + ((mBlockStart - delay) & mMask);
+  }
+
+  /** Coefficients for the points delay + 2, delay + 1, delay and delay - 1 samples back, where frac is the fractional part of the delay */
+  static inline void LagrangeCoeffs(T frac, T gain, T* pCoeffs)
+  {
+    const T u = frac + T(1.);
+    const T um1 = frac;
+    const T um2 = frac - T(1.);
+    const T um3 = frac - T(2.);
+    pCoeffs[0] = gain * u * um1 * um2 / T(6.);
+    pCoeffs[1] = gain * -u * um1 * um3 / T(2.);
+    pCoeffs[2] = gain * u * um2 * um3 / T(2.);
+    pCoeffs[3] = gain * -um1 * um2 * um3 / T(6.);
+  }
+
+  template<bool Accumulate>
+  void ReadFixed(int chan, T* pOut, int nFrames, double delay, T gain, EInterp interp) const
+  {
+    const double maxDelay = static_cast<double>(mMaxDelay);
+
+    switch (interp)
+    {
+      case kInterpNone:
+      {
+        const int whole = static_cast<int>(Clip(delay, 0., maxDelay));
+
+        if (!Accumulate && gain == T(1.))
+          ReadInteger(chan, pOut, nFrames, whole);
+        else
+          ApplyKernel<1, Accumulate>(pOut, GetReadPtr(chan, whole), &gain, nFrames);
+        break;
+      }
+      case kInterpLagrange:
+      {
+        delay = Clip(delay, 1., maxDelay);
+        const int whole = static_cast<int>(delay);
+        T coeffs[4];
+        LagrangeCoeffs(static_cast<T>(delay - whole), gain, coeffs);
+        ApplyKernel<4, Accumulate>(pOut, GetReadPtr(chan, whole + 2), coeffs, nFrames);
+        break;
+      }
+      default:
+      {
+        assert(interp == kInterpLinear);
+        delay = Clip(delay, 0., maxDelay);
+        const int whole = static_cast<int>(delay);
+        const T frac = static_cast<T>(delay - whole);
+        const T coeffs[2] = { gain * frac, gain * (T(1.) - frac) };
+        ApplyKernel<2, Accumulate>(pOut, GetReadPtr(chan, whole + 1), coeffs, nFrames);
+        break;
+      }
+    }
+  }
+
+  /** y[n] = a * x[n - D] + x[n - D - 1] - a * y[n - 1], with the allpass delay D + delta kept within 0.5...1.5 samples of D */
+  template<bool Accumulate>
+  void ReadThiran(int chan, T* pOut, int nFrames, Tap& tap)
+  {
+    const double delay = Clip(tap.delay, 0.5, static_cast<double>(mMaxDelay));
+    const int whole = static_cast<int>(delay - 0.5);
+    const double delta = delay - whole;
+    const T a = static_cast<T>((1. - delta) / (1. + delta));
+    const T coeffs[2] = { T(1.), a };
+    T* pFIR = Accumulate ? mScratch.Get() : pOut;
+
+    ApplyKernel<2, false>(pFIR, GetReadPtr(chan, whole + 1), coeffs, nFrames);
+
+    T y1 = tap.thiranState;
+    const T gain = tap.gain;
+
+    for (auto s = 0; s < nFrames; s++)
+    {
+      y1 = pFIR[s] - a * y1;
+
+      if (Accumulate)
+        pOut[s] += gain * y1;
+      else
+        pOut[s] = gain * y1;
+    }
+
+    tap.thiranState = y1;
+  }
+
+  /** pOut[s] (+)= sum of pCoeffs[k] * pIn[s + k], two or four frames per instruction with IPLUG_SIMDE */
+  template<int NPoints, bool Accumulate>
+  static void ApplyKernel(T* pOut, const T* pIn, const T* pCoeffs, int nFrames)
+  {
+    int s = 0;
+
+#ifdef IPLUG_SIMDE
+    using Lanes = DelayLineLanes<T>;
+    typename Lanes::Vec coeffs[NPoints];
+
+    for (auto k = 0; k < NPoints; k++)
+      coeffs[k] = Lanes::Set1(pCoeffs[k]);
+
+    for (; s + Lanes::kNLanes <= nFrames; s += Lanes::kNLanes)
+    {
+      auto v = Lanes::Mul(coeffs[0], Lanes::Load(pIn + s));
+
+      for (auto k = 1; k < NPoints; k++)
+        v = Lanes::Add(v, Lanes::Mul(coeffs[k], Lanes::Load(pIn + s + k)));
+
+      if (Accumulate)
+        v = Lanes::Add(v, Lanes::Load(pOut + s));
+
+      Lanes::Store(pOut + s, v);
+    }
+#endif
+
+    for (; s < nFrames; s++)
+    {
+      T v = pCoeffs[0] * pIn[s];
+
+      for (auto k = 1; k < NPoints; k++)
+        v += pCoeffs[k] * pIn[s + k];
+
+      if (Accumulate)
+        pOut[s] += v;
+      else
+        pOut[s] = v;
+    }
+  }
+
+  WDL_TypedBuf<T> mBuffer;
+  WDL_TypedBuf<T> mScratch;
+  int mNChans = 0;
+  int mMaxDelay = 0;
+  int mMaxBlockSize = 1;
+  int mMask = 0;
+  int mGuardSize = 0;
+  int mChanStride = 0;
+  int mWritePos = 0;
+  int mBlockStart = 0;
+} WDL_FIXALIGN;
+
 // A static delayline used to delay bypassed signals to match mLatency in AAX/VST3/AU
 template<typename T>
 class NChanDelayLine
@@ -25,44 +470,27 @@ public:
 
   void SetDelayTime(int delayTimeSamples)
   {
-    mDTSamples = delayTimeSamples;
-    mBuffer.Resize(mNInChans * delayTimeSamples);
-    mWriteAddress = 0;
-    ClearBuffer();
+    mDTSamples = std::max(delayTimeSamples, 0);
+    // Blocks of any size are processed in chunks of kChunkSize, which keeps the ring buffers short
+    mDelayLine.Resize(std::min(mNInChans, mNOutChans), mDTSamples, kChunkSize);
   }
 
   void ClearBuffer()
   {
-    memset(mBuffer.Get(), 0, mNInChans * mDTSamples * sizeof(T));
+    mDelayLine.Clear();
   }
 
   void ProcessBlock(T** inputs, T** outputs, int nFrames)
   {
-    T* buffer = mBuffer.Get();
-
-    for (auto s = 0 ; s < nFrames; ++s)
-    {
-      for (auto c = 0; c < mNInChans; c++)
-      {
-        if (c < mNOutChans)
-        {
-          T input = inputs[c][s];
-          const int offset = c * mDTSamples;
-          outputs[c][s] = buffer[offset + mWriteAddress];
-          buffer[offset + mWriteAddress] = input;
-        }
-      }
-
-      mWriteAddress++;
-      mWriteAddress %= mDTSamples;
-    }
+    mDelayLine.ProcessBlock(inputs, outputs, nFrames, mDTSamples);
   }
 
 private:
-  WDL_TypedBuf<T> mBuffer;
-  uint32_t mNInChans, mNOutChans;
-  uint32_t mWriteAddress = 0;
-  uint32_t mDTSamples = 0;
+  static constexpr int kChunkSize = 256;
+
+  MultiTapDelayLine<T> mDelayLine { 0 };
+  int mNInChans, mNOutChans;
+  int mDTSamples = 0;
 } WDL_FIXALIGN;
 
 END_IPLUG_NAMESPACE
@@ -12,11 +12,16 @@
 
 #define OVERSAMPLING_FACTORS_VA_LIST "None", "2x", "4x", "8x", "16x"
 
+#include <algorithm>
 #include <functional>
+#include <type_traits>
 #include <cmath>
+#include <cstring>
 
 #include "HIIR/FPUUpsampler2x.h"
 #include "HIIR/FPUDownsampler2x.h"
+#include "HIIR/MultiUpsampler2x.h"
+#include "HIIR/MultiDownsampler2x.h"
 
 #include "heapbuf.h"
 #include "ptrlist.h"
@@ -37,22 +42,36 @@ enum EFactor
   kNumFactors
 };
 
+// Half-band filter coefficients for each 2x stage of the cascade. The first stage needs the steepest filter, later stages only have to reject what the previous stage let through
+static constexpr double kOverSamplerCoeffs2x[12] = { 0.036681502163648017, 0.13654762463195794, 0.27463175937945444, 0.42313861743656711, 0.56109869787919531, 0.67754004997416184, 0.76974183386322703, 0.83988962484963892, 0.89226081800387902, 0.9315419599631839, 0.96209454837808417, 0.98781637073289585 };
+static constexpr double kOverSamplerCoeffs4x[4] = {0.041893991997656171, 0.16890348243995201, 0.39056077292116603, 0.74389574826847926 };
+static constexpr double kOverSamplerCoeffs8x[3] = {0.055748680811302048, 0.24305119574153072, 0.64669913119268196 };
+static constexpr double kOverSamplerCoeffs16x[2] = {0.10717745346023573, 0.53091435354504557 };
+
+/** Up-samples, processes and down-samples audio at 2x, 4x, 8x or 16x the sample rate, using cascaded HIIR polyphase half-band filters.
+ * With IPLUG_SIMDE defined, ProcessBlock() filters groups of kLaneWidth channels at once, one channel per SIMD lane (see HIIR/MultiStageProc.h).
+ * Channels that don't fill a group use the scalar filters. Process() and ProcessGen() are single channel and always use the scalar filters.
+ * @tparam T the sample type */
 template<typename T = double>
 class OverSampler
 {
 public:
   using BlockProcessFunc = std::function<void(T**, T**, int)>;
+
+  /** The number of channels filtered together by ProcessBlock(), 1 if SIMD isn't available */
+  static constexpr int kLaneWidth = LaneVec<T>::NBR_LANES;
   
   OverSampler(EFactor factor = kNone, bool blockProcessing = true, int nInChannels = 1, int nOutChannels = 1)
   : mBlockProcessing(blockProcessing)
   , mNInChannels(nInChannels)
   , mNOutChannels(nOutChannels)
+  , mNInGroups(NumLaneGroups(nInChannels))
+  , mNOutGroups(NumLaneGroups(nOutChannels))
   {
-    
-    static constexpr double coeffs2x[12] = { 0.036681502163648017, 0.13654762463195794, 0.27463175937945444, 0.42313861743656711, 0.56109869787919531, 0.67754004997416184, 0.76974183386322703, 0.83988962484963892, 0.89226081800387902, 0.9315419599631839, 0.96209454837808417, 0.98781637073289585 };
-    static constexpr double coeffs4x[4] = {0.041893991997656171, 0.16890348243995201, 0.39056077292116603, 0.74389574826847926 };
-    static constexpr double coeffs8x[3] = {0.055748680811302048, 0.24305119574153072, 0.64669913119268196 };
-    static constexpr double coeffs16x[2] = {0.10717745346023573, 0.53091435354504557 };
+    const auto& coeffs2x = kOverSamplerCoeffs2x;
+    const auto& coeffs4x = kOverSamplerCoeffs4x;
+    const auto& coeffs8x = kOverSamplerCoeffs8x;
+    const auto& coeffs16x = kOverSamplerCoeffs16x;
 
     for (auto c = 0; c < mNInChannels; c++)
     {
@@ -85,6 +104,32 @@ public:
       // ptr location doesn't matter at this stage
       mNextOutputPtrs.Add(mDown2x.Get());
     }
+    
+    for (auto g = 0; g < mNInGroups; g++)
+    {
+      mMultiUpsampler2x.Add(new Upsampler2xMulti<12, T>());
+      mMultiUpsampler4x.Add(new Upsampler2xMulti<4, T>());
+      mMultiUpsampler8x.Add(new Upsampler2xMulti<3, T>());
+      mMultiUpsampler16x.Add(new Upsampler2xMulti<2, T>());
+      
+      mMultiUpsampler2x.Get(g)->set_coefs(coeffs2x);
+      mMultiUpsampler4x.Get(g)->set_coefs(coeffs4x);
+      mMultiUpsampler8x.Get(g)->set_coefs(coeffs8x);
+      mMultiUpsampler16x.Get(g)->set_coefs(coeffs16x);
+    }
+    
+    for (auto g = 0; g < mNOutGroups; g++)
+    {
+      mMultiDownsampler2x.Add(new Downsampler2xMulti<12, T>());
+      mMultiDownsampler4x.Add(new Downsampler2xMulti<4, T>());
+      mMultiDownsampler8x.Add(new Downsampler2xMulti<3, T>());
+      mMultiDownsampler16x.Add(new Downsampler2xMulti<2, T>());
+      
+      mMultiDownsampler2x.Get(g)->set_coefs(coeffs2x);
+      mMultiDownsampler4x.Get(g)->set_coefs(coeffs4x);
+      mMultiDownsampler8x.Get(g)->set_coefs(coeffs8x);
+      mMultiDownsampler16x.Get(g)->set_coefs(coeffs16x);
+    }
         
     SetOverSampling(factor);
     
@@ -101,6 +146,14 @@ public:
     mDownsampler8x.Empty(true);
     mUpsampler16x.Empty(true);
     mDownsampler16x.Empty(true);
+    mMultiUpsampler2x.Empty(true);
+    mMultiDownsampler2x.Empty(true);
+    mMultiUpsampler4x.Empty(true);
+    mMultiDownsampler4x.Empty(true);
+    mMultiUpsampler8x.Empty(true);
+    mMultiDownsampler8x.Empty(true);
+    mMultiUpsampler16x.Empty(true);
+    mMultiDownsampler16x.Empty(true);
   }
 
   OverSampler(const OverSampler&) = delete;
@@ -165,6 +218,30 @@ public:
       mDown8BufferPtrs.Add(mDown8x.Get() + (c * 8 * blockSize));
       mDown16BufferPtrs.Add(mDown16x.Get() + (c * 16 * blockSize));
     }
+    
+    for (auto g = 0; g < mNInGroups; g++)
+    {
+      mMultiUpsampler2x.Get(g)->clear_buffers();
+      mMultiUpsampler4x.Get(g)->clear_buffers();
+      mMultiUpsampler8x.Get(g)->clear_buffers();
+      mMultiUpsampler16x.Get(g)->clear_buffers();
+    }
+    
+    for (auto g = 0; g < mNOutGroups; g++)
+    {
+      mMultiDownsampler2x.Get(g)->clear_buffers();
+      mMultiDownsampler4x.Get(g)->clear_buffers();
+      mMultiDownsampler8x.Get(g)->clear_buffers();
+      mMultiDownsampler16x.Get(g)->clear_buffers();
+    }
+    
+    // Unused lanes of a partly filled group read silence and write to a scratch buffer
+    if (mNInGroups || mNOutGroups)
+    {
+      mLaneSilence.Resize(16 * blockSize);
+      mLaneScratch.Resize(16 * blockSize);
+      memset(mLaneSilence.Get(), 0, mLaneSilence.GetSize() * sizeof(T));
+    }
   }
 
   /** Over sample an input block with a per-block function (up sample input -> process with function -> down sample)
@@ -205,7 +282,26 @@ public:
       mPrevRate = mRate;
     }
 
-    for (auto c = 0; c < nInChans; c++) {
+    for (auto g = 0; g < mNInGroups; g++) {
+      if (mRate >= 2) {
+        SetLanePtrs(g, nInChans, inputs, mUp2BufferPtrs.GetList());
+        mMultiUpsampler2x.Get(g)->process_block(mLaneDstPtrs, mLaneSrcPtrs, nFrames);
+      }
+      if (mRate >= 4) {
+        SetLanePtrs(g, nInChans, mUp2BufferPtrs.GetList(), mUp4BufferPtrs.GetList());
+        mMultiUpsampler4x.Get(g)->process_block(mLaneDstPtrs, mLaneSrcPtrs, nFrames * 2);
+      }
+      if (mRate >= 8) {
+        SetLanePtrs(g, nInChans, mUp4BufferPtrs.GetList(), mUp8BufferPtrs.GetList());
+        mMultiUpsampler8x.Get(g)->process_block(mLaneDstPtrs, mLaneSrcPtrs, nFrames * 4);
+      }
+      if (mRate == 16) {
+        SetLanePtrs(g, nInChans, mUp8BufferPtrs.GetList(), mUp16BufferPtrs.GetList());
+        mMultiUpsampler16x.Get(g)->process_block(mLaneDstPtrs, mLaneSrcPtrs, nFrames * 8);
+      }
+    }
+    
+    for (auto c = mNInGroups * kLaneWidth; c < nInChans; c++) {
       if (mRate >= 2) {
         mUpsampler2x.Get(c)->process_block(mUp2BufferPtrs.Get(c), inputs[c], nFrames);
       }
@@ -232,7 +328,26 @@ public:
       }
     }
     
-    for (auto c = 0; c < nOutChans; c++) {
+    for (auto g = 0; g < mNOutGroups; g++) {
+      if (mRate == 16) {
+        SetLanePtrs(g, nOutChans, mDown16BufferPtrs.GetList(), mDown8BufferPtrs.GetList());
+        mMultiDownsampler16x.Get(g)->process_block(mLaneDstPtrs, mLaneSrcPtrs, nFrames * 8);
+      }
+      if (mRate >= 8) {
+        SetLanePtrs(g, nOutChans, mDown8BufferPtrs.GetList(), mDown4BufferPtrs.GetList());
+        mMultiDownsampler8x.Get(g)->process_block(mLaneDstPtrs, mLaneSrcPtrs, nFrames * 4);
+      }
+      if (mRate >= 4) {
+        SetLanePtrs(g, nOutChans, mDown4BufferPtrs.GetList(), mDown2BufferPtrs.GetList());
+        mMultiDownsampler4x.Get(g)->process_block(mLaneDstPtrs, mLaneSrcPtrs, nFrames * 2);
+      }
+      if (mRate >= 2) {
+        SetLanePtrs(g, nOutChans, mDown2BufferPtrs.GetList(), outputs);
+        mMultiDownsampler2x.Get(g)->process_block(mLaneDstPtrs, mLaneSrcPtrs, nFrames);
+      }
+    }
+    
+    for (auto c = mNOutGroups * kLaneWidth; c < nOutChans; c++) {
       if (mRate == 16) {
         mDownsampler16x.Get(c)->process_block(mDown8BufferPtrs.Get(c), mDown16BufferPtrs.Get(c), nFrames * 8);
       }
@@ -431,6 +546,36 @@ public:
   }
 
 private:
+  /** Channels are filtered in groups of kLaneWidth. A trailing partial group is only worth it if it fills at least half its lanes, and more than one */
+  static int NumLaneGroups(int nChans)
+  {
+    if (kLaneWidth < 2)
+      return 0;
+    
+    const int remainder = nChans % kLaneWidth;
+    return (nChans / kLaneWidth) + ((remainder > 1 && remainder * 2 >= kLaneWidth) ? 1 : 0);
+  }
+  
+  /** Point the lanes of a group at the source and destination buffers of its channels. Lanes beyond nChans read silence and write to scratch */
+  void SetLanePtrs(int group, int nChans, T* const* src, T* const* dst)
+  {
+    for (auto l = 0; l < kLaneWidth; l++)
+    {
+      const auto c = group * kLaneWidth + l;
+      
+      if (c < nChans)
+      {
+        mLaneSrcPtrs[l] = src[c];
+        mLaneDstPtrs[l] = dst[c];
+      }
+      else
+      {
+        mLaneSrcPtrs[l] = mLaneSilence.Get();
+        mLaneDstPtrs[l] = mLaneScratch.Get();
+      }
+    }
+  }
+  
   EFactor mFactor = kNone;
   int mPrevRate = 0;
   int mRate = 1;
@@ -439,6 +584,8 @@ private:
   bool mBlockProcessing; // false
   int mNInChannels; // 1
   int mNOutChannels;
+  int mNInGroups; // groups of kLaneWidth input channels filtered together
+  int mNOutGroups;
   
   // the actual data
   WDL_TypedBuf<T> mUp16x;
@@ -479,6 +626,285 @@ private:
   WDL_PtrList<Downsampler2xFPU<4, T>> mDownsampler4x;  // decimator for 4x to 2x SR
   WDL_PtrList<Downsampler2xFPU<3, T>> mDownsampler8x;  // decimator for 8x to 4x SR
   WDL_PtrList<Downsampler2xFPU<2, T>> mDownsampler16x; // decimator for 16x to 8x SR
+  
+  //Ptrs to multi-channel oversamplers for each group of kLaneWidth channels
+  WDL_PtrList<Upsampler2xMulti<12, T>> mMultiUpsampler2x;
+  WDL_PtrList<Upsampler2xMulti<4, T>> mMultiUpsampler4x;
+  WDL_PtrList<Upsampler2xMulti<3, T>> mMultiUpsampler8x;
+  WDL_PtrList<Upsampler2xMulti<2, T>> mMultiUpsampler16x;
+  
+  WDL_PtrList<Downsampler2xMulti<12, T>> mMultiDownsampler2x;
+  WDL_PtrList<Downsampler2xMulti<4, T>> mMultiDownsampler4x;
+  WDL_PtrList<Downsampler2xMulti<3, T>> mMultiDownsampler8x;
+  WDL_PtrList<Downsampler2xMulti<2, T>> mMultiDownsampler16x;
+  
+  const T* mLaneSrcPtrs[kLaneWidth];
+  T* mLaneDstPtrs[kLaneWidth];
+  WDL_TypedBuf<T> mLaneSilence;
+  WDL_TypedBuf<T> mLaneScratch;
+};
+
+/** An OverSampler for hot paths, such as many oversampled stages in a chain.
+ * The maximum factor and the processing callable are template parameters, so the callable is inlined rather than called through a std::function.
+ * Each 2x stage filters a whole block at a time, rather than running the whole cascade for every input sample as OverSampler::Process() does.
+ * Buffers are sized for MaxFactor and the maximum block size in Reset(), so SetOverSampling() can switch factor on the audio thread without allocating.
+ * @tparam MaxFactor The highest oversampling factor that will be used
+ * @tparam T the sample type */
+template<EFactor MaxFactor = k16x, typename T = double>
+class StaticOverSampler
+{
+public:
+  static constexpr int kMaxRate = 1 << MaxFactor;
+  
+  static_assert(MaxFactor > kNone && MaxFactor < kNumFactors, "StaticOverSampler MaxFactor must be between k2x and k16x");
+
+  /** Constructor. Allocates, call Reset() again if the maximum block size changes
+   * @param factor The initial oversampling factor, <= MaxFactor
+   * @param nChannels The number of channels to process
+   * @param maxBlockSize The largest nFrames that will be passed in one call. Larger blocks are split */
+  StaticOverSampler(EFactor factor = MaxFactor, int nChannels = 1, int maxBlockSize = DEFAULT_BLOCK_SIZE)
+  {
+    for (auto c = 0; c < nChannels; c++)
+    {
+      Channel* pChannel = new Channel();
+      pChannel->up2x.set_coefs(kOverSamplerCoeffs2x);
+      pChannel->up4x.set_coefs(kOverSamplerCoeffs4x);
+      pChannel->up8x.set_coefs(kOverSamplerCoeffs8x);
+      pChannel->up16x.set_coefs(kOverSamplerCoeffs16x);
+      pChannel->down2x.set_coefs(kOverSamplerCoeffs2x);
+      pChannel->down4x.set_coefs(kOverSamplerCoeffs4x);
+      pChannel->down8x.set_coefs(kOverSamplerCoeffs8x);
+      pChannel->down16x.set_coefs(kOverSamplerCoeffs16x);
+      mChannels.Add(pChannel);
+    }
+    
+    Reset(maxBlockSize);
+    SetOverSampling(factor);
+  }
+  
+  ~StaticOverSampler()
+  {
+    mChannels.Empty(true);
+  }
+  
+  StaticOverSampler(const StaticOverSampler&) = delete;
+  StaticOverSampler& operator=(const StaticOverSampler&) = delete;
+  
+  /** Size the buffers for MaxFactor and clear the filter state. Allocates
+   * @param maxBlockSize The largest nFrames that will be passed in one call */
+  void Reset(int maxBlockSize = DEFAULT_BLOCK_SIZE)
+  {
+    mMaxBlockSize = std::max(maxBlockSize, 1);
+    
+    for (auto c = 0; c < mChannels.GetSize(); c++)
+    {
+      Channel* pChannel = mChannels.Get(c);
+      
+      for (auto s = 0; s < MaxFactor; s++)
+        pChannel->stages[s].Resize(mMaxBlockSize << (s + 1));
+      
+      pChannel->top.Resize(mMaxBlockSize * kMaxRate);
+    }
+    
+    mInPtrs.Resize(mChannels.GetSize());
+    mOutPtrs.Resize(mChannels.GetSize());
+    
+    ClearState();
+  }
+  
+  /** Switch factor. Doesn't allocate, so can be called on the audio thread. Clears the filter state if the factor changes
+   * @param factor The new factor, <= MaxFactor */
+  void SetOverSampling(EFactor factor)
+  {
+    assert(factor <= MaxFactor);
+    factor = std::min(factor, MaxFactor);
+    
+    if (factor != mFactor)
+    {
+      mFactor = factor;
+      ClearState();
+    }
+  }
+  
+  int GetRate() const
+  {
+    return 1 << mFactor;
+  }
+  
+  /** Over sample a block with a per-block callable (up sample input -> process with func -> down sample)
+   * @param inputs Non-interleaved input buffers, one per channel
+   * @param outputs Non-interleaved output buffers, one per channel. May be the same as inputs
+   * @param nFrames The number of samples per channel at the original rate
+   * @param nChans The number of channels to process, <= the number passed to the constructor
+   * @param func Called as func(T** inputs, T** outputs, int nFrames) at the higher rate, once per chunk of up to maxBlockSize input frames */
+  template <typename F>
+  void ProcessBlock(T** inputs, T** outputs, int nFrames, int nChans, F&& func)
+  {
+    switch (mFactor)
+    {
+      case k2x: ProcessChunks<1, false>(inputs, outputs, nFrames, nChans, func); break;
+      case k4x: ProcessChunks<2, false>(inputs, outputs, nFrames, nChans, func); break;
+      case k8x: ProcessChunks<3, false>(inputs, outputs, nFrames, nChans, func); break;
+      case k16x: ProcessChunks<4, false>(inputs, outputs, nFrames, nChans, func); break;
+      default: func(inputs, outputs, nFrames); break;
+    }
+  }
+  
+  /** Over sample a block with a per-sample callable, which is applied in place to every sample at the higher rate
+   * @param inputs Non-interleaved input buffers, one per channel
+   * @param outputs Non-interleaved output buffers, one per channel. May be the same as inputs
+   * @param nFrames The number of samples per channel at the original rate
+   * @param nChans The number of channels to process, <= the number passed to the constructor
+   * @param func Called as T func(int channel, T sample) */
+  template <typename F>
+  void ProcessSamples(T** inputs, T** outputs, int nFrames, int nChans, F&& func)
+  {
+    switch (mFactor)
+    {
+      case k2x: ProcessChunks<1, true>(inputs, outputs, nFrames, nChans, func); break;
+      case k4x: ProcessChunks<2, true>(inputs, outputs, nFrames, nChans, func); break;
+      case k8x: ProcessChunks<3, true>(inputs, outputs, nFrames, nChans, func); break;
+      case k16x: ProcessChunks<4, true>(inputs, outputs, nFrames, nChans, func); break;
+      default:
+        for (auto c = 0; c < nChans; c++)
+        {
+          for (auto s = 0; s < nFrames; s++)
+            outputs[c][s] = func(c, inputs[c][s]);
+        }
+        break;
+    }
+  }
+  
+private:
+  struct Channel
+  {
+    Upsampler2xFPU<12, T> up2x;
+    Upsampler2xFPU<4, T> up4x;
+    Upsampler2xFPU<3, T> up8x;
+    Upsampler2xFPU<2, T> up16x;
+    
+    Downsampler2xFPU<12, T> down2x;
+    Downsampler2xFPU<4, T> down4x;
+    Downsampler2xFPU<3, T> down8x;
+    Downsampler2xFPU<2, T> down16x;
+    
+    WDL_TypedBuf<T> stages[kNumFactors - 1]; // up sampled data at 2x, 4x, 8x and 16x
+    WDL_TypedBuf<T> top; // output of a per-block callable, at the highest rate
+  };
+  
+  void ClearState()
+  {
+    for (auto c = 0; c < mChannels.GetSize(); c++)
+    {
+      Channel* pChannel = mChannels.Get(c);
+      pChannel->up2x.clear_buffers();
+      pChannel->up4x.clear_buffers();
+      pChannel->up8x.clear_buffers();
+      pChannel->up16x.clear_buffers();
+      pChannel->down2x.clear_buffers();
+      pChannel->down4x.clear_buffers();
+      pChannel->down8x.clear_buffers();
+      pChannel->down16x.clear_buffers();
+    }
+  }
+  
+  /** Splits the block into chunks of at most mMaxBlockSize and processes them with NStages 2x stages
+   * @tparam NStages The number of 2x stages, log2 of the rate
+   * @tparam PerSample true if func is a per-sample callable, false if it is a per-block callable */
+  template <int NStages, bool PerSample, typename F>
+  void ProcessChunks(T** inputs, T** outputs, int nFrames, int nChans, F& func)
+  {
+    assert(nChans <= mChannels.GetSize());
+    
+    for (auto offset = 0; offset < nFrames; offset += mMaxBlockSize)
+    {
+      const int n = std::min(nFrames - offset, mMaxBlockSize);
+      
+      for (auto c = 0; c < nChans; c++)
+        Upsample<NStages>(*mChannels.Get(c), inputs[c] + offset, n);
+      
+      const int nUp = n << NStages;
+      
+      ApplyFunc(func, nUp, nChans, NStages - 1, std::integral_constant<bool, PerSample>());
+      
+      for (auto c = 0; c < nChans; c++)
+      {
+        Channel& channel = *mChannels.Get(c);
+        T* pTop = PerSample ? channel.stages[NStages - 1].Get() : channel.top.Get();
+        Downsample<NStages>(channel, pTop, outputs[c] + offset, n);
+      }
+    }
+  }
+  
+  /** Run a per-sample callable in place on the up sampled data of stage topStage */
+  template <typename F>
+  void ApplyFunc(F& func, int nUp, int nChans, int topStage, std::true_type)
+  {
+    for (auto c = 0; c < nChans; c++)
+    {
+      T* pData = mChannels.Get(c)->stages[topStage].Get();
+      
+      for (auto s = 0; s < nUp; s++)
+        pData[s] = func(c, pData[s]);
+    }
+  }
+  
+  /** Run a per-block callable on the up sampled data of stage topStage, writing to the top buffers */
+  template <typename F>
+  void ApplyFunc(F& func, int nUp, int nChans, int topStage, std::false_type)
+  {
+    for (auto c = 0; c < nChans; c++)
+    {
+      mInPtrs.Get()[c] = mChannels.Get(c)->stages[topStage].Get();
+      mOutPtrs.Get()[c] = mChannels.Get(c)->top.Get();
+    }
+    
+    func(mInPtrs.Get(), mOutPtrs.Get(), nUp);
+  }
+  
+  template <int NStages>
+  static void Upsample(Channel& channel, const T* pIn, int nFrames)
+  {
+    channel.up2x.process_block(channel.stages[0].Get(), pIn, nFrames);
+    
+    if (NStages >= 2)
+      channel.up4x.process_block(channel.stages[1].Get(), channel.stages[0].Get(), nFrames * 2);
+    if (NStages >= 3)
+      channel.up8x.process_block(channel.stages[2].Get(), channel.stages[1].Get(), nFrames * 4);
+    if (NStages >= 4)
+      channel.up16x.process_block(channel.stages[3].Get(), channel.stages[2].Get(), nFrames * 8);
+  }
+  
+  /** Down samples pTop, which holds nFrames << NStages samples, into pOut. The stage buffers below the top are reused as scratch */
+  template <int NStages>
+  static void Downsample(Channel& channel, const T* pTop, T* pOut, int nFrames)
+  {
+    const T* pSrc = pTop;
+    
+    if (NStages >= 4)
+    {
+      channel.down16x.process_block(channel.stages[2].Get(), pSrc, nFrames * 8);
+      pSrc = channel.stages[2].Get();
+    }
+    if (NStages >= 3)
+    {
+      channel.down8x.process_block(channel.stages[1].Get(), pSrc, nFrames * 4);
+      pSrc = channel.stages[1].Get();
+    }
+    if (NStages >= 2)
+    {
+      channel.down4x.process_block(channel.stages[0].Get(), pSrc, nFrames * 2);
+      pSrc = channel.stages[0].Get();
+    }
+    
+    channel.down2x.process_block(pOut, pSrc, nFrames);
+  }
+  
+  EFactor mFactor = kNone;
+  int mMaxBlockSize = 0;
+  WDL_PtrList<Channel> mChannels;
+  WDL_TypedBuf<T*> mInPtrs;
+  WDL_TypedBuf<T*> mOutPtrs;
 };
 
 END_IPLUG_NAMESPACE
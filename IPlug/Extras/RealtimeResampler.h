@@ -32,7 +32,7 @@ BEGIN_IPLUG_NAMESPACE
  * 
  * The Lanczos resampler has a configurable filter size (A) that affects the 
  * latency of the resampler. It can also optionally use SIMD instructions
- * when T==float.
+ * for float or double, see LanczosResampler.
  *
  * @tparam T the sampletype float or double
  * @tparam NCHANS the number of channels
@@ -98,8 +98,10 @@ public:
     {
       const T outerRate = static_cast<T>(mOuterSampleRate);
       const T innerRate = static_cast<T>(mInnerSampleRate);
-      mInResampler = std::make_unique<LanczosResampler>(outerRate, innerRate);
-      mOutResampler = std::make_unique<LanczosResampler>(innerRate, outerRate);
+      // Each resampler buffers one block plus the filter history, so the buffer has to grow with the block size, e.g. at 192kHz
+      const auto bufferSize = std::max(static_cast<size_t>(std::max(mMaxOuterLength, mMaxInnerLength)) + 4 * A, LanczosResampler::kDefaultBufferSize);
+      mInResampler = std::make_unique<LanczosResampler>(outerRate, innerRate, bufferSize);
+      mOutResampler = std::make_unique<LanczosResampler>(innerRate, outerRate, bufferSize);
       
       // Warm up the resamplers with enough silence that the first real buffer can yield the required number of output samples.
       const auto outSamplesRequired = mOutResampler->GetNumSamplesRequiredFor(1);
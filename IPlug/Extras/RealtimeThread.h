@@ -0,0 +1,176 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+ */
+
+#pragma once
+
+/**
+ * @file
+ * @brief Helpers for worker threads that do work for the audio thread: SetCurrentThreadRealtimePriority() and RealtimeSemaphore
+ */
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+#include "IPlugPlatform.h"
+
+#if defined OS_WIN
+  #ifndef NOMINMAX
+    #define NOMINMAX
+  #endif
+  #include <windows.h>
+#elif defined OS_MAC || defined OS_IOS || defined OS_VISION
+  #include <mach/mach.h>
+  #include <mach/mach_time.h>
+  #include <mach/semaphore.h>
+  #include <mach/thread_policy.h>
+  #include <pthread.h>
+#else
+  #include <cerrno>
+  #include <pthread.h>
+  #include <sched.h>
+  #include <semaphore.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_IX86)
+  #include <emmintrin.h>
+  #define IPLUG_SPIN_PAUSE() _mm_pause()
+#elif defined(__aarch64__) || defined(__arm__)
+  #define IPLUG_SPIN_PAUSE() __asm__ __volatile__("yield")
+#else
+  #define IPLUG_SPIN_PAUSE() std::this_thread::yield()
+#endif
+
+BEGIN_IPLUG_NAMESPACE
+
+/** Give the calling thread the scheduling class of an audio thread, where the platform allows it, so that the audio thread does not
+ * wait on a worker that has been preempted by ordinary threads. Call it at the start of the worker's thread function.
+ * On macOS and iOS this is the time constraint policy that CoreAudio's I/O threads use, on Windows THREAD_PRIORITY_TIME_CRITICAL, and elsewhere
+ * SCHED_FIFO, which usually needs extra privileges. Joining the host's audio workgroup (macOS 11) needs the workgroup from the host, so is
+ * left to the plug-in
+ * @param periodMS The expected time between audio callbacks in milliseconds, used by the macOS time constraint policy
+ * @return \c true if the priority was changed, otherwise the thread keeps its priority */
+static inline bool SetCurrentThreadRealtimePriority(double periodMS = 3.)
+{
+#if defined OS_WIN
+  return SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL) != 0;
+#elif defined OS_MAC || defined OS_IOS || defined OS_VISION
+  mach_timebase_info_data_t timebase;
+  mach_timebase_info(&timebase);
+  const double ticksPerMS = 1000000. * timebase.denom / timebase.numer;
+
+  thread_time_constraint_policy_data_t policy;
+  policy.period = static_cast<uint32_t>(periodMS * ticksPerMS);
+  policy.computation = static_cast<uint32_t>(0.5 * periodMS * ticksPerMS);
+  policy.constraint = policy.period;
+  policy.preemptible = true;
+
+  return thread_policy_set(pthread_mach_thread_np(pthread_self()), THREAD_TIME_CONSTRAINT_POLICY,
+                           reinterpret_cast<thread_policy_t>(&policy), THREAD_TIME_CONSTRAINT_POLICY_COUNT) == KERN_SUCCESS;
+#elif defined OS_WEB
+  return false;
+#else
+  const int minPriority = sched_get_priority_min(SCHED_FIFO);
+  const int maxPriority = sched_get_priority_max(SCHED_FIFO);
+  sched_param param {};
+  param.sched_priority = minPriority + ((maxPriority - minPriority) * 3) / 4; // below JACK's default for its own threads
+  return pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;
+#endif
+}
+
+/** A counting semaphore for waking a worker thread from the audio thread.
+ * Signal() never locks, and only makes a system call if the worker is blocked in Wait(). A signal that arrives before the worker waits is
+ * counted, so it is never lost, whatever the interleaving. The worker can spin on TryWait() for a while before it blocks */
+class RealtimeSemaphore final
+{
+public:
+  RealtimeSemaphore()
+  {
+#if defined OS_WIN
+    mSemaphore = CreateSemaphore(NULL, 0, LONG_MAX, NULL);
+#elif defined OS_MAC || defined OS_IOS || defined OS_VISION
+    semaphore_create(mach_task_self(), &mSemaphore, SYNC_POLICY_FIFO, 0);
+#else
+    sem_init(&mSemaphore, 0, 0);
+#endif
+  }
+
+  ~RealtimeSemaphore()
+  {
+#if defined OS_WIN
+    CloseHandle(mSemaphore);
+#elif defined OS_MAC || defined OS_IOS || defined OS_VISION
+    semaphore_destroy(mach_task_self(), mSemaphore);
+#else
+    sem_destroy(&mSemaphore);
+#endif
+  }
+
+  RealtimeSemaphore(const RealtimeSemaphore&) = delete;
+  RealtimeSemaphore& operator=(const RealtimeSemaphore&) = delete;
+
+  /** Wake the waiting thread, or let its next Wait() or TryWait() return at once. Writes made before Signal() are visible to the
+   * thread once its wait returns */
+  void Signal()
+  {
+    if (mCount.fetch_add(1, std::memory_order_release) < 0)
+    {
+#if defined OS_WIN
+      ReleaseSemaphore(mSemaphore, 1, NULL);
+#elif defined OS_MAC || defined OS_IOS || defined OS_VISION
+      semaphore_signal(mSemaphore);
+#else
+      sem_post(&mSemaphore);
+#endif
+    }
+  }
+
+  /** Consume a signal if there is one, without blocking
+   * @return \c true if a signal was consumed */
+  bool TryWait()
+  {
+    int count = mCount.load(std::memory_order_relaxed);
+
+    while (count > 0)
+    {
+      if (mCount.compare_exchange_weak(count, count - 1, std::memory_order_acquire, std::memory_order_relaxed))
+        return true;
+    }
+
+    return false;
+  }
+
+  /** Block until there is a signal, and consume it */
+  void Wait()
+  {
+    if (mCount.fetch_sub(1, std::memory_order_acquire) > 0)
+      return;
+
+#if defined OS_WIN
+    WaitForSingleObject(mSemaphore, INFINITE);
+#elif defined OS_MAC || defined OS_IOS || defined OS_VISION
+    while (semaphore_wait(mSemaphore) == KERN_ABORTED) {}
+#else
+    while (sem_wait(&mSemaphore) != 0 && errno == EINTR) {}
+#endif
+  }
+
+private:
+  std::atomic<int> mCount {0}; // signals not yet consumed, or minus the number of blocked waiters
+#if defined OS_WIN
+  HANDLE mSemaphore;
+#elif defined OS_MAC || defined OS_IOS || defined OS_VISION
+  semaphore_t mSemaphore;
+#else
+  sem_t mSemaphore;
+#endif
+};
+
+END_IPLUG_NAMESPACE
@@ -14,10 +14,22 @@
  * @file
  * Multi-channel SVF Based on Andy Simper's code:
  * - http://www.cytomic.com/files/dsp/SvfLinearTrapOptimised2.pdf
+ * ProcessBlockModulated() supports per-sample cutoff modulation, e.g. for stacked synth voices, one voice per channel.
+ * Define IPLUG_SIMDE at project level in order to process pairs of channels with SSE2 instructions in ProcessBlockModulated(), and if on non-x86_64
+ * include the SIMDE library in your search paths in order to translate intel intrinsics to e.g. arm64.
  */
 
 #include <complex>
 
+#if defined IPLUG_SIMDE
+  #if defined(__arm64__)
+    #define SIMDE_ENABLE_NATIVE_ALIASES
+    #include "simde/x86/sse2.h"
+  #else
+    #include <emmintrin.h>
+  #endif
+#endif
+
 #include "IPlugPlatform.h"
 
 BEGIN_IPLUG_NAMESPACE
@@ -121,6 +133,77 @@ public:
     }
   }
 
+  /** Process a block with the cutoff frequency modulated per sample. Mode, Q, gain and sample rate are taken from the Set*() methods, SetFreqCPS() is ignored.
+   * The prewarping tan() is computed per sample with FastTan(), so coefficients match UpdateCoefficients() to within ~1e-12 relative
+   * @param ppCutoffHz nChans buffers of nFrames cutoff frequencies in Hz, one per channel. The same buffer may be passed for every channel.
+   * Values are clipped to the same range as SetFreqCPS(), and below Nyquist */
+  void ProcessBlockModulated(T** inputs, T** outputs, int nChans, int nFrames, const T* const* ppCutoffHz)
+  {
+    assert(nChans <= NC);
+
+    if(mState != mNewState)
+      UpdateCoefficients();
+
+    const double minFreq = 10.;
+    const double maxFreq = std::min(20000., mState.sampleRate * 0.49);
+    const double piOverSR = PI / mState.sampleRate;
+
+    int c = 0;
+
+#ifdef IPLUG_SIMDE
+    for (; c + 1 < nChans; c += 2)
+      ProcessModulatedPair(inputs, outputs, c, nFrames, ppCutoffHz, minFreq, maxFreq, piOverSR);
+#endif
+
+    for (; c < nChans; c++)
+    {
+      const T* pCutoff = ppCutoffHz[c];
+
+      for (auto s = 0; s < nFrames; s++)
+      {
+        const double freq = Clip(static_cast<double>(pCutoff[s]), minFreq, maxFreq);
+        double num, den;
+        FastTanFraction(freq * piOverSR, num, den);
+        num *= mGScale;
+        // with g = num / den, a1 = 1 / (1 + g * (g + k)) = den^2 / e, so all three coefficients share one division
+        const double oneOverE = 1. / (den * den + num * (num + mK * den));
+        const double a1 = den * den * oneOverE;
+        const double a2 = num * den * oneOverE;
+        const double a3 = num * num * oneOverE;
+        const double v0 = static_cast<double>(inputs[c][s]);
+
+        mV3[c] = v0 - mIc2eq[c];
+        mV1[c] = a1 * mIc1eq[c] + a2 * mV3[c];
+        mV2[c] = mIc2eq[c] + a2 * mIc1eq[c] + a3 * mV3[c];
+        mIc1eq[c] = 2.0 * mV1[c] - mIc1eq[c];
+        mIc2eq[c] = 2.0 * mV2[c] - mIc2eq[c];
+
+        outputs[c][s] = static_cast<T>(m_m0 * v0 + m_m1 * mV1[c] + m_m2 * mV2[c]);
+      }
+    }
+  }
+
+  /** tan(x) for x in [0, pi/2). Reflects x > pi/4 to pi/2 - x, and evaluates a [7/6] Pade approximant there, max relative error ~2e-13.
+   * Branch-free, so it can be evaluated on SIMD lanes */
+  static inline double FastTan(double x)
+  {
+    double num, den;
+    FastTanFraction(x, num, den);
+    return num / den;
+  }
+
+  /** FastTan() as a fraction, tan(x) ~= num / den, so that callers can fold the division into their own */
+  static inline void FastTanFraction(double x, double& num, double& den)
+  {
+    const bool reflect = x > 0.7853981633974483;
+    const double y = reflect ? 1.5707963267948966 - x : x;
+    const double y2 = y * y;
+    const double p = y * (135135. + y2 * (-17325. + y2 * (378. - y2)));
+    const double q = 135135. + y2 * (-62370. + y2 * (3150. - 28. * y2));
+    num = reflect ? q : p;
+    den = reflect ? p : q;
+  }
+
   void Reset()
   {
     for (auto c = 0; c < NC; c++)
@@ -244,7 +327,85 @@ private:
       default:
         break;
     }
+
+    mK = 1. / mState.Q;
+    mGScale = (mState.mode == kLowPassShelf || mState.mode == kHighPassShelf) ? 1. / std::sqrt(std::pow(10., mState.gain/40.)) : 1.;
+  }
+
+#ifdef IPLUG_SIMDE
+  /** ProcessBlockModulated() for channels c and c + 1, one per SSE2 lane */
+  void ProcessModulatedPair(T** inputs, T** outputs, int c, int nFrames, const T* const* ppCutoffHz, double minFreq, double maxFreq, double piOverSR)
+  {
+    const __m128d vMinFreq = _mm_set1_pd(minFreq);
+    const __m128d vMaxFreq = _mm_set1_pd(maxFreq);
+    const __m128d vPiOverSR = _mm_set1_pd(piOverSR);
+    const __m128d vGScale = _mm_set1_pd(mGScale);
+    const __m128d vK = _mm_set1_pd(mK);
+    const __m128d vM0 = _mm_set1_pd(m_m0);
+    const __m128d vM1 = _mm_set1_pd(m_m1);
+    const __m128d vM2 = _mm_set1_pd(m_m2);
+    const __m128d one = _mm_set1_pd(1.);
+    const __m128d two = _mm_set1_pd(2.);
+    const __m128d quarterPi = _mm_set1_pd(0.7853981633974483);
+    const __m128d halfPi = _mm_set1_pd(1.5707963267948966);
+
+    __m128d ic1eq = _mm_loadu_pd(&mIc1eq[c]);
+    __m128d ic2eq = _mm_loadu_pd(&mIc2eq[c]);
+    __m128d v1 = _mm_loadu_pd(&mV1[c]);
+    __m128d v2 = _mm_loadu_pd(&mV2[c]);
+    __m128d v3 = _mm_loadu_pd(&mV3[c]);
+
+    const T* pCutoff0 = ppCutoffHz[c];
+    const T* pCutoff1 = ppCutoffHz[c + 1];
+    const T* pIn0 = inputs[c];
+    const T* pIn1 = inputs[c + 1];
+    T* pOut0 = outputs[c];
+    T* pOut1 = outputs[c + 1];
+
+    for (auto s = 0; s < nFrames; s++)
+    {
+      const __m128d freq = _mm_min_pd(_mm_max_pd(_mm_set_pd(pCutoff1[s], pCutoff0[s]), vMinFreq), vMaxFreq);
+      const __m128d x = _mm_mul_pd(freq, vPiOverSR);
+
+      // FastTan()
+      const __m128d reflect = _mm_cmpgt_pd(x, quarterPi);
+      const __m128d y = Select(reflect, _mm_sub_pd(halfPi, x), x);
+      const __m128d y2 = _mm_mul_pd(y, y);
+      const __m128d num = _mm_mul_pd(y, _mm_add_pd(_mm_set1_pd(135135.), _mm_mul_pd(y2, _mm_add_pd(_mm_set1_pd(-17325.), _mm_mul_pd(y2, _mm_sub_pd(_mm_set1_pd(378.), y2))))));
+      const __m128d den = _mm_add_pd(_mm_set1_pd(135135.), _mm_mul_pd(y2, _mm_add_pd(_mm_set1_pd(-62370.), _mm_mul_pd(y2, _mm_sub_pd(_mm_set1_pd(3150.), _mm_mul_pd(_mm_set1_pd(28.), y2))))));
+      const __m128d gNum = _mm_mul_pd(Select(reflect, den, num), vGScale);
+      const __m128d gDen = Select(reflect, num, den);
+
+      const __m128d oneOverE = _mm_div_pd(one, _mm_add_pd(_mm_mul_pd(gDen, gDen), _mm_mul_pd(gNum, _mm_add_pd(gNum, _mm_mul_pd(vK, gDen)))));
+      const __m128d a1 = _mm_mul_pd(_mm_mul_pd(gDen, gDen), oneOverE);
+      const __m128d a2 = _mm_mul_pd(_mm_mul_pd(gNum, gDen), oneOverE);
+      const __m128d a3 = _mm_mul_pd(_mm_mul_pd(gNum, gNum), oneOverE);
+      const __m128d v0 = _mm_set_pd(pIn1[s], pIn0[s]);
+
+      v3 = _mm_sub_pd(v0, ic2eq);
+      v1 = _mm_add_pd(_mm_mul_pd(a1, ic1eq), _mm_mul_pd(a2, v3));
+      v2 = _mm_add_pd(_mm_add_pd(ic2eq, _mm_mul_pd(a2, ic1eq)), _mm_mul_pd(a3, v3));
+      ic1eq = _mm_sub_pd(_mm_mul_pd(two, v1), ic1eq);
+      ic2eq = _mm_sub_pd(_mm_mul_pd(two, v2), ic2eq);
+
+      double out[2];
+      _mm_storeu_pd(out, _mm_add_pd(_mm_add_pd(_mm_mul_pd(vM0, v0), _mm_mul_pd(vM1, v1)), _mm_mul_pd(vM2, v2)));
+      pOut0[s] = static_cast<T>(out[0]);
+      pOut1[s] = static_cast<T>(out[1]);
+    }
+
+    _mm_storeu_pd(&mIc1eq[c], ic1eq);
+    _mm_storeu_pd(&mIc2eq[c], ic2eq);
+    _mm_storeu_pd(&mV1[c], v1);
+    _mm_storeu_pd(&mV2[c], v2);
+    _mm_storeu_pd(&mV3[c], v3);
+  }
+
+  static inline __m128d Select(__m128d mask, __m128d a, __m128d b)
+  {
+    return _mm_or_pd(_mm_and_pd(mask, a), _mm_andnot_pd(mask, b));
   }
+#endif
 
 private:
   double mV1[NC] = {};
@@ -258,6 +419,8 @@ private:
   double m_m0 = 0.;
   double m_m1 = 0.;
   double m_m2 = 0.;
+  double mK = 1.; // 1 / Q
+  double mGScale = 1.; // g = tan(w) * mGScale, for the shelving modes
 
   struct Settings
   {
@@ -9,7 +9,11 @@
 */
 #pragma once
 
+#include <algorithm>
+#include <cmath>
+
 #include "denormal.h"
+#include "heapbuf.h"
 #include "IPlugConstants.h"
 
 BEGIN_IPLUG_NAMESPACE
@@ -87,6 +91,148 @@ public:
 
 } WDL_FIXALIGN;
 
+/** A bank of one-pole smoothers with the same response as LogParamSmooth, which tracks which channels are still converging.
+ * Converging channels are computed in closed form, target + (value - target) * a^(s+1), from a table of powers of a,
+ * so the per-channel loop has no recurrence and can auto-vectorize. Once a channel is within the settle threshold of its target it snaps to it,
+ * and following blocks are flagged as constant, so they cost a fill, or nothing at all. See ProcessBlock() and IsConstant()
+ * @tparam T the sample type
+ * @tparam NC the number of channels */
+template<typename T, int NC = 1>
+class SmootherBank
+{
+public:
+  /** Constructor. Allocates
+   * @param timeMs The smoothing time
+   * @param initialValue The value all channels start at, settled
+   * @param maxBlockSize The size of the table of powers. Larger blocks are processed in several chunks */
+  SmootherBank(double timeMs = 5., T initialValue = 0., int maxBlockSize = DEFAULT_BLOCK_SIZE)
+  : mTimeMs(timeMs)
+  {
+    SetValue(initialValue);
+    mPowers.Resize(std::max(maxBlockSize, 1));
+    SetSmoothTime(timeMs, DEFAULT_SAMPLE_RATE);
+  }
+
+  /** Set the smoothing time. Rebuilds the table of powers, so shouldn't be called per block */
+  void SetSmoothTime(double timeMs, double sampleRate)
+  {
+    static constexpr double TWO_PI = 6.283185307179586476925286766559;
+
+    mTimeMs = timeMs;
+    const double a = exp(-TWO_PI / (timeMs * 0.001 * sampleRate));
+    double power = a;
+
+    for (auto s = 0; s < mPowers.GetSize(); s++)
+    {
+      // Flush to zero rather than letting the tail go denormal
+      mPowers.Get()[s] = power > 1e-30 ? static_cast<T>(power) : T(0);
+      power *= a;
+    }
+  }
+
+  /** Resize the table of powers. Allocates, must not be called on the audio thread */
+  void SetMaxBlockSize(double sampleRate, int maxBlockSize)
+  {
+    mPowers.Resize(std::max(maxBlockSize, 1));
+    SetSmoothTime(mTimeMs, sampleRate);
+  }
+
+  /** Jump all channels to value */
+  void SetValue(T value)
+  {
+    for (auto c = 0; c < NC; c++)
+    {
+      mValues[c] = mTargets[c] = value;
+      mConstant[c] = mConstantThisBlock[c] = true;
+    }
+  }
+
+  /** Jump each channel to a value */
+  void SetValues(T values[NC])
+  {
+    for (auto c = 0; c < NC; c++)
+    {
+      mValues[c] = mTargets[c] = values[c];
+      mConstant[c] = mConstantThisBlock[c] = true;
+    }
+  }
+
+  /** A channel is settled once it is within this distance of its target. Defaults to 1e-6 */
+  void SetSettleThreshold(T threshold) { mSettleThreshold = threshold; }
+
+  /** Smooth a block towards the target values. Arguments are as for LogParamSmooth::ProcessBlock()
+   * @param fillConstant If true, channels that are constant for this block are filled with their value.
+   * If false they are left untouched, and consumers should check IsConstant() and use GetValue() for those channels */
+  void ProcessBlock(const T inputs[NC], T** outputs, int nFrames, int channelOffset = 0, bool fillConstant = true)
+  {
+    for (auto c = 0; c < NC; c++)
+    {
+      const T target = inputs[channelOffset + c];
+
+      if (target != mTargets[c])
+      {
+        mTargets[c] = target;
+        mConstant[c] = false;
+      }
+    }
+
+    for (auto c = 0; c < NC; c++)
+    {
+      T* pOutput = outputs[channelOffset + c];
+
+      mConstantThisBlock[c] = mConstant[c];
+
+      if (mConstant[c])
+      {
+        if (fillConstant)
+          std::fill(pOutput, pOutput + nFrames, mValues[c]);
+
+        continue;
+      }
+
+      const T target = mTargets[c];
+      const T* pPowers = mPowers.Get();
+      T delta = mValues[c] - target;
+
+      for (auto offset = 0; offset < nFrames; offset += mPowers.GetSize())
+      {
+        const int n = std::min(nFrames - offset, mPowers.GetSize());
+
+        for (auto s = 0; s < n; s++)
+          pOutput[offset + s] = target + (delta * pPowers[s]);
+
+        delta *= pPowers[n - 1];
+      }
+
+      if (std::abs(delta) <= mSettleThreshold)
+      {
+        // Settled, the next block will be constant
+        mValues[c] = target;
+        mConstant[c] = true;
+      }
+      else
+      {
+        mValues[c] = target + delta;
+      }
+    }
+  }
+
+  /** @return true if the output of channel c was the constant GetValue(c) for the whole of the last block */
+  bool IsConstant(int c) const { return mConstantThisBlock[c]; }
+
+  /** @return The current value of channel c */
+  T GetValue(int c) const { return mValues[c]; }
+
+private:
+  double mTimeMs;
+  T mSettleThreshold = static_cast<T>(1e-6);
+  T mValues[NC];
+  T mTargets[NC];
+  bool mConstant[NC];
+  bool mConstantThisBlock[NC];
+  WDL_TypedBuf<T> mPowers;
+} WDL_FIXALIGN;
+
 template<typename T>
 class SmoothedGain
 {
@@ -94,6 +94,18 @@ public:
     mVoiceAllocator.mATMode = mode;
   }
 
+  /** Choose which voice is stolen when a note starts and every voice is busy, see VoiceStealPolicy */
+  void SetVoiceStealMode(VoiceAllocator::EVoiceStealMode mode)
+  {
+    mVoiceAllocator.SetVoiceStealMode(mode);
+  }
+
+  /** Use a custom VoiceStealPolicy, which must outlive the synth, or nullptr for the default */
+  void SetVoiceStealPolicy(VoiceStealPolicy* pPolicy)
+  {
+    mVoiceAllocator.SetVoiceStealPolicy(pPolicy);
+  }
+
   /** Set this function to something other than the default
    * if you need to implement a tuning table for microtonal support
    * @param fn A function taking an integer key value and returning a double-precision
@@ -118,6 +130,23 @@ public:
     mVoiceAllocator.SetControlGlideTime(t);
   }
 
+  /** Render voices in parallel across multiple cores. This spawns threads and replaces the thread pool without synchronization, so only call it
+   * while audio processing is stopped, e.g. from the plug-in constructor, never from the UI thread while ProcessBlock() may be running
+   * Voices must not share mutable state with each other if this is enabled, since they may be processed concurrently
+   * @param nThreads The total number of render threads including the audio thread, 1 or less to render on the audio thread only
+   * @param maxOutputs The maximum number of output channels that will be passed to ProcessBlock() */
+  void SetNumRenderThreads(int nThreads, int maxOutputs = 2)
+  {
+    mVoiceAllocator.SetNumRenderThreads(nThreads, maxOutputs);
+  }
+
+  /** Render voices with a VoiceBank rather than one SynthVoice at a time. Add the bank's proxy voices with AddVoice()
+   * @param pBank The bank, which must outlive the synth, or nullptr for none */
+  void SetVoiceBank(VoiceBank* pBank)
+  {
+    mVoiceAllocator.SetVoiceBank(pBank);
+  }
+
   SynthVoice* GetVoice(int voiceIdx)
   {
     return mVoiceAllocator.GetVoice(voiceIdx);
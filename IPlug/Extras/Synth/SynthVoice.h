@@ -101,6 +101,18 @@ public:
    */
   virtual void SetControl(int controlNumber, float value) {};
 
+  /** Implement this to report how loud the voice is at the moment, for example the last output of its amplitude envelope.
+   * Voice stealing policies such as QuietestVoiceStealPolicy call it for every voice once per block, so it must be cheap.
+   * The default reports the gain set by the VoiceAllocator while the voice is busy
+   * @return A non-negative loudness estimate, on any scale that is consistent across voices */
+  virtual float GetLoudness() const { return GetBusy() ? static_cast<float>(mGain) : 0.f; }
+
+  /** @return The sample time at which the VoiceAllocator last triggered this voice, or -1 if it has never been triggered */
+  int64_t GetLastTriggeredTime() const { return mLastTriggeredTime; }
+
+  /** @return \c true if the voice has been released since it was last triggered */
+  bool GetReleased() const { return mReleased; }
+
 protected:
   VoiceInputs mInputs;
   int64_t mLastTriggeredTime{-1};
@@ -110,6 +122,7 @@ protected:
   uint8_t mKey{0};
   double mBasePitch{0.};
   double mGain{0.}; // used by voice allocator to hard-kill voices.
+  bool mReleased{false}; // set by the voice allocator when the voice's note ends
 
   friend class MidiSynth;
   friend class VoiceAllocator;
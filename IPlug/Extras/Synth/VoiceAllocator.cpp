@@ -12,6 +12,7 @@
 
 #include <algorithm>
 #include <numeric>
+#include <functional>
 #include <iostream>
 
 using namespace iplug;
@@ -23,7 +24,26 @@ std::ostream& operator<< (std::ostream& out, const VoiceInputEvent& r)
   return out;
 }
 
+// The built-in policies are stateless, so every allocator can share them
+static VoiceStealPolicy* GetBuiltInStealPolicy(VoiceAllocator::EVoiceStealMode mode)
+{
+  static OldestVoiceStealPolicy sOldest;
+  static QuietestVoiceStealPolicy sQuietest;
+  static ReleasedFirstVoiceStealPolicy sReleasedFirst;
+  static SameKeyFirstVoiceStealPolicy sSameKeyFirst;
+
+  switch(mode)
+  {
+    case VoiceAllocator::kStealQuietest: return &sQuietest;
+    case VoiceAllocator::kStealReleasedFirst: return &sReleasedFirst;
+    case VoiceAllocator::kStealSameKeyFirst: return &sSameKeyFirst;
+    case VoiceAllocator::kStealOldest:
+    default: return &sOldest;
+  }
+}
+
 VoiceAllocator::VoiceAllocator()
+: mStealPolicy(GetBuiltInStealPolicy(kStealOldest))
 {
   // setup default key->pitch fn
   mKeyToPitchFn = [](int k){return (k - 69.f)/12.f;};
@@ -53,149 +73,171 @@ void VoiceAllocator::ClearVoiceInputs(SynthVoice* pVoice)
 
 void VoiceAllocator::AddVoice(SynthVoice* pVoice, uint8_t zone)
 {
-  if(mVoicePtrs.size() + 1 < UCHAR_MAX)
-  {
-    mVoicePtrs.push_back(pVoice);
-    ClearVoiceInputs(pVoice);
-    pVoice->mKey = -1;
-    pVoice->mZone = zone;
-
-    // make a glides structures for the control ramps of the new voice
-    mVoiceGlides.emplace_back(ControlRampProcessor::Create(pVoice->mInputs));
-  }
-  else
-  {
-    throw std::runtime_error{"VoiceAllocator: max voices exceeded!"};
-  }
+  const int voiceIdx = static_cast<int>(mVoicePtrs.size());
+
+  mVoicePtrs.push_back(pVoice);
+  ClearVoiceInputs(pVoice);
+  pVoice->mKey = -1;
+  pVoice->mZone = zone;
+
+  // make a glides structures for the control ramps of the new voice
+  mVoiceGlides.emplace_back(ControlRampProcessor::Create(pVoice->mInputs));
+
+  mZoneIndex.Add(voiceIdx, pVoice->mZone);
+  mChannelIndex.Add(voiceIdx, pVoice->mChannel);
+  mKeyIndex.Add(voiceIdx, pVoice->mKey);
+  mTriggeredKeyIndex.Add(voiceIdx, pVoice->mKey);
+
+  // resize the masks and reserve the steal heap up front, so that nothing allocates while processing events
+  const int nVoices = voiceIdx + 1;
+  mMatchedVoices.Resize(nVoices);
+  mIdleVoices.Resize(nVoices);
+  mPendingStealVoices.Resize(nVoices);
+  mStealHeap.reserve(2 * nVoices + 65);
+  mStealPriorities.push_back(0.);
+  mStealGenerations.push_back(0);
+  UpdateIdleVoices();
+  RebuildStealHeap();
+
+  ResizeThreadPool();
 }
 
-VoiceAllocator::VoiceBitsArray VoiceAllocator::VoicesMatchingAddress(VoiceAddress addr)
+const VoiceAllocator::VoiceBitsArray& VoiceAllocator::VoicesMatchingAddress(VoiceAddress addr)
 {
-  const int n = static_cast<int>(mVoicePtrs.size());
-  VoiceBitsArray v;
+  VoiceBitsArray& v = mMatchedVoices;
+  v.ClearAll();
 
-  // set all bits to true
-  for(int i=0; i<n; ++i)
-  {
-    v[i] = true;
-  }
+  // setting the flag kVoicesAll returns all voices matching the zone of the address.
+  const bool zoneOnly = addr.mFlags & kVoicesAll;
 
-  // for each criterion present in address, clear any voice bits not matching
+  // for each criterion present in address, reject any voice not matching
+  auto matches = [&](int i) {
+    SynthVoice* pVoice = mVoicePtrs[i];
 
-  // zone
-  if(addr.mZone != kAllZones)
-  {
-    for(int i=0; i<n; ++i)
-    {
-      v[i] = v[i] & (mVoicePtrs[i]->mZone == addr.mZone);
-    }
-  }
+    if(addr.mZone != kAllZones && pVoice->mZone != addr.mZone)
+      return false;
 
-  // setting the flag kVoicesAll returns all voices matching the zone of the address.
-  if(addr.mFlags & kVoicesAll) return v;
+    if(zoneOnly)
+      return true;
+
+    if(addr.mChannel != kAllChannels && pVoice->mChannel != addr.mChannel)
+      return false;
+
+    if(addr.mKey != kAllKeys && pVoice->mKey != addr.mKey)
+      return false;
 
-  // channel
-  if(addr.mChannel != kAllChannels)
+    if((addr.mFlags & kVoicesBusy) && !pVoice->GetBusy())
+      return false;
+
+    return true;
+  };
+
+  // only visit the voices in the narrowest index that applies to the address
+  const VoiceIndex* pIndex = nullptr;
+  uint8_t group = 0;
+
+  if(!zoneOnly && addr.mKey != kAllKeys)
   {
-    for(int i=0; i<n; ++i)
-    {
-      v[i] = v[i] & (mVoicePtrs[i]->mChannel == addr.mChannel);
-    }
+    pIndex = &mKeyIndex;
+    group = addr.mKey;
+  }
+  else if(!zoneOnly && addr.mChannel != kAllChannels)
+  {
+    pIndex = &mChannelIndex;
+    group = addr.mChannel;
+  }
+  else if(addr.mZone != kAllZones)
+  {
+    pIndex = &mZoneIndex;
+    group = addr.mZone;
   }
 
-  // Key
-  if(addr.mKey != kAllKeys)
+  if(pIndex)
   {
-    for(int i=0; i<n; ++i)
+    for(int i = pIndex->First(group); i >= 0; i = pIndex->Next(i))
     {
-      v[i] = v[i] & (mVoicePtrs[i]->mKey == addr.mKey);
+      if(matches(i))
+        v.Set(i);
     }
   }
-
-  // busy flag
-  if(addr.mFlags & kVoicesBusy)
+  else
   {
+    const int n = static_cast<int>(mVoicePtrs.size());
     for(int i=0; i<n; ++i)
     {
-      v[i] = v[i] & mVoicePtrs[i]->GetBusy();
+      if(matches(i))
+        v.Set(i);
     }
   }
 
+  if(zoneOnly) return v;
+
   // most recent
   if(addr.mFlags & kVoicesMostRecent)
   {
     int64_t maxT = -1;
     int maxIdx = -1;
-    for(int i=0; i<n; ++i)
-    {
-      if(v[i])
+    v.ForEach([&](int i) {
+      int64_t vt = mVoicePtrs[i]->mLastTriggeredTime;
+      if(vt > maxT)
       {
-        int64_t vt = mVoicePtrs[i]->mLastTriggeredTime;
-        if(vt > maxT)
-        {
-          maxT = vt;
-          maxIdx = i;
-        }
+        maxT = vt;
+        maxIdx = i;
       }
-    }
+    });
 
-    // set all bits to false
-    //v.reset();
-    for(int i=0; i<n; ++i)
-    {
-      v[i] = 0;
-    }
+    v.ClearAll();
 
     if(maxIdx >= 0)
     {
-      v[maxIdx] = true;
+      v.Set(maxIdx);
     }
   }
   return v;
 }
 
-void VoiceAllocator::SendControlToVoiceInputs(VoiceBitsArray v, int ctlIdx, float val, int glideSamples)
+void VoiceAllocator::SendControlToVoiceInputs(const VoiceBitsArray& v, int ctlIdx, float val, int glideSamples)
 {
   // send control change to all matched voices through glide generators
-  for(int i=0; i<mVoicePtrs.size(); ++i)
-  {
-    if(v[i])
-    {
-      mVoiceGlides[i]->at(ctlIdx).SetTarget(val, 0, glideSamples, mBlockSize);
-    }
-  }
+  v.ForEach([&](int i) {
+    mVoiceGlides[i]->at(ctlIdx).SetTarget(val, 0, glideSamples, mBlockSize);
+  });
 }
 
-void VoiceAllocator::SendControlToVoicesDirect(VoiceBitsArray v, int ctlIdx, float val)
+void VoiceAllocator::SendControlToVoicesDirect(const VoiceBitsArray& v, int ctlIdx, float val)
 {
   // send generic control change directly to voice
-  for(int i=0; i<mVoicePtrs.size(); ++i)
-  {
-    if(v[i])
-    {
-      mVoicePtrs[i]->SetControl(ctlIdx, val);
-    }
-  }
+  v.ForEach([&](int i) {
+    mVoicePtrs[i]->SetControl(ctlIdx, val);
+  });
 }
 
-void VoiceAllocator::SendProgramChangeToVoices(VoiceBitsArray v, int pgm)
+void VoiceAllocator::SendProgramChangeToVoices(const VoiceBitsArray& v, int pgm)
 {
-  for(int i=0; i<mVoicePtrs.size(); ++i)
-  {
-    if(v[i])
-    {
-      mVoicePtrs[i]->SetProgramNumber(pgm);
-    }
-  }
+  v.ForEach([&](int i) {
+    mVoicePtrs[i]->SetProgramNumber(pgm);
+  });
 }
 
 void VoiceAllocator::ProcessEvents(int blockSize, int64_t sampleTime)
 {
+  if(mPendingStealPolicy.load(std::memory_order_relaxed))
+  {
+    mStealPolicy = mPendingStealPolicy.exchange(nullptr, std::memory_order_acquire);
+    mRebuildStealHeap = true;
+  }
+
+  // voices may have finished, and steal priorities changed, since the last block
+  if(mInputQueue.ElementsAvailable())
+  {
+    UpdateIdleVoices();
+    UpdateStealHeap();
+  }
+
   while(mInputQueue.ElementsAvailable())
   {
     VoiceInputEvent event;
     mInputQueue.Pop(event);
-    VoiceAllocator::VoiceBitsArray voices = VoicesMatchingAddress(event.mAddress);
 
     switch(event.mAction)
     {
@@ -218,17 +260,17 @@ void VoiceAllocator::ProcessEvents(int blockSize, int64_t sampleTime)
       }
       case kPitchBendAction:
       {
-        SendControlToVoiceInputs(voices, kVoiceControlPitchBend, event.mValue, mControlGlideSamples);
+        SendControlToVoiceInputs(VoicesMatchingAddress(event.mAddress), kVoiceControlPitchBend, event.mValue, mControlGlideSamples);
         break;
       }
       case kPressureAction:
       {
-        SendControlToVoiceInputs(voices, kVoiceControlPressure, event.mValue, mControlGlideSamples);
+        SendControlToVoiceInputs(VoicesMatchingAddress(event.mAddress), kVoiceControlPressure, event.mValue, mControlGlideSamples);
         break;
       }
       case kTimbreAction:
       {
-        SendControlToVoiceInputs(voices, kVoiceControlTimbre, event.mValue, mControlGlideSamples);
+        SendControlToVoiceInputs(VoicesMatchingAddress(event.mAddress), kVoiceControlTimbre, event.mValue, mControlGlideSamples);
         break;
       }
       case kSustainAction:
@@ -258,12 +300,12 @@ void VoiceAllocator::ProcessEvents(int blockSize, int64_t sampleTime)
       case kControllerAction:
       {
         // called for any continuous controller other than the special #74 specified in MPE
-        SendControlToVoicesDirect(voices, event.mControllerNumber, event.mValue);
+        SendControlToVoicesDirect(VoicesMatchingAddress(event.mAddress), event.mControllerNumber, event.mValue);
         break;
       }
       case kProgramChangeAction:
       {
-        SendProgramChangeToVoices(voices, event.mControllerNumber);
+        SendProgramChangeToVoices(VoicesMatchingAddress(event.mAddress), event.mControllerNumber);
         break;
       }
       case kNullAction:
@@ -290,90 +332,184 @@ void VoiceAllocator::CalcGlideTimesInSamples()
   mControlGlideSamples = static_cast<int>(mControlGlideTime * mSampleRate);
 }
 
-int VoiceAllocator::FindFreeVoiceIndex(int startIndex) const
+void VoiceAllocator::UpdateIdleVoices()
 {
-  size_t voices = mVoicePtrs.size();
-  for(int i=0; i<voices; ++i)
+  const int n = static_cast<int>(mVoicePtrs.size());
+  for(int i=0; i<n; ++i)
+  {
+    if(mVoicePtrs[i]->GetBusy())
+      mIdleVoices.Clear(i);
+    else
+      mIdleVoices.Set(i);
+  }
+}
+
+void VoiceAllocator::SetVoiceStealMode(EVoiceStealMode mode)
+{
+  SetVoiceStealPolicy(GetBuiltInStealPolicy(mode));
+}
+
+void VoiceAllocator::SetVoiceStealPolicy(VoiceStealPolicy* pPolicy)
+{
+  // handed to ProcessEvents(), which is the only place the policy is used, so this is safe from any thread
+  mPendingStealPolicy.store(pPolicy ? pPolicy : GetBuiltInStealPolicy(kStealOldest), std::memory_order_release);
+}
+
+void VoiceAllocator::UpdateStealHeap()
+{
+  if(mRebuildStealHeap || mStealPolicy->IsDynamic())
+  {
+    mPendingStealVoices.ClearAll();
+    RebuildStealHeap();
+    return;
+  }
+
+  // the voices started in the last block can now be stolen
+  mPendingStealVoices.ForEach([&](int i) {
+    mPendingStealVoices.Clear(i);
+    PushStealEntry(i);
+  });
+}
+
+void VoiceAllocator::RebuildStealHeap()
+{
+  mStealHeap.clear();
+  const int n = static_cast<int>(mVoicePtrs.size());
+  for(int i=0; i<n; ++i)
   {
-    int j = (startIndex + i)%voices;
-    SynthVoice* pv = mVoicePtrs[j];
-    if(!pv->GetBusy())
+    if(!mPendingStealVoices.Test(i))
     {
-      return j;
+      mStealPriorities[i] = mStealPolicy->GetPriority(*mVoicePtrs[i]);
+      mStealHeap.push_back({mStealPriorities[i], mVoicePtrs[i]->GetLastTriggeredTime(), i, ++mStealGenerations[i]});
     }
   }
-  return -1;
+  std::make_heap(mStealHeap.begin(), mStealHeap.end(), std::greater<StealEntry>());
+  mRebuildStealHeap = false;
 }
 
-int VoiceAllocator::FindVoiceIndexToSteal(int64_t sampleTime) const
+void VoiceAllocator::PushStealEntry(int voiceIdx)
 {
-  size_t voices = mVoicePtrs.size();
-  int64_t earliestTime = sampleTime;
-  int longestPlayingVoiceIdx = 0;
-  for(int i=0; i<voices; ++i)
+  // stale entries are discarded lazily, rebuild before the reserved capacity runs out
+  if(mStealHeap.size() >= 2 * mVoicePtrs.size() + 64)
   {
-    SynthVoice* pv = mVoicePtrs[i];
-    if(pv->mLastTriggeredTime < earliestTime)
+    RebuildStealHeap();
+    return;
+  }
+
+  mStealPriorities[voiceIdx] = mStealPolicy->GetPriority(*mVoicePtrs[voiceIdx]);
+  mStealHeap.push_back({mStealPriorities[voiceIdx], mVoicePtrs[voiceIdx]->GetLastTriggeredTime(), voiceIdx, ++mStealGenerations[voiceIdx]});
+  std::push_heap(mStealHeap.begin(), mStealHeap.end(), std::greater<StealEntry>());
+}
+
+int VoiceAllocator::FindFreeVoiceIndex(int startIndex) const
+{
+  return mIdleVoices.FindNext(startIndex);
+}
+
+int VoiceAllocator::FindVoiceIndexToSteal(int key, int64_t sampleTime)
+{
+  if(mStealPolicy->GetStealSameKeyFirst())
+  {
+    int bestIdx = -1;
+    for(int i = mTriggeredKeyIndex.First(key); i >= 0; i = mTriggeredKeyIndex.Next(i))
     {
-      earliestTime = pv->mLastTriggeredTime;
-      longestPlayingVoiceIdx = i;
+      if(mPendingStealVoices.Test(i))
+        continue;
+
+      if(bestIdx < 0 || mStealPriorities[i] < mStealPriorities[bestIdx] || (mStealPriorities[i] == mStealPriorities[bestIdx] && i < bestIdx))
+        bestIdx = i;
     }
+
+    if(bestIdx >= 0)
+      return bestIdx;
+  }
+
+  // pop entries that have been replaced since they were pushed
+  while(!mStealHeap.empty())
+  {
+    const StealEntry& top = mStealHeap.front();
+    if(mStealGenerations[top.voiceIdx] == top.generation)
+      break;
+
+    std::pop_heap(mStealHeap.begin(), mStealHeap.end(), std::greater<StealEntry>());
+    mStealHeap.pop_back();
   }
-  return longestPlayingVoiceIdx;
+
+  if(!mStealHeap.empty() && mVoicePtrs[mStealHeap.front().voiceIdx]->mLastTriggeredTime < sampleTime)
+  {
+    return mStealHeap.front().voiceIdx;
+  }
+  return 0;
 }
 
-// start a single voice and set its current channel and key.
+// start a single voice and set its current channel and key. if retrig is true and the voice is still sounding, it is told to
+// retrigger, so that it can fade out from its current level rather than jump to the start of the new note.
 void VoiceAllocator::StartVoice(int voiceIdx, int channel, int key, float pitch, float velocity, int sampleOffset, int64_t sampleTime, bool retrig)
 {
-  if(!retrig)
-  {
-    // add immediate sample-accurate change for trigger
-    mVoiceGlides[voiceIdx]->at(kVoiceControlGate).SetTarget(velocity, sampleOffset, 1, mBlockSize);
-  }
+  SynthVoice* pVoice = mVoicePtrs[voiceIdx];
+  retrig = retrig && pVoice->GetBusy();
+
+  // add immediate sample-accurate change for trigger. a retriggered voice needs the new velocity too, and its gate may have been closed by a release
+  mVoiceGlides[voiceIdx]->at(kVoiceControlGate).SetTarget(velocity, sampleOffset, 1, mBlockSize);
 
   // add glide for pitch
   mVoiceGlides[voiceIdx]->at(kVoiceControlPitch).SetTarget(pitch, sampleOffset, mNoteGlideSamples, mBlockSize);
 
   // set things directly in voice
-  SynthVoice* pVoice = mVoicePtrs[voiceIdx];
   pVoice->mLastTriggeredTime = sampleTime;
   pVoice->mChannel = channel;
   pVoice->mKey = key;
   pVoice->mGain = 1.;
+  pVoice->mReleased = false;
+
+  mChannelIndex.Move(voiceIdx, pVoice->mChannel);
+  mKeyIndex.Move(voiceIdx, pVoice->mKey);
+  mTriggeredKeyIndex.Move(voiceIdx, pVoice->mKey);
+
+  // retire the voice's heap entry, it can be stolen again from the next block
+  ++mStealGenerations[voiceIdx];
+  mPendingStealVoices.Set(voiceIdx);
 
   // call voice's Trigger method
   pVoice->Trigger(velocity, retrig);
+
+  if(pVoice->GetBusy())
+    mIdleVoices.Clear(voiceIdx);
+  else
+    mIdleVoices.Set(voiceIdx);
 }
 
 // start all of the voice indexes marked in the VoieBitsArray and set the current channel and key of each.
-void VoiceAllocator::StartVoices(VoiceBitsArray vbits, int channel, int key, float pitch, float velocity, int sampleOffset, int64_t sampleTime, bool retrig)
+void VoiceAllocator::StartVoices(const VoiceBitsArray& vbits, int channel, int key, float pitch, float velocity, int sampleOffset, int64_t sampleTime, bool retrig)
 {
-  for(int i=0; i<mVoicePtrs.size(); ++i)
-  {
-    if(vbits[i])
-    {
-      StartVoice(i, channel, key, pitch, velocity, sampleOffset, sampleTime, retrig);
-    }
-  }
+  vbits.ForEach([&](int i) {
+    StartVoice(i, channel, key, pitch, velocity, sampleOffset, sampleTime, retrig);
+  });
 }
 
 void VoiceAllocator::StopVoice(int voiceIdx, int sampleOffset)
 {
   mVoiceGlides[voiceIdx]->at(kVoiceControlGate).SetTarget(0.0, sampleOffset, 1, mBlockSize);
-  mVoicePtrs[voiceIdx]->mKey = -1;
-  mVoicePtrs[voiceIdx]->Release();
+  SynthVoice* pVoice = mVoicePtrs[voiceIdx];
+  pVoice->mKey = -1;
+  pVoice->mReleased = true;
+  mKeyIndex.Move(voiceIdx, pVoice->mKey);
+  pVoice->Release();
+
+  if(!pVoice->GetBusy())
+    mIdleVoices.Set(voiceIdx);
+
+  // re-rank the voice if the policy cares about the release
+  if(!mPendingStealVoices.Test(voiceIdx) && mStealPolicy->GetPriority(*pVoice) != mStealPriorities[voiceIdx])
+    PushStealEntry(voiceIdx);
 }
 
 // stop all voices marked in the VoiceBitsArray.
-void VoiceAllocator::StopVoices(VoiceBitsArray vbits, int sampleOffset)
+void VoiceAllocator::StopVoices(const VoiceBitsArray& vbits, int sampleOffset)
 {
-  for(int i=0; i<mVoicePtrs.size(); ++i)
-  {
-    if(vbits[i])
-    {
-      StopVoice(i, sampleOffset);
-    }
-  }
+  vbits.ForEach([&](int i) {
+    StopVoice(i, sampleOffset);
+  });
 }
 
 void VoiceAllocator::SoftKillAllVoices()
@@ -410,8 +546,9 @@ void VoiceAllocator::NoteOn(VoiceInputEvent e, int64_t sampleTime)
   {
     case kPolyModeMono:
     {
-      // TODO retrig / legato
-      bool retrig = false;
+      // TODO legato
+      // the voices in the zone are still sounding if a key is held, so retrigger them
+      bool retrig = true;
 
       // trigger all voices in zone
       StartVoices(VoicesMatchingAddress({e.mAddress.mZone, kAllChannels, kAllKeys, 0}), channel, key, pitch, velocity, offset, sampleTime, retrig);
@@ -425,7 +562,7 @@ void VoiceAllocator::NoteOn(VoiceInputEvent e, int64_t sampleTime)
       int i = FindFreeVoiceIndex(mVoiceRotateIndex);
       if(i < 0)
       {
-        i = FindVoiceIndexToSteal(sampleTime);
+        i = FindVoiceIndexToSteal(key, sampleTime);
       }
       if(mRotateVoices)
       {
@@ -433,7 +570,8 @@ void VoiceAllocator::NoteOn(VoiceInputEvent e, int64_t sampleTime)
       }
       if(i >= 0)
       {
-        bool retrig = false;
+        // a stolen voice is still sounding, so retrigger it. StartVoice() ignores this for a free voice
+        bool retrig = true;
         StartVoice(i, channel, key, pitch, velocity, offset, sampleTime, retrig);
       }
       break;
@@ -512,7 +650,7 @@ void VoiceAllocator::NoteOff(VoiceInputEvent e, int64_t sampleTime)
       // trigger the queued key for all voices in the zone at the minimum held velocity.
       // alternatively the release velocity of the note off could be used here.
       float pitch = mKeyToPitchFn(queuedKey + static_cast<int>(mPitchOffset));
-      bool retrig = false;
+      bool retrig = true;
 
       StartVoices(VoicesMatchingAddress({e.mAddress.mZone, kAllChannels, kAllKeys, 0}), channel, queuedKey, pitch, mMinHeldVelocity, offset, sampleTime, retrig);
     }
@@ -527,14 +665,53 @@ void VoiceAllocator::NoteOff(VoiceInputEvent e, int64_t sampleTime)
   }
 }
 
+void VoiceAllocator::SetNumRenderThreads(int nThreads, int maxOutputs)
+{
+  assert(!mProcessingVoices && "SetNumRenderThreads() must not be called while processing");
+  mMaxThreadPoolOutputs = maxOutputs;
+
+  if(nThreads > 1)
+  {
+    mThreadPool = std::unique_ptr<VoiceThreadPool>(new VoiceThreadPool(nThreads));
+    ResizeThreadPool();
+  }
+  else
+  {
+    mThreadPool = nullptr;
+  }
+}
+
+void VoiceAllocator::ResizeThreadPool()
+{
+  if(mThreadPool)
+  {
+    mThreadPool->Resize(static_cast<int>(mVoicePtrs.size()), mMaxThreadPoolOutputs, mMaxFrames);
+  }
+}
+
 void VoiceAllocator::ProcessVoices(sample** inputs, sample** outputs, int nInputs, int nOutputs, int startIndex, int blockSize)
 {
-  for(auto pVoice : mVoicePtrs)
+  mProcessingVoices.store(true, std::memory_order_relaxed);
+
+  if(mThreadPool)
   {
-    // TODO distribute voices across cores
-    if(pVoice->GetBusy())
+    mThreadPool->ProcessVoices(mVoicePtrs.data(), static_cast<int>(mVoicePtrs.size()), inputs, outputs, nInputs, nOutputs, startIndex, blockSize);
+  }
+  else
+  {
+    for(auto pVoice : mVoicePtrs)
     {
-      pVoice->ProcessSamplesAccumulating(inputs, outputs, nInputs, nOutputs, startIndex, blockSize);
+      if(pVoice->GetBusy())
+      {
+        pVoice->ProcessSamplesAccumulating(inputs, outputs, nInputs, nOutputs, startIndex, blockSize);
+      }
     }
   }
+
+  if(mVoiceBank)
+  {
+    mVoiceBank->ProcessVoiceBank(inputs, outputs, nInputs, nOutputs, startIndex, blockSize);
+  }
+
+  mProcessingVoices.store(false, std::memory_order_relaxed);
 }
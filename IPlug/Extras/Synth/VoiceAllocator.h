@@ -15,17 +15,28 @@
  * @copydoc VoiceAllocator
  */
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <cassert>
 #include <vector>
 #include <stdint.h>
+#include <climits>
 #include <functional>
-#include <bitset>
+#include <memory>
 //#include <iostream>
 
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
 #include "IPlugLogger.h"
 #include "IPlugQueue.h"
 
 #include "SynthVoice.h"
+#include "VoiceStealPolicy.h"
+#include "VoiceThreadPool.h"
+#include "VoiceBank.h"
 
 BEGIN_IPLUG_NAMESPACE
 
@@ -76,6 +87,84 @@ struct VoiceInputEvent
   int mSampleOffset;
 };
 
+#pragma mark - VoiceMask class
+
+/** A set of voice indices with one bit per voice, for any number of voices. Set bits are visited a 64 bit word at a time */
+class VoiceMask
+{
+public:
+  /** Set the number of voices and clear all bits. This allocates */
+  void Resize(int nVoices)
+  {
+    mNVoices = nVoices;
+    mWords.assign((nVoices + 63) / 64, 0);
+  }
+
+  int GetSize() const { return mNVoices; }
+
+  void ClearAll() { std::fill(mWords.begin(), mWords.end(), 0); }
+
+  void Set(int i) { mWords[i >> 6] |= (uint64_t(1) << (i & 63)); }
+
+  void Clear(int i) { mWords[i >> 6] &= ~(uint64_t(1) << (i & 63)); }
+
+  bool Test(int i) const { return (mWords[i >> 6] >> (i & 63)) & 1; }
+
+  bool operator[](int i) const { return Test(i); }
+
+  /** Call func(voiceIdx) for each set bit, in ascending order */
+  template <class F>
+  void ForEach(F&& func) const
+  {
+    for (size_t w = 0; w < mWords.size(); w++)
+    {
+      for (uint64_t bits = mWords[w]; bits; bits &= bits - 1)
+        func(static_cast<int>(w * 64) + CountTrailingZeros(bits));
+    }
+  }
+
+  /** @return The first set bit at or after start, wrapping around at the end, or -1 if no bits are set */
+  int FindNext(int start) const
+  {
+    if (!mNVoices)
+      return -1;
+
+    start %= mNVoices;
+    const int nWords = static_cast<int>(mWords.size());
+    const int startWord = start >> 6;
+
+    // the start word, from the start bit on
+    uint64_t bits = mWords[startWord] & (~uint64_t(0) << (start & 63));
+
+    for (int i = 0; i <= nWords; i++)
+    {
+      if (bits)
+        return (((startWord + i) % nWords) * 64) + CountTrailingZeros(bits);
+
+      // the last iteration revisits the bits of the start word that are before the start bit
+      const int w = (startWord + i + 1) % nWords;
+      bits = (i == nWords - 1) ? (mWords[w] & ~(~uint64_t(0) << (start & 63))) : mWords[w];
+    }
+
+    return -1;
+  }
+
+private:
+  static inline int CountTrailingZeros(uint64_t x)
+  {
+#if defined(_MSC_VER)
+    unsigned long idx;
+    _BitScanForward64(&idx, x);
+    return static_cast<int>(idx);
+#else
+    return __builtin_ctzll(x);
+#endif
+  }
+
+  std::vector<uint64_t> mWords;
+  int mNVoices = 0;
+};
+
 #pragma mark - VoiceAllocator class
 
 class VoiceAllocator final
@@ -96,6 +185,16 @@ public:
     kNumPolyModes
   };
 
+  /** The built-in voice stealing policies, see VoiceStealPolicy */
+  enum EVoiceStealMode
+  {
+    kStealOldest = 0,
+    kStealQuietest,
+    kStealReleasedFirst,
+    kStealSameKeyFirst,
+    kNumVoiceStealModes
+  };
+
   static constexpr int kVoiceMostRecent = 1 << 7;
 
   // one voice worth of ramp generators
@@ -109,11 +208,11 @@ public:
 
   void Clear();
 
-  void SetSampleRateAndBlockSize(double sampleRate, int blockSize) { mSampleRate = sampleRate; CalcGlideTimesInSamples(); }
+  void SetSampleRateAndBlockSize(double sampleRate, int blockSize) { mSampleRate = sampleRate; mMaxFrames = blockSize; CalcGlideTimesInSamples(); ResizeThreadPool(); }
   void SetNoteGlideTime(double t) { mNoteGlideTime = t; CalcGlideTimesInSamples(); }
   void SetControlGlideTime(double t) { mControlGlideTime = t; CalcGlideTimesInSamples(); }
 
-  /** Add a synth voice to the allocator. We do not take ownership ot the voice.
+  /** Add a synth voice to the allocator. We do not take ownership ot the voice. There is no limit on the number of voices. This allocates.
    @param pv Pointer to the voice to add.
    @param zone A zone can be specified to make multitimbral synths.*/
   void AddVoice(SynthVoice* pv, uint8_t zone);
@@ -137,29 +236,141 @@ public:
 
   void ProcessVoices(sample** inputs, sample** outputs, int nInputs, int nOutputs, int startIndex, int blockSize);
 
+  /** Render busy voices in parallel on a pool of pre-spawned threads. This allocates, spawns threads and replaces the pool that ProcessVoices() uses
+   * without synchronization, so it must only be called while audio processing is stopped, e.g. from the plug-in constructor, never concurrently with ProcessVoices().
+   * @param nThreads The total number of render threads including the audio thread. 1 or less renders all voices on the audio thread
+   * @param maxOutputs The maximum number of output channels that will be passed to ProcessVoices() */
+  void SetNumRenderThreads(int nThreads, int maxOutputs = 2);
+
+  /** @return The total number of render threads including the audio thread */
+  int GetNumRenderThreads() const { return mThreadPool ? mThreadPool->NThreads() : 1; }
+
+  /** Render the voices with a VoiceBank. The voices added with AddVoice() should be the bank's proxy voices.
+   * After the busy voices have been visited, ProcessVoices() calls VoiceBank::ProcessVoiceBank() once per block
+   * @param pBank The bank, which is not owned by the allocator, or nullptr for none */
+  void SetVoiceBank(VoiceBank* pBank) { mVoiceBank = pBank; }
+
+  /** Choose one of the built-in policies for which voice to steal when every voice is busy. The default is kStealOldest.
+   * Like SetVoiceStealPolicy(), this may be called from any thread, e.g. from OnParamChange(), and takes effect at the next ProcessEvents()
+   * @param mode The policy */
+  void SetVoiceStealMode(EVoiceStealMode mode);
+
+  /** Use a custom policy for which voice to steal when every voice is busy. The change is queued and takes effect at the start of the
+   * next ProcessEvents(), so this may be called from any thread while audio is running. Calls from more than one thread at once are not ordered
+   * @param pPolicy The policy, which is not owned by the allocator and must outlive it, or nullptr for kStealOldest */
+  void SetVoiceStealPolicy(VoiceStealPolicy* pPolicy);
+
   size_t GetNVoices() const {return mVoicePtrs.size();}
   SynthVoice* GetVoice(int voiceIndex) const {return mVoicePtrs[voiceIndex];}
   void SetPitchOffset(float offset) { mPitchOffset = offset; }
 
 private:
-  using VoiceBitsArray = std::bitset<UCHAR_MAX>;
+  using VoiceBitsArray = VoiceMask;
+
+  /** Voice indices grouped by a uint8_t voice property (zone, channel or key), as intrusive doubly linked lists,
+   * so that a voice moves between groups in O(1) and the voices in a group are visited without scanning the others */
+  class VoiceIndex
+  {
+  public:
+    void Add(int voiceIdx, uint8_t group)
+    {
+      mNext.push_back(-1);
+      mPrev.push_back(-1);
+      mGroup.push_back(group);
+      Link(voiceIdx, group);
+    }
+
+    void Move(int voiceIdx, uint8_t group)
+    {
+      if (mGroup[voiceIdx] == group)
+        return;
+
+      Unlink(voiceIdx);
+      mGroup[voiceIdx] = group;
+      Link(voiceIdx, group);
+    }
+
+    int First(uint8_t group) const { return mHeads[group]; }
+    int Next(int voiceIdx) const { return mNext[voiceIdx]; }
+
+  private:
+    void Link(int voiceIdx, uint8_t group)
+    {
+      mPrev[voiceIdx] = -1;
+      mNext[voiceIdx] = mHeads[group];
+
+      if (mHeads[group] >= 0)
+        mPrev[mHeads[group]] = voiceIdx;
+
+      mHeads[group] = voiceIdx;
+    }
+
+    void Unlink(int voiceIdx)
+    {
+      const int prev = mPrev[voiceIdx];
+      const int next = mNext[voiceIdx];
+
+      if (prev >= 0)
+        mNext[prev] = next;
+      else
+        mHeads[mGroup[voiceIdx]] = next;
+
+      if (next >= 0)
+        mPrev[next] = prev;
+    }
+
+    std::array<int, UCHAR_MAX + 1> mHeads = MakeEmptyHeads();
+    std::vector<int> mNext, mPrev;
+    std::vector<uint8_t> mGroup;
+
+    static std::array<int, UCHAR_MAX + 1> MakeEmptyHeads()
+    {
+      std::array<int, UCHAR_MAX + 1> heads;
+      heads.fill(-1);
+      return heads;
+    }
+  };
+
+  /** An entry in the steal heap, which is stale once the generation of its voice has moved on */
+  struct StealEntry
+  {
+    double priority;
+    int64_t triggeredTime;
+    int voiceIdx;
+    uint32_t generation;
+
+    // the heap is a min-heap, equal priorities are ordered by trigger time, so e.g. equally loud voices steal the oldest, then by voice index
+    bool operator>(const StealEntry& other) const
+    {
+      if (priority != other.priority)
+        return priority > other.priority;
+
+      return triggeredTime != other.triggeredTime ? triggeredTime > other.triggeredTime : voiceIdx > other.voiceIdx;
+    }
+  };
 
-  VoiceBitsArray VoicesMatchingAddress(VoiceAddress va);
+  /** @return The voices matching the address. The mask is reused, so it is only valid until the next call */
+  const VoiceBitsArray& VoicesMatchingAddress(VoiceAddress va);
 
-  void SendControlToVoiceInputs(VoiceBitsArray v, int ctlIdx, float val, int glideSamples);
-  void SendControlToVoicesDirect(VoiceBitsArray v, int ctlIdx, float val);
-  void SendProgramChangeToVoices(VoiceBitsArray v, int pgm);
+  void SendControlToVoiceInputs(const VoiceBitsArray& v, int ctlIdx, float val, int glideSamples);
+  void SendControlToVoicesDirect(const VoiceBitsArray& v, int ctlIdx, float val);
+  void SendProgramChangeToVoices(const VoiceBitsArray& v, int pgm);
 
   void StartVoice(int voiceIdx, int channel, int key, float pitch, float velocity, int sampleOffset, int64_t sampleTime, bool retrig);
-  void StartVoices(VoiceBitsArray voices, int channel, int key, float pitch, float velocity, int sampleOffset, int64_t sampleTime, bool retrig);
+  void StartVoices(const VoiceBitsArray& voices, int channel, int key, float pitch, float velocity, int sampleOffset, int64_t sampleTime, bool retrig);
 
   void StopVoice(int voiceIdx, int sampleOffset);
-  void StopVoices(VoiceBitsArray voices, int sampleOffset);
+  void StopVoices(const VoiceBitsArray& voices, int sampleOffset);
 
   void CalcGlideTimesInSamples();
+  void ResizeThreadPool();
   void ClearVoiceInputs(SynthVoice* pVoice);
+  void UpdateIdleVoices();
+  void UpdateStealHeap();
+  void RebuildStealHeap();
+  void PushStealEntry(int voiceIdx);
   int FindFreeVoiceIndex(int startIndex) const;
-  int FindVoiceIndexToSteal(int64_t sampleTime) const;
+  int FindVoiceIndexToSteal(int key, int64_t sampleTime);
 
   void NoteOn(VoiceInputEvent e, int64_t sampleTime);
   void NoteOff(VoiceInputEvent e, int64_t sampleTime);
@@ -168,6 +379,21 @@ private:
 
   std::vector<SynthVoice*> mVoicePtrs;
   std::vector<std::unique_ptr<VoiceControlRamps>> mVoiceGlides;
+
+  // Indexes kept up to date as voices are added, started and stopped, so events don't have to scan every voice
+  VoiceIndex mZoneIndex, mChannelIndex, mKeyIndex;
+  VoiceIndex mTriggeredKeyIndex; // voices by the key they were last triggered with, which unlike mKey survives the release
+  VoiceBitsArray mMatchedVoices; // result of VoicesMatchingAddress()
+  VoiceBitsArray mIdleVoices; // voices that are not busy, refreshed before each block's events
+
+  // Voice stealing. Voices started in the current block are kept out of the heap until the next block
+  VoiceStealPolicy* mStealPolicy;
+  std::atomic<VoiceStealPolicy*> mPendingStealPolicy{nullptr}; // set by SetVoiceStealPolicy(), applied by ProcessEvents()
+  std::vector<StealEntry> mStealHeap; // min-heap of steal priorities
+  std::vector<double> mStealPriorities; // the priority of each voice's current heap entry
+  std::vector<uint32_t> mStealGenerations; // bumped whenever a voice's heap entry is replaced
+  VoiceBitsArray mPendingStealVoices; // voices started in the current block
+  bool mRebuildStealHeap{false};
   std::vector<int> mHeldKeys; // The currently physically held keys on the keyboard
   std::vector<int> mSustainedNotes; // Any notes that are sustained, including those that are physically held
 
@@ -181,6 +407,13 @@ private:
   double mSampleRate;
   int mBlockSize;
 
+  std::unique_ptr<VoiceThreadPool> mThreadPool;
+  std::atomic<bool> mProcessingVoices{false}; // set during ProcessVoices(), to catch SetNumRenderThreads() being called while processing
+  int mMaxThreadPoolOutputs{2};
+  int mMaxFrames{0};
+
+  VoiceBank* mVoiceBank{nullptr};
+
   bool mRotateVoices{true};
   int mVoiceRotateIndex{0};
   bool mSustainPedalDown{false};
@@ -0,0 +1,600 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+ */
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc VoiceBank
+ */
+
+#include <cmath>
+#include <cstring>
+#include <stdint.h>
+
+#if defined IPLUG_SIMDE
+  #if defined(__arm64__)
+    #define SIMDE_ENABLE_NATIVE_ALIASES
+    #include "simde/x86/sse2.h"
+  #else
+    #include <emmintrin.h>
+  #endif
+#endif
+
+#include "IPlugConstants.h"
+#include "SynthVoice.h"
+
+BEGIN_IPLUG_NAMESPACE
+
+/** A VoiceBank renders many voices in a single pass, rather than one SynthVoice object at a time.
+ * The VoiceAllocator still allocates, steals and glides voices as usual. The SynthVoices it is given are lightweight proxies that
+ * hand their state to the bank, and after the voices have been visited, VoiceAllocator::ProcessVoices() calls ProcessVoiceBank() once.
+ * See MidiSynth::SetVoiceBank() */
+class VoiceBank
+{
+public:
+  virtual ~VoiceBank() {}
+
+  /** Render all voices in the bank, accumulating into outputs. Arguments are as for SynthVoice::ProcessSamplesAccumulating() */
+  virtual void ProcessVoiceBank(sample** inputs, sample** outputs, int nInputs, int nOutputs, int startIdx, int nFrames) = 0;
+
+  /** Tell the bank which inputs hold the same value for every sample of the current block, e.g. from SmootherBank::IsConstant().
+   * Banks can then read a constant input once, rather than per sample
+   * @param pConstantInputs One flag per input channel, updated by the caller before each block, or nullptr if no inputs are known to be constant */
+  void SetConstantInputs(const bool* pConstantInputs) { mConstantInputs = pConstantInputs; }
+
+  /** @return true if input inputIdx is constant for the current block, see SetConstantInputs() */
+  bool IsInputConstant(int inputIdx) const { return mConstantInputs && mConstantInputs[inputIdx]; }
+
+private:
+  const bool* mConstantInputs = nullptr;
+};
+
+/** A bank of sine oscillator + ADSR envelope + noise voices, stored in structure-of-arrays form.
+ * Voices are processed in groups of kLaneWidth, one voice per SIMD lane. Groups where every voice is idle are skipped.
+ * Define IPLUG_SIMDE at project level in order to use SSE2 instructions, and if on non-x86_64
+ * include the SIMDE library in your search paths in order to translate intel intrinsics to e.g. arm64.
+ * The envelope follows the same math as ADSREnvelope (linear attack, exponential decay and release, and a fast linear fade to zero before a
+ * retriggered voice restarts), the oscillator uses a polynomial sine
+ * rather than the table lookup of FastSinOscillator, so that it can be computed for all lanes at once.
+ * @tparam MaxVoices The number of voices in the bank, a multiple of kLaneWidth */
+template <int MaxVoices>
+class SinVoiceBank : public VoiceBank
+{
+public:
+  static constexpr int kLaneWidth = 4;
+  static_assert(MaxVoices % kLaneWidth == 0, "MaxVoices must be a multiple of kLaneWidth");
+
+  enum EStage
+  {
+    kIdle = 0,
+    kAttack,
+    kDecay,
+    kSustain,
+    kRelease,
+    kReleasedToRetrigger
+  };
+
+  static constexpr float ENV_VALUE_LOW = 0.000001f; // -120dB
+  static constexpr float ENV_VALUE_HIGH = 0.999f;
+  static constexpr double MIN_ENV_TIME_MS = 0.022675736961451; // 1 sample @44100
+  static constexpr double MAX_ENV_TIME_MS = 60000.;
+  static constexpr double RETRIGGER_RELEASE_TIME_MS = 3.;
+
+  /** A SynthVoice that is a handle to one lane of the bank. Add these to the MidiSynth */
+  class Voice : public SynthVoice
+  {
+  public:
+    Voice(SinVoiceBank& bank, int lane)
+    : mBank(bank)
+    , mLane(lane)
+    {}
+
+    bool GetBusy() const override { return mBank.mStage[mLane] != kIdle; }
+
+    void Trigger(double level, bool isRetrigger) override { mBank.Trigger(mLane, static_cast<float>(level), isRetrigger); }
+
+    void Release() override { mBank.Release(mLane); }
+
+    float GetLoudness() const override { return mBank.mPrevResult[mLane] * mBank.mLevel[mLane]; }
+
+    void ProcessSamplesAccumulating(sample** inputs, sample** outputs, int nInputs, int nOutputs, int startIdx, int nFrames) override
+    {
+      // No rendering here, just gather this voice's control ramps into the bank
+      const ControlRamp& timbre = mInputs[kVoiceControlTimbre];
+      mBank.mPitch[mLane] = static_cast<float>(mInputs[kVoiceControlPitch].endValue + mInputs[kVoiceControlPitchBend].endValue);
+      mBank.mTimbreStart[mLane] = static_cast<float>(timbre.startValue);
+      mBank.mTimbreEnd[mLane] = static_cast<float>(timbre.endValue);
+      mBank.mTimbreTransitionStart[mLane] = static_cast<float>(timbre.transitionStart);
+      mBank.mTimbreTransitionEnd[mLane] = static_cast<float>(std::max(timbre.transitionEnd, timbre.transitionStart + 1));
+      mBank.mGain[mLane] = static_cast<float>(mGain);
+    }
+
+    void SetSampleRateAndBlockSize(double sampleRate, int blockSize) override { mBank.SetSampleRate(sampleRate); }
+
+  private:
+    SinVoiceBank& mBank;
+    const int mLane;
+  };
+
+  SinVoiceBank()
+  {
+    for (auto v = 0; v < MaxVoices; v++)
+    {
+      mVoices[v] = new Voice(*this, v);
+      mRandSeed[v] = static_cast<uint32_t>(v) * 0x9E3779B9u;
+    }
+
+    SetSampleRate(DEFAULT_SAMPLE_RATE);
+  }
+
+  ~SinVoiceBank()
+  {
+    for (auto v = 0; v < MaxVoices; v++)
+      delete mVoices[v];
+  }
+
+  SinVoiceBank(const SinVoiceBank&) = delete;
+  SinVoiceBank& operator=(const SinVoiceBank&) = delete;
+
+  /** @return The SynthVoice proxy for a lane of the bank. The bank retains ownership */
+  Voice* GetVoice(int lane) { return mVoices[lane]; }
+
+  /** Select which of the inputs passed to ProcessVoiceBank() are used for modulation
+   * @param pitchModInputIdx Input channel whose first sample is added to the pitch of every voice (1v/oct), or -1 for none
+   * @param sustainInputIdx Input channel containing the envelope sustain level per sample, or -1 to use SetSustain() */
+  void SetInputs(int pitchModInputIdx, int sustainInputIdx)
+  {
+    mPitchModInputIdx = pitchModInputIdx;
+    mSustainInputIdx = sustainInputIdx;
+  }
+
+  /** Set the sustain level used if no sustain input is selected */
+  void SetSustain(double sustain) { mSustain = static_cast<float>(sustain); }
+
+  void SetSampleRate(double sampleRate)
+  {
+    if (sampleRate != mSampleRate)
+    {
+      mSampleRate = sampleRate;
+      mRetriggerIncr = static_cast<float>((1. / mSampleRate) / (RETRIGGER_RELEASE_TIME_MS / 1000.));
+      SetStageTime(kAttack, mStageTimes[kAttack]);
+      SetStageTime(kDecay, mStageTimes[kDecay]);
+      SetStageTime(kRelease, mStageTimes[kRelease]);
+    }
+  }
+
+  /** Sets the time for a particular envelope stage, for all voices
+   * @param stage kAttack, kDecay or kRelease
+   * @param timeMS The time in milliseconds for that stage */
+  void SetStageTime(int stage, double timeMS)
+  {
+    mStageTimes[stage] = timeMS;
+    timeMS = Clip(timeMS, MIN_ENV_TIME_MS, MAX_ENV_TIME_MS);
+
+    switch (stage)
+    {
+      case kAttack:
+        mAttackIncr = static_cast<float>((1. / mSampleRate) / (timeMS / 1000.));
+        break;
+      case kDecay:
+        mDecayIncr = static_cast<float>(std::min(-std::expm1(1000.0 * std::log(0.001) / (mSampleRate * timeMS)), 1.));
+        break;
+      case kRelease:
+        mReleaseIncr = static_cast<float>(std::min(-std::expm1(1000.0 * std::log(0.001) / (mSampleRate * timeMS)), 1.));
+        break;
+      default:
+        break;
+    }
+  }
+
+  void ProcessVoiceBank(sample** inputs, sample** outputs, int nInputs, int nOutputs, int startIdx, int nFrames) override
+  {
+    const double pitchMod = (mPitchModInputIdx >= 0 && mPitchModInputIdx < nInputs) ? inputs[mPitchModInputIdx][0] : 0.;
+    const sample* pSustain = (mSustainInputIdx >= 0 && mSustainInputIdx < nInputs) ? inputs[mSustainInputIdx] + startIdx : nullptr;
+    float sustain = mSustain;
+
+    if (pSustain && IsInputConstant(mSustainInputIdx))
+    {
+      sustain = static_cast<float>(pSustain[0]);
+      pSustain = nullptr;
+    }
+
+    int nActiveGroups = 0;
+
+    for (auto group = 0; group < MaxVoices; group += kLaneWidth)
+    {
+      bool active = false;
+
+      for (auto l = 0; l < kLaneWidth; l++)
+        active |= (mStage[group + l] != kIdle);
+
+      if (!active)
+        continue;
+
+      mActiveGroups[nActiveGroups++] = group;
+
+      // per block, per voice: convert from "1v/oct" pitch space to a phase increment
+      for (auto l = 0; l < kLaneWidth; l++)
+        mPhaseIncr[group + l] = static_cast<float>(440. * std::pow(2., mPitch[group + l] + pitchMod) / mSampleRate);
+    }
+
+    if (!nActiveGroups)
+      return;
+
+    // Groups accumulate lane-wise into mLaneOutputs, which is only summed across lanes once per sample at the end
+    for (auto offset = 0; offset < nFrames; offset += kMaxChunkSize)
+    {
+      const int chunkSize = std::min(kMaxChunkSize, nFrames - offset);
+      memset(mLaneOutputs, 0, chunkSize * kLaneWidth * sizeof(float));
+
+      for (auto g = 0; g < nActiveGroups; g++)
+        ProcessGroup(mActiveGroups[g], pSustain ? pSustain + offset : nullptr, sustain, offset, chunkSize);
+
+      SumLanes(outputs, nOutputs, startIdx + offset, chunkSize);
+    }
+  }
+
+private:
+  void Trigger(int lane, float level, bool isRetrigger)
+  {
+    // as ADSREnvelope::Retrigger(), fade out from the current level before restarting, rather than jumping to zero
+    if (isRetrigger && mStage[lane] != kIdle)
+    {
+      mReleaseLevel[lane] = mPrevResult[lane];
+      mEnv[lane] = 1.f;
+      mNewLevel[lane] = level;
+      mStage[lane] = kReleasedToRetrigger;
+      return;
+    }
+
+    mPhase[lane] = 0.25f; // FastSinOscillator's table is a cosine, start at the same point in the cycle
+    mEnv[lane] = 0.f;
+    mLevel[lane] = level;
+    mPrevResult[lane] = 0.f;
+    mStage[lane] = kAttack;
+  }
+
+  void Release(int lane)
+  {
+    if (mStage[lane] == kIdle)
+      return;
+
+    mReleaseLevel[lane] = mPrevResult[lane];
+    mEnv[lane] = 1.f;
+    mStage[lane] = kRelease;
+  }
+
+#ifdef IPLUG_SIMDE
+  static inline __m128 Select(__m128 mask, __m128 a, __m128 b)
+  {
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+  }
+
+  /** Low 32 bits of a 32x32 bit multiply, since _mm_mullo_epi32 needs SSE4.1 */
+  static inline __m128i MulLo32(__m128i a, __m128i b)
+  {
+    const __m128i even = _mm_mul_epu32(a, b);
+    const __m128i odd = _mm_mul_epu32(_mm_srli_si128(a, 4), _mm_srli_si128(b, 4));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+  }
+
+  /** sin(2 * pi * phase) for phase in [0, 1), folded to [-pi/2, pi/2] and evaluated as a Taylor series to a^9 */
+  static inline __m128 Sin2Pi(__m128 phase)
+  {
+    const __m128 signBit = _mm_set1_ps(-0.f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    __m128 x = _mm_sub_ps(phase, half);
+    const __m128 sign = _mm_and_ps(x, signBit);
+    const __m128 ax = _mm_andnot_ps(signBit, x);
+    x = Select(_mm_cmpgt_ps(ax, _mm_set1_ps(0.25f)), _mm_or_ps(_mm_sub_ps(half, ax), sign), x);
+    const __m128 a = _mm_mul_ps(x, _mm_set1_ps(6.28318530718f));
+    const __m128 a2 = _mm_mul_ps(a, a);
+    __m128 p = _mm_add_ps(_mm_set1_ps(-1.f/5040.f), _mm_mul_ps(a2, _mm_set1_ps(1.f/362880.f)));
+    p = _mm_add_ps(_mm_set1_ps(1.f/120.f), _mm_mul_ps(a2, p));
+    p = _mm_add_ps(_mm_set1_ps(-1.f/6.f), _mm_mul_ps(a2, p));
+    p = _mm_add_ps(_mm_set1_ps(1.f), _mm_mul_ps(a2, p));
+    return _mm_xor_ps(_mm_mul_ps(a, p), signBit);
+  }
+
+  /** Render nFrames samples of one group of voices, accumulating each lane into mLaneOutputs
+   * @param pSustain Sustain level per sample, or nullptr to use constantSustain
+   * @param constantSustain The sustain level for the whole block, if pSustain is nullptr
+   * @param rampOffset Position of the first sample relative to the start of the voices' control ramps */
+  void ProcessGroup(int group, const sample* pSustain, float constantSustain, int rampOffset, int nFrames)
+  {
+    __m128 phase = _mm_load_ps(mPhase + group);
+    const __m128 phaseIncr = _mm_load_ps(mPhaseIncr + group);
+    __m128 env = _mm_load_ps(mEnv + group);
+    __m128 prevResult = _mm_load_ps(mPrevResult + group);
+    __m128i stage = _mm_load_si128(reinterpret_cast<const __m128i*>(mStage + group));
+    __m128i seed = _mm_load_si128(reinterpret_cast<const __m128i*>(mRandSeed + group));
+    const __m128 releaseLevel = _mm_load_ps(mReleaseLevel + group);
+    __m128 level = _mm_load_ps(mLevel + group);
+    const __m128 newLevel = _mm_load_ps(mNewLevel + group);
+    const __m128 gain = _mm_load_ps(mGain + group);
+    const __m128 timbreStart = _mm_load_ps(mTimbreStart + group);
+    const __m128 timbreRange = _mm_sub_ps(_mm_load_ps(mTimbreEnd + group), timbreStart);
+    const __m128 timbreTS = _mm_load_ps(mTimbreTransitionStart + group);
+    const __m128 timbreRecip = _mm_div_ps(_mm_set1_ps(1.f), _mm_sub_ps(_mm_load_ps(mTimbreTransitionEnd + group), timbreTS));
+
+    const __m128 attackIncr = _mm_set1_ps(mAttackIncr);
+    const __m128 decayIncr = _mm_set1_ps(mDecayIncr);
+    const __m128 releaseIncr = _mm_set1_ps(mReleaseIncr);
+    const __m128 retriggerIncr = _mm_set1_ps(mRetriggerIncr);
+    const __m128 startPhase = _mm_set1_ps(0.25f);
+    const __m128 envHigh = _mm_set1_ps(ENV_VALUE_HIGH);
+    const __m128 envLow = _mm_set1_ps(ENV_VALUE_LOW);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.f);
+    const __m128i attack = _mm_set1_epi32(kAttack);
+    const __m128i decay = _mm_set1_epi32(kDecay);
+    const __m128i sustainStage = _mm_set1_epi32(kSustain);
+    const __m128i release = _mm_set1_epi32(kRelease);
+    const __m128i retrigger = _mm_set1_epi32(kReleasedToRetrigger);
+    const __m128i randMul = _mm_set1_epi32(0x0019660D);
+    const __m128i randAdd = _mm_set1_epi32(0x3C6EF35F);
+    const __m128 randScale = _mm_set1_ps(2.f / 8388608.f);
+
+    for (auto i = 0; i < nFrames; i++)
+    {
+      const __m128 sustain = _mm_set1_ps(pSustain ? static_cast<float>(pSustain[i]) : constantSustain);
+
+      // envelope
+      const __m128 isAttack = _mm_castsi128_ps(_mm_cmpeq_epi32(stage, attack));
+      const __m128 isDecay = _mm_castsi128_ps(_mm_cmpeq_epi32(stage, decay));
+      const __m128 isRelease = _mm_castsi128_ps(_mm_cmpeq_epi32(stage, release));
+      const __m128 isRetrigger = _mm_castsi128_ps(_mm_cmpeq_epi32(stage, retrigger));
+      const __m128 expIncr = _mm_or_ps(_mm_and_ps(isDecay, decayIncr), _mm_and_ps(isRelease, releaseIncr));
+      const __m128 linIncr = _mm_sub_ps(_mm_and_ps(isAttack, attackIncr), _mm_and_ps(isRetrigger, retriggerIncr));
+      env = _mm_sub_ps(_mm_add_ps(env, linIncr), _mm_mul_ps(expIncr, env));
+
+      const __m128 attackDone = _mm_and_ps(isAttack, _mm_cmpgt_ps(env, envHigh));
+      const __m128 decayDone = _mm_and_ps(isDecay, _mm_cmplt_ps(env, envLow));
+      const __m128 releaseDone = _mm_and_ps(isRelease, _mm_cmplt_ps(env, envLow));
+      const __m128 retriggerDone = _mm_and_ps(isRetrigger, _mm_cmplt_ps(env, envLow));
+      // masks are -1, so subtracting them advances attack -> decay -> sustain, release -> idle is -kRelease, retrigger -> attack is -(kReleasedToRetrigger - kAttack)
+      stage = _mm_sub_epi32(stage, _mm_castps_si128(_mm_or_ps(attackDone, decayDone)));
+      stage = _mm_sub_epi32(stage, _mm_and_si128(_mm_castps_si128(releaseDone), release));
+      stage = _mm_sub_epi32(stage, _mm_and_si128(_mm_castps_si128(retriggerDone), _mm_sub_epi32(retrigger, attack)));
+      env = Select(_mm_or_ps(attackDone, decayDone), one, _mm_andnot_ps(_mm_or_ps(releaseDone, retriggerDone), env));
+
+      // a retriggered voice restarts at its new level and phase once it has faded out
+      level = Select(retriggerDone, newLevel, level);
+      phase = Select(retriggerDone, startPhase, phase);
+
+      __m128 result = _mm_and_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(stage, attack)), env);
+      result = Select(_mm_castsi128_ps(_mm_cmpeq_epi32(stage, decay)), _mm_add_ps(_mm_mul_ps(env, _mm_sub_ps(one, sustain)), sustain), result);
+      result = Select(_mm_castsi128_ps(_mm_cmpeq_epi32(stage, sustainStage)), sustain, result);
+      const __m128 isFading = _mm_or_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(stage, release)), _mm_castsi128_ps(_mm_cmpeq_epi32(stage, retrigger)));
+      result = Select(isFading, _mm_mul_ps(env, releaseLevel), result);
+      prevResult = result;
+
+      // timbre ramp
+      __m128 t = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(static_cast<float>(rampOffset + i + 1)), timbreTS), timbreRecip);
+      t = _mm_min_ps(_mm_max_ps(t, zero), one);
+      const __m128 timbre = _mm_add_ps(timbreStart, _mm_mul_ps(timbreRange, t));
+
+      // noise
+      seed = _mm_add_epi32(MulLo32(seed, randMul), randAdd);
+      const __m128 noise = _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(seed, 9)), randScale), one);
+
+      // oscillator
+      const __m128 osc = Sin2Pi(phase);
+      phase = _mm_add_ps(phase, phaseIncr);
+      phase = _mm_sub_ps(phase, _mm_and_ps(_mm_cmpge_ps(phase, one), one));
+
+      const __m128 out = _mm_mul_ps(_mm_mul_ps(_mm_add_ps(osc, _mm_mul_ps(timbre, noise)), result), _mm_mul_ps(level, gain));
+      float* pLaneOut = mLaneOutputs + (i * kLaneWidth);
+      _mm_store_ps(pLaneOut, _mm_add_ps(_mm_load_ps(pLaneOut), out));
+    }
+
+    _mm_store_ps(mPhase + group, phase);
+    _mm_store_ps(mEnv + group, env);
+    _mm_store_ps(mPrevResult + group, prevResult);
+    _mm_store_ps(mLevel + group, level);
+    _mm_store_si128(reinterpret_cast<__m128i*>(mStage + group), stage);
+    _mm_store_si128(reinterpret_cast<__m128i*>(mRandSeed + group), seed);
+  }
+  /** Sum mLaneOutputs across lanes, accumulating the mono result into every output channel */
+  void SumLanes(sample** outputs, int nOutputs, int startIdx, int nFrames)
+  {
+    auto i = 0;
+
+    for (; i + 4 <= nFrames; i += 4)
+    {
+      __m128 r0 = _mm_load_ps(mLaneOutputs + (i * kLaneWidth));
+      __m128 r1 = _mm_load_ps(mLaneOutputs + ((i + 1) * kLaneWidth));
+      __m128 r2 = _mm_load_ps(mLaneOutputs + ((i + 2) * kLaneWidth));
+      __m128 r3 = _mm_load_ps(mLaneOutputs + ((i + 3) * kLaneWidth));
+      _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+      float sums[4];
+      _mm_storeu_ps(sums, _mm_add_ps(_mm_add_ps(r0, r1), _mm_add_ps(r2, r3)));
+
+      for (auto c = 0; c < nOutputs; c++)
+      {
+        for (auto s = 0; s < 4; s++)
+          outputs[c][startIdx + i + s] += sums[s];
+      }
+    }
+
+    for (; i < nFrames; i++)
+    {
+      const float* pLaneOut = mLaneOutputs + (i * kLaneWidth);
+      const float sum = pLaneOut[0] + pLaneOut[1] + pLaneOut[2] + pLaneOut[3];
+
+      for (auto c = 0; c < nOutputs; c++)
+        outputs[c][startIdx + i] += sum;
+    }
+  }
+#else // scalar
+  /** sin(2 * pi * phase) for phase in [0, 1) */
+  static inline float Sin2Pi(float phase)
+  {
+    // map to x in [-0.5, 0.5) where sin(2 pi phase) = -sin(2 pi x), then fold to [-0.25, 0.25] using sin(pi - a) = sin(a)
+    float x = phase - 0.5f;
+    const float ax = std::fabs(x);
+    const float sign = x < 0.f ? -1.f : 1.f;
+    x = ax > 0.25f ? sign * (0.5f - ax) : x;
+    const float a = x * 6.28318530718f;
+    const float a2 = a * a;
+    // Taylor series to a^9, max error < 4e-6 over [-pi/2, pi/2]
+    const float s = a * (1.f + a2 * (-1.f/6.f + a2 * (1.f/120.f + a2 * (-1.f/5040.f + a2 * (1.f/362880.f)))));
+    return -s;
+  }
+
+  void ProcessGroup(int group, const sample* pSustain, float constantSustain, int rampOffset, int nFrames)
+  {
+    constexpr int W = kLaneWidth;
+
+    // Load the group's state into local fixed-width arrays, so the compiler can keep them in registers
+    float phase[W], phaseIncr[W], env[W], level[W], newLevel[W], releaseLevel[W], prevResult[W], gain[W];
+    float timbreStart[W], timbreEnd[W], timbreTS[W], timbreTE[W];
+    int32_t stage[W];
+    uint32_t seed[W];
+
+    for (auto l = 0; l < W; l++)
+    {
+      phase[l] = mPhase[group + l];
+      phaseIncr[l] = mPhaseIncr[group + l];
+      env[l] = mEnv[group + l];
+      level[l] = mLevel[group + l];
+      newLevel[l] = mNewLevel[group + l];
+      releaseLevel[l] = mReleaseLevel[group + l];
+      prevResult[l] = mPrevResult[group + l];
+      gain[l] = mGain[group + l];
+      timbreStart[l] = mTimbreStart[group + l];
+      timbreEnd[l] = mTimbreEnd[group + l];
+      timbreTS[l] = mTimbreTransitionStart[group + l];
+      timbreTE[l] = mTimbreTransitionEnd[group + l];
+      stage[l] = mStage[group + l];
+      seed[l] = mRandSeed[group + l];
+    }
+
+    const float attackIncr = mAttackIncr;
+    const float decayIncr = mDecayIncr;
+    const float releaseIncr = mReleaseIncr;
+    const float retriggerIncr = mRetriggerIncr;
+
+    for (auto i = 0; i < nFrames; i++)
+    {
+      const float sustain = pSustain ? static_cast<float>(pSustain[i]) : constantSustain;
+      const float fi = static_cast<float>(rampOffset + i + 1); // ControlRamp::Write() reaches the first ramp step at transitionStart
+      float* pLaneOut = mLaneOutputs + (i * W);
+
+      for (auto l = 0; l < W; l++)
+      {
+        // envelope, the same stage logic as ADSREnvelope::Process()
+        const int32_t st = stage[l];
+        float e = env[l];
+        e = st == kAttack ? e + attackIncr : e;
+        e = st == kDecay ? e - decayIncr * e : e;
+        e = st == kRelease ? e - releaseIncr * e : e;
+        e = st == kReleasedToRetrigger ? e - retriggerIncr : e;
+
+        const bool attackDone = (st == kAttack) & (e > ENV_VALUE_HIGH);
+        const bool decayDone = (st == kDecay) & (e < ENV_VALUE_LOW);
+        const bool releaseDone = (st == kRelease) & (e < ENV_VALUE_LOW);
+        const bool retriggerDone = (st == kReleasedToRetrigger) & (e < ENV_VALUE_LOW);
+        const int32_t newStage = attackDone ? kDecay : decayDone ? kSustain : releaseDone ? kIdle : retriggerDone ? kAttack : st;
+        e = (attackDone | decayDone) ? 1.f : (releaseDone | retriggerDone) ? 0.f : e;
+
+        // a retriggered voice restarts at its new level and phase once it has faded out
+        level[l] = retriggerDone ? newLevel[l] : level[l];
+        phase[l] = retriggerDone ? 0.25f : phase[l];
+
+        float result = newStage == kAttack ? e : 0.f;
+        result = newStage == kDecay ? e * (1.f - sustain) + sustain : result;
+        result = newStage == kSustain ? sustain : result;
+        result = (newStage == kRelease) | (newStage == kReleasedToRetrigger) ? e * releaseLevel[l] : result;
+
+        env[l] = e;
+        stage[l] = newStage;
+        prevResult[l] = result;
+
+        // timbre ramp, as ControlRamp::Write()
+        float t = (fi - timbreTS[l]) / (timbreTE[l] - timbreTS[l]);
+        t = t < 0.f ? 0.f : (t > 1.f ? 1.f : t);
+        const float timbre = timbreStart[l] + (timbreEnd[l] - timbreStart[l]) * t;
+
+        // noise on [-1, 1]
+        seed[l] = seed[l] * 0x0019660Du + 0x3C6EF35Fu;
+        const float noise = static_cast<float>(seed[l] >> 9) * (2.f / 8388608.f) - 1.f;
+
+        // oscillator
+        const float osc = Sin2Pi(phase[l]);
+        float p = phase[l] + phaseIncr[l];
+        phase[l] = p >= 1.f ? p - 1.f : p;
+
+        pLaneOut[l] += (osc + timbre * noise) * result * level[l] * gain[l];
+      }
+    }
+
+    for (auto l = 0; l < W; l++)
+    {
+      mPhase[group + l] = phase[l];
+      mEnv[group + l] = env[l];
+      mPrevResult[group + l] = prevResult[l];
+      mLevel[group + l] = level[l];
+      mStage[group + l] = stage[l];
+      mRandSeed[group + l] = seed[l];
+    }
+  }
+
+  /** Sum mLaneOutputs across lanes, accumulating the mono result into every output channel */
+  void SumLanes(sample** outputs, int nOutputs, int startIdx, int nFrames)
+  {
+    for (auto i = 0; i < nFrames; i++)
+    {
+      float sum = 0.f;
+
+      for (auto l = 0; l < kLaneWidth; l++)
+        sum += mLaneOutputs[(i * kLaneWidth) + l];
+
+      for (auto c = 0; c < nOutputs; c++)
+        outputs[c][startIdx + i] += sum;
+    }
+  }
+#endif
+
+  static constexpr int kMaxChunkSize = 64;
+
+  Voice* mVoices[MaxVoices];
+  int mActiveGroups[MaxVoices / kLaneWidth];
+  alignas(16) float mLaneOutputs[kMaxChunkSize * kLaneWidth];
+
+  alignas(16) float mPhase[MaxVoices] {};
+  alignas(16) float mPhaseIncr[MaxVoices] {};
+  alignas(16) float mPitch[MaxVoices] {};
+  alignas(16) float mEnv[MaxVoices] {};
+  alignas(16) float mLevel[MaxVoices] {};
+  alignas(16) float mNewLevel[MaxVoices] {}; // the level a retriggered voice restarts at
+  alignas(16) float mReleaseLevel[MaxVoices] {};
+  alignas(16) float mPrevResult[MaxVoices] {};
+  alignas(16) float mGain[MaxVoices] {};
+  alignas(16) float mTimbreStart[MaxVoices] {};
+  alignas(16) float mTimbreEnd[MaxVoices] {};
+  alignas(16) float mTimbreTransitionStart[MaxVoices] {};
+  alignas(16) float mTimbreTransitionEnd[MaxVoices] {};
+  alignas(16) int32_t mStage[MaxVoices] {};
+  alignas(16) uint32_t mRandSeed[MaxVoices] {};
+
+  double mSampleRate = 0.;
+  double mStageTimes[kRelease + 1] = {0., 10., 10., 0., 10.};
+  float mAttackIncr = 0.f;
+  float mDecayIncr = 0.f;
+  float mReleaseIncr = 0.f;
+  float mRetriggerIncr = 0.f;
+  float mSustain = 0.5f;
+  int mPitchModInputIdx = -1;
+  int mSustainInputIdx = -1;
+};
+
+END_IPLUG_NAMESPACE
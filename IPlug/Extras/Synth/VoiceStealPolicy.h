@@ -0,0 +1,82 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+ */
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc VoiceStealPolicy
+ */
+
+#include "SynthVoice.h"
+
+BEGIN_IPLUG_NAMESPACE
+
+/** A VoiceStealPolicy decides which voice the VoiceAllocator steals when a note starts and every voice is busy.
+ * A policy only ranks voices: the allocator keeps them in a priority queue, so choosing a voice is O(log n) rather than a scan.
+ * Voices triggered in the current block are never stolen while an older voice is available.
+ * See VoiceAllocator::SetVoiceStealPolicy() */
+class VoiceStealPolicy
+{
+public:
+  virtual ~VoiceStealPolicy() {}
+
+  /** @param voice A voice, which may be busy or idle
+   * @return The steal priority of the voice. The voice with the lowest priority is stolen first, ties go to the voice triggered longest ago, then to the lowest voice index */
+  virtual double GetPriority(const SynthVoice& voice) const = 0;
+
+  /** @return \c true if GetPriority() changes while a voice plays, e.g. because it depends on loudness. Dynamic priorities are
+   * re-read for every voice once per block, otherwise only when a voice is added, triggered or released */
+  virtual bool IsDynamic() const { return false; }
+
+  /** @return \c true to steal a voice that was last triggered with the incoming key, if there is one, before ranking all voices by priority */
+  virtual bool GetStealSameKeyFirst() const { return false; }
+};
+
+/** Steal the voice that was triggered longest ago. This is the default policy */
+class OldestVoiceStealPolicy : public VoiceStealPolicy
+{
+public:
+  double GetPriority(const SynthVoice& voice) const override { return static_cast<double>(voice.GetLastTriggeredTime()); }
+};
+
+/** Steal the voice that is currently quietest, according to SynthVoice::GetLoudness(), or the oldest of equally quiet voices.
+ * Voices that don't override GetLoudness() all report their gain, so for them this behaves like OldestVoiceStealPolicy */
+class QuietestVoiceStealPolicy : public VoiceStealPolicy
+{
+public:
+  double GetPriority(const SynthVoice& voice) const override { return voice.GetLoudness(); }
+
+  bool IsDynamic() const override { return true; }
+};
+
+/** Steal voices whose note has already ended before voices that are still held, the oldest first within each group */
+class ReleasedFirstVoiceStealPolicy : public VoiceStealPolicy
+{
+public:
+  double GetPriority(const SynthVoice& voice) const override
+  {
+    // sample times are well below 2^52, so the offset keeps the two groups apart without losing precision
+    const double time = static_cast<double>(voice.GetLastTriggeredTime());
+    return voice.GetReleased() ? time - kHeldOffset : time;
+  }
+
+private:
+  static constexpr double kHeldOffset = 4503599627370496.; // 2^52
+};
+
+/** Retrigger a voice that last played the same key, e.g. for repeated piano notes, otherwise steal the oldest voice */
+class SameKeyFirstVoiceStealPolicy : public OldestVoiceStealPolicy
+{
+public:
+  bool GetStealSameKeyFirst() const override { return true; }
+};
+
+END_IPLUG_NAMESPACE
@@ -0,0 +1,213 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+ */
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc VoiceThreadPool
+ */
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "heapbuf.h"
+
+#include "IPlugConstants.h"
+#include "RealtimeThread.h"
+#include "SynthVoice.h"
+
+BEGIN_IPLUG_NAMESPACE
+
+/** A pool of pre-spawned worker threads that render SynthVoices in parallel.
+ * The calling (audio) thread acts as one of the render threads. Busy voices are shared out between the threads in a fixed order,
+ * each thread accumulates its voices into its own buffer, and the buffers are summed into the outputs in thread order,
+ * so the result is deterministic for a given set of busy voices and thread count.
+ * ProcessVoices() does not allocate or lock. The workers run at realtime priority where the platform allows it, see SetCurrentThreadRealtimePriority().
+ * Each worker is woken with its own RealtimeSemaphore: it spins on it for a short while and then blocks, and the audio thread only makes a
+ * system call to wake a worker that has blocked. The audio thread never waits on a lock, only for the workers to finish the current block. */
+class VoiceThreadPool final
+{
+public:
+  /** Busy voice counts below this are rendered on the calling thread, since the handoff would cost more than it saves */
+  static constexpr int kMinVoicesForThreading = 4;
+
+  /** Number of spin iterations a worker waits for new work before it blocks */
+  static constexpr int kWorkerSpinCount = 20000;
+
+  /** Create a pool, spawning the worker threads. This allocates and must not be called on the audio thread.
+   * @param nThreads The total number of render threads, including the calling thread */
+  VoiceThreadPool(int nThreads)
+  : mNThreads(std::max(nThreads, 1))
+  , mBuffers(mNThreads)
+  , mChannelPtrs(mNThreads)
+  , mWake(new RealtimeSemaphore[mNThreads])
+  {
+    for (auto t = 1; t < mNThreads; t++)
+      mWorkers.emplace_back([this, t]() { WorkerLoop(t); });
+  }
+
+  ~VoiceThreadPool()
+  {
+    mQuit.store(true, std::memory_order_relaxed);
+
+    for (auto t = 1; t < mNThreads; t++)
+      mWake[t].Signal();
+
+    for (auto& worker : mWorkers)
+      worker.join();
+  }
+
+  VoiceThreadPool(const VoiceThreadPool&) = delete;
+  VoiceThreadPool& operator=(const VoiceThreadPool&) = delete;
+
+  /** Allocate the per-thread accumulation buffers. Must not be called on the audio thread
+   * @param nVoices The maximum number of voices that will be passed to ProcessVoices()
+   * @param nChannels The maximum number of output channels
+   * @param maxFrames The maximum value of startIdx + nFrames that will be passed to ProcessVoices() */
+  void Resize(int nVoices, int nChannels, int maxFrames)
+  {
+    mBusyVoices.resize(nVoices);
+    mMaxChannels = nChannels;
+    mMaxFrames = maxFrames;
+
+    for (auto t = 0; t < mNThreads; t++)
+    {
+      mBuffers[t].Resize(nChannels * maxFrames);
+      mChannelPtrs[t].resize(nChannels);
+
+      for (auto c = 0; c < nChannels; c++)
+        mChannelPtrs[t][c] = mBuffers[t].Get() + (c * maxFrames);
+    }
+  }
+
+  /** @return The total number of render threads, including the calling thread */
+  int NThreads() const { return mNThreads; }
+
+  /** Render all busy voices, accumulating into outputs. Arguments are as for SynthVoice::ProcessSamplesAccumulating()
+   * @param ppVoices The voices to render */
+  void ProcessVoices(SynthVoice* const* ppVoices, int nVoices, sample** inputs, sample** outputs, int nInputs, int nOutputs, int startIdx, int nFrames)
+  {
+    int nBusy = 0;
+
+    for (auto v = 0; v < nVoices && nBusy < static_cast<int>(mBusyVoices.size()); v++)
+    {
+      if (ppVoices[v]->GetBusy())
+        mBusyVoices[nBusy++] = ppVoices[v];
+    }
+
+    if (mNThreads < 2 || nBusy < kMinVoicesForThreading || nOutputs > mMaxChannels || startIdx + nFrames > mMaxFrames)
+    {
+      for (auto v = 0; v < nBusy; v++)
+        mBusyVoices[v]->ProcessSamplesAccumulating(inputs, outputs, nInputs, nOutputs, startIdx, nFrames);
+
+      return;
+    }
+
+    mJob.inputs = inputs;
+    mJob.nInputs = nInputs;
+    mJob.nOutputs = nOutputs;
+    mJob.startIdx = startIdx;
+    mJob.nFrames = nFrames;
+    mJob.nBusy = nBusy;
+
+    mPending.store(mNThreads - 1, std::memory_order_relaxed);
+
+    for (auto t = 1; t < mNThreads; t++)
+      mWake[t].Signal();
+
+    RenderShare(0);
+
+    // If the workers are slower than us (or we share a core with them) stop burning cycles and yield to them
+    for (auto i = 0; mPending.load(std::memory_order_acquire); i++)
+    {
+      if (i < kWorkerSpinCount)
+        IPLUG_SPIN_PAUSE();
+      else
+        std::this_thread::yield();
+    }
+
+    for (auto t = 0; t < mNThreads; t++)
+    {
+      for (auto c = 0; c < nOutputs; c++)
+      {
+        const sample* pSrc = mChannelPtrs[t][c];
+        sample* pDst = outputs[c];
+
+        for (auto s = startIdx; s < startIdx + nFrames; s++)
+          pDst[s] += pSrc[s];
+      }
+    }
+  }
+
+private:
+  struct Job
+  {
+    sample** inputs = nullptr;
+    int nInputs = 0;
+    int nOutputs = 0;
+    int startIdx = 0;
+    int nFrames = 0;
+    int nBusy = 0;
+  };
+
+  void RenderShare(int threadIdx)
+  {
+    sample** ppOut = mChannelPtrs[threadIdx].data();
+
+    for (auto c = 0; c < mJob.nOutputs; c++)
+      memset(ppOut[c] + mJob.startIdx, 0, mJob.nFrames * sizeof(sample));
+
+    for (auto v = threadIdx; v < mJob.nBusy; v += mNThreads)
+      mBusyVoices[v]->ProcessSamplesAccumulating(mJob.inputs, ppOut, mJob.nInputs, mJob.nOutputs, mJob.startIdx, mJob.nFrames);
+  }
+
+  void WorkerLoop(int threadIdx)
+  {
+    SetCurrentThreadRealtimePriority();
+    RealtimeSemaphore& wake = mWake[threadIdx];
+
+    while (true)
+    {
+      auto i = 0;
+
+      while (i < kWorkerSpinCount && !wake.TryWait())
+      {
+        IPLUG_SPIN_PAUSE();
+        i++;
+      }
+
+      if (i == kWorkerSpinCount)
+        wake.Wait();
+
+      if (mQuit.load(std::memory_order_relaxed))
+        return;
+
+      RenderShare(threadIdx);
+      mPending.fetch_sub(1, std::memory_order_acq_rel);
+    }
+  }
+
+  const int mNThreads;
+  int mMaxChannels = 0;
+  int mMaxFrames = 0;
+  Job mJob;
+  std::vector<SynthVoice*> mBusyVoices;
+  std::vector<WDL_TypedBuf<sample>> mBuffers;
+  std::vector<std::vector<sample*>> mChannelPtrs;
+  std::unique_ptr<RealtimeSemaphore[]> mWake; // one per thread, signalled once per block that is handed to the workers
+  std::vector<std::thread> mWorkers;
+  std::atomic<int> mPending{0};
+  std::atomic<bool> mQuit{false};
+};
+
+END_IPLUG_NAMESPACE
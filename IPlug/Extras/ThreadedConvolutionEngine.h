@@ -0,0 +1,442 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+ */
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc ThreadedConvolutionEngine
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "convoengine.h"
+
+#include "IPlugConstants.h"
+#include "RealtimeThread.h"
+
+BEGIN_IPLUG_NAMESPACE
+
+/** A zero latency convolution engine for long impulse responses, with the same Add()/Avail()/Get()/Advance() interface as the WDL engines.
+ * The first 2 * TailBlockSize() samples of the impulse (the head) are convolved on the calling thread by a WDL_ConvolutionEngine_Div.
+ * The rest of the impulse (the tail) is convolved on a worker thread by a second WDL_ConvolutionEngine_Div, whose smallest partition
+ * is TailBlockSize(), so the large FFTs of a long impulse never land on an audio callback.
+ * Each block of TailBlockSize() input samples is handed to the worker as soon as it is complete, and its tail output is not needed
+ * until TailBlockSize() samples later, which is the worker's deadline. If the worker misses the deadline the audio thread waits for it
+ * for at most SetMaxWait(), and then outputs the block's tail as silence, see GetNumLateBlocks(). Otherwise the output is the same as a
+ * single WDL_ConvolutionEngine_Div's, within rounding.
+ * The worker runs at realtime priority where the platform allows it, see SetCurrentThreadRealtimePriority(), and is woken with a
+ * RealtimeSemaphore, so the audio thread never locks and only makes a system call if the worker has blocked.
+ * Add() and Avail() do not lock, and only allocate when the channel count changes or the WDL queues grow. */
+class ThreadedConvolutionEngine final
+{
+public:
+  /** Impulses no longer than kMinTailBlockSize * 2 are convolved on the calling thread only */
+  static constexpr int kMinTailBlockSize = 512;
+
+  /** The number of tail blocks that can be in flight between the audio thread and the worker */
+  static constexpr int kNumSlots = 4;
+
+  /** Number of spin iterations the worker waits for a new block before it blocks */
+  static constexpr int kWorkerSpinCount = 2000;
+
+  /** No block */
+  static constexpr uint32_t kNoBlock = ~0u;
+
+  ThreadedConvolutionEngine()
+  {
+    for (auto& slotBlock : mSlotBlocks)
+      slotBlock.store(kNoBlock, std::memory_order_relaxed);
+
+    mWorker = std::thread([this]() { WorkerLoop(); });
+  }
+
+  ~ThreadedConvolutionEngine()
+  {
+    mQuit.store(true, std::memory_order_relaxed);
+    mWake.Signal();
+    mWorker.join();
+
+    mOutput.Empty(true);
+    mTailOutput.Empty(true);
+  }
+
+  ThreadedConvolutionEngine(const ThreadedConvolutionEngine&) = delete;
+  ThreadedConvolutionEngine& operator=(const ThreadedConvolutionEngine&) = delete;
+
+  /** Set the impulse. This allocates and must not be called while Add()/Avail() may be running on another thread
+   * @param impulse The impulse response
+   * @param knownBlockSize The largest block size that will be passed to Add(). Tail blocks are at least this long,
+   * since the worker needs one whole callback between receiving a block and its deadline
+   * @param tailBlockSize The smallest partition size of the tail, rounded up to a power of two. Bigger blocks leave the worker
+   * more time, but make the head, which runs on the audio thread, longer. 0 picks a size from knownBlockSize
+   * @param nChans The number of channels that will be passed to Add()
+   * @return The latency, always 0 */
+  int SetImpulse(WDL_ImpulseBuffer* impulse, int knownBlockSize = DEFAULT_BLOCK_SIZE, int tailBlockSize = 0, int nChans = 2)
+  {
+    WaitForWorker();
+
+    int blockSize = kMinTailBlockSize;
+
+    while (blockSize < std::max(knownBlockSize, tailBlockSize))
+      blockSize *= 2;
+
+    mTailBlockSize = blockSize;
+    mHeadLength = 2 * blockSize;
+    mHasTail = impulse->GetLength() > mHeadLength;
+
+    mHead.SetImpulse(impulse, 0, knownBlockSize, mHasTail ? mHeadLength : 0);
+
+    if (mHasTail)
+      mTail.SetImpulse(impulse, 0, mTailBlockSize, 0, mHeadLength, mTailBlockSize);
+
+    Configure(nChans);
+    return 0;
+  }
+
+  int GetLatency() const { return 0; }
+
+  /** @return The partition size of the tail, which is also the worker's deadline, in samples */
+  int TailBlockSize() const { return mTailBlockSize; }
+
+  /** @return The number of tail blocks since the last Reset() that were output as silence, because the worker had not finished them
+   * within SetMaxWait() of their deadline, or had fallen so far behind that their input could not be handed to it */
+  int GetNumLateBlocks() const { return mNumLateBlocks; }
+
+  /** Set how long the audio thread waits for the worker to finish a tail block that is due, before it outputs the block as silence
+   * @param microseconds The longest wait. The default is 200 */
+  void SetMaxWait(double microseconds) { mMaxWait = microseconds / 1000000.; }
+
+  /** Clear all latent samples. Must not be called while Add()/Avail() may be running on another thread */
+  void Reset()
+  {
+    WaitForWorker();
+    mHead.Reset();
+    mTail.Reset();
+    Configure(mNChans);
+  }
+
+  void Add(WDL_FFT_REAL** bufs, int len, int nch)
+  {
+    if (nch != mNChans)
+    {
+      WaitForWorker();
+      mTail.Reset();
+      Configure(nch);
+    }
+
+    mHead.Add(bufs, len, nch);
+
+    if (!mHasTail)
+      return;
+
+    int pos = 0;
+
+    while (pos < len)
+    {
+      const uint32_t block = mSubmitted.load(std::memory_order_relaxed);
+
+      // Don't overwrite a slot that the worker may still be reading
+      while (block - mCollected >= kNumSlots)
+        CollectBlock();
+
+      // The worker may still be reading the slot's input, if it is so far behind that blocks were output as silence. Then the
+      // block's input is dropped, and the worker convolves silence in its place, so that the tail stays in time
+      if (mFill == 0)
+      {
+        mSlotWritable = block - mConsumed.load(std::memory_order_acquire) < kNumSlots;
+
+        if (!mSlotWritable)
+          mNumLateBlocks++;
+      }
+
+      const int n = std::min(len - pos, mTailBlockSize - mFill);
+      WDL_FFT_REAL* pSlot = mSlotInputs.Get() + (SlotOffset(block) * mNChans);
+
+      for (auto c = 0; c < nch && mSlotWritable; c++)
+      {
+        WDL_FFT_REAL* pDst = pSlot + (c * mTailBlockSize) + mFill;
+
+        if (bufs && bufs[c])
+          memcpy(pDst, bufs[c] + pos, n * sizeof(WDL_FFT_REAL));
+        else
+          memset(pDst, 0, n * sizeof(WDL_FFT_REAL));
+      }
+
+      mFill += n;
+      pos += n;
+
+      if (mFill == mTailBlockSize)
+      {
+        mFill = 0;
+
+        if (mSlotWritable)
+          mSlotBlocks[block % kNumSlots].store(block, std::memory_order_relaxed);
+
+        mSubmitted.store(block + 1, std::memory_order_release);
+        mWake.Signal();
+      }
+    }
+  }
+
+  int Avail(int wantSamples)
+  {
+    int n = mHead.Avail(wantSamples);
+
+    if (n <= 0)
+      return OutputAvailable(wantSamples);
+
+    if (mHasTail)
+    {
+      // Collect tail blocks that are done, and wait for any that are due
+      while (mCollected != mSubmitted.load(std::memory_order_relaxed) && IsCompleted(mCollected))
+        CollectBlock();
+
+      while (TailAvailable() < n && mCollected != mSubmitted.load(std::memory_order_relaxed))
+        CollectBlock();
+
+      // Only if Add() was called with blocks longer than knownBlockSize without the output being consumed
+      n = std::min(n, TailAvailable());
+    }
+
+    WDL_FFT_REAL** pHead = mHead.Get();
+    const int nBytes = n * static_cast<int>(sizeof(WDL_FFT_REAL));
+
+    for (auto c = 0; c < mNChans; c++)
+    {
+      WDL_FFT_REAL* pDst = static_cast<WDL_FFT_REAL*>(mOutput.Get(c)->Add(nullptr, nBytes));
+
+      if (!pDst)
+        continue;
+
+      memcpy(pDst, pHead[c], nBytes);
+
+      if (mHasTail)
+      {
+        WDL_Queue* pTail = mTailOutput.Get(c);
+        const WDL_FFT_REAL* pSrc = static_cast<const WDL_FFT_REAL*>(pTail->Get());
+
+        for (auto s = 0; s < n; s++)
+          pDst[s] += pSrc[s];
+
+        pTail->Advance(nBytes);
+        pTail->Compact();
+      }
+    }
+
+    mHead.Advance(n);
+    return OutputAvailable(wantSamples);
+  }
+
+  WDL_FFT_REAL** Get()
+  {
+    WDL_FFT_REAL** ret = mGetPtrs.Get();
+
+    for (auto c = 0; c < mNChans; c++)
+      ret[c] = static_cast<WDL_FFT_REAL*>(mOutput.Get(c)->Get());
+
+    return ret;
+  }
+
+  void Advance(int len)
+  {
+    for (auto c = 0; c < mNChans; c++)
+    {
+      WDL_Queue* pQueue = mOutput.Get(c);
+      pQueue->Advance(len * sizeof(WDL_FFT_REAL));
+      pQueue->Compact();
+    }
+  }
+
+private:
+  int SlotOffset(uint32_t block) const { return static_cast<int>(block % kNumSlots) * mTailBlockSize; }
+
+  int TailAvailable() const
+  {
+    return static_cast<int>(mTailOutput.Get(0)->Available() / sizeof(WDL_FFT_REAL));
+  }
+
+  int OutputAvailable(int wantSamples) const
+  {
+    const int av = mNChans ? static_cast<int>(mOutput.Get(0)->Available() / sizeof(WDL_FFT_REAL)) : 0;
+    return std::min(av, wantSamples);
+  }
+
+  /** @return \c true if the worker has finished the block. Blocks that were output as silence can be ahead of the worker */
+  bool IsCompleted(uint32_t block) const
+  {
+    return static_cast<int32_t>(mCompleted.load(std::memory_order_acquire) - block) > 0;
+  }
+
+  /** Move the oldest submitted tail block's output to the tail output queues, waiting up to mMaxWait for the worker if needed,
+   * or add silence if it is still not done */
+  void CollectBlock()
+  {
+    if (!IsCompleted(mCollected))
+    {
+      const auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>(mMaxWait);
+
+      for (auto i = 0; !IsCompleted(mCollected); i++)
+      {
+        IPLUG_SPIN_PAUSE();
+
+        if (i % 64 == 0 && std::chrono::steady_clock::now() > deadline)
+          break;
+      }
+    }
+
+    const WDL_FFT_REAL* pSlot = mSlotOutputs.Get() + (SlotOffset(mCollected) * mNChans);
+    const bool late = !IsCompleted(mCollected);
+    const int nBytes = mTailBlockSize * static_cast<int>(sizeof(WDL_FFT_REAL));
+
+    for (auto c = 0; c < mNChans; c++)
+    {
+      if (late)
+        memset(mTailOutput.Get(c)->Add(nullptr, nBytes), 0, nBytes);
+      else
+        mTailOutput.Get(c)->Add(pSlot + (c * mTailBlockSize), nBytes);
+    }
+
+    if (late)
+      mNumLateBlocks++;
+
+    mCollected++;
+  }
+
+  /** Wait until the worker has finished every submitted block, so that the tail engine and slots can be changed */
+  void WaitForWorker()
+  {
+    while (mCompleted.load(std::memory_order_acquire) != mSubmitted.load(std::memory_order_acquire))
+      std::this_thread::yield();
+  }
+
+  /** Allocate the slots and queues for nch channels and rewind the handoff. The worker must be idle */
+  void Configure(int nch)
+  {
+    mNChans = nch;
+    mSlotInputs.Resize(kNumSlots * mTailBlockSize * nch);
+    mSlotOutputs.Resize(kNumSlots * mTailBlockSize * nch);
+    mGetPtrs.Resize(nch);
+    mSilence.Resize(mTailBlockSize);
+    memset(mSilence.Get(), 0, mTailBlockSize * sizeof(WDL_FFT_REAL));
+
+    while (mOutput.GetSize() < nch) mOutput.Add(new WDL_Queue);
+    while (mOutput.GetSize() > nch) mOutput.Delete(mOutput.GetSize() - 1, true);
+    while (mTailOutput.GetSize() < nch) mTailOutput.Add(new WDL_Queue);
+    while (mTailOutput.GetSize() > nch) mTailOutput.Delete(mTailOutput.GetSize() - 1, true);
+
+    const int nBytes = mHeadLength * static_cast<int>(sizeof(WDL_FFT_REAL));
+
+    for (auto c = 0; c < nch; c++)
+    {
+      mOutput.Get(c)->Clear();
+      mTailOutput.Get(c)->Clear();
+
+      // The tail output is for the input mHeadLength samples ago
+      if (mHasTail)
+        memset(mTailOutput.Get(c)->Add(nullptr, nBytes), 0, nBytes);
+    }
+
+    mFill = 0;
+    mSlotWritable = true;
+    mCollected = 0;
+    mNumLateBlocks = 0;
+
+    for (auto& slotBlock : mSlotBlocks)
+      slotBlock.store(kNoBlock, std::memory_order_relaxed);
+
+    mConsumed.store(0, std::memory_order_relaxed);
+    mCompleted.store(0, std::memory_order_relaxed);
+    mSubmitted.store(0, std::memory_order_release);
+  }
+
+  void WorkerLoop()
+  {
+    SetCurrentThreadRealtimePriority();
+    WDL_TypedBuf<WDL_FFT_REAL*> inputPtrs;
+
+    while (true)
+    {
+      auto i = 0;
+
+      while (i < kWorkerSpinCount && !mWake.TryWait())
+      {
+        IPLUG_SPIN_PAUSE();
+        i++;
+      }
+
+      if (i == kWorkerSpinCount)
+        mWake.Wait();
+
+      if (mQuit.load(std::memory_order_relaxed))
+        return;
+
+      const uint32_t submitted = mSubmitted.load(std::memory_order_acquire);
+
+      // Configure() rewinds the counters while the worker is idle, so only ever step forwards from mCompleted
+      for (uint32_t block = mCompleted.load(std::memory_order_relaxed); block != submitted; block++)
+      {
+        const int offset = SlotOffset(block) * mNChans;
+        const bool hasInput = mSlotBlocks[block % kNumSlots].load(std::memory_order_relaxed) == block;
+        WDL_FFT_REAL** ppIn = inputPtrs.ResizeOK(mNChans, false);
+
+        for (auto c = 0; c < mNChans; c++)
+          ppIn[c] = hasInput ? mSlotInputs.Get() + offset + (c * mTailBlockSize) : mSilence.Get();
+
+        // the tail engine copies the input, so the slot can be reused from here on
+        mTail.Add(ppIn, mTailBlockSize, mNChans);
+        mConsumed.store(block + 1, std::memory_order_release);
+
+        const int n = mTail.Avail(mTailBlockSize);
+        WDL_FFT_REAL** ppOut = mTail.Get();
+        WDL_FFT_REAL* pSlot = mSlotOutputs.Get() + offset;
+
+        for (auto c = 0; c < mNChans; c++)
+        {
+          if (n == mTailBlockSize)
+            memcpy(pSlot + (c * mTailBlockSize), ppOut[c], n * sizeof(WDL_FFT_REAL));
+          else
+            memset(pSlot + (c * mTailBlockSize), 0, mTailBlockSize * sizeof(WDL_FFT_REAL));
+        }
+
+        mTail.Advance(n);
+        mCompleted.store(block + 1, std::memory_order_release);
+      }
+    }
+  }
+
+  WDL_ConvolutionEngine_Div mHead;
+  WDL_ConvolutionEngine_Div mTail; // only touched by the worker while blocks are in flight
+  WDL_TypedBuf<WDL_FFT_REAL> mSlotInputs, mSlotOutputs; // kNumSlots blocks of nChans * mTailBlockSize
+  WDL_TypedBuf<WDL_FFT_REAL> mSilence; // mTailBlockSize zeros, the worker's input for a block that was dropped
+  WDL_PtrList<WDL_Queue> mOutput, mTailOutput;
+  WDL_TypedBuf<WDL_FFT_REAL*> mGetPtrs;
+  int mTailBlockSize = kMinTailBlockSize;
+  int mHeadLength = 2 * kMinTailBlockSize;
+  int mNChans = 0;
+  int mFill = 0; // samples in the slot being filled
+  int mNumLateBlocks = 0;
+  double mMaxWait = 0.0002; // seconds
+  bool mHasTail = false;
+  bool mSlotWritable = true; // false if the input of the block being filled is dropped, audio thread only
+  uint32_t mCollected = 0; // blocks whose output, or silence, has been moved to mTailOutput, audio thread only
+  std::atomic<uint32_t> mSlotBlocks[kNumSlots]; // the block whose input each slot holds
+  std::atomic<uint32_t> mSubmitted{0};
+  std::atomic<uint32_t> mConsumed{0}; // blocks whose input the worker has taken from its slot
+  std::atomic<uint32_t> mCompleted{0};
+  std::atomic<bool> mQuit{false};
+  RealtimeSemaphore mWake; // signalled for each submitted block
+  std::thread mWorker;
+};
+
+END_IPLUG_NAMESPACE
@@ -0,0 +1,488 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @brief Band-limited wavetable oscillators, built on the same table lookup idea as FastSinOscillator.
+ * A Wavetable holds one single-cycle waveform as a mipmap of band-limited tables, one per octave, so that an oscillator
+ * can always pick a table whose highest harmonic is below Nyquist. Tables for the basic shapes are built once and shared.
+ * Define IPLUG_SIMDE at project level in order to render four samples at a time with SSE2 instructions (eight with
+ * AVX2 gathers, if the compiler targets AVX2), and if on non-x86_64 include the SIMDE library in your search paths in
+ * order to translate intel intrinsics to e.g. arm64.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#if defined IPLUG_SIMDE
+  #if defined(__arm64__)
+    #define SIMDE_ENABLE_NATIVE_ALIASES
+    #include "simde/x86/sse2.h"
+  #elif defined(__AVX2__)
+    #include <immintrin.h>
+  #else
+    #include <emmintrin.h>
+  #endif
+#endif
+
+#include "IPlugUtilities.h"
+#include "Oscillator.h"
+
+BEGIN_IPLUG_NAMESPACE
+
+/** A single-cycle waveform, stored as per-octave mipmapped band-limited tables.
+ * Level 0 holds up to kMaxHarmonics harmonics in an 8192 sample table, each following level halves both the number of
+ * harmonics and (down to 256 samples) the table size, which keeps the table at least eight times oversampled for linear interpolation.
+ * Tables are float, whatever the sample type of the oscillator, to keep them small in the cache */
+class Wavetable
+{
+public:
+  static constexpr int kLog2BaseSize = 13; // 8192 samples at level 0
+  static constexpr int kMinLog2Size = 8; // 256 samples
+  static constexpr int kLog2Oversampling = 3; // table size / highest harmonic
+  static constexpr int kMaxHarmonics = 1 << (kLog2BaseSize - kLog2Oversampling);
+  static constexpr int kNumLevels = kLog2BaseSize - kLog2Oversampling + 1; // kMaxHarmonics harmonics down to 1
+
+  enum EShape
+  {
+    kSine,
+    kTriangle,
+    kSaw,
+    kSquare,
+    kNumShapes
+  };
+
+  Wavetable() = default;
+
+  /** Builds the tables from a harmonic series, x(t) = dc + sum of pCos[h-1] * cos(2 pi h t) + pSin[h-1] * sin(2 pi h t). Allocates.
+   * @param pCos nHarmonics cosine amplitudes, starting from the fundamental, or nullptr
+   * @param pSin nHarmonics sine amplitudes, starting from the fundamental, or nullptr
+   * @param nHarmonics The number of harmonics. Harmonics above kMaxHarmonics are ignored
+   * @param dc The DC offset */
+  void SetHarmonics(const double* pCos, const double* pSin, int nHarmonics, double dc = 0.)
+  {
+    nHarmonics = std::min(nHarmonics, kMaxHarmonics);
+    mCos.assign(nHarmonics, 0.);
+    mSin.assign(nHarmonics, 0.);
+
+    for (auto h = 0; h < nHarmonics; h++)
+    {
+      if (pCos) mCos[h] = pCos[h];
+      if (pSin) mSin[h] = pSin[h];
+    }
+
+    mDC = dc;
+    BuildLevels();
+  }
+
+  /** Builds the tables from one cycle of a waveform, e.g. a user wavetable. The harmonics are found with a DFT, so any
+   * length will do, but only nSamples / 2 - 1 harmonics can be recovered. Allocates, and is O(nSamples * harmonics)
+   * @param pSamples One cycle of the waveform
+   * @param nSamples The length of the cycle */
+  template<typename S>
+  void LoadFromBuffer(const S* pSamples, int nSamples)
+  {
+    const int nHarmonics = std::max(0, std::min(nSamples / 2 - 1, static_cast<int>(kMaxHarmonics)));
+    std::vector<double> sinTable(nSamples);
+    std::vector<double> cosAmps(nHarmonics), sinAmps(nHarmonics);
+
+    for (auto i = 0; i < nSamples; i++)
+      sinTable[i] = std::sin(2. * PI * i / nSamples);
+
+    double dc = 0.;
+
+    for (auto i = 0; i < nSamples; i++)
+      dc += pSamples[i];
+
+    for (auto h = 1; h <= nHarmonics; h++)
+    {
+      double a = 0., b = 0.;
+      long sinIdx = 0; // h * i mod nSamples
+      long cosIdx = nSamples / 4; // cos(x) == sin(x + pi / 2), exact when nSamples is a multiple of 4
+      const bool exactCos = (nSamples % 4) == 0;
+
+      for (auto i = 0; i < nSamples; i++)
+      {
+        const double x = static_cast<double>(pSamples[i]);
+        b += x * sinTable[sinIdx];
+        a += x * (exactCos ? sinTable[cosIdx] : std::cos(2. * PI * h * i / nSamples));
+        sinIdx += h; if (sinIdx >= nSamples) sinIdx -= nSamples;
+        cosIdx += h; if (cosIdx >= nSamples) cosIdx -= nSamples;
+      }
+
+      cosAmps[h-1] = 2. * a / nSamples;
+      sinAmps[h-1] = 2. * b / nSamples;
+    }
+
+    SetHarmonics(cosAmps.data(), sinAmps.data(), nHarmonics, dc / nSamples);
+  }
+
+  /** Get a shared, band-limited table for a basic shape, built on first use. Call this from a constructor rather than
+   * on the audio thread, so that building the tables does not cost a block */
+  static const Wavetable& GetShape(EShape shape)
+  {
+    switch (shape)
+    {
+      case kSine: { static const Wavetable sTable = MakeShape(kSine); return sTable; }
+      case kTriangle: { static const Wavetable sTable = MakeShape(kTriangle); return sTable; }
+      case kSquare: { static const Wavetable sTable = MakeShape(kSquare); return sTable; }
+      case kSaw:
+      default: { static const Wavetable sTable = MakeShape(kSaw); return sTable; }
+    }
+  }
+
+  /** @return The mip level to use for a phase increment in cycles per sample: the first level whose highest harmonic is below Nyquist */
+  static int GetLevelForIncrement(double phaseIncr)
+  {
+    const double x = std::fabs(phaseIncr) * (2 * kMaxHarmonics);
+
+    if (x <= 1.)
+      return 0;
+
+    // ceil(log2(x)), exactly: x = m * 2^e with m in [0.5, 1), so log2(x) is e - 1 when m is 0.5 and between e - 1 and e otherwise
+    int e = 0;
+    const double m = std::frexp(x, &e);
+
+    return std::min(m == 0.5 ? e - 1 : e, kNumLevels - 1);
+  }
+
+  /** @return The table of a mip level, GetLevelSize(level) samples plus a copy of the first sample at the end */
+  const float* GetLevel(int level) const { return mTables.data() + mLevelOffsets[level]; }
+
+  static int GetLevelLog2Size(int level) { return std::max(kLog2BaseSize - level, static_cast<int>(kMinLog2Size)); }
+
+  static int GetLevelSize(int level) { return 1 << GetLevelLog2Size(level); }
+
+  static int GetLevelHarmonics(int level) { return kMaxHarmonics >> level; }
+
+  bool IsEmpty() const { return mTables.empty(); }
+
+private:
+  static Wavetable MakeShape(EShape shape)
+  {
+    std::vector<double> sinAmps(kMaxHarmonics, 0.);
+
+    for (auto h = 1; h <= kMaxHarmonics; h++)
+    {
+      const bool odd = (h & 1) != 0;
+
+      switch (shape)
+      {
+        case kSine: sinAmps[h-1] = (h == 1) ? 1. : 0.; break;
+        case kTriangle: sinAmps[h-1] = odd ? (8. / (PI * PI)) * (((h - 1) / 2) & 1 ? -1. : 1.) / (h * h) : 0.; break;
+        case kSquare: sinAmps[h-1] = odd ? 4. / (PI * h) : 0.; break;
+        case kSaw: // rising from -1 to 1
+        default: sinAmps[h-1] = -2. / (PI * h); break;
+      }
+    }
+
+    Wavetable table;
+    table.SetHarmonics(nullptr, sinAmps.data(), kMaxHarmonics);
+    return table;
+  }
+
+  /** Additive synthesis of every level, using a sine table of the level size so that each partial is a table read */
+  void BuildLevels()
+  {
+    int totalSize = 0;
+
+    for (auto level = 0; level < kNumLevels; level++)
+    {
+      mLevelOffsets[level] = totalSize;
+      totalSize += GetLevelSize(level) + 1;
+    }
+
+    mTables.assign(totalSize, 0.f);
+
+    const int nHarmonics = static_cast<int>(mCos.size());
+    std::vector<double> sinTable, sum;
+
+    for (auto level = 0; level < kNumLevels; level++)
+    {
+      const int size = GetLevelSize(level);
+      const int mask = size - 1;
+      const int maxHarmonic = std::min(GetLevelHarmonics(level), nHarmonics);
+
+      sinTable.resize(size);
+      sum.assign(size, mDC);
+
+      for (auto i = 0; i < size; i++)
+        sinTable[i] = std::sin(2. * PI * i / size);
+
+      for (auto h = 1; h <= maxHarmonic; h++)
+      {
+        const double a = mCos[h-1];
+        const double b = mSin[h-1];
+
+        if (a == 0. && b == 0.)
+          continue;
+
+        for (auto i = 0; i < size; i++)
+        {
+          const int idx = (h * i) & mask;
+          sum[i] += a * sinTable[(idx + size / 4) & mask] + b * sinTable[idx];
+        }
+      }
+
+      float* pTable = mTables.data() + mLevelOffsets[level];
+
+      for (auto i = 0; i < size; i++)
+        pTable[i] = static_cast<float>(sum[i]);
+
+      pTable[size] = pTable[0];
+    }
+  }
+
+  std::vector<float> mTables;
+  std::vector<double> mCos, mSin;
+  double mDC = 0.;
+  int mLevelOffsets[kNumLevels] = {};
+};
+
+/** Renders a wavetable with a 32 bit fixed point phase, so that wrapping is free and the table index is a shift */
+template <typename T>
+class WavetableKernel
+{
+public:
+  /** @return A phase increment in cycles per sample as a 32 bit fixed point phase increment */
+  static inline uint32_t ToFixedPhase(double phase)
+  {
+    phase -= std::floor(phase);
+    return static_cast<uint32_t>(static_cast<int64_t>(phase * 4294967296.));
+  }
+
+  static inline double FromFixedPhase(uint32_t phase)
+  {
+    return phase * (1. / 4294967296.);
+  }
+
+  /** Renders (or adds, if Accumulate) nFrames of gain * table into pOutput, advancing phase */
+  template<bool Accumulate>
+  static void Render(const Wavetable& table, int level, uint32_t& phase, uint32_t phaseIncr, float gain, T* pOutput, int nFrames)
+  {
+    const float* pTable = table.GetLevel(level);
+    const int fracBits = 32 - Wavetable::GetLevelLog2Size(level);
+    const uint32_t fracMask = (1u << fracBits) - 1u;
+    const float fracScale = 1.f / static_cast<float>(1u << fracBits);
+    int s = 0;
+
+#if defined IPLUG_SIMDE
+  #if defined(__AVX2__) && !defined(__arm64__)
+    const __m128i shift = _mm_cvtsi32_si128(fracBits);
+    const __m256i vFracMask = _mm256_set1_epi32(static_cast<int>(fracMask));
+    const __m256 vFracScale = _mm256_set1_ps(fracScale);
+    const __m256 vGain = _mm256_set1_ps(gain);
+    const __m256i step = _mm256_set1_epi32(static_cast<int>(phaseIncr * 8u));
+    __m256i phases = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(phase)), _mm256_mullo_epi32(_mm256_set1_epi32(static_cast<int>(phaseIncr)), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7)));
+
+    for (; s + 8 <= nFrames; s += 8)
+    {
+      const __m256i idx = _mm256_srl_epi32(phases, shift);
+      const __m256 a = _mm256_i32gather_ps(pTable, idx, 4);
+      const __m256 b = _mm256_i32gather_ps(pTable + 1, idx, 4);
+      const __m256 frac = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(phases, vFracMask)), vFracScale);
+      const __m256 y = _mm256_mul_ps(vGain, _mm256_add_ps(a, _mm256_mul_ps(frac, _mm256_sub_ps(b, a))));
+      Store<Accumulate>(pOutput + s, _mm256_castps256_ps128(y));
+      Store<Accumulate>(pOutput + s + 4, _mm256_extractf128_ps(y, 1));
+      phases = _mm256_add_epi32(phases, step);
+    }
+  #else
+    const __m128i shift = _mm_cvtsi32_si128(fracBits);
+    const __m128i vFracMask = _mm_set1_epi32(static_cast<int>(fracMask));
+    const __m128 vFracScale = _mm_set1_ps(fracScale);
+    const __m128 vGain = _mm_set1_ps(gain);
+    const __m128i step = _mm_set1_epi32(static_cast<int>(phaseIncr * 4u));
+    __m128i phases = _mm_set_epi32(static_cast<int>(phase + 3u * phaseIncr), static_cast<int>(phase + 2u * phaseIncr), static_cast<int>(phase + phaseIncr), static_cast<int>(phase));
+    alignas(16) int32_t idx[4];
+
+    for (; s + 4 <= nFrames; s += 4)
+    {
+      _mm_store_si128(reinterpret_cast<__m128i*>(idx), _mm_srl_epi32(phases, shift));
+      const __m128 a = _mm_set_ps(pTable[idx[3]], pTable[idx[2]], pTable[idx[1]], pTable[idx[0]]);
+      const __m128 b = _mm_set_ps(pTable[idx[3] + 1], pTable[idx[2] + 1], pTable[idx[1] + 1], pTable[idx[0] + 1]);
+      const __m128 frac = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(phases, vFracMask)), vFracScale);
+      Store<Accumulate>(pOutput + s, _mm_mul_ps(vGain, _mm_add_ps(a, _mm_mul_ps(frac, _mm_sub_ps(b, a)))));
+      phases = _mm_add_epi32(phases, step);
+    }
+  #endif
+    phase += static_cast<uint32_t>(s) * phaseIncr;
+#endif
+
+    for (; s < nFrames; s++)
+    {
+      const float* pPoint = pTable + (phase >> fracBits);
+      const float frac = static_cast<float>(phase & fracMask) * fracScale;
+      const float y = gain * (pPoint[0] + frac * (pPoint[1] - pPoint[0]));
+
+      if (Accumulate)
+        pOutput[s] += static_cast<T>(y);
+      else
+        pOutput[s] = static_cast<T>(y);
+
+      phase += phaseIncr;
+    }
+  }
+
+private:
+#if defined IPLUG_SIMDE
+  template<bool Accumulate>
+  static inline void Store(float* pOutput, __m128 y)
+  {
+    _mm_storeu_ps(pOutput, Accumulate ? _mm_add_ps(_mm_loadu_ps(pOutput), y) : y);
+  }
+
+  template<bool Accumulate>
+  static inline void Store(double* pOutput, __m128 y)
+  {
+    const __m128d lo = _mm_cvtps_pd(y);
+    const __m128d hi = _mm_cvtps_pd(_mm_movehl_ps(y, y));
+    _mm_storeu_pd(pOutput, Accumulate ? _mm_add_pd(_mm_loadu_pd(pOutput), lo) : lo);
+    _mm_storeu_pd(pOutput + 2, Accumulate ? _mm_add_pd(_mm_loadu_pd(pOutput + 2), hi) : hi);
+  }
+#endif
+};
+
+/** A band-limited wavetable oscillator. The mip level is chosen from the frequency, once per block */
+template <typename T>
+class WavetableOscillator : public IOscillator<T>
+{
+public:
+  WavetableOscillator(const Wavetable& table = Wavetable::GetShape(Wavetable::kSaw), double startPhase = 0., double startFreq = 1.)
+  : IOscillator<T>(startPhase, startFreq)
+  , mTable(&table)
+  {
+  }
+
+  /** Set the wavetable. The oscillator keeps a pointer, so the table must outlive it */
+  void SetWavetable(const Wavetable& table) { mTable = &table; }
+
+  inline T Process(double freqHz) override
+  {
+    IOscillator<T>::SetFreqCPS(freqHz);
+
+    T output = 0.;
+    ProcessBlock(&output, 1);
+
+    return output;
+  }
+
+  void ProcessBlock(T* pOutput, int nFrames)
+  {
+    uint32_t phase = WavetableKernel<T>::ToFixedPhase(IOscillator<T>::mPhase);
+    const double phaseIncr = IOscillator<T>::mPhaseIncr;
+    WavetableKernel<T>::template Render<false>(*mTable, Wavetable::GetLevelForIncrement(phaseIncr), phase, WavetableKernel<T>::ToFixedPhase(phaseIncr), 1.f, pOutput, nFrames);
+    IOscillator<T>::mPhase = WavetableKernel<T>::FromFixedPhase(phase);
+  }
+
+private:
+  const Wavetable* mTable;
+};
+
+/** A bank of wavetable oscillators for a polyphonic synth, with unison: each voice is the sum of NUnison() detuned
+ * copies of the same table. A single call renders every voice into its own buffer */
+template <typename T>
+class WavetableOscillatorBank
+{
+public:
+  /** @param nVoices The number of voices
+   * @param maxUnison The largest unison count that will be passed to SetUnison(). Allocates */
+  WavetableOscillatorBank(int nVoices = 0, int maxUnison = 1, const Wavetable& table = Wavetable::GetShape(Wavetable::kSaw))
+  : mTable(&table)
+  {
+    Resize(nVoices, maxUnison);
+  }
+
+  /** Set the number of voices and the largest unison count. Allocates, so must not be called on the audio thread */
+  void Resize(int nVoices, int maxUnison)
+  {
+    mMaxUnison = std::max(maxUnison, 1);
+    mFreqHz.resize(nVoices, 440.);
+    mPhases.resize(nVoices * mMaxUnison, 0u);
+    mDetuneRatios.resize(mMaxUnison, 1.);
+    SetUnison(std::min(mNUnison, mMaxUnison), mDetuneCents);
+  }
+
+  int NVoices() const { return static_cast<int>(mFreqHz.size()); }
+
+  int NUnison() const { return mNUnison; }
+
+  void SetSampleRate(double sampleRate) { mSampleRate = sampleRate; }
+
+  /** Set the wavetable for all voices. The bank keeps a pointer, so the table must outlive it */
+  void SetWavetable(const Wavetable& table) { mTable = &table; }
+
+  /** Set the unison count and spread
+   * @param nUnison The number of oscillators per voice, at most the maxUnison passed to Resize()
+   * @param detuneCents The detune of the outermost oscillators, which are spread evenly in between */
+  void SetUnison(int nUnison, double detuneCents)
+  {
+    mNUnison = Clip(nUnison, 1, mMaxUnison);
+    mDetuneCents = detuneCents;
+    mUnisonGain = static_cast<float>(1. / std::sqrt(static_cast<double>(mNUnison)));
+
+    for (auto u = 0; u < mNUnison; u++)
+    {
+      const double spread = mNUnison > 1 ? (2. * u / (mNUnison - 1) - 1.) : 0.;
+      mDetuneRatios[u] = std::pow(2., spread * detuneCents / 1200.);
+    }
+  }
+
+  void SetFreqCPS(int voice, double freqHz) { mFreqHz[voice] = freqHz; }
+
+  /** Restart a voice. Unison oscillators are offset by the golden ratio so that they don't start in phase */
+  void ResetVoice(int voice, double phase = 0.)
+  {
+    for (auto u = 0; u < mMaxUnison; u++)
+      mPhases[voice * mMaxUnison + u] = WavetableKernel<T>::ToFixedPhase(phase + u * 0.6180339887498949);
+  }
+
+  /** Render a block of every voice
+   * @param outputs One buffer of nFrames per voice. Voices with a nullptr buffer are skipped and keep their phase */
+  void ProcessBlock(T** outputs, int nFrames)
+  {
+    const double freqToIncr = 1. / mSampleRate;
+
+    for (auto v = 0; v < NVoices(); v++)
+    {
+      if (!outputs[v])
+        continue;
+
+      for (auto u = 0; u < mNUnison; u++)
+      {
+        const double phaseIncr = mFreqHz[v] * mDetuneRatios[u] * freqToIncr;
+        uint32_t& phase = mPhases[v * mMaxUnison + u];
+        const int level = Wavetable::GetLevelForIncrement(phaseIncr);
+        const uint32_t fixedIncr = WavetableKernel<T>::ToFixedPhase(phaseIncr);
+
+        if (u == 0)
+          WavetableKernel<T>::template Render<false>(*mTable, level, phase, fixedIncr, mUnisonGain, outputs[v], nFrames);
+        else
+          WavetableKernel<T>::template Render<true>(*mTable, level, phase, fixedIncr, mUnisonGain, outputs[v], nFrames);
+      }
+    }
+  }
+
+private:
+  const Wavetable* mTable;
+  std::vector<double> mFreqHz;
+  std::vector<uint32_t> mPhases; // maxUnison per voice
+  std::vector<double> mDetuneRatios;
+  double mSampleRate = 44100.;
+  double mDetuneCents = 0.;
+  float mUnisonGain = 1.f;
+  int mNUnison = 1;
+  int mMaxUnison = 1;
+};
+
+END_IPLUG_NAMESPACE
@@ -24,6 +24,7 @@ using namespace iplug;
 
 IPlugAPIBase::IPlugAPIBase(Config c, EAPI plugAPI)
   : IPluginBase(c.nParams, c.nPresets)
+  , mParamChangeFromProcessor(c.nParams)
 {
   mUniqueID = c.uniqueID;
   mMfrID = c.mfrID;
@@ -136,7 +137,7 @@ void IPlugAPIBase::SendParameterValueFromAPI(int paramIdx, double value, bool no
   if (normalized)
     value = GetParam(paramIdx)->FromNormalized(value);
   
-  mParamChangeFromProcessor.PushFromArgs(paramIdx, value);
+  mParamChangeFromProcessor.Set(paramIdx, value);
 }
 
 void IPlugAPIBase::OnTimer(Timer& t)
@@ -145,6 +146,13 @@ void IPlugAPIBase::OnTimer(Timer& t)
   {
 // VST3 ********************************************************************************
 #if defined VST3P_API || defined VST3_API
+#if defined PARAMS_SNAPSHOT && !defined VST3P_API
+    // values set by ApplyParamSnapshot() on the audio thread
+    mParamChangeFromProcessor.ForEachChanged([&](int paramIdx, double value) {
+      SendParameterValueFromDelegate(paramIdx, value, false);
+    });
+#endif
+
     while (mMidiMsgsFromProcessor.ElementsAvailable())
     {
       IMidiMsg msg;
@@ -156,24 +164,20 @@ void IPlugAPIBase::OnTimer(Timer& t)
 #endif
     }
 
-    while (mSysExDataFromProcessor.ElementsAvailable())
+    while (const SysExData* pMsg = mSysExDataFromProcessor.BeginPop())
     {
-      SysExData msg;
-      mSysExDataFromProcessor.Pop(msg);
 #ifdef VST3P_API // distributed
-      TransmitSysExDataFromProcessor(msg);
+      TransmitSysExDataFromProcessor(*pMsg);
 #else
-      SendSysexMsgFromDelegate({msg.mOffset, msg.mData, msg.mSize});
+      SendSysexMsgFromDelegate({pMsg->mOffset, pMsg->mData, pMsg->mSize});
 #endif
+      mSysExDataFromProcessor.EndPop();
     }
 // !VST3 ******************************************************************************
 #else
-    while(mParamChangeFromProcessor.ElementsAvailable())
-    {
-      ParamTuple p;
-      mParamChangeFromProcessor.Pop(p);
-      SendParameterValueFromDelegate(p.idx, p.value, false);
-    }
+    mParamChangeFromProcessor.ForEachChanged([&](int paramIdx, double value) {
+      SendParameterValueFromDelegate(paramIdx, value, false);
+    });
     
     while (mMidiMsgsFromProcessor.ElementsAvailable())
     {
@@ -182,11 +186,10 @@ void IPlugAPIBase::OnTimer(Timer& t)
       SendMidiMsgFromDelegate(msg);
     }
     
-    while (mSysExDataFromProcessor.ElementsAvailable())
+    while (const SysExData* pMsg = mSysExDataFromProcessor.BeginPop())
     {
-      SysExData msg;
-      mSysExDataFromProcessor.Pop(msg);
-      SendSysexMsgFromDelegate({msg.mOffset, msg.mData, msg.mSize});
+      SendSysexMsgFromDelegate({pMsg->mOffset, pMsg->mData, pMsg->mSize});
+      mSysExDataFromProcessor.EndPop();
     }
 #endif
   }
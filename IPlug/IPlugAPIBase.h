@@ -24,6 +24,7 @@
 #include "IPlugUtilities.h"
 #include "IPlugParameter.h"
 #include "IPlugQueue.h"
+#include "IPlugParamCoalescer.h"
 #include "IPlugTimer.h"
 
 /**
@@ -211,6 +212,10 @@ private:
 
   void OnTimer(Timer& t);
 
+#ifdef PARAMS_SNAPSHOT
+  void OnParamSnapshotValueApplied(int paramIdx, double value) override { mParamChangeFromProcessor.Set(paramIdx, value); }
+#endif
+
   friend class IPlugAPP;
   friend class IPlugAAX;
   friend class IPlugAU;
@@ -227,7 +232,7 @@ private:
   WDL_String mParamDisplayStr;
   std::unique_ptr<Timer> mTimer;
   
-  IPlugQueue<ParamTuple> mParamChangeFromProcessor {PARAM_TRANSFER_SIZE};
+  IParamCoalescer mParamChangeFromProcessor; // latest value of each parameter changed by the host, to send to the editor
   IPlugQueue<IMidiMsg> mMidiMsgsFromEditor {MIDI_TRANSFER_SIZE}; // a queue of midi messages generated in the editor by clicking keyboard UI etc
   IPlugQueue<IMidiMsg> mMidiMsgsFromProcessor {MIDI_TRANSFER_SIZE}; // a queue of MIDI messages received (potentially on the high priority thread), by the processor to send to the editor
   IPlugQueue<SysExData> mSysExDataFromEditor {SYSEX_TRANSFER_SIZE}; // a queue of SYSEX data to send to the processor
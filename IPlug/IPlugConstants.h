@@ -115,6 +115,10 @@ static const int MAX_PARAM_DISPLAY_PRECISION = 6;
 #define MAX_SYSEX_SIZE 512
 #endif
 
+#ifndef MAX_PARAM_EVENTS_PER_BLOCK
+#define MAX_PARAM_EVENTS_PER_BLOCK 1024 // the maximum number of timestamped parameter changes held for sample accurate automation
+#endif
+
 #define PARAM_TRANSFER_SIZE 512
 #define MIDI_TRANSFER_SIZE 32
 #define SYSEX_TRANSFER_SIZE 4
@@ -0,0 +1,97 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc IParamCoalescer
+ */
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "IPlugPlatform.h"
+
+BEGIN_IPLUG_NAMESPACE
+
+/** Transfers parameter changes from the realtime audio thread (or any other thread) to the main thread, keeping only the latest value of each parameter.
+ * Each parameter has an atomic value and a dirty bit. Set() stores the value and sets the bit, which is wait-free and O(1) and can never overflow
+ * like a queue can. The main thread calls ForEachChanged(), which only visits words of the dirty bitmap that have bits set,
+ * and reports each changed parameter once, with its most recent value, however many times it changed since the last call.
+ * Any number of threads can call Set(), ForEachChanged() must only be called from one thread */
+class IParamCoalescer final
+{
+public:
+  IParamCoalescer(int nParams = 0)
+  {
+    Resize(nParams);
+  }
+
+  IParamCoalescer(const IParamCoalescer&) = delete;
+  IParamCoalescer& operator=(const IParamCoalescer&) = delete;
+
+  /** Allocate storage for nParams parameters, clearing any pending changes. Must not be called while other threads are using the object
+   * @param nParams The number of parameters */
+  void Resize(int nParams)
+  {
+    mValues = std::vector<std::atomic<double>>(nParams);
+    mDirty = std::vector<std::atomic<uint32_t>>((nParams + kBitsPerWord - 1) / kBitsPerWord);
+
+    for (auto& value : mValues)
+      value.store(0., std::memory_order_relaxed);
+
+    for (auto& word : mDirty)
+      word.store(0, std::memory_order_relaxed);
+  }
+
+  /** Record the latest value of a parameter. Can be called from any thread, including the realtime audio thread
+   * @param paramIdx The parameter index
+   * @param value The new (non-normalized) value */
+  void Set(int paramIdx, double value)
+  {
+    mValues[paramIdx].store(value, std::memory_order_relaxed);
+    mDirty[paramIdx / kBitsPerWord].fetch_or(1u << (paramIdx % kBitsPerWord), std::memory_order_release);
+  }
+
+  /** Visit every parameter that has changed since the last call, clearing its dirty bit. Call from a single consumer thread
+   * @param func Called as func(int paramIdx, double value) for each changed parameter, in parameter order */
+  template <typename F>
+  void ForEachChanged(F func)
+  {
+    const int nWords = static_cast<int>(mDirty.size());
+
+    for (auto w = 0; w < nWords; w++)
+    {
+      if (!mDirty[w].load(std::memory_order_relaxed))
+        continue;
+
+      uint32_t bits = mDirty[w].exchange(0, std::memory_order_acquire);
+
+      for (auto b = 0; bits; b++, bits >>= 1)
+      {
+        if (bits & 1u)
+        {
+          const int paramIdx = (w * kBitsPerWord) + b;
+          func(paramIdx, mValues[paramIdx].load(std::memory_order_relaxed));
+        }
+      }
+    }
+  }
+
+private:
+  static constexpr int kBitsPerWord = 32;
+
+  std::vector<std::atomic<double>> mValues;
+  std::vector<std::atomic<uint32_t>> mDirty;
+};
+
+END_IPLUG_NAMESPACE
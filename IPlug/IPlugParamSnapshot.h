@@ -0,0 +1,162 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+/**
+ * @file
+ * @copydoc IParamSnapshot
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+
+#include "heapbuf.h"
+#include "mutex.h"
+
+#include "IPlugPlatform.h"
+
+BEGIN_IPLUG_NAMESPACE
+
+/** A wait-free triple buffer of parameter values, used to hand a complete set of parameter values (e.g. a recalled preset)
+ * from a non-realtime thread to the realtime audio thread without the audio thread ever taking a lock.
+ * The writer fills the back buffer and publishes it by swapping it with the middle buffer. The reader swaps the middle buffer
+ * with the front buffer only if something new has been published. Neither side ever waits for the other, and the reader always sees
+ * a complete, consistent set of values.
+ * Multiple writer threads are serialized amongst themselves with a mutex, which is never touched by the reader.
+ * Until the reader has applied the newest snapshot, writer-side threads can still look its values up with GetPendingValue(). */
+class IParamSnapshot final
+{
+public:
+  /** One parameter of a snapshot */
+  struct Entry
+  {
+    double value = 0.0; // the non-normalized value to set
+    uint32_t setCount = 0; // IParam::GetSetCount() when the snapshot was written, so that later changes can win
+    bool valid = false; // \c false if the value could not be read, in which case the parameter is left alone
+  };
+
+  IParamSnapshot(int nParams = 0)
+  {
+    Resize(nParams);
+  }
+
+  IParamSnapshot(const IParamSnapshot&) = delete;
+  IParamSnapshot& operator=(const IParamSnapshot&) = delete;
+
+  /** Allocate storage for nParams entries. Must not be called while audio is processing
+   * @param nParams The number of parameter entries in each buffer */
+  void Resize(int nParams)
+  {
+    mNParams = nParams;
+    mData.Resize(nParams * 4);
+    std::fill(mData.Get(), mData.Get() + nParams * 4, Entry());
+    std::fill(mGenerations, mGenerations + 3, 0);
+    mWrittenGeneration = 0;
+    mAcquiredGeneration = 0;
+    mAppliedGeneration.store(0);
+    mBackIdx = 0;
+    mMiddle.store(1, std::memory_order_relaxed);
+    mFrontIdx = 2;
+  }
+
+  /** @return The number of parameter entries in each buffer */
+  int NParams() const { return mNParams; }
+
+  /** Called on the writer thread to begin filling a new snapshot. Must be balanced with a call to EndWrite()
+   * @return Pointer to NParams() entries that the writer may fill */
+  Entry* BeginWrite()
+  {
+    mWriteMutex.Enter();
+    return GetBuffer(mBackIdx);
+  }
+
+  /** Called on the writer thread to publish the entries written since BeginWrite() */
+  void EndWrite()
+  {
+    Entry* pEntries = GetBuffer(mBackIdx);
+    std::copy(pEntries, pEntries + mNParams, GetBuffer(kLastWrittenIdx));
+    mGenerations[mBackIdx] = ++mWrittenGeneration;
+
+    const int prev = mMiddle.exchange(mBackIdx | kFreshBit, std::memory_order_acq_rel);
+    mBackIdx = prev & kIndexMask;
+    mWriteMutex.Leave();
+  }
+
+  /** Called on the writer thread instead of EndWrite(), to discard the entries written since BeginWrite() without publishing them */
+  void CancelWrite()
+  {
+    mWriteMutex.Leave();
+  }
+
+  /** Called on the reader (audio) thread. Never blocks.
+   * @return Pointer to NParams() entries if a new snapshot has been published since the last call, otherwise nullptr */
+  const Entry* Acquire()
+  {
+    if (!(mMiddle.load(std::memory_order_relaxed) & kFreshBit))
+      return nullptr;
+
+    const int prev = mMiddle.exchange(mFrontIdx, std::memory_order_acq_rel);
+    mFrontIdx = prev & kIndexMask;
+    mAcquiredGeneration = mGenerations[mFrontIdx];
+    return GetBuffer(mFrontIdx);
+  }
+
+  /** Called on the reader (audio) thread once it has applied the entries returned by Acquire(). Never blocks */
+  void EndApply()
+  {
+    mAppliedGeneration.store(mAcquiredGeneration, std::memory_order_release);
+  }
+
+  /** @return \c true if a snapshot has been published that the reader has not yet acquired */
+  bool IsPending() const { return mMiddle.load(std::memory_order_relaxed) & kFreshBit; }
+
+  /** Look up the value that the newest snapshot will give a parameter, if the reader has not applied it yet. Not for the reader thread
+   * @param paramIdx The index of the parameter
+   * @param setCount The parameter's current IParam::GetSetCount(). If it has changed since the snapshot was written, the parameter keeps its value
+   * @param value Set to the pending value, if there is one
+   * @return \c true if the snapshot has a pending value for the parameter */
+  bool GetPendingValue(int paramIdx, uint32_t setCount, double& value) const
+  {
+    WDL_MutexLock lock(&mWriteMutex);
+
+    if (mAppliedGeneration.load(std::memory_order_acquire) == mWrittenGeneration)
+      return false;
+
+    const Entry& entry = mData.Get()[kLastWrittenIdx * mNParams + paramIdx];
+
+    if (!entry.valid || entry.setCount != setCount)
+      return false;
+
+    value = entry.value;
+    return true;
+  }
+
+private:
+  static constexpr int kIndexMask = 0x3;
+  static constexpr int kFreshBit = 0x4;
+  static constexpr int kLastWrittenIdx = 3; // a writer-side copy of the newest snapshot, for GetPendingValue()
+
+  Entry* GetBuffer(int idx) { return mData.Get() + (idx * mNParams); }
+
+  WDL_TypedBuf<Entry> mData;
+  mutable WDL_Mutex mWriteMutex;
+  int mNParams = 0;
+  int mBackIdx = 0; // owned by the writer
+  int mFrontIdx = 2; // owned by the reader
+  std::atomic<int> mMiddle {1}; // shared, index plus kFreshBit
+  uint64_t mGenerations[3] = {}; // the generation of the snapshot in each buffer, written before it is published
+  uint64_t mWrittenGeneration = 0; // owned by the writer
+  uint64_t mAcquiredGeneration = 0; // owned by the reader
+  std::atomic<uint64_t> mAppliedGeneration {0}; // the generation the reader has finished applying
+};
+
+END_IPLUG_NAMESPACE
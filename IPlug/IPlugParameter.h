@@ -307,7 +307,7 @@ public:
 
   /** Sets the parameter value
    * @param value Value to be set. Will be stepped and clamped between \c mMin and \c mMax */
-  void Set(double value) { mValue.store(Constrain(value)); }
+  void Set(double value) { StoreValue(Constrain(value)); }
 
   /** Sets the parameter value from a normalized range (usually coming from the linked IControl)
    * @param normalizedValue The expected normalized value between 0. and 1. */
@@ -315,10 +315,10 @@ public:
 
   /** Set the parameter value using a textual representation
    * @param str The textual representations as a CString */
-  void SetString(const char* str) { mValue.store(StringToValue(str)); }
+  void SetString(const char* str) { StoreValue(StringToValue(str)); }
 
   /** Replaces the parameter's current value with the default one  */
-  void SetToDefault() { mValue.store(mDefault); }
+  void SetToDefault() { StoreValue(mDefault); }
 
   /** Set the parameter's default value, and set the parameter to that default
    * @param value The new default value */
@@ -345,6 +345,17 @@ public:
    * @return double Current value of the parameter */
   double Value() const { return mValue.load(); }
 
+#ifdef PARAMS_SNAPSHOT
+  /** @return A count that is incremented every time the value is set, which IPluginBase::ApplyParamSnapshot() uses to tell
+   * whether a parameter was set after a snapshot was taken */
+  uint32_t GetSetCount() const { return mSetCount.load(std::memory_order_acquire); }
+
+  /** Sets the value without incrementing GetSetCount(). Used by IPluginBase::ApplyParamSnapshot(), so that applying one snapshot
+   * doesn't look like a newer change to a snapshot that was taken meanwhile
+   * @param value Value to be set. Will be stepped and clamped between \c mMin and \c mMax */
+  void SetFromSnapshot(double value) { mValue.store(Constrain(value)); }
+#endif
+
   /** Returns the parameter's value as a boolean
    * @return \c true if value >= 0.5, else otherwise */
   bool Bool() const { return (mValue.load() >= 0.5); }
@@ -504,6 +515,14 @@ public:
   /** Helper to print the parameter details to debug console in debug builds */
   void PrintDetails() const;
 private:
+  void StoreValue(double value)
+  {
+    mValue.store(value);
+#ifdef PARAMS_SNAPSHOT
+    mSetCount.fetch_add(1, std::memory_order_acq_rel);
+#endif
+  }
+
   /** A DisplayText is used to link a certain real value of the parameter with a CString. For example -70 on a decibel gain parameter could instead read "-inf" */
   struct DisplayText
   {
@@ -514,6 +533,9 @@ private:
   EParamType mType = kTypeNone;
   EParamUnit mUnit = kUnitCustom;
   std::atomic<double> mValue{0.0};
+#ifdef PARAMS_SNAPSHOT
+  std::atomic<uint32_t> mSetCount{0};
+#endif
   double mMin = 0.0;
   double mMax = 1.0;
   double mStep = 1.0;
@@ -58,6 +58,21 @@
   #define LEAVE_PARAMS_MUTEX_STATIC
 #endif
 
+#ifdef PARAMS_SNAPSHOT
+  #ifdef PARAMS_MUTEX
+    #error "PARAMS_SNAPSHOT and PARAMS_MUTEX are mutually exclusive"
+  #endif
+  #define APPLY_PARAMS_SNAPSHOT ApplyParamSnapshot();
+  #define APPLY_PARAMS_SNAPSHOT_STATIC _this->ApplyParamSnapshot();
+  #define SET_PARAMS_SNAPSHOT_PROCESSING(processing) SetParamSnapshotProcessing(processing);
+  #define SET_PARAMS_SNAPSHOT_PROCESSING_STATIC(processing) _this->SetParamSnapshotProcessing(processing);
+#else
+  #define APPLY_PARAMS_SNAPSHOT
+  #define APPLY_PARAMS_SNAPSHOT_STATIC
+  #define SET_PARAMS_SNAPSHOT_PROCESSING(processing)
+  #define SET_PARAMS_SNAPSHOT_PROCESSING_STATIC(processing)
+#endif
+
 #define BEGIN_IPLUG_NAMESPACE namespace iplug {
 #define END_IPLUG_NAMESPACE }
 
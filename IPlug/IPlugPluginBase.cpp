@@ -21,6 +21,9 @@ using namespace iplug;
 
 IPluginBase::IPluginBase(int nParams, int nPresets)
 : EDITOR_DELEGATE_CLASS(nParams)
+#ifdef PARAMS_SNAPSHOT
+, mParamSnapshot(nParams)
+#endif
 {  
   for (int i = 0; i < nPresets; ++i)
     mPresets.Add(new IPreset());
@@ -114,13 +117,104 @@ bool IPluginBase::SerializeParams(IByteChunk& chunk) const
   for (i = 0; i < n && savedOK; ++i)
   {
     IParam* pParam = mParams.Get(i);
-    Trace(TRACELOC, "%d %s %f", i, pParam->GetName(), pParam->Value());
     double v = pParam->Value();
+#ifdef PARAMS_SNAPSHOT
+    // a preset that was loaded but not yet applied by the audio thread is still the current state
+    mParamSnapshot.GetPendingValue(i, pParam->GetSetCount(), v);
+#endif
+    Trace(TRACELOC, "%d %s %f", i, pParam->GetName(), v);
     savedOK &= (chunk.Put(&v) > 0);
   }
   return savedOK;
 }
 
+#ifdef PARAMS_SNAPSHOT
+int IPluginBase::UnserializeParams(const IByteChunk& chunk, int startPos)
+{
+  TRACE
+  int i, n = mParams.GetSize(), pos = startPos;
+  
+  // While the audio thread is processing, the IParams are not touched here: the values are written to the back buffer of the snapshot
+  // and published in one step, and the audio thread sets them in ApplyParamSnapshot() before its next block, so it never sees a half-loaded
+  // preset and never waits
+  IParamSnapshot::Entry* pEntries = mParamSnapshot.BeginWrite();
+  for (i = 0; i < n; ++i)
+  {
+    IParamSnapshot::Entry& entry = pEntries[i];
+    double v = 0.0;
+    if (pos >= 0)
+      pos = chunk.Get(&v, pos);
+    
+    entry.value = v;
+    entry.valid = pos >= 0;
+    
+    if (entry.valid)
+      Trace(TRACELOC, "%d %s %f", i, mParams.Get(i)->GetName(), v);
+  }
+  
+  // Nothing would apply a snapshot on an instance that is not processing (e.g. the VST3 controller, or while the host has suspended
+  // the plug-in), so set the IParams now, as without PARAMS_SNAPSHOT
+  if (!mParamSnapshotProcessing.load())
+  {
+    for (i = 0; i < n; ++i)
+    {
+      if (pEntries[i].valid)
+        mParams.Get(i)->Set(pEntries[i].value);
+    }
+    OnParamReset(kPresetRecall);
+  }
+  
+  for (i = 0; i < n; ++i)
+    pEntries[i].setCount = mParams.Get(i)->GetSetCount();
+  
+  // If processing started while the IParams were being set, the audio thread may have seen some of the old values, so it gets the snapshot as well
+  if (mParamSnapshotProcessing.load())
+    mParamSnapshot.EndWrite();
+  else
+    mParamSnapshot.CancelWrite();
+
+  return pos;
+}
+
+void IPluginBase::ApplyParamSnapshot()
+{
+  if (!mParamSnapshotProcessing.load(std::memory_order_relaxed))
+    mParamSnapshotProcessing.store(true);
+  
+  const IParamSnapshot::Entry* pEntries = mParamSnapshot.Acquire();
+  
+  if (!pEntries)
+    return;
+  
+  const int n = std::min(mParamSnapshot.NParams(), NParams());
+  
+  for (int i = 0; i < n; ++i)
+  {
+    IParam* pParam = GetParam(i);
+    
+    // a value that the host or UI set after the snapshot was taken is newer than the snapshot, so it wins
+    if (!pEntries[i].valid || pParam->GetSetCount() != pEntries[i].setCount)
+      continue;
+    
+    pParam->SetFromSnapshot(pEntries[i].value);
+    OnParamChange(i, kPresetRecall);
+    OnParamSnapshotValueApplied(i, pParam->Value());
+  }
+  
+  mParamSnapshot.EndApply();
+}
+
+void IPluginBase::SetParamSnapshotProcessing(bool processing)
+{
+  if (!processing)
+  {
+    // the audio thread has stopped, so apply a snapshot that it did not get to on this thread
+    ApplyParamSnapshot();
+  }
+  
+  mParamSnapshotProcessing.store(processing);
+}
+#else
 int IPluginBase::UnserializeParams(const IByteChunk& chunk, int startPos)
 {
   TRACE
@@ -143,6 +237,7 @@ int IPluginBase::UnserializeParams(const IByteChunk& chunk, int startPos)
 
   return pos;
 }
+#endif
 
 void IPluginBase::InitParamRange(int startIdx, int endIdx, int countStart, const char* nameFmtStr, double defaultVal, double minVal, double maxVal, double step, const char *label, int flags, const char *group, const IParam::Shape& shape, IParam::EParamUnit unit, IParam::DisplayFunc displayFunc)
 {
@@ -19,6 +19,9 @@
 #include "IPlugParameter.h"
 #include "IPlugStructs.h"
 #include "IPlugLogger.h"
+#ifdef PARAMS_SNAPSHOT
+#include "IPlugParamSnapshot.h"
+#endif
 
 BEGIN_IPLUG_NAMESPACE
 
@@ -139,6 +142,29 @@ public:
    * @param startPos The start position in the chunk where parameter values are stored
    * @return The new chunk position (endPos) */
   int UnserializeParams(const IByteChunk& chunk, int startPos);
+
+#ifdef PARAMS_SNAPSHOT
+  /** Called by the API class on the realtime audio thread, before processing a block. If a new parameter snapshot has been
+   * published by UnserializeParams() on another thread, its values are set and OnParamChange() is called for each parameter with kPresetRecall.
+   * Parameters that were set after the snapshot was taken, e.g. by the host, keep their newer values. This method never blocks.
+   * While the instance is processing, GetParam() still returns the values from before the snapshot until this runs */
+  void ApplyParamSnapshot();
+
+  /** Called by the API class when the host starts or stops calling the audio processing callback. While an instance is not processing,
+   * e.g. the VST3 controller, or before the host activates the plug-in or after it suspends it, UnserializeParams() sets the parameters
+   * directly and calls OnParamReset(), since no audio thread would pick up a snapshot. When processing stops, a snapshot the audio thread
+   * did not get to is applied. ApplyParamSnapshot() also marks the instance as processing, for APIs that don't call this
+   * @param processing \c true if the audio thread is (about to start) processing */
+  void SetParamSnapshotProcessing(bool processing);
+
+protected:
+  /** Called by ApplyParamSnapshot() on the realtime audio thread for each parameter it sets, so that the API class can tell the editor
+   * @param paramIdx The index of the parameter
+   * @param value The new non-normalized value */
+  virtual void OnParamSnapshotValueApplied(int paramIdx, double value) {}
+
+public:
+#endif
     
   /** Override this method to serialize custom state data, if your plugin does state chunks.
    * @param chunk The output bytechunk where data can be serialized
@@ -439,6 +465,13 @@ protected:
   /** Lock when accessing mParams (including via GetParam) from the audio thread */
   WDL_Mutex mParams_mutex;
 #endif  
+
+#ifdef PARAMS_SNAPSHOT
+  /** Parameter values published by UnserializeParams() for lock-free pickup by ApplyParamSnapshot() on the audio thread */
+  IParamSnapshot mParamSnapshot;
+  /** \c true while the host is calling the audio processing callback, see SetParamSnapshotProcessing() */
+  std::atomic<bool> mParamSnapshotProcessing {false};
+#endif
 };
 
 END_IPLUG_NAMESPACE
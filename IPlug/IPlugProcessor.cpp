@@ -35,6 +35,10 @@ IPlugProcessor::IPlugProcessor(const Config& config, EAPI plugAPI)
 
   mScratchData[ERoute::kInput].Resize(totalNInChans);
   mScratchData[ERoute::kOutput].Resize(totalNOutChans);
+  mSubBlockData[ERoute::kInput].Resize(totalNInChans);
+  mSubBlockData[ERoute::kOutput].Resize(totalNOutChans);
+  mParamEvents.Resize(MAX_PARAM_EVENTS_PER_BLOCK);
+  mParamEventsScratch.Resize(MAX_PARAM_EVENTS_PER_BLOCK);
 
   sample** ppInData = mScratchData[ERoute::kInput].Get();
 
@@ -496,6 +500,8 @@ void IPlugProcessor::AttachBuffers(ERoute direction, int idx, int n, PLUG_SAMPLE
 
 void IPlugProcessor::PassThroughBuffers(PLUG_SAMPLE_DST type, int nFrames)
 {
+  FlushParamEvents();
+
   if (mLatency && mLatencyDelay)
     mLatencyDelay->ProcessBlock(mScratchData[ERoute::kInput].Get(), mScratchData[ERoute::kOutput].Get(), nFrames);
   else
@@ -522,7 +528,144 @@ void IPlugProcessor::PassThroughBuffers(PLUG_SAMPLE_SRC type, int nFrames)
 
 void IPlugProcessor::ProcessBuffers(PLUG_SAMPLE_DST type, int nFrames)
 {
-  ProcessBlock(mScratchData[ERoute::kInput].Get(), mScratchData[ERoute::kOutput].Get(), nFrames);
+  if (mNParamEvents)
+    ProcessSubBlocks(nFrames);
+  else
+    ProcessBlock(mScratchData[ERoute::kInput].Get(), mScratchData[ERoute::kOutput].Get(), nFrames);
+}
+
+bool IPlugProcessor::EnqueueParamEvent(int paramIdx, double value, int sampleOffset)
+{
+  if (!mSampleAccurateParamChanges)
+    return false;
+
+  IParamEvent* pEvents = mParamEvents.Get();
+
+  if (mNParamEvents < mParamEvents.GetSize())
+  {
+    pEvents[mNParamEvents++] = IParamEvent(paramIdx, value, sampleOffset);
+    return true;
+  }
+
+  // The list is full: replace the last change queued for this parameter, so that it still ends the block on the newest value.
+  // If none is queued, applying the change straight away can't be overtaken by an older one
+  for (auto i = mNParamEvents - 1; i >= 0; --i)
+  {
+    if (pEvents[i].idx == paramIdx)
+    {
+      pEvents[i].value = value;
+      pEvents[i].offset = std::max(pEvents[i].offset, sampleOffset);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void IPlugProcessor::FlushParamEvents()
+{
+  const IParamEvent* pEvents = mParamEvents.Get();
+
+  for (auto i = 0; i < mNParamEvents; ++i)
+    ApplyParamEvent(pEvents[i]);
+
+  mNParamEvents = 0;
+}
+
+void IPlugProcessor::SortParamEvents()
+{
+  auto byOffset = [](const IParamEvent& a, const IParamEvent& b) { return a.offset < b.offset; };
+
+  IParamEvent* pSrc = mParamEvents.Get();
+  const int nEvents = mNParamEvents;
+
+  if (std::is_sorted(pSrc, pSrc + nEvents, byOffset))
+    return;
+
+  // Events arrive grouped by parameter and in time order within each group, so merge the ordered runs pairwise, which is stable and O(n log runs)
+  IParamEvent* pDest = mParamEventsScratch.Get();
+
+  while (true)
+  {
+    int nRuns = 0;
+    int start = 0;
+
+    while (start < nEvents)
+    {
+      int mid = start + 1;
+      while (mid < nEvents && !byOffset(pSrc[mid], pSrc[mid - 1]))
+        ++mid;
+
+      int end = std::min(mid + 1, nEvents);
+      while (end < nEvents && !byOffset(pSrc[end], pSrc[end - 1]))
+        ++end;
+
+      std::merge(pSrc + start, pSrc + mid, pSrc + mid, pSrc + end, pDest + start, byOffset);
+      start = end;
+      ++nRuns;
+    }
+
+    std::swap(pSrc, pDest);
+
+    if (nRuns == 1)
+      break;
+  }
+
+  if (pSrc != mParamEvents.Get())
+    std::copy(pSrc, pSrc + nEvents, mParamEvents.Get());
+}
+
+void IPlugProcessor::ProcessSubBlocks(int nFrames)
+{
+  const IParamEvent* pEvents = mParamEvents.Get();
+  const int nEvents = mNParamEvents;
+
+  SortParamEvents();
+
+  const int nIn = MaxNChannels(ERoute::kInput);
+  const int nOut = MaxNChannels(ERoute::kOutput);
+  sample** ppIn = mScratchData[ERoute::kInput].Get();
+  sample** ppOut = mScratchData[ERoute::kOutput].Get();
+  sample** ppSubIn = mSubBlockData[ERoute::kInput].Get();
+  sample** ppSubOut = mSubBlockData[ERoute::kOutput].Get();
+
+  const ITimeInfo timeInfo = mTimeInfo;
+  const double samplesPerBeat = GetSamplesPerBeat();
+
+  int eventIdx = 0;
+  int pos = 0;
+
+  while (pos < nFrames)
+  {
+    while (eventIdx < nEvents && pEvents[eventIdx].offset <= pos)
+      ApplyParamEvent(pEvents[eventIdx++]);
+
+    int end = nFrames;
+
+    if (eventIdx < nEvents)
+      end = std::min(std::max(pEvents[eventIdx].offset, pos + mMinSubBlockSize), nFrames);
+
+    for (auto c = 0; c < nIn; ++c)
+      ppSubIn[c] = ppIn[c] + pos;
+
+    for (auto c = 0; c < nOut; ++c)
+      ppSubOut[c] = ppOut[c] + pos;
+
+    mTimeInfo.mSamplePos = timeInfo.mSamplePos + pos;
+
+    if (samplesPerBeat > 0.0)
+      mTimeInfo.mPPQPos = timeInfo.mPPQPos + (pos / samplesPerBeat);
+
+    ProcessBlock(ppSubIn, ppSubOut, end - pos);
+    pos = end;
+  }
+
+  // Any events stamped beyond the end of the block
+  while (eventIdx < nEvents)
+    ApplyParamEvent(pEvents[eventIdx++]);
+
+  mTimeInfo = timeInfo;
+  mNParamEvents = 0;
 }
 
 void IPlugProcessor::ProcessBuffers(PLUG_SAMPLE_SRC type, int nFrames)
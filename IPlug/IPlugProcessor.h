@@ -251,6 +251,19 @@ public:
    * @param tailSize the new tailsize in samples*/
   virtual void SetTailSize(int tailSize) { mTailSize = tailSize; }
 
+  /** Call this method (typically in your plug-in's constructor) to enable sample accurate parameter automation.
+   * When enabled, timestamped parameter changes from the host are gathered into a list sorted by sample offset, and ProcessBlock() is called
+   * several times per host block, split at the offsets where parameters change. OnParamChange() is called for each change just before the sub-block it starts.
+   * ProcessBlock() will then receive sub-blocks smaller than GetBlockSize(). MIDI message offsets remain relative to the host block,
+   * so if you queue MIDI with IMidiQueue you should call IMidiQueue::Flush(nFrames) at the end of each ProcessBlock() as usual.
+   * Currently supported by the VST3 and CLAP APIs, other APIs apply parameter changes at the start of the host block
+   * @param enable \c true to enable block splitting
+   * @param minSubBlockSize Changes less than this number of samples apart are applied together, in order to bound the cost of splitting */
+  void SetSampleAccurateParamChanges(bool enable, int minSubBlockSize = 16) { mSampleAccurateParamChanges = enable; mMinSubBlockSize = std::max(minSubBlockSize, 1); }
+
+  /** @return \c true if sample accurate parameter automation has been enabled with SetSampleAccurateParamChanges() */
+  bool GetSampleAccurateParamChanges() const { return mSampleAccurateParamChanges; }
+
   /** A static method to parse the config.h channel I/O string.
    * @param IOStr Space separated cstring list of I/O configurations for this plug-in in the format ninchans-noutchans.
    * A hypen character \c(-) deliminates input-output. Supports multiple buses, which are indicated using a period \c(.) character.
@@ -286,7 +299,28 @@ protected:
   void SetRenderingOffline(bool renderingOffline) { mRenderingOffline = renderingOffline; }
   const WDL_String& GetChannelLabel(ERoute direction, int idx) { return mChannelData[direction].Get(idx)->mLabel; }
 
+  /** Called by the API class prior to ProcessBuffers() to queue a timestamped parameter change, when sample accurate parameter changes are enabled
+   * @param paramIdx The index of the parameter
+   * @param value The value as delivered by the plug-in API
+   * @param sampleOffset The offset of the change in the forthcoming block
+   * @return \c false if sample accurate changes are disabled, or if the event list is full and holds no change to this parameter,
+   * in which case the API class should apply the change immediately. If the list is full, the last change queued for the parameter is replaced */
+  bool EnqueueParamEvent(int paramIdx, double value, int sampleOffset);
+
+  /** Apply any queued parameter changes immediately, e.g. if the plug-in is bypassed and ProcessBlock() will not be called */
+  void FlushParamEvents();
+
+  /** Implemented by API classes that support sample accurate parameter changes, in order to update the parameter and call OnParamChange()
+   * @param event The parameter change to apply */
+  virtual void ApplyParamEvent(const IParamEvent& event) {}
+
 private:
+  /** Stable sort of the queued parameter changes by sample offset, without allocating */
+  void SortParamEvents();
+
+  /** Sort the queued parameter changes and call ProcessBlock() for each sub-block between them */
+  void ProcessSubBlocks(int nFrames);
+
   /** See EIPlugPluginTypes */
   EIPlugPluginType mPlugType;
   /** \c true if the plug-in accepts MIDI input */
@@ -315,6 +349,18 @@ private:
   WDL_PtrList<IChannelData<>> mChannelData[2];
   /** A multi-channel delay line used to delay the bypassed signal when a plug-in with latency is bypassed. */
   std::unique_ptr<NChanDelayLine<sample>> mLatencyDelay = nullptr;
+  /** \c true if ProcessBlock() should be split at the offsets of parameter changes */
+  bool mSampleAccurateParamChanges = false;
+  /** The minimum size of a sub-block when splitting */
+  int mMinSubBlockSize = 16;
+  /** Pre-allocated storage for timestamped parameter changes in the current block */
+  WDL_TypedBuf<IParamEvent> mParamEvents;
+  /** Scratch space for sorting mParamEvents */
+  WDL_TypedBuf<IParamEvent> mParamEventsScratch;
+  /** The number of valid events in mParamEvents */
+  int mNParamEvents = 0;
+  /** Channel pointers offset to the start of the current sub-block */
+  WDL_TypedBuf<sample*> mSubBlockData[2];
 protected: // protected because it needs to be access by the API classes, and don't want a setter/getter
   /** Contains detailed information about the transport state */
   ITimeInfo mTimeInfo;
@@ -15,6 +15,7 @@
  * @copydoc IPlugQueue
  */
 
+#include <algorithm>
 #include <atomic>
 #include <cstddef>
 
@@ -26,13 +27,19 @@ BEGIN_IPLUG_NAMESPACE
 
 /** A lock-free SPSC queue used to transfer data between threads
  * based on MLQueue.h by Randy Jones
- * based on https://kjellkod.wordpress.com/2012/11/28/c-debt-paid-in-full-wait-free-lock-free-queue/ */
+ * based on https://kjellkod.wordpress.com/2012/11/28/c-debt-paid-in-full-wait-free-lock-free-queue/
+ *
+ * The capacity is rounded up to a power of two and the read and write indices run freely, so a slot is found by masking rather than a modulo,
+ * and every slot can be used. The indices live on separate cache lines, and each side keeps a cached copy of the other side's index,
+ * so that the shared cache line is only touched when the cached copy says the queue is full (producer) or empty (consumer).
+ * As well as single element Push() and Pop() there are bulk PushN() / PopN() calls, and BeginPush() / EndPush() and BeginPop() / EndPop()
+ * which give direct access to a slot, so that large elements can be written and read in place, rather than copied in and out. */
 template<typename T>
 class IPlugQueue final
 {
 public:
   /** IPlugQueue constructor 
-   * @param size \todo */
+   * @param size The minimum number of elements the queue can hold */
   IPlugQueue(int size)
   {
     Resize(size);
@@ -43,113 +50,223 @@ public:
   IPlugQueue(const IPlugQueue&) = delete;
   IPlugQueue& operator=(const IPlugQueue&) = delete;
     
-  /** \todo 
-   * @param size \todo */
+  /** Resize the queue, discarding its contents. This must not be called while either thread is using the queue
+   * @param size The minimum number of elements the queue can hold. The capacity is rounded up to a power of two */
   void Resize(int size)
   {
-    mData.Resize(size + 1);
+    size_t capacity = 1;
+
+    while (capacity < static_cast<size_t>(size))
+      capacity <<= 1;
+
+    mData.Resize(static_cast<int>(capacity));
+    mMask = capacity - 1;
+    mWriteIndex.store(0, std::memory_order_relaxed);
+    mReadIndex.store(0, std::memory_order_relaxed);
+    mCachedReadIndex = 0;
+    mCachedWriteIndex = 0;
+  }
+
+  /** @return The number of elements the queue can hold */
+  size_t Capacity() const
+  {
+    return mMask + 1;
   }
 
-  /** \todo 
-   * @param item \todo
-   * @return true \todo
-   * @return false \todo */
+  /** Push an element onto the queue. Call on the producer thread
+   * @param item The element to copy into the queue
+   * @return \c true if the element was pushed, \c false if the queue was full */
   bool Push(const T& item)
   {
-    const auto currentWriteIndex = mWriteIndex.load(std::memory_order_relaxed);
-    const auto nextWriteIndex = Increment(currentWriteIndex);
-    if(nextWriteIndex != mReadIndex.load(std::memory_order_acquire))
-    {
-      mData.Get()[currentWriteIndex] = item;
-      mWriteIndex.store(nextWriteIndex, std::memory_order_release);
-      return true;
-    }
-    return false;
+    T* pSlot = BeginPush();
+
+    if (!pSlot)
+      return false;
+
+    *pSlot = item;
+    EndPush();
+    return true;
   }
 
-  /** \todo 
-   * @param item \todo
-   * @return true \todo
-   * @return false \todo */
+  /** Pop an element off the queue. Call on the consumer thread
+   * @param item Receives a copy of the element
+   * @return \c true if an element was popped, \c false if the queue was empty */
   bool Pop(T& item)
   {
-    const auto currentReadIndex = mReadIndex.load(std::memory_order_relaxed);
-    if(currentReadIndex == mWriteIndex.load(std::memory_order_acquire))
-    {
-      return false; // empty the queue
-    }
-    item = mData.Get()[currentReadIndex];
-    mReadIndex.store(Increment(currentReadIndex), std::memory_order_release);
+    T* pSlot = BeginPop();
+
+    if (!pSlot)
+      return false;
+
+    item = *pSlot;
+    EndPop();
     return true;
   }
 
-  /** \todo
-   * @param args... \todo
-   * @return true \todo
-   * @return false \todo */
+  /** Construct an element in the queue from a list of arguments. Call on the producer thread
+   * @param args... Arguments passed to the constructor of T
+   * @return \c true if the element was pushed, \c false if the queue was full */
   template <typename... Args>
   bool PushFromArgs(Args ...args)
   {
-    const auto currentWriteIndex = mWriteIndex.load(std::memory_order_relaxed);
-    const auto nextWriteIndex = Increment(currentWriteIndex);
-    if(nextWriteIndex != mReadIndex.load(std::memory_order_acquire))
-    {
-      mData.Get()[currentWriteIndex] = T(args...);
-      mWriteIndex.store(nextWriteIndex, std::memory_order_release);
-      return true;
-    }
-    return false;
+    T* pSlot = BeginPush();
+
+    if (!pSlot)
+      return false;
+
+    *pSlot = T(args...);
+    EndPush();
+    return true;
   }
-  
-  /** \todo 
-   * @return size_t \todo */
+
+  /** Push as many elements as will fit, publishing them all at once. Call on the producer thread
+   * @param pItems Pointer to the elements to copy into the queue
+   * @param n The number of elements at pItems
+   * @return The number of elements pushed, which is less than n if the queue became full */
+  int PushN(const T* pItems, int n)
+  {
+    const size_t writeIndex = mWriteIndex.load(std::memory_order_relaxed);
+    const int nToPush = static_cast<int>(std::min(static_cast<size_t>(n), FreeSpace(writeIndex, n)));
+    T* pData = mData.Get();
+
+    for (auto i = 0; i < nToPush; i++)
+      pData[(writeIndex + i) & mMask] = pItems[i];
+
+    mWriteIndex.store(writeIndex + nToPush, std::memory_order_release);
+    return nToPush;
+  }
+
+  /** Pop up to n elements at once. Call on the consumer thread
+   * @param pItems Pointer to storage for at least n elements
+   * @param n The maximum number of elements to pop
+   * @return The number of elements popped */
+  int PopN(T* pItems, int n)
+  {
+    const size_t readIndex = mReadIndex.load(std::memory_order_relaxed);
+    const int nToPop = static_cast<int>(std::min(static_cast<size_t>(n), Available(readIndex, n)));
+    const T* pData = mData.Get();
+
+    for (auto i = 0; i < nToPop; i++)
+      pItems[i] = pData[(readIndex + i) & mMask];
+
+    mReadIndex.store(readIndex + nToPop, std::memory_order_release);
+    return nToPop;
+  }
+
+  /** Reserve the next free slot so it can be written in place. Call on the producer thread, and if it succeeds, follow with EndPush()
+   * @return Pointer to the slot, or nullptr if the queue is full */
+  T* BeginPush()
+  {
+    const size_t writeIndex = mWriteIndex.load(std::memory_order_relaxed);
+
+    if (!FreeSpace(writeIndex, 1))
+      return nullptr;
+
+    return mData.Get() + (writeIndex & mMask);
+  }
+
+  /** Publish the slot returned by BeginPush() to the consumer */
+  void EndPush()
+  {
+    mWriteIndex.store(mWriteIndex.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+
+  /** Access the oldest element in place. Call on the consumer thread, and if it succeeds, follow with EndPop() once done with the element.
+   * The element can be modified, the producer will not touch the slot until EndPop() is called
+   * @return Pointer to the element, or nullptr if the queue is empty */
+  T* BeginPop()
+  {
+    const size_t readIndex = mReadIndex.load(std::memory_order_relaxed);
+
+    if (!Available(readIndex, 1))
+      return nullptr;
+
+    return mData.Get() + (readIndex & mMask);
+  }
+
+  /** Release the slot returned by BeginPop() back to the producer */
+  void EndPop()
+  {
+    mReadIndex.store(mReadIndex.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+
+  /** Call on the producer or the consumer thread only.
+   * On the consumer thread the result is a lower bound, because the producer may push more at any time.
+   * On the producer thread it reads a consumer index that may be stale, so the result is an upper bound on the elements,
+   * and Capacity() - ElementsAvailable() is only a lower bound on the free space
+   * @return The number of elements in the queue */
   size_t ElementsAvailable() const
   {
-    size_t write = mWriteIndex.load(std::memory_order_acquire);
-    size_t read = mReadIndex.load(std::memory_order_relaxed);
+    const size_t write = mWriteIndex.load(std::memory_order_acquire);
+    const size_t read = mReadIndex.load(std::memory_order_relaxed);
 
-    return (read > write) ? mData.GetSize() - (read - write) : write - read;
+    return write - read;
   }
 
-  /** \todo
-   * useful for reading elements while a criterion is met. Can be used like
+  /** Useful for reading elements while a criterion is met. Can be used like
    * while IPlugQueue.ElementsAvailable() && q.peek().mTime < 100 { elem = q.pop() ... }
-   * @return const T& \todo */
+   * @return const T& The oldest element. Only valid if ElementsAvailable() is non-zero */
   const T& Peek()
   {
     const auto currentReadIndex = mReadIndex.load(std::memory_order_relaxed);
-    return mData.Get()[currentReadIndex];
+    return mData.Get()[currentReadIndex & mMask];
   }
 
-  /** \todo 
-   * @return true \todo
-   * @return false \todo */
+  /** @return \c true if the queue was empty when checked */
   bool WasEmpty() const
   {
     return (mWriteIndex.load() == mReadIndex.load());
   }
 
-  /** \todo 
-   * @return true \todo
-   * @return false \todo */
+  /** @return \c true if the queue was full when checked */
   bool WasFull() const
   {
-    const auto nextWriteIndex = Increment(mWriteIndex.load());
-    return (nextWriteIndex == mReadIndex.load());
+    return (mWriteIndex.load() - mReadIndex.load()) > mMask;
   }
 
 private:
-  /** \todo 
-   * @param idx \todo
-   * @return size_t \todo */
-  size_t Increment(size_t idx) const
+  static constexpr size_t kCacheLineSize = 64;
+
+  /** Producer side. Only reloads the consumer's index if the cached copy says there isn't enough room
+   * @return The number of free slots, which is only guaranteed to be accurate if it is less than required */
+  size_t FreeSpace(size_t writeIndex, size_t required)
   {
-    return (idx + 1) % (mData.GetSize());
+    size_t free = Capacity() - (writeIndex - mCachedReadIndex);
+
+    if (free < required)
+    {
+      mCachedReadIndex = mReadIndex.load(std::memory_order_acquire);
+      free = Capacity() - (writeIndex - mCachedReadIndex);
+    }
+
+    return free;
+  }
+
+  /** Consumer side. Only reloads the producer's index if the cached copy says there aren't enough elements
+   * @return The number of elements available, which is only guaranteed to be accurate if it is less than required */
+  size_t Available(size_t readIndex, size_t required)
+  {
+    size_t available = mCachedWriteIndex - readIndex;
+
+    if (available < required)
+    {
+      mCachedWriteIndex = mWriteIndex.load(std::memory_order_acquire);
+      available = mCachedWriteIndex - readIndex;
+    }
+
+    return available;
   }
 
   WDL_TypedBuf<T> mData;
-  std::atomic<size_t> mWriteIndex{0};
-  std::atomic<size_t> mReadIndex{0};
+  size_t mMask = 0;
+
+  // written by the producer
+  alignas(kCacheLineSize) std::atomic<size_t> mWriteIndex{0};
+  size_t mCachedReadIndex = 0;
+
+  // written by the consumer
+  alignas(kCacheLineSize) std::atomic<size_t> mReadIndex{0};
+  size_t mCachedWriteIndex = 0;
 };
 
 END_IPLUG_NAMESPACE
@@ -40,6 +40,21 @@ struct ParamTuple
   {}
 };
 
+/** A parameter change with a sample offset into the current block, used for sample accurate parameter automation.
+ * The value is stored as it was delivered by the plug-in API, the API class that queued the event knows how to interpret it */
+struct IParamEvent
+{
+  int idx;
+  double value;
+  int offset;
+  
+  IParamEvent(int idx = kNoParameter, double value = 0., int offset = 0)
+  : idx(idx)
+  , value(value)
+  , offset(offset)
+  {}
+};
+
 /** This structure is used when queueing Sysex messages. You may need to set MAX_SYSEX_SIZE to reflect the max sysex payload in bytes */
 struct SysExData
 {
@@ -22,6 +22,13 @@
 #include "IPlugPlatform.h"
 #include "IPlugQueue.h"
 #include <array>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 #if defined OS_IOS || defined OS_MAC
 #include <Accelerate/Accelerate.h>
@@ -78,33 +85,35 @@ public:
   
   /** Pops elements off the queue and sends messages to controls.
    *  This must be called on the main thread - typically in MyPlugin::OnIdle() */
-  void TransmitData(IEditorDelegate& dlg)
+  virtual void TransmitData(IEditorDelegate& dlg)
   {
-    while (mQueue.ElementsAvailable())
+    // Work on the data in place in the queue, rather than copying each packet out
+    while (ISenderData<MAXNC, T>* pData = mQueue.BeginPop())
     {
-      ISenderData<MAXNC, T> d;
-      mQueue.Pop(d);
+      ISenderData<MAXNC, T>& d = *pData;
       assert(d.ctrlTag != kNoTag && "You must supply a control tag");
       PrepareDataForUI(d);
       dlg.SendControlMsgFromDelegate(d.ctrlTag, kUpdateMessage, sizeof(ISenderData<MAXNC, T>), (void*) &d);
+      mQueue.EndPop();
     }
   }
   
   /** This variation can be used if you need to supply multiple controls with the same ISenderData, overriding the tags in the data packet
    @param dlg The editor delegate
    @param ctrlTags A list of control tags that should receive the updates from this sender */
-  void TransmitDataToControlsWithTags(IEditorDelegate& dlg, const std::initializer_list<int>& ctrlTags)
+  virtual void TransmitDataToControlsWithTags(IEditorDelegate& dlg, const std::initializer_list<int>& ctrlTags)
   {
-    while(mQueue.ElementsAvailable())
+    while(ISenderData<MAXNC, T>* pData = mQueue.BeginPop())
     {
-      ISenderData<MAXNC, T> d;
-      mQueue.Pop(d);
+      ISenderData<MAXNC, T>& d = *pData;
       
       for (auto tag : ctrlTags)
       {
         d.ctrlTag = tag;
         dlg.SendControlMsgFromDelegate(tag, kUpdateMessage, sizeof(ISenderData<MAXNC, T>), (void*) &d);
       }
+
+      mQueue.EndPop();
     }
   }
 
@@ -504,13 +513,230 @@ private:
   float mThreshold = 0.01f;
 };
 
-/** ISpectrumSender is designed for sending Spectral Data from the plug-in to the UI */
-template <int MAXNC = 1, int QUEUE_SIZE = 64, int MAX_FFT_SIZE = 4096>
+/** IRingBufferSender keeps a history of sample data that the UI can read directly, without messages.
+ * The realtime audio thread writes each sample once into a single-producer ring buffer. A reader copies the most recent window
+ * straight out of the ring, checked against a sequence number (the count of samples written) so that a window is never torn.
+ * Unlike IBufferSender, the number of channels and the history length are set at runtime, and nothing is copied
+ * through an IPlugQueue or IEditorDelegate::SendControlMsgFromDelegate(). Because the UI holds a pointer to the sender,
+ * this only works when the UI and the DSP share an address space, i.e. not for the split web/remote editor.
+ * Conflicts are resolved without blocking either side: if a reader that has stalled for a whole ring's worth of samples is still
+ * copying a region the audio thread needs to overwrite, the audio thread skips the samples that would land on it rather than wait,
+ * but still counts them, so the history stays in step with the audio. A later ReadLatest() returns skipped samples as silence. */
+class IRingBufferSender
+{
+public:
+  /** Constructs an IRingBufferSender
+   * @param nChans The number of channels to keep
+   * @param historyLength The number of samples per channel that readers can read, see Resize() */
+  IRingBufferSender(int nChans = 1, int historyLength = 1024)
+  {
+    Resize(nChans, historyLength);
+  }
+
+  IRingBufferSender(const IRingBufferSender&) = delete;
+  IRingBufferSender& operator=(const IRingBufferSender&) = delete;
+
+  /** Set the number of channels and the history length. This allocates and clears the history, so it must not be called on the
+   * realtime audio thread or while the audio thread or a reader is using the sender, e.g. call it from OnReset() or the constructor
+   * @param nChans The number of channels to keep
+   * @param historyLength The number of samples per channel that readers can read */
+  void Resize(int nChans, int historyLength)
+  {
+    assert(nChans > 0);
+    assert(historyLength > 0);
+
+    // twice the history, so the audio thread can write a block while the newest window is being read
+    int capacity = 1;
+    while (capacity < 2 * historyLength)
+      capacity *= 2;
+
+    mNChans = nChans;
+    mHistoryLength = historyLength;
+    mCapacity = capacity;
+    mMask = capacity - 1;
+    mData.assign(static_cast<size_t>(nChans) * capacity, 0.f);
+    mSlotSeqs.resize(capacity);
+
+    for (int i = 0; i < capacity; i++)
+      mSlotSeqs[i] = static_cast<uint32_t>(i);
+
+    // counts start at one ring's worth, so a window reaching back before the first write reads the cleared samples
+    mWriteBegin.store(capacity);
+    mWriteEnd.store(capacity);
+    mReadStart.store(kNoReader);
+  }
+
+  /** @return The number of channels kept */
+  int NChans() const { return mNChans; }
+
+  /** @return The number of samples per channel that readers can read */
+  int GetHistoryLength() const { return mHistoryLength; }
+
+  /** Write sample buffers into the history. This can be called on the realtime audio thread, and only from one thread.
+   * Every frame advances GetWriteCount(), even if a stalled reader forces it to be skipped
+   * @param inputs The sample buffers
+   * @param nFrames The number of sample frames in the input buffers
+   * @param nChans The number of channels to write, or -1 for NChans(). Channels beyond NChans() are ignored
+   * @param chanOffset The first input channel to write */
+  void ProcessBlock(sample** inputs, int nFrames, int nChans = -1, int chanOffset = 0)
+  {
+    if (nChans < 0 || nChans > mNChans)
+      nChans = mNChans;
+
+    // samples older than the history can be overwritten while a window is being read, so write in chunks that spare it
+    const int maxChunk = mCapacity - mHistoryLength;
+
+    for (int s = 0; s < nFrames;)
+    {
+      const int n = std::min(nFrames - s, maxChunk);
+      const uint64_t w = mWriteEnd.load(std::memory_order_relaxed);
+
+      // announce the chunk, then check for a reader copying the samples it will overwrite, [w - capacity, w + n - capacity).
+      // Only the frames that land on the reader's window are skipped, their slots keep the sequence numbers of the older samples
+      mWriteBegin.store(w + n);
+      const uint64_t r = mReadStart.load();
+      int nWritten = n;
+
+      if (r != kNoReader && r < w + n - mCapacity)
+        nWritten = r + mCapacity > w ? static_cast<int>(r + mCapacity - w) : 0;
+
+      const int pos = static_cast<int>(w & mMask);
+      const int n1 = std::min(nWritten, mCapacity - pos);
+
+      for (int c = 0; c < nChans; c++)
+      {
+        const sample* pIn = inputs[chanOffset + c] + s;
+        float* pChan = mData.data() + static_cast<size_t>(c) * mCapacity;
+
+        for (int i = 0; i < n1; i++)
+          pChan[pos + i] = static_cast<float>(pIn[i]);
+
+        for (int i = n1; i < nWritten; i++)
+          pChan[i - n1] = static_cast<float>(pIn[i]);
+      }
+
+      for (int i = 0; i < nWritten; i++)
+        mSlotSeqs[(w + i) & mMask] = static_cast<uint32_t>(w + i);
+
+      mWriteEnd.store(w + n, std::memory_order_release);
+      s += n;
+    }
+  }
+
+  /** @return The sequence number of the newest sample, which increases by one for every sample frame written.
+   * A reader can compare this with the number returned from ReadLatest() to find out whether there is new data */
+  uint64_t GetWriteCount() const { return mWriteEnd.load(std::memory_order_acquire); }
+
+  /** Copy the newest window of samples out of the history. Only one thread may read at a time, normally the UI thread
+   * @param pDest Planar destination buffers, pDest[c] must have room for nFrames samples for each of the nChans channels
+   * @param nChans The number of channels to copy, at most NChans()
+   * @param nFrames The number of sample frames to copy, at most GetHistoryLength()
+   * @param writeCount Set to the sequence number of the last sample copied, see GetWriteCount()
+   * @param pNumSkipped If not nullptr, set to the number of frames in the window that the audio thread had to skip because an earlier
+   * read was still copying over them. They are copied as silence
+   * @return \c true if a consistent window was copied, \c false if the audio thread kept overwriting it, in which case try again later */
+  bool ReadLatest(float** pDest, int nChans, int nFrames, uint64_t& writeCount, int* pNumSkipped = nullptr) const
+  {
+    assert(nChans <= mNChans);
+    assert(nFrames <= mHistoryLength);
+
+    for (int attempt = 0; attempt < kMaxReadAttempts; attempt++)
+    {
+      const uint64_t end = mWriteEnd.load(std::memory_order_acquire);
+      const uint64_t start = end - nFrames;
+
+      // claim the window, then make sure no chunk that is being written overwrites it
+      mReadStart.store(start);
+
+      if (start < mWriteBegin.load() - mCapacity)
+      {
+        mReadStart.store(kNoReader, std::memory_order_release);
+        continue;
+      }
+
+      const int pos = static_cast<int>(start & mMask);
+      const int n1 = std::min(nFrames, mCapacity - pos);
+
+      for (int c = 0; c < nChans; c++)
+      {
+        const float* pChan = mData.data() + static_cast<size_t>(c) * mCapacity;
+        std::copy(pChan + pos, pChan + pos + n1, pDest[c]);
+        std::copy(pChan, pChan + (nFrames - n1), pDest[c] + n1);
+      }
+
+      // a slot that still holds an older sample than the window expects was skipped
+      int nSkipped = 0;
+
+      for (int i = 0; i < nFrames; i++)
+      {
+        if (mSlotSeqs[(start + i) & mMask] != static_cast<uint32_t>(start + i))
+        {
+          for (int c = 0; c < nChans; c++)
+            pDest[c][i] = 0.f;
+
+          nSkipped++;
+        }
+      }
+
+      mReadStart.store(kNoReader, std::memory_order_release);
+      writeCount = end;
+
+      if (pNumSkipped)
+        *pNumSkipped = nSkipped;
+
+      return true;
+    }
+
+    return false;
+  }
+
+private:
+  static constexpr uint64_t kNoReader = ~uint64_t(0);
+  static constexpr int kMaxReadAttempts = 4;
+
+  std::vector<float> mData; // one ring of mCapacity samples per channel
+  std::vector<uint32_t> mSlotSeqs; // the low 32 bits of the sequence number of the sample in each slot, shared by all channels
+  int mNChans = 0;
+  int mHistoryLength = 0;
+  int mCapacity = 0;
+  int mMask = 0;
+  std::atomic<uint64_t> mWriteBegin {0}; // end of the chunk the audio thread is writing
+  std::atomic<uint64_t> mWriteEnd {0}; // end of the samples that readers may copy
+  mutable std::atomic<uint64_t> mReadStart {kNoReader}; // start of the window being copied, or kNoReader
+};
+
+/** Layout of the display columns that ISpectrumSender's analysis thread reduces spectra to, see ISpectrumSender::SetColumnLayout() */
+struct ISpectrumColumnLayout
+{
+  int nColumns = 0;      // number of columns, e.g. the width of the display in pixels
+  float freqLo = 0.f;    // frequency of the left edge of the first column, normalized to Nyquist
+  float freqHi = 1.f;    // frequency of the right edge of the last column, normalized to Nyquist
+  bool logScale = true;  // columns are spaced logarithmically rather than linearly in frequency
+};
+
+/** Magnitude spectra reduced to one value per display column, sent by ISpectrumSender when its analysis thread is running */
+template <int MAXNC = 1, int MAX_COLUMNS = 1024>
+struct ISpectrumColumnData : ISenderData<MAXNC, std::array<float, MAX_COLUMNS>>
+{
+  int nColumns = 0;
+};
+
+/** ISpectrumSender is designed for sending Spectral Data from the plug-in to the UI
+ * By default the STFT is calculated on the main thread in TransmitData(), and full spectra are sent to the controls.
+ * StartAnalysisThread() moves the STFT to a dedicated thread, which sends each frame as ready-to-draw magnitudes
+ * at the resolution set with SetColumnLayout(), as ISpectrumColumnData with the kColumnsMessage tag.
+ * Pairs of channels share one complex FFT, since the spectra of two real signals can be separated from the spectrum of
+ * one signal in the real part and the other in the imaginary part. */
+template <int MAXNC = 1, int QUEUE_SIZE = 64, int MAX_FFT_SIZE = 4096, int MAX_COLUMNS = 1024>
 class ISpectrumSender : public IBufferSender<MAXNC, QUEUE_SIZE, MAX_FFT_SIZE>
 {
 public:
   using TDataPacket = std::array<float, MAX_FFT_SIZE>;
   using TBufferSender = IBufferSender<MAXNC, QUEUE_SIZE, MAX_FFT_SIZE>;
+  using TColumnData = ISpectrumColumnData<MAXNC, MAX_COLUMNS>;
+
+  /** The message tag of the ISpectrumColumnData sent to controls when the analysis thread is running */
+  static constexpr int kColumnsMessage = 100;
   
   enum class EWindowType {
     Hann = 0,
@@ -534,64 +760,138 @@ public:
     SetFFTSizeAndOverlap(fftSize, overlap);
   }
 
+  ~ISpectrumSender()
+  {
+    StopAnalysisThread();
+  }
+
+  ISpectrumSender(const ISpectrumSender&) = delete;
+  ISpectrumSender& operator=(const ISpectrumSender&) = delete;
+
   void SetFFTSize(int fftSize)
   {
+    std::lock_guard<std::mutex> lock(mAnalysisMutex);
     TBufferSender::SetBufferSize(fftSize);
     SetFFTSize();
     CalculateWindow();
     CalculateScalingFactors();
+    CalculateColumnBins();
   }
   
   void SetFFTSizeAndOverlap(int fftSize, int overlap)
   {
+    std::lock_guard<std::mutex> lock(mAnalysisMutex);
     mOverlap = overlap;
     TBufferSender::SetBufferSize(fftSize);
     SetFFTSize();
     CalculateWindow();
     CalculateScalingFactors();
+    CalculateColumnBins();
   }
   
   void SetWindowType(EWindowType windowType)
   {
+    std::lock_guard<std::mutex> lock(mAnalysisMutex);
     mWindowType = windowType;
     CalculateWindow();
   }
   
   void SetOutputType(EOutputType outputType)
   {
+    std::lock_guard<std::mutex> lock(mAnalysisMutex);
     mOutputType = outputType;
   }
   
-  void PrepareDataForUI(ISenderData<MAXNC, TDataPacket>& d) override
+  /** Set the display columns that the analysis thread reduces each spectrum to. Each column gets the peak magnitude of the bins
+   * it covers, or a value interpolated between bins where a column is narrower than a bin
+   * @param layout The layout, typically sent by the control that draws the spectrum */
+  void SetColumnLayout(const ISpectrumColumnLayout& layout)
+  {
+    std::lock_guard<std::mutex> lock(mAnalysisMutex);
+    mColumnLayout = layout;
+    mColumnLayout.nColumns = Clip(layout.nColumns, 0, MAX_COLUMNS);
+    CalculateColumnBins();
+  }
+
+  /** Calculate the STFT on a dedicated thread rather than in TransmitData(). TransmitData() then only sends the column data
+   * the thread has prepared. This spawns a thread, so call it on the main thread, not from ProcessBlock() */
+  void StartAnalysisThread()
+  {
+    if (mAnalysisThread.joinable())
+      return;
+
+    {
+      std::lock_guard<std::mutex> lock(mAnalysisMutex);
+      SetFFTSize(); // start from a clean history
+      mRunAnalysis = true;
+    }
+
+    mAnalysisThread = std::thread([this]() { AnalysisLoop(); });
+  }
+
+  /** Stop the analysis thread, if it is running, and go back to calculating the STFT in TransmitData() */
+  void StopAnalysisThread()
   {
-    auto fftSize = TBufferSender::GetBufferSize();
+    if (!mAnalysisThread.joinable())
+      return;
 
-    for (auto s = 0; s < fftSize; s++)
     {
-      for (auto stftFrameIdx = 0; stftFrameIdx < mOverlap; stftFrameIdx++)
+      std::lock_guard<std::mutex> lock(mAnalysisMutex);
+      mRunAnalysis = false;
+    }
+
+    mAnalysisCV.notify_one();
+    mAnalysisThread.join();
+  }
+
+  bool GetAnalysisThreadRunning() const { return mAnalysisThread.joinable(); }
+
+  void PrepareDataForUI(ISenderData<MAXNC, TDataPacket>& d) override
+  {
+    std::lock_guard<std::mutex> lock(mAnalysisMutex);
+
+    // only the last frame of the packet is sent, so the earlier ones are not transformed
+    ProcessPacket(d, [&]() {
+      for (auto ch = d.chanOffset; ch < d.chanOffset + d.nChans; ch++)
       {
-        auto& stftFrame = mSTFTFrames[stftFrameIdx];
-        
-        for (auto ch = 0; ch < MAXNC; ch++)
-        {
-          auto windowedValue = (float) d.vals[ch][s] * mWindow[stftFrame.pos];
-          stftFrame.bins[ch][stftFrame.pos].re = windowedValue;
-          stftFrame.bins[ch][stftFrame.pos].im = 0.0f;
-        }
-        
-        stftFrame.pos++;
+        WriteOutput(ch, d.vals[ch].data());
+      }
+    }, false);
+  }
 
-        if (stftFrame.pos >= fftSize)
-        {
-          stftFrame.pos = 0;
-          
-          for (auto ch = 0; ch < MAXNC; ch++)
-          {
-            Permute(ch, stftFrameIdx);
-            memcpy(d.vals[ch].data(), mSTFTOutput[ch].data(), fftSize * sizeof(float));
-          }
-        }
+  void TransmitData(IEditorDelegate& dlg) override
+  {
+    if (!GetAnalysisThreadRunning())
+    {
+      TBufferSender::TransmitData(dlg);
+      return;
+    }
+
+    while (TColumnData* pData = mColumnQueue.BeginPop())
+    {
+      assert(pData->ctrlTag != kNoTag && "You must supply a control tag");
+      dlg.SendControlMsgFromDelegate(pData->ctrlTag, kColumnsMessage, sizeof(TColumnData), (void*) pData);
+      mColumnQueue.EndPop();
+    }
+  }
+
+  void TransmitDataToControlsWithTags(IEditorDelegate& dlg, const std::initializer_list<int>& ctrlTags) override
+  {
+    if (!GetAnalysisThreadRunning())
+    {
+      TBufferSender::TransmitDataToControlsWithTags(dlg, ctrlTags);
+      return;
+    }
+
+    while (TColumnData* pData = mColumnQueue.BeginPop())
+    {
+      for (auto tag : ctrlTags)
+      {
+        pData->ctrlTag = tag;
+        dlg.SendControlMsgFromDelegate(tag, kColumnsMessage, sizeof(TColumnData), (void*) pData);
       }
+        
+      mColumnQueue.EndPop();
     }
   }
 
@@ -608,25 +908,15 @@ public:
 private:
   void SetFFTSize()
   {
-    if (mSTFTFrames.size() != mOverlap)
-    {
-      mSTFTFrames.resize(mOverlap);
-    }
-    
-    for (auto&& frame : mSTFTFrames)
-    {
-      for (auto ch = 0; ch < MAXNC; ch++)
-      {
-        std::fill(frame.bins[ch].begin(), frame.bins[ch].end(), WDL_FFT_COMPLEX{0.0f, 0.0f});
-      }
-      
-      frame.pos = 0;
-    }
+    const auto fftSize = TBufferSender::GetBufferSize();
     
     for (auto ch = 0; ch < MAXNC; ch++)
     {
-      std::fill(mSTFTOutput[ch].begin(), mSTFTOutput[ch].end(), 0.0f);
+      std::fill(mHistory[ch].begin(), mHistory[ch].end(), 0.0f);
     }
+
+    mHistoryPos = 0;
+    mHopSize = std::max(fftSize / std::max(mOverlap, 1), 1);
   }
   
   void CalculateWindow()
@@ -682,48 +972,284 @@ private:
     mScalingFactor = scaling * scaling;
   }
   
-  void Permute(int ch, int frameIdx)
+  /** Precalculate the fractional bin at each column edge */
+  void CalculateColumnBins()
+  {
+    const auto nBins = TBufferSender::GetBufferSize() / 2;
+    const auto nColumns = mColumnLayout.nColumns;
+    const auto lo = std::max(mColumnLayout.freqLo, 1e-6f);
+    const auto hi = std::max(mColumnLayout.freqHi, lo);
+
+    for (auto c = 0; c <= nColumns; c++)
+    {
+      const auto t = static_cast<float>(c) / static_cast<float>(std::max(nColumns, 1));
+      const auto freq = mColumnLayout.logScale ? lo * std::pow(hi / lo, t) : lo + (hi - lo) * t;
+      mColumnBins[c] = Clip(freq * nBins, 0.0f, static_cast<float>(nBins - 1));
+    }
+  }
+
+  /** Push a packet of samples into the history, calling onFrame after the transform of each frame that completes
+   * @param allFrames Transform every frame that completes in the packet, rather than only the last one */
+  template <typename F>
+  void ProcessPacket(const ISenderData<MAXNC, TDataPacket>& d, F&& onFrame, bool allFrames)
   {
     const auto fftSize = TBufferSender::GetBufferSize();
-    WDL_fft(mSTFTFrames[frameIdx].bins[ch].data(), fftSize, false);
 
-    if (mOutputType == EOutputType::Complex)
+    for (auto start = 0; start < fftSize; start += mHopSize)
     {
-      auto nBins = fftSize/2;
-      for (auto i = 0; i < nBins; ++i)
+      const auto n = std::min(mHopSize, fftSize - start);
+      
+      for (auto ch = d.chanOffset; ch < d.chanOffset + d.nChans; ch++)
       {
-        int sortIdx = WDL_fft_permute(fftSize, i);
-        mSTFTOutput[ch][i] = mSTFTFrames[frameIdx].bins[ch][sortIdx].re;
-        mSTFTOutput[ch][i + nBins] = mSTFTFrames[frameIdx].bins[ch][sortIdx].im;
+        auto pos = mHistoryPos;
+        for (auto s = start; s < start + n; s++)
+        {
+          mHistory[ch][pos] = d.vals[ch][s];
+          if (++pos == fftSize)
+            pos = 0;
+        }
+      }
+      
+      mHistoryPos = (mHistoryPos + n) % fftSize;
+
+      if (allFrames || (start + n >= fftSize))
+      {
+        Transform(d.chanOffset, d.nChans);
+        onFrame();
+      }
+    }
+  }
+  
+  /** Window the history of the channels and transform it into mRe/mIm, two channels per complex FFT */
+  void Transform(int chanOffset, int nChans)
+  {
+    const auto fftSize = TBufferSender::GetBufferSize();
+    const auto nBins = fftSize / 2;
+    const auto tailSize = fftSize - mHistoryPos;
+    const int* permute = WDL_fft_permute_tab(fftSize);
+    WDL_FFT_COMPLEX* pBuf = mFFTBuffer.data();
+
+    auto ch = chanOffset;
+    for (; ch + 1 < chanOffset + nChans; ch += 2)
+    {
+      // the oldest sample is at mHistoryPos
+      const float* pX = mHistory[ch].data();
+      const float* pY = mHistory[ch + 1].data();
+      
+      for (auto i = 0; i < tailSize; i++)
+      {
+        pBuf[i].re = pX[mHistoryPos + i] * mWindow[i];
+        pBuf[i].im = pY[mHistoryPos + i] * mWindow[i];
+      }
+      
+      for (auto i = tailSize; i < fftSize; i++)
+      {
+        pBuf[i].re = pX[i - tailSize] * mWindow[i];
+        pBuf[i].im = pY[i - tailSize] * mWindow[i];
+      }
+
+      WDL_fft(pBuf, fftSize, false);
+
+      // separate the spectra: X[k] = (Z[k] + conj(Z[N-k])) / 2, Y[k] = (Z[k] - conj(Z[N-k])) / 2i
+      float* pXRe = mRe[ch].data();
+      float* pXIm = mIm[ch].data();
+      float* pYRe = mRe[ch + 1].data();
+      float* pYIm = mIm[ch + 1].data();
+      
+      for (auto k = 0; k < nBins; k++)
+      {
+        const WDL_FFT_COMPLEX& a = pBuf[permute[k]];
+        const WDL_FFT_COMPLEX& b = pBuf[permute[(fftSize - k) & (fftSize - 1)]];
+        pXRe[k] = static_cast<float>(0.5 * (a.re + b.re));
+        pXIm[k] = static_cast<float>(0.5 * (a.im - b.im));
+        pYRe[k] = static_cast<float>(0.5 * (a.im + b.im));
+        pYIm[k] = static_cast<float>(0.5 * (b.re - a.re));
       }
     }
+
+    if (ch < chanOffset + nChans) // an odd channel out
+    {
+      WDL_FFT_REAL* pRealBuf = reinterpret_cast<WDL_FFT_REAL*>(pBuf);
+      const float* pX = mHistory[ch].data();
+      
+      // the real FFT expects input scaled by 0.5, relative to the complex one
+      for (auto i = 0; i < tailSize; i++)
+        pRealBuf[i] = 0.5f * pX[mHistoryPos + i] * mWindow[i];
+      
+      for (auto i = tailSize; i < fftSize; i++)
+        pRealBuf[i] = 0.5f * pX[i - tailSize] * mWindow[i];
+
+      WDL_real_fft(pRealBuf, fftSize, false);
+
+      const int* permuteHalf = WDL_fft_permute_tab(nBins);
+      
+      for (auto k = 0; k < nBins; k++)
+      {
+        const WDL_FFT_COMPLEX& a = pBuf[permuteHalf[k]];
+        mRe[ch][k] = static_cast<float>(a.re);
+        mIm[ch][k] = static_cast<float>(a.im);
+      }
+      
+      mIm[ch][0] = 0.0f; // holds the Nyquist bin
+    }
+  }
+
+  /** Write the last transform of a channel to pOutput in the format set with SetOutputType() */
+  void WriteOutput(int ch, float* pOutput)
+  {
+    const auto nBins = TBufferSender::GetBufferSize() / 2;
+
+    if (mOutputType == EOutputType::Complex)
+    {
+      std::copy(mRe[ch].begin(), mRe[ch].begin() + nBins, pOutput);
+      std::copy(mIm[ch].begin(), mIm[ch].begin() + nBins, pOutput + nBins);
+    }
     else // magPhase
     {
-      auto nBins = fftSize/2;
-      for (auto i = 0; i < nBins; ++i)
+      CalculateMagnitudes(ch, pOutput);
+      CalculatePhases(ch, pOutput + nBins);
+    }
+  }
+
+  void CalculateMagnitudes(int ch, float* pOutput)
+  {
+    const auto nBins = TBufferSender::GetBufferSize() / 2;
+    const float scale = 2.0f / mScalingFactor;
+    const float* pRe = mRe[ch].data();
+    const float* pIm = mIm[ch].data();
+#if defined OS_IOS || defined OS_MAC
+    DSPSplitComplex split { const_cast<float*>(pRe), const_cast<float*>(pIm) };
+    vDSP_zvmags(&split, 1, pOutput, 1, nBins);
+    vDSP_vsmul(pOutput, 1, &scale, pOutput, 1, nBins);
+    vvsqrtf(pOutput, pOutput, &nBins);
+#else
+    for (auto k = 0; k < nBins; k++)
+    {
+      pOutput[k] = std::sqrt(scale * (pRe[k] * pRe[k] + pIm[k] * pIm[k]));
+    }
+#endif
+  }
+
+  void CalculatePhases(int ch, float* pOutput)
+  {
+    const auto nBins = TBufferSender::GetBufferSize() / 2;
+    const float* pRe = mRe[ch].data();
+    const float* pIm = mIm[ch].data();
+#if defined OS_IOS || defined OS_MAC
+    DSPSplitComplex split { const_cast<float*>(pRe), const_cast<float*>(pIm) };
+    vDSP_zvphas(&split, 1, pOutput, 1, nBins);
+#else
+    for (auto k = 0; k < nBins; k++)
+    {
+      pOutput[k] = FastAtan2(pIm[k], pRe[k]);
+    }
+#endif
+  }
+
+  /** A branch free atan2, so that the loop above vectorizes. The maximum error is about 1e-5 radians */
+  static inline float FastAtan2(float y, float x)
+  {
+    const float ax = std::fabs(x);
+    const float ay = std::fabs(y);
+    const float mx = ax > ay ? ax : ay;
+    const float mn = ax > ay ? ay : ax;
+    const float a = mn / (mx + 1e-30f);
+    const float s = a * a;
+    float r = ((((-0.0117212f * s + 0.05265332f) * s - 0.11643287f) * s + 0.19354346f) * s - 0.33262347f) * s * a + 0.99997726f * a;
+    r = ay > ax ? 1.57079637f - r : r;
+    r = x < 0.0f ? 3.14159274f - r : r;
+    return y < 0.0f ? -r : r;
+  }
+
+  /** Reduce a channel's magnitudes to the column layout */
+  void ReduceToColumns(const float* pMags, float* pColumns) const
+  {
+    const auto nColumns = mColumnLayout.nColumns;
+    const auto lastBin = TBufferSender::GetBufferSize() / 2 - 1;
+
+    for (auto c = 0; c < nColumns; c++)
+    {
+      const float lo = mColumnBins[c];
+      const float hi = mColumnBins[c + 1];
+      const int first = static_cast<int>(std::ceil(lo));
+      const int last = static_cast<int>(hi);
+
+      if (last > first) // the peak of the bins in the column
       {
-        int sortIdx = WDL_fft_permute(fftSize, i);
-        auto re = mSTFTFrames[frameIdx].bins[ch][sortIdx].re;
-        auto im = mSTFTFrames[frameIdx].bins[ch][sortIdx].im;
-        mSTFTOutput[ch][i] = std::sqrt(2.0f * (re * re + im * im) / mScalingFactor);
-        mSTFTOutput[ch][i + nBins] = std::atan2(im, re);
+        pColumns[c] = *std::max_element(pMags + first, pMags + last + 1);
+      }
+      else // narrower than a bin, interpolate at the centre of the column
+      {
+        const float centre = 0.5f * (lo + hi);
+        const int i = static_cast<int>(centre);
+        const int j = std::min(i + 1, lastBin);
+        const float frac = centre - static_cast<float>(i);
+        pColumns[c] = pMags[i] + frac * (pMags[j] - pMags[i]);
       }
     }
   }
-  
-  struct STFTFrame
+
+  void AnalysisLoop()
   {
-    int pos;
-    std::array<std::array<WDL_FFT_COMPLEX, MAX_FFT_SIZE>, MAXNC> bins;
-  };
+    std::unique_lock<std::mutex> lock(mAnalysisMutex);
+
+    while (mRunAnalysis)
+    {
+      while (ISenderData<MAXNC, TDataPacket>* pData = TBufferSender::mQueue.BeginPop())
+      {
+        const ISenderData<MAXNC, TDataPacket>& d = *pData;
+        
+        ProcessPacket(d, [&]() {
+          if (!mColumnLayout.nColumns)
+            return;
+          
+          TColumnData& out = mColumnData;
+          out.ctrlTag = d.ctrlTag;
+          out.nChans = d.nChans;
+          out.chanOffset = d.chanOffset;
+          out.nColumns = mColumnLayout.nColumns;
+
+          for (auto ch = d.chanOffset; ch < d.chanOffset + d.nChans; ch++)
+          {
+            CalculateMagnitudes(ch, mMags.data());
+            ReduceToColumns(mMags.data(), out.vals[ch].data());
+          }
+
+          // if the UI is not keeping up, drop the frame
+          mColumnQueue.Push(out);
+        }, true);
+        
+        TBufferSender::mQueue.EndPop();
+      }
+
+      // the audio thread doesn't signal new data, so poll at a rate well above the display refresh rate
+      mAnalysisCV.wait_for(lock, std::chrono::milliseconds(kAnalysisPollMs), [this]() { return !mRunAnalysis; });
+    }
+  }
+
+  static constexpr int kAnalysisPollMs = 2;
   
   int mOverlap = 2;
+  int mHopSize = 512;
+  int mHistoryPos = 0;
   EWindowType mWindowType;
   EOutputType mOutputType;
   std::array<float, MAX_FFT_SIZE> mWindow;
-  std::vector<STFTFrame> mSTFTFrames;
-  std::array<std::array<float, MAX_FFT_SIZE>, MAXNC> mSTFTOutput;
+  std::array<std::array<float, MAX_FFT_SIZE>, MAXNC> mHistory; // circular, the last fftSize samples of each channel
+  std::array<WDL_FFT_COMPLEX, MAX_FFT_SIZE> mFFTBuffer;
+  std::array<std::array<float, MAX_FFT_SIZE / 2>, MAXNC> mRe, mIm; // the spectrum of each channel, in bin order
+  std::array<float, MAX_FFT_SIZE / 2> mMags;
   float mScalingFactor = 0.0f;
+
+  // analysis thread
+  ISpectrumColumnLayout mColumnLayout;
+  std::array<float, MAX_COLUMNS + 1> mColumnBins;
+  TColumnData mColumnData;
+  IPlugQueue<TColumnData> mColumnQueue {QUEUE_SIZE};
+  std::thread mAnalysisThread;
+  std::mutex mAnalysisMutex;
+  std::condition_variable mAnalysisCV;
+  bool mRunAnalysis = false; // guarded by mAnalysisMutex
 };
 
 END_IPLUG_NAMESPACE
@@ -235,6 +235,10 @@ bool IPlugVST3ProcessorBase::SetProcessing(bool state)
   if (!state)
     OnReset();
   
+#ifdef PARAMS_SNAPSHOT
+  mPlug.SetParamSnapshotProcessing(state);
+#endif
+  
   return true;
 }
 
@@ -307,7 +311,22 @@ void IPlugVST3ProcessorBase::ProcessParameterChanges(ProcessData& data, IPlugQue
             }
             default:
             {
-              if (idx >= 0 && idx < mPlug.NParams())
+              if (idx >= 0 && idx < mPlug.NParams() && GetSampleAccurateParamChanges())
+              {
+                // Queue every point, not just the last one, so that ProcessBlock() can be split at each change
+                for (int32 pointIdx = 0; pointIdx < numPoints; pointIdx++)
+                {
+                  int32 pointOffset;
+                  double pointValue;
+                  
+                  if (paramQueue->getPoint(pointIdx, pointOffset, pointValue) == kResultTrue)
+                  {
+                    if (!EnqueueParamEvent(idx, pointValue, pointOffset))
+                      ApplyParamEvent(IParamEvent(idx, pointValue, pointOffset));
+                  }
+                }
+              }
+              else if (idx >= 0 && idx < mPlug.NParams())
               {
 #ifdef PARAMS_MUTEX
                 mPlug.mParams_mutex.Enter();
@@ -347,6 +366,19 @@ void IPlugVST3ProcessorBase::ProcessParameterChanges(ProcessData& data, IPlugQue
   }
 }
 
+void IPlugVST3ProcessorBase::ApplyParamEvent(const IParamEvent& event)
+{
+  // Queued events are applied from ProcessBuffers(), which already holds the (recursive) mutex, overflowing ones from ProcessParameterChanges(), which doesn't
+#ifdef PARAMS_MUTEX
+  mPlug.mParams_mutex.Enter();
+#endif
+  mPlug.GetParam(event.idx)->SetNormalized(event.value);
+  mPlug.OnParamChange(event.idx, kHost, event.offset);
+#ifdef PARAMS_MUTEX
+  mPlug.mParams_mutex.Leave();
+#endif
+}
+
 void IPlugVST3ProcessorBase::ProcessAudio(ProcessData& data, ProcessSetup& setup, const BusList& ins, const BusList& outs)
 {
   int32 sampleSize = setup.symbolicSampleSize;
@@ -424,6 +456,9 @@ void IPlugVST3ProcessorBase::ProcessAudio(ProcessData& data, ProcessSetup& setup
 void IPlugVST3ProcessorBase::Process(ProcessData& data, ProcessSetup& setup, const BusList& ins, const BusList& outs, IPlugQueue<IMidiMsg>& fromEditor, IPlugQueue<IMidiMsg>& fromProcessor, IPlugQueue<SysExData>& sysExFromEditor, SysExData& sysExBuf)
 {
   PrepareProcessContext(data, setup);
+#ifdef PARAMS_SNAPSHOT
+  mPlug.ApplyParamSnapshot();
+#endif
   ProcessParameterChanges(data, fromProcessor);
   
   if (DoesMIDIIn())
@@ -190,6 +190,7 @@ public:
   
   // IPlugProcessor overrides
   bool SendMidiMsg(const IMidiMsg& msg) override;
+  void ApplyParamEvent(const IParamEvent& event) override;
 
 private:
   int mMaxNChansForMainInputBus = 0;
@@ -3,6 +3,14 @@
 
 #include "IControls.h"
 
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#if defined IGRAPHICS_SKIA && defined IGRAPHICS_CPU
+#include "IGraphicsSkia.h"
+#endif
+
 IGraphicsStressTest::IGraphicsStressTest(const InstanceInfo& info)
 : Plugin(info, MakeConfig(kNumParams, 1))
 {
@@ -62,13 +70,16 @@ void IGraphicsStressTest::LayoutUI(IGraphics* pGraphics)
     GetUI()->SetAllControlsDirty();
   };
   
-  pGraphics->SetKeyHandlerFunc([DoFunc](const IKeyPress& key, bool isUp)
+  pGraphics->SetKeyHandlerFunc([this, DoFunc](const IKeyPress& key, bool isUp)
   {
     if(!isUp) {
       switch (key.VK) {
         case kVK_UP: DoFunc(EFunc::More); return true;
         case kVK_DOWN: DoFunc(EFunc::Less); return true;
         case kVK_TAB: key.S ? DoFunc(EFunc::Prev) : DoFunc(EFunc::Next); return true;
+        case kVK_B: RunControlBenchmark(GetUI()); return true;
+        case kVK_O: RunRectOptimizeBenchmark(GetUI()); return true;
+        case kVK_F: RunFrameTimeBenchmark(GetUI()); return true;
         default: return false;
       }
     }
@@ -88,6 +99,9 @@ void IGraphicsStressTest::LayoutUI(IGraphics* pGraphics)
     {
       g.DrawText(IText(30), "Press tab to go to next test", r);
       g.DrawText(IText(30), "up/down to change the # of things", r.GetVShifted(40.f));
+      g.DrawText(IText(30), "B to benchmark per-frame overhead with 10k controls", r.GetVShifted(80.f));
+      g.DrawText(IText(30), "O to test and benchmark IRECTList::Optimize()", r.GetVShifted(120.f));
+      g.DrawText(IText(30), "F to benchmark offscreen frame times (Skia CPU)", r.GetVShifted(160.f));
     }
     else
     //      if (!g.CheckLayer(pCaller->mLayer))
@@ -171,4 +185,296 @@ void IGraphicsStressTest::LayoutUI(IGraphics* pGraphics)
   });
 
 }
+
+void IGraphicsStressTest::RunControlBenchmark(IGraphics* pGraphics)
+{
+  // Measures the per-frame UI overhead that doesn't depend on drawing: finding the control under the mouse,
+  // animating and collecting dirty controls, and cleaning them, with and without the spatial index and dirty tracking
+  static constexpr int kNumControls = 10000;
+  static constexpr int kNumAnimating = 64;
+  static constexpr int kNumFrames = 500;
+
+  const IRECT area = pGraphics->GetControl(1)->GetRECT();
+  const int startIdx = pGraphics->NControls();
+  const int nColumns = static_cast<int>(std::ceil(std::sqrt(kNumControls * area.W() / area.H())));
+  const int nRows = (kNumControls + nColumns - 1) / nColumns;
+
+  for (int i = 0; i < kNumControls; i++)
+  {
+    IControl* pControl = pGraphics->AttachControl(new IPanelControl(area.GetGridCell(i, nRows, nColumns).GetPadded(-1.f), IColor::GetRandomColor()));
+
+    if (i % (kNumControls / kNumAnimating) == 0)
+      pControl->SetAnimation([](IControl* pCaller) {});
+  }
+
+  const bool mouseOverEnabled = pGraphics->MouseOverEnabled();
+  pGraphics->EnableMouseOver(true);
+
+  auto timeFrames = [&](bool accelerate) {
+    pGraphics->EnableSpatialIndex(accelerate);
+    pGraphics->EnableDirtyTracking(accelerate);
+
+    IRECTList rects;
+    IMouseMod mod;
+    std::srand(1);
+
+    auto doFrame = [&]() {
+      const float x = area.L + area.W() * static_cast<float>(std::rand()) / RAND_MAX;
+      const float y = area.T + area.H() * static_cast<float>(std::rand()) / RAND_MAX;
+      pGraphics->OnMouseOver(x, y, mod);
+      rects.Clear();
+      pGraphics->IsDirty(rects);
+      pGraphics->SetAllControlsClean();
+    };
+
+    // Let the newly attached controls settle, and build the index
+    doFrame();
+    doFrame();
+
+    const auto start = std::chrono::high_resolution_clock::now();
+
+    for (int f = 0; f < kNumFrames; f++)
+      doFrame();
+
+    const std::chrono::duration<double, std::micro> elapsed = std::chrono::high_resolution_clock::now() - start;
+    return elapsed.count() / kNumFrames;
+  };
+
+  const double linearTime = timeFrames(false);
+  const double acceleratedTime = timeFrames(true);
+
+  pGraphics->EnableSpatialIndex(false);
+  pGraphics->EnableDirtyTracking(false);
+  pGraphics->EnableMouseOver(mouseOverEnabled);
+  pGraphics->RemoveControls(startIdx);
+  pGraphics->SetAllControlsDirty();
+
+  DBGMSG("%i controls: %.1f us/frame linear, %.1f us/frame with spatial index and dirty tracking\n", kNumControls, linearTime, acceleratedTime);
+  pGraphics->GetControlWithTag(kCtrlTagTestNum)->As<ITextControl>()->SetStrFmt(128, "10k controls: %.0f / %.0f us per frame", linearTime, acceleratedTime);
+}
+
+namespace {
+
+// The previous IRECTList::Optimize() algorithm, kept here as a reference for RunRectOptimizeBenchmark()
+void LegacyOptimize(std::vector<IRECT>& rects)
+{
+  auto shrink = [](const IRECT& r, const IRECT& i) {
+    if (i.L != r.L)
+      return IRECT(r.L, r.T, i.L, r.B);
+    if (i.T != r.T)
+      return IRECT(r.L, r.T, r.R, i.T);
+    if (i.R != r.R)
+      return IRECT(i.R, r.T, r.R, r.B);
+    return IRECT(r.L, i.B, r.R, r.B);
+  };
+
+  auto split = [&rects](const IRECT r, const IRECT& i) {
+    if (r.L == i.L)
+    {
+      if (r.T == i.T)
+      {
+        rects.push_back(IRECT(i.R, r.T, r.R, i.B));
+        return IRECT(r.L, i.B, r.R, r.B);
+      }
+
+      rects.push_back(IRECT(r.L, r.T, r.R, i.T));
+      return IRECT(i.R, i.T, r.R, r.B);
+    }
+
+    if (r.T == i.T)
+    {
+      rects.push_back(IRECT(r.L, r.T, i.L, i.B));
+      return IRECT(r.L, i.B, r.R, r.B);
+    }
+
+    rects.push_back(IRECT(r.L, r.T, r.R, i.T));
+    return IRECT(r.L, i.T, i.L, r.B);
+  };
+
+  for (int i = 0; i < static_cast<int>(rects.size()); i++)
+  {
+    for (int j = i + 1; j < static_cast<int>(rects.size()); j++)
+    {
+      if (rects[i].Contains(rects[j]))
+      {
+        rects.erase(rects.begin() + j);
+        j--;
+      }
+      else if (rects[j].Contains(rects[i]))
+      {
+        rects.erase(rects.begin() + i);
+        i--;
+        break;
+      }
+      else if (rects[i].Intersects(rects[j]))
+      {
+        IRECT intersection = rects[i].Intersect(rects[j]);
+
+        if (rects[i].Mergeable(intersection))
+          rects[i] = shrink(rects[i], intersection);
+        else if (rects[j].Mergeable(intersection))
+          rects[j] = shrink(rects[j], intersection);
+        else if (rects[i].Area() < rects[j].Area())
+          rects[i] = split(rects[i], intersection);
+        else
+          rects[j] = split(rects[j], intersection);
+      }
+    }
+  }
+
+  for (int i = 0; i < static_cast<int>(rects.size()); i++)
+  {
+    for (int j = i + 1; j < static_cast<int>(rects.size()); j++)
+    {
+      if (rects[i].Mergeable(rects[j]))
+      {
+        rects[j] = rects[i].Union(rects[j]);
+        rects.erase(rects.begin() + i);
+        i = -1;
+        break;
+      }
+    }
+  }
+}
+
+// Counts how many times each pixel of a width x height area is covered by the rects
+template <typename GetRectFunc>
+void RasterizeRects(int nRects, GetRectFunc getRect, int width, int height, std::vector<int>& coverage)
+{
+  coverage.assign(width * height, 0);
+
+  for (int i = 0; i < nRects; i++)
+  {
+    const IRECT r = getRect(i);
+
+    for (int y = std::max(0, static_cast<int>(r.T)); y < std::min(height, static_cast<int>(r.B)); y++)
+    {
+      for (int x = std::max(0, static_cast<int>(r.L)); x < std::min(width, static_cast<int>(r.R)); x++)
+        coverage[y * width + x]++;
+    }
+  }
+}
+
+} // namespace
+
+void IGraphicsStressTest::RunRectOptimizeBenchmark(IGraphics* pGraphics)
+{
+  // Checks that IRECTList::Optimize() covers exactly the same pixels as its input, without overlaps,
+  // and times it against the previous algorithm, for random pixel-aligned rects like those from many small controls
+  const int width = pGraphics->Width();
+  const int height = pGraphics->Height();
+  std::vector<int> inputCoverage, outputCoverage;
+  bool passed = true;
+
+  std::srand(1);
+
+  for (int nRects : {10, 100, 1000, 5000})
+  {
+    IRECTList input;
+
+    for (int i = 0; i < nRects; i++)
+    {
+      const float l = static_cast<float>(std::rand() % width);
+      const float t = static_cast<float>(std::rand() % height);
+      input.Add(IRECT(l, t, std::min<float>(width, l + 1 + std::rand() % 60), std::min<float>(height, t + 1 + std::rand() % 60)));
+    }
+
+    const int nRepeats = std::max(1, 1000 / nRects);
+    double optimizeTime = 0.;
+    double legacyTime = 0.;
+    int nOptimized = 0;
+    int nLegacy = 0;
+
+    for (int r = 0; r < nRepeats; r++)
+    {
+      IRECTList rects;
+      std::vector<IRECT> legacyRects;
+
+      for (int i = 0; i < input.Size(); i++)
+      {
+        rects.Add(input.Get(i));
+        legacyRects.push_back(input.Get(i));
+      }
+
+      auto start = std::chrono::high_resolution_clock::now();
+      rects.Optimize();
+      optimizeTime += std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count();
+
+      start = std::chrono::high_resolution_clock::now();
+      LegacyOptimize(legacyRects);
+      legacyTime += std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count();
+
+      nOptimized = rects.Size();
+      nLegacy = static_cast<int>(legacyRects.size());
+
+      if (r == 0)
+      {
+        RasterizeRects(input.Size(), [&](int i) { return input.Get(i); }, width, height, inputCoverage);
+        RasterizeRects(rects.Size(), [&](int i) { return rects.Get(i); }, width, height, outputCoverage);
+
+        for (size_t p = 0; p < inputCoverage.size(); p++)
+        {
+          if ((inputCoverage[p] > 0) != (outputCoverage[p] == 1))
+          {
+            DBGMSG("IRECTList::Optimize() FAILED with %i rects: pixel %i,%i covered %i times, %i in input\n", nRects,
+                   static_cast<int>(p) % width, static_cast<int>(p) / width, outputCoverage[p], inputCoverage[p]);
+            passed = false;
+            break;
+          }
+        }
+      }
+    }
+
+    DBGMSG("%i rects: Optimize() %.1f us -> %i rects, previous algorithm %.1f us -> %i rects\n", nRects,
+           optimizeTime / nRepeats, nOptimized, legacyTime / nRepeats, nLegacy);
+  }
+
+  pGraphics->GetControlWithTag(kCtrlTagTestNum)->As<ITextControl>()->SetStrFmt(128, "IRECTList::Optimize() %s, timings in debug output", passed ? "passed" : "FAILED");
+}
+
+void IGraphicsStressTest::RunFrameTimeBenchmark(IGraphics* pGraphics)
+{
+#if defined IGRAPHICS_SKIA && defined IGRAPHICS_CPU
+  // Times full redraws of the current test into the backing surface, without presenting them, with single and multi-threaded rasterization
+  static constexpr int kNumFrames = 50;
+
+  IGraphicsSkia* pSkia = static_cast<IGraphicsSkia*>(pGraphics);
+  const int prevNumThreads = pSkia->GetNumRenderThreads();
+  const int maxNumThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+  WDL_String results;
+
+  if (mKindOfThing == 0)
+    mKindOfThing = 2;
+
+  for (int nThreads : {1, maxNumThreads})
+  {
+    pSkia->SetNumRenderThreads(nThreads);
+    IRECTList rects;
+    std::srand(1);
+
+    const auto start = std::chrono::high_resolution_clock::now();
+
+    for (int f = 0; f < kNumFrames; f++)
+    {
+      pGraphics->SetAllControlsDirty();
+      rects.Clear();
+      pGraphics->IsDirty(rects);
+      pSkia->DrawOffscreen(rects);
+    }
+
+    const std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+    DBGMSG("Test %i, %i things, %i render threads: %.2f ms/frame\n", mKindOfThing, mNumberOfThings, nThreads, elapsed.count() / kNumFrames);
+    results.AppendFormatted(64, "%i thread(s) %.1f ms ", nThreads, elapsed.count() / kNumFrames);
+
+    if (maxNumThreads == 1)
+      break;
+  }
+
+  pSkia->SetNumRenderThreads(prevNumThreads);
+  pGraphics->GetControlWithTag(kCtrlTagTestNum)->As<ITextControl>()->SetStr(results.Get());
+  pGraphics->SetAllControlsDirty();
+#else
+  pGraphics->GetControlWithTag(kCtrlTagTestNum)->As<ITextControl>()->SetStr("Frame time benchmark needs IGRAPHICS_SKIA and IGRAPHICS_CPU");
+#endif
+}
 #endif
@@ -30,6 +30,9 @@ public:
 #if IPLUG_EDITOR
   void LayoutUI(IGraphics* pGraphics) override;
   void OnParentWindowResize(int width, int height) override;
+  void RunControlBenchmark(IGraphics* pGraphics);
+  void RunRectOptimizeBenchmark(IGraphics* pGraphics);
+  void RunFrameTimeBenchmark(IGraphics* pGraphics);
 public:
   int mNumberOfThings = 16;
   int mKindOfThing = 0;
@@ -0,0 +1,208 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+// Streams numbered elements from a producer thread to a consumer thread through an IPlugQueue, with Push()/Pop(), PushN()/PopN()
+// and BeginPush()/BeginPop(), for several capacities, and prints the throughput of each. Checks that:
+// - every element arrives once, in order, and its payload is not torn
+// - ElementsAvailable() never exceeds Capacity(), and on the consumer side never exceeds what was pushed
+// - a queue holds exactly Capacity() elements, Capacity() is rounded up to a power of two and the indices wrap around correctly
+// Build with -fsanitize=thread to check the memory ordering as well.
+// See README.md for how to build and run it
+
+#include <atomic>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "IPlugQueue.h"
+#include "TestUtils.h"
+
+using namespace iplug;
+
+// about the size of a parameter change or MIDI message with a timestamp
+struct Element
+{
+  uint64_t mSeq = 0;
+  uint64_t mPayload[3] = {};
+
+  static Element Make(uint64_t seq)
+  {
+    Element e;
+    e.mSeq = seq;
+    for (int i = 0; i < 3; i++)
+      e.mPayload[i] = seq * 0x9E3779B97F4A7C15ull + i;
+    return e;
+  }
+
+  bool IsValid() const
+  {
+    for (int i = 0; i < 3; i++)
+    {
+      if (mPayload[i] != mSeq * 0x9E3779B97F4A7C15ull + i)
+        return false;
+    }
+    return true;
+  }
+};
+
+enum EMode
+{
+  kSingle,
+  kBatch,
+  kInPlace,
+  kMixed
+};
+
+static const char* kModeNames[] = {"Push/Pop", "PushN/PopN", "BeginPush/BeginPop", "mixed"};
+
+static void Stream(int capacity, EMode mode, uint64_t nElements)
+{
+  constexpr int kBatchSize = 16;
+  IPlugQueue<Element> queue(capacity);
+  std::atomic<uint64_t> pushing {0}; // stored before each push, so the consumer never sees more elements than this
+  bool ordered = true, intact = true, bounded = true;
+  uint64_t received = 0;
+
+  const double start = testutils::Seconds();
+
+  std::thread producer([&]() {
+    Element batch[kBatchSize];
+    uint64_t seq = 0;
+
+    while (seq < nElements)
+    {
+      const EMode m = mode == kMixed ? static_cast<EMode>(seq % 3) : mode;
+      const int nWanted = m == kBatch ? static_cast<int>(std::min<uint64_t>(kBatchSize, nElements - seq)) : 1;
+      pushing.store(seq + nWanted, std::memory_order_release);
+      int n = 0;
+
+      if (m == kSingle)
+      {
+        n = queue.Push(Element::Make(seq)) ? 1 : 0;
+      }
+      else if (m == kBatch)
+      {
+        for (int i = 0; i < nWanted; i++)
+          batch[i] = Element::Make(seq + i);
+        n = queue.PushN(batch, nWanted);
+      }
+      else if (Element* pSlot = queue.BeginPush())
+      {
+        *pSlot = Element::Make(seq);
+        queue.EndPush();
+        n = 1;
+      }
+
+      seq += n;
+      bounded &= queue.ElementsAvailable() <= queue.Capacity();
+
+      if (!n)
+        std::this_thread::yield();
+    }
+  });
+
+  Element batch[kBatchSize];
+
+  while (received < nElements)
+  {
+    const EMode m = mode == kMixed ? static_cast<EMode>((received / 5) % 3) : mode;
+    const size_t available = queue.ElementsAvailable();
+    bounded &= available <= queue.Capacity() && available <= pushing.load(std::memory_order_acquire) - received;
+    int n = 0;
+
+    if (m == kSingle)
+    {
+      n = queue.Pop(batch[0]) ? 1 : 0;
+    }
+    else if (m == kBatch)
+    {
+      n = queue.PopN(batch, kBatchSize);
+    }
+    else if (const Element* pSlot = queue.BeginPop())
+    {
+      batch[0] = *pSlot;
+      queue.EndPop();
+      n = 1;
+    }
+
+    for (int i = 0; i < n; i++)
+    {
+      ordered &= batch[i].mSeq == received + i;
+      intact &= batch[i].IsValid();
+    }
+
+    received += n;
+
+    if (!n)
+      std::this_thread::yield();
+  }
+
+  producer.join();
+  const double seconds = testutils::Seconds() - start;
+
+  CHECK(ordered);
+  CHECK(intact);
+  CHECK(bounded);
+  CHECK(queue.WasEmpty());
+
+  printf("capacity %5zu, %-18s %7.1f M elements/s\n", queue.Capacity(), kModeNames[mode], nElements / seconds / 1e6);
+}
+
+static void TestCapacity()
+{
+  IPlugQueue<int> queue(100);
+  CHECK(queue.Capacity() == 128);
+
+  // fill the queue, then pop some but not all of it, several times, so that the indices wrap around at different offsets
+  bool exact = true, ordered = true;
+  int nextPush = 0, nextPop = 0;
+
+  for (int round = 0; round < 20; round++)
+  {
+    const int nHeld = nextPush - nextPop;
+    int n = 0;
+    while (queue.Push(nextPush))
+    {
+      nextPush++;
+      n++;
+    }
+
+    exact &= n == 128 - nHeld && queue.WasFull() && queue.ElementsAvailable() == 128;
+
+    for (int i = 0; i < 37 + round; i++)
+    {
+      int value = -1;
+      ordered &= queue.Pop(value) && value == nextPop++;
+    }
+  }
+
+  int value = -1;
+  while (queue.Pop(value))
+    ordered &= value == nextPop++;
+
+  ordered &= nextPop == nextPush;
+
+  CHECK(exact);
+  CHECK(ordered);
+  CHECK(queue.WasEmpty());
+}
+
+int main()
+{
+  TestCapacity();
+
+  for (int capacity : {2, 64, 4096})
+  {
+    for (EMode mode : {kSingle, kBatch, kInPlace, kMixed})
+      Stream(capacity, mode, 2000000);
+  }
+
+  return testutils::ReportResults("IPlugQueueTest");
+}
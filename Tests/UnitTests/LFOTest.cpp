@@ -0,0 +1,364 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+// Renders every LFO shape and polarity in Hz mode, and in BPM mode with the transport running and stopped, with LFO::ProcessBlock()
+// and LFOBank, in blocks of varying size, and prints the time per sample of each. Checks that:
+// - LFO::ProcessBlock() matches a per-sample reference that accumulates the phase and uses std::sin and std::fmod, as LFO did before
+//   it had block kernels, for double and float
+// - LFO::Process() matches LFO::ProcessBlock() in Hz mode
+// - LFOBank::ProcessBlock() matches a separate LFO per slot, and LFOBank::ProcessValues() matches the last frame of its blocks
+// Samples of the reference within 1e-9 of a jump in the square and ramp shapes are skipped, since the phase is computed differently.
+// See README.md for how to build and run it
+
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+#include "IPlugConstants.h"
+#include "IPlugUtilities.h"
+#include "LFO.h"
+#include "TestUtils.h"
+
+using namespace iplug;
+
+static constexpr double kSampleRate = 48000.;
+static const int kBlockSizes[] = {64, 13, 1, 128, 64, 37};
+static constexpr int kNumBlockSizes = sizeof(kBlockSizes) / sizeof(kBlockSizes[0]);
+
+// A host transport that plays for a while, stops for a while, and starts again somewhere else
+struct Transport
+{
+  double tempo = 97.3;
+  double qnPos = 3.21;
+  bool running = true;
+  int block = 0;
+
+  void Advance(int nFrames)
+  {
+    qnPos += nFrames * tempo / (60. * kSampleRate);
+    block++;
+
+    if (block % 150 == 0)
+    {
+      running = !running;
+      qnPos += 1.618;
+    }
+  }
+};
+
+// The LFO as it was before it had block kernels: one sample at a time, all in double
+struct ReferenceLFO
+{
+  double phase = 0.;
+  double freqHz = 1.;
+  double qnScalar = 1.;
+  double level = 1.;
+  int shape = 0;
+  bool bipolar = false;
+  bool sync = false;
+
+  static double WrapPhase(double x)
+  {
+    while (x >= 1.)
+      x -= 1.;
+    while (x < 0.)
+      x += 1.;
+    return x;
+  }
+
+  static double Shape(int shape, bool bipolar, double x)
+  {
+    switch (shape)
+    {
+      case LFO<>::kTriangle: return bipolar ? (2. * (1. - std::abs((WrapPhase(x + 0.25) * 2.) - 1.))) - 1. : 1. - std::abs((x * 2.) - 1.);
+      case LFO<>::kSquare:   return bipolar ? std::copysign(1., x - 0.5) : std::copysign(0.5, x - 0.5) + 0.5;
+      case LFO<>::kRampUp:   return bipolar ? (x * 2.) - 1. : x;
+      case LFO<>::kRampDown: return bipolar ? ((1. - x) * 2.) - 1. : 1. - x;
+      case LFO<>::kSine:     return bipolar ? std::sin(x * 6.283185307179586) : (std::sin(x * 6.283185307179586) * 0.5) + 0.5;
+      default:               return 0.;
+    }
+  }
+
+  // true if x is within 1e-9 of a jump in the shape
+  bool NearJump(double x) const
+  {
+    const bool nearWrap = std::min(x, 1. - x) < 1e-9;
+
+    if (shape == LFO<>::kSquare)
+      return nearWrap || std::abs(x - 0.5) < 1e-9;
+
+    return nearWrap && (shape == LFO<>::kRampUp || shape == LFO<>::kRampDown);
+  }
+
+  void ProcessBlock(double* pOutput, bool* pSkip, int nFrames, const Transport& transport)
+  {
+    const double samplesPerBeat = kSampleRate * 60. / transport.tempo;
+    const double incr = (sync && !transport.running ? transport.tempo / 60. : freqHz) / kSampleRate;
+
+    for (int s = 0; s < nFrames; s++)
+    {
+      if (sync && transport.running)
+        phase = std::fmod(transport.qnPos + s / samplesPerBeat, 1. / qnScalar) * qnScalar;
+      else
+        phase = WrapPhase(phase + incr * (sync ? qnScalar : 1.));
+
+      pOutput[s] = Shape(shape, bipolar, phase) * level;
+      pSkip[s] = NearJump(phase);
+    }
+  }
+};
+
+struct Config
+{
+  int shape;
+  bool bipolar;
+  bool sync;
+  double freqHz;
+  int division;
+};
+
+static std::vector<Config> MakeConfigs()
+{
+  std::vector<Config> configs;
+
+  for (int shape = 0; shape < LFO<>::kNumShapes; shape++)
+  {
+    for (bool bipolar : {false, true})
+    {
+      configs.push_back({shape, bipolar, false, 1.37, 0});
+      configs.push_back({shape, bipolar, false, 7.31, 0});
+      configs.push_back({shape, bipolar, true, 1., LFO<>::k8thT});
+      configs.push_back({shape, bipolar, true, 1., LFO<>::k1});
+    }
+  }
+
+  return configs;
+}
+
+template <typename T>
+static void Configure(LFO<T>& lfo, ReferenceLFO& reference, const Config& config)
+{
+  lfo.SetSampleRate(kSampleRate);
+  lfo.SetFreqCPS(config.freqHz);
+  lfo.SetShape(config.shape);
+  lfo.SetPolarity(config.bipolar);
+  lfo.SetRateMode(config.sync);
+  lfo.SetQNScalarFromDivision(config.division);
+  lfo.SetScalar(static_cast<T>(0.8));
+
+  reference.freqHz = config.freqHz;
+  reference.shape = config.shape;
+  reference.bipolar = config.bipolar;
+  reference.sync = config.sync;
+  reference.qnScalar = LFO<T>::GetQNScalar(static_cast<typename LFO<T>::ETempoDivison>(config.division));
+  reference.level = 0.8;
+}
+
+template <typename T>
+static void TestMatchesReference(double tolerance)
+{
+  constexpr int kNumBlocks = 3000;
+  double maxDiff = 0.;
+  int nSkipped = 0, nSamples = 0;
+
+  for (const Config& config : MakeConfigs())
+  {
+    LFO<T> lfo;
+    ReferenceLFO reference;
+    Configure(lfo, reference, config);
+    Transport transport;
+    T output[128];
+    double expected[128];
+    bool skip[128];
+
+    for (int block = 0; block < kNumBlocks; block++)
+    {
+      const int n = kBlockSizes[block % kNumBlockSizes];
+      lfo.ProcessBlock(output, n, transport.qnPos, transport.running, transport.tempo);
+      reference.ProcessBlock(expected, skip, n, transport);
+
+      for (int s = 0; s < n; s++)
+      {
+        if (skip[s])
+          nSkipped++;
+        else
+          maxDiff = std::max(maxDiff, std::abs(static_cast<double>(output[s]) - expected[s]));
+      }
+
+      nSamples += n;
+      transport.Advance(n);
+    }
+  }
+
+  printf("%-6s ProcessBlock(): max difference from the per-sample reference %g, %d of %d samples skipped at jumps\n",
+         sizeof(T) == 4 ? "float" : "double", maxDiff, nSkipped, nSamples);
+  CHECK(maxDiff < tolerance);
+  CHECK(nSkipped < nSamples / 10000);
+}
+
+static void TestProcessMatchesProcessBlock()
+{
+  double maxDiff = 0.;
+
+  for (const Config& config : MakeConfigs())
+  {
+    if (config.sync)
+      continue;
+
+    LFO<> block, perSample;
+    ReferenceLFO reference;
+    Configure(block, reference, config);
+    Configure(perSample, reference, config);
+    double output[128];
+
+    for (int b = 0; b < 1000; b++)
+    {
+      const int n = kBlockSizes[b % kNumBlockSizes];
+      block.ProcessBlock(output, n);
+
+      for (int s = 0; s < n; s++)
+        maxDiff = std::max(maxDiff, std::abs(perSample.Process(config.freqHz) - output[s]));
+    }
+  }
+
+  printf("Process(): max difference from ProcessBlock() %g\n", maxDiff);
+  CHECK(maxDiff < 1e-9);
+}
+
+static void TestBank()
+{
+  constexpr int kNumBlocks = 3000;
+  const std::vector<Config> configs = MakeConfigs();
+  const int nLFOs = static_cast<int>(configs.size());
+
+  std::vector<std::unique_ptr<LFO<>>> lfos;
+  LFOBank<> bank(nLFOs), valuesBank(nLFOs);
+  bank.SetSampleRate(kSampleRate);
+  valuesBank.SetSampleRate(kSampleRate);
+
+  for (int i = 0; i < nLFOs; i++)
+  {
+    const Config& config = configs[i];
+    ReferenceLFO reference;
+    lfos.emplace_back(new LFO<>());
+    Configure(*lfos.back(), reference, config);
+
+    for (LFOBank<>* pBank : {&bank, &valuesBank})
+    {
+      pBank->SetFreqCPS(i, config.freqHz);
+      pBank->SetShape(i, config.shape);
+      pBank->SetPolarity(i, config.bipolar);
+      pBank->SetRateMode(i, config.sync);
+      pBank->SetQNScalarFromDivision(i, config.division);
+      pBank->SetScalar(i, 0.8);
+    }
+  }
+
+  std::vector<double> bankBuffers(nLFOs * 128), lfoBuffer(128), values(nLFOs);
+  std::vector<double*> bankOutputs(nLFOs);
+  for (int i = 0; i < nLFOs; i++)
+    bankOutputs[i] = bankBuffers.data() + i * 128;
+
+  Transport transport;
+  double maxDiff = 0., maxValueDiff = 0.;
+
+  for (int block = 0; block < kNumBlocks; block++)
+  {
+    const int n = kBlockSizes[block % kNumBlockSizes];
+    bank.ProcessBlock(bankOutputs.data(), n, transport.qnPos, transport.running, transport.tempo);
+    valuesBank.ProcessValues(values.data(), n, transport.qnPos, transport.running, transport.tempo);
+
+    for (int i = 0; i < nLFOs; i++)
+    {
+      lfos[i]->ProcessBlock(lfoBuffer.data(), n, transport.qnPos, transport.running, transport.tempo);
+
+      for (int s = 0; s < n; s++)
+        maxDiff = std::max(maxDiff, std::abs(bankOutputs[i][s] - lfoBuffer[s]));
+
+      maxValueDiff = std::max(maxValueDiff, std::abs(values[i] - bankOutputs[i][n - 1]));
+    }
+
+    transport.Advance(n);
+  }
+
+  printf("LFOBank: max difference from separate LFOs %g, ProcessValues() from the last frame of ProcessBlock() %g\n", maxDiff, maxValueDiff);
+  CHECK(maxDiff < 1e-9);
+  CHECK(maxValueDiff == 0.);
+}
+
+// 64 LFOs in BPM mode with the transport running, the case where the per-sample path called std::fmod for every sample
+static void Time()
+{
+  constexpr int kNumLFOs = 64;
+  constexpr int kBlockSize = 64;
+  constexpr int kNumBlocks = 2000;
+  std::vector<Config> configs = MakeConfigs();
+  std::vector<ReferenceLFO> references(kNumLFOs);
+  std::vector<std::unique_ptr<LFO<>>> lfos;
+  LFOBank<> bank(kNumLFOs);
+  bank.SetSampleRate(kSampleRate);
+
+  for (int i = 0; i < kNumLFOs; i++)
+  {
+    Config config = configs[i % configs.size()];
+    config.sync = true;
+    lfos.emplace_back(new LFO<>());
+    Configure(*lfos.back(), references[i], config);
+    bank.SetShape(i, config.shape);
+    bank.SetPolarity(i, config.bipolar);
+    bank.SetRateMode(i, true);
+    bank.SetQNScalarFromDivision(i, config.division);
+  }
+
+  std::vector<double> buffers(kNumLFOs * kBlockSize);
+  std::vector<double*> outputs(kNumLFOs);
+  bool skip[kBlockSize];
+  for (int i = 0; i < kNumLFOs; i++)
+    outputs[i] = buffers.data() + i * kBlockSize;
+
+  double seconds[3] = {};
+  Transport transport;
+
+  for (int block = 0; block < kNumBlocks; block++)
+  {
+    double start = testutils::Seconds();
+    for (int i = 0; i < kNumLFOs; i++)
+      references[i].ProcessBlock(outputs[i], skip, kBlockSize, transport);
+    seconds[0] += testutils::Seconds() - start;
+
+    start = testutils::Seconds();
+    for (int i = 0; i < kNumLFOs; i++)
+      lfos[i]->ProcessBlock(outputs[i], kBlockSize, transport.qnPos, true, transport.tempo);
+    seconds[1] += testutils::Seconds() - start;
+
+    start = testutils::Seconds();
+    bank.ProcessBlock(outputs.data(), kBlockSize, transport.qnPos, true, transport.tempo);
+    seconds[2] += testutils::Seconds() - start;
+
+    transport.qnPos += kBlockSize * transport.tempo / (60. * kSampleRate);
+  }
+
+  const double nSamples = static_cast<double>(kNumLFOs) * kBlockSize * kNumBlocks;
+  printf("%d LFOs, BPM with the transport running: per-sample reference %.2f ns, LFO::ProcessBlock() %.2f ns, LFOBank %.2f ns per sample\n",
+         kNumLFOs, 1e9 * seconds[0] / nSamples, 1e9 * seconds[1] / nSamples, 1e9 * seconds[2] / nSamples);
+}
+
+int main()
+{
+  // the sine is a polynomial with a maximum error of about 6e-8, and the float LFO rounds the phase and the shape to float
+  TestMatchesReference<double>(2e-7);
+  TestMatchesReference<float>(2e-6);
+  TestProcessMatchesProcessBlock();
+  TestBank();
+  Time();
+
+  return testutils::ReportResults("LFOTest");
+}
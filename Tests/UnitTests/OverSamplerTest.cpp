@@ -0,0 +1,220 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+// Runs noise through OverSampler::ProcessBlock() with a waveshaper at the higher rate, for float and double, 2x to 16x and 1 to 12
+// channels, in blocks of varying size, and prints the time per block. Checks that:
+// - the output of every channel matches a chain of the scalar HIIR filters run on that channel alone, so the channels filtered in
+//   SIMD lanes, in a partly filled group of lanes and by the scalar fallback all give the same result, and channels don't leak into
+//   each other, including through the unused lanes of a partly filled group
+// - processing fewer channels than the OverSampler was made for gives the same result for those channels
+// Build with and without IPLUG_SIMDE: without it the lane width is 1 and every channel uses the scalar filters.
+// See README.md for how to build and run it
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "IPlugConstants.h"
+#include "Oversampler.h"
+#include "TestUtils.h"
+
+using namespace iplug;
+
+static constexpr int kMaxBlockSize = 64;
+static const int kBlockSizes[] = {64, 17, 1, 64, 33, 2, 64};
+
+template <typename T>
+static void Shape(T** inputs, T** outputs, int nChans, int nFrames)
+{
+  for (int c = 0; c < nChans; c++)
+  {
+    for (int s = 0; s < nFrames; s++)
+      outputs[c][s] = std::tanh(static_cast<T>(2) * inputs[c][s]);
+  }
+}
+
+// One channel of OverSampler::ProcessBlock(), written out with the scalar filters
+template <typename T>
+class ReferenceChannel
+{
+public:
+  ReferenceChannel()
+  {
+    mUp2x.set_coefs(kOverSamplerCoeffs2x);
+    mUp4x.set_coefs(kOverSamplerCoeffs4x);
+    mUp8x.set_coefs(kOverSamplerCoeffs8x);
+    mUp16x.set_coefs(kOverSamplerCoeffs16x);
+    mDown2x.set_coefs(kOverSamplerCoeffs2x);
+    mDown4x.set_coefs(kOverSamplerCoeffs4x);
+    mDown8x.set_coefs(kOverSamplerCoeffs8x);
+    mDown16x.set_coefs(kOverSamplerCoeffs16x);
+  }
+
+  void Process(const T* input, T* output, int nFrames, int rate)
+  {
+    std::vector<T> up2(2 * nFrames), up4(4 * nFrames), up8(8 * nFrames), up16(16 * nFrames);
+    mUp2x.process_block(up2.data(), input, nFrames);
+    if (rate >= 4) mUp4x.process_block(up4.data(), up2.data(), 2 * nFrames);
+    if (rate >= 8) mUp8x.process_block(up8.data(), up4.data(), 4 * nFrames);
+    if (rate == 16) mUp16x.process_block(up16.data(), up8.data(), 8 * nFrames);
+
+    T* pHigh = rate == 2 ? up2.data() : rate == 4 ? up4.data() : rate == 8 ? up8.data() : up16.data();
+    Shape(&pHigh, &pHigh, 1, rate * nFrames);
+
+    if (rate == 16) mDown16x.process_block(up8.data(), up16.data(), 8 * nFrames);
+    if (rate >= 8) mDown8x.process_block(up4.data(), up8.data(), 4 * nFrames);
+    if (rate >= 4) mDown4x.process_block(up2.data(), up4.data(), 2 * nFrames);
+    mDown2x.process_block(output, up2.data(), nFrames);
+  }
+
+private:
+  Upsampler2xFPU<12, T> mUp2x;
+  Upsampler2xFPU<4, T> mUp4x;
+  Upsampler2xFPU<3, T> mUp8x;
+  Upsampler2xFPU<2, T> mUp16x;
+  Downsampler2xFPU<12, T> mDown2x;
+  Downsampler2xFPU<4, T> mDown4x;
+  Downsampler2xFPU<3, T> mDown8x;
+  Downsampler2xFPU<2, T> mDown16x;
+};
+
+// every channel gets different noise at a different level, so that a leak between channels shows up
+template <typename T>
+static std::vector<std::vector<T>> MakeInput(int nChans, int nFrames)
+{
+  std::mt19937 rng(11);
+  std::uniform_real_distribution<double> noise(-1., 1.);
+  std::vector<std::vector<T>> input(nChans, std::vector<T>(nFrames));
+
+  for (int c = 0; c < nChans; c++)
+  {
+    for (int s = 0; s < nFrames; s++)
+      input[c][s] = static_cast<T>(noise(rng) * (0.2 + 0.1 * c));
+  }
+
+  return input;
+}
+
+template <typename T>
+static double Compare(EFactor factor, int nChans, int nProcessedChans, double tolerance)
+{
+  constexpr int kNumRepeats = 20;
+  const int rate = 1 << factor;
+  int nFrames = 0;
+  for (int blockSize : kBlockSizes)
+    nFrames += blockSize;
+  nFrames *= kNumRepeats;
+
+  const auto input = MakeInput<T>(nChans, nFrames);
+  std::vector<std::vector<T>> output(nChans, std::vector<T>(nFrames)), expected(nChans, std::vector<T>(nFrames));
+
+  OverSampler<T> overSampler(factor, true, nChans, nChans);
+  overSampler.Reset(kMaxBlockSize);
+  std::vector<ReferenceChannel<T>> reference(nProcessedChans);
+  std::vector<const T*> inPtrs(nChans);
+  std::vector<T*> outPtrs(nChans);
+
+  for (int pos = 0, block = 0; pos < nFrames; block++)
+  {
+    const int n = kBlockSizes[block % (sizeof(kBlockSizes) / sizeof(kBlockSizes[0]))];
+
+    for (int c = 0; c < nChans; c++)
+    {
+      inPtrs[c] = input[c].data() + pos;
+      outPtrs[c] = output[c].data() + pos;
+    }
+
+    overSampler.ProcessBlock(const_cast<T**>(inPtrs.data()), outPtrs.data(), n, nProcessedChans, nProcessedChans,
+                             [nProcessedChans](T** in, T** out, int nSamples) { Shape(in, out, nProcessedChans, nSamples); });
+
+    for (int c = 0; c < nProcessedChans; c++)
+      reference[c].Process(input[c].data() + pos, expected[c].data() + pos, n, rate);
+
+    pos += n;
+  }
+
+  double maxDiff = 0.;
+  for (int c = 0; c < nProcessedChans; c++)
+  {
+    for (int s = 0; s < nFrames; s++)
+      maxDiff = std::max(maxDiff, std::fabs(static_cast<double>(output[c][s]) - expected[c][s]));
+  }
+
+  if (maxDiff > tolerance)
+    printf("%s, %2dx, %2d of %2d channels: max difference from the scalar filters %g\n", sizeof(T) == 4 ? "float" : "double", rate,
+           nProcessedChans, nChans, maxDiff);
+
+  CHECK(maxDiff <= tolerance);
+  return maxDiff;
+}
+
+template <typename T>
+static void Time(EFactor factor, int nChans)
+{
+  constexpr int kNumBlocks = 4000;
+  const auto input = MakeInput<T>(nChans, kMaxBlockSize);
+  std::vector<std::vector<T>> output(nChans, std::vector<T>(kMaxBlockSize));
+  std::vector<T*> inPtrs(nChans), outPtrs(nChans);
+
+  for (int c = 0; c < nChans; c++)
+  {
+    inPtrs[c] = const_cast<T*>(input[c].data());
+    outPtrs[c] = output[c].data();
+  }
+
+  OverSampler<T> overSampler(factor, true, nChans, nChans);
+  overSampler.Reset(kMaxBlockSize);
+
+  const double start = testutils::Seconds();
+  for (int block = 0; block < kNumBlocks; block++)
+  {
+    overSampler.ProcessBlock(inPtrs.data(), outPtrs.data(), kMaxBlockSize, nChans, nChans,
+                             [nChans](T** in, T** out, int nSamples) { Shape(in, out, nChans, nSamples); });
+  }
+  const double seconds = testutils::Seconds() - start;
+
+  printf("%-6s %2d channels, %2dx: %6.1f us per %d sample block\n", sizeof(T) == 4 ? "float" : "double", nChans, 1 << factor,
+         1e6 * seconds / kNumBlocks, kMaxBlockSize);
+}
+
+template <typename T>
+static void TestType(double tolerance)
+{
+  double maxDiff = 0.;
+
+  for (int factor = k2x; factor <= k16x; factor++)
+  {
+    for (int nChans = 1; nChans <= 12; nChans++)
+      maxDiff = std::max(maxDiff, Compare<T>(static_cast<EFactor>(factor), nChans, nChans, tolerance));
+
+    maxDiff = std::max(maxDiff, Compare<T>(static_cast<EFactor>(factor), 12, 7, tolerance));
+    maxDiff = std::max(maxDiff, Compare<T>(static_cast<EFactor>(factor), 8, 3, tolerance));
+  }
+
+  printf("%s, %d lanes: max difference from the scalar filters %g\n", sizeof(T) == 4 ? "float" : "double", OverSampler<T>::kLaneWidth,
+         maxDiff);
+
+  for (int nChans : {4, 12})
+  {
+    for (EFactor factor : {k2x, k8x, k16x})
+      Time<T>(factor, nChans);
+  }
+}
+
+int main()
+{
+  // the lanes do the same operations in the same order as the scalar filters, so the results should be identical. The tolerance
+  // allows for a compiler that fuses multiplies and adds differently in the two
+  TestType<float>(1e-6);
+  TestType<double>(1e-14);
+
+  return testutils::ReportResults("OverSamplerTest");
+}
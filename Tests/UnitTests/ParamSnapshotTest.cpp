@@ -0,0 +1,210 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+// Hammers preset loads (IPluginBase::UnserializeParams) from one thread while another thread processes blocks
+// (IPluginBase::ApplyParamSnapshot), with PARAMS_SNAPSHOT defined. Checks that:
+// - the processor never waits: ApplyParamSnapshot() completes while a writer is holding the snapshot's write lock
+// - the processor only ever sees complete presets, never a mix of two
+// - a value set by the host after a preset load is not overwritten when the snapshot is applied
+// - SerializeParams() reports a loaded preset before the processor has applied it
+// - without a processor (e.g. the VST3 controller, or a suspended plug-in) a preset load sets the parameters and calls OnParamReset() at once,
+//   and a preset that a processor did not get to is applied when processing stops
+// See README.md for how to build and run it
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+#include "IPlugPluginBase.h"
+#include "TestUtils.h"
+
+using namespace iplug;
+
+static constexpr int kNumParams = 256;
+
+class TestPlugin : public IPluginBase
+{
+public:
+  TestPlugin()
+  : IPluginBase(kNumParams, 0)
+  {
+    for (int i = 0; i < kNumParams; i++)
+      GetParam(i)->InitDouble("p", 0., 0., 100000., 1.);
+  }
+
+  void BeginInformHostOfParamChangeFromUI(int paramIdx) override {}
+  void EndInformHostOfParamChangeFromUI(int paramIdx) override {}
+  void OnParamReset(EParamSource source) override { if (source == kPresetRecall) mNumPresetRecalls++; }
+
+  int mNumPresetRecalls = 0;
+
+  // a preset in which every parameter has the same value
+  static void MakePreset(IByteChunk& chunk, double value)
+  {
+    chunk.Clear();
+    for (int i = 0; i < kNumParams; i++)
+      chunk.Put(&value);
+  }
+
+  // the audio thread: pick up any new preset and check that the parameters form a single preset
+  bool ProcessBlock()
+  {
+    ApplyParamSnapshot();
+
+    const double first = GetParam(0)->Value();
+    for (int i = 1; i < kNumParams; i++)
+    {
+      if (GetParam(i)->Value() != first)
+        return false;
+    }
+    return true;
+  }
+};
+
+static void TestProcessorNeverWaits()
+{
+  IParamSnapshot snapshot(kNumParams);
+  std::atomic<bool> writerHolding {false};
+  std::atomic<bool> readerDone {false};
+  std::atomic<bool> writerReleased {false};
+
+  // the writer begins a snapshot and holds the write lock until the reader is done, or gives up after a second
+  std::thread writer([&]() {
+    IParamSnapshot::Entry* pEntries = snapshot.BeginWrite();
+    writerHolding = true;
+
+    for (int i = 0; i < 1000 && !readerDone; i++)
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    pEntries[0].valid = true;
+    writerReleased = true;
+    snapshot.EndWrite();
+  });
+
+  while (!writerHolding)
+    std::this_thread::yield();
+
+  for (int block = 0; block < 1000; block++)
+  {
+    if (snapshot.Acquire())
+      snapshot.EndApply();
+  }
+
+  // the reader ran all its blocks while the writer was still between BeginWrite() and EndWrite()
+  CHECK(!writerReleased);
+  readerDone = true;
+  writer.join();
+  CHECK(snapshot.Acquire() != nullptr);
+}
+
+static void TestPresetHammer()
+{
+  TestPlugin plugin;
+  plugin.SetParamSnapshotProcessing(true);
+  std::atomic<bool> done {false};
+  std::atomic<int> tornBlocks {0};
+  std::atomic<int> blocks {0};
+
+  std::thread audio([&]() {
+    while (!done)
+    {
+      if (!plugin.ProcessBlock())
+        tornBlocks++;
+      blocks++;
+    }
+  });
+
+  IByteChunk chunk;
+  const int nLoads = 20000;
+  for (int load = 1; load <= nLoads; load++)
+  {
+    TestPlugin::MakePreset(chunk, static_cast<double>(load));
+    CHECK(plugin.UnserializeParams(chunk, 0) >= 0);
+  }
+
+  // let the processor pick up the last preset
+  const int blocksAtEnd = blocks;
+  while (blocks < blocksAtEnd + 2)
+    std::this_thread::yield();
+
+  done = true;
+  audio.join();
+
+  CHECK(tornBlocks == 0);
+  CHECK(plugin.GetParam(0)->Value() == static_cast<double>(nLoads));
+  printf("%d preset loads, %d blocks, %d torn\n", nLoads, blocks.load(), tornBlocks.load());
+}
+
+static void TestHostValueWins()
+{
+  TestPlugin plugin;
+  plugin.SetParamSnapshotProcessing(true);
+  IByteChunk chunk;
+  TestPlugin::MakePreset(chunk, 7.);
+  plugin.UnserializeParams(chunk, 0);
+
+  // not applied yet, but the saved state already reflects the preset
+  CHECK(plugin.GetParam(3)->Value() == 0.);
+  IByteChunk saved;
+  plugin.SerializeParams(saved);
+  double v = 0.;
+  saved.Get(&v, 3 * sizeof(double));
+  CHECK(v == 7.);
+
+  // the host sets a parameter between the load and the next block
+  plugin.GetParam(3)->Set(42.);
+  plugin.ApplyParamSnapshot();
+
+  CHECK(plugin.GetParam(0)->Value() == 7.);
+  CHECK(plugin.GetParam(3)->Value() == 42.);
+}
+
+static void TestRestoreWithoutProcessing()
+{
+  TestPlugin plugin;
+  IByteChunk chunk;
+  TestPlugin::MakePreset(chunk, 7.);
+
+  // nothing is processing, so the values are visible straight away, as they are on a VST3 controller
+  CHECK(plugin.UnserializeParams(chunk, 0) >= 0);
+  CHECK(plugin.GetParam(0)->Value() == 7.);
+  CHECK(plugin.GetParam(kNumParams - 1)->Value() == 7.);
+  CHECK(plugin.mNumPresetRecalls == 1);
+
+  // once processing starts, the load goes through the snapshot, and is applied when processing stops if no block picked it up
+  plugin.SetParamSnapshotProcessing(true);
+  TestPlugin::MakePreset(chunk, 9.);
+  plugin.UnserializeParams(chunk, 0);
+  CHECK(plugin.GetParam(0)->Value() == 7.);
+  CHECK(plugin.mNumPresetRecalls == 1);
+  plugin.SetParamSnapshotProcessing(false);
+  CHECK(plugin.GetParam(0)->Value() == 9.);
+  CHECK(plugin.GetParam(kNumParams - 1)->Value() == 9.);
+
+  // the direct load leaves no snapshot behind that a later block would apply over a newer host value
+  TestPlugin::MakePreset(chunk, 11.);
+  plugin.UnserializeParams(chunk, 0);
+  plugin.GetParam(5)->Set(42.);
+  CHECK(plugin.ProcessBlock() == false);
+  CHECK(plugin.GetParam(5)->Value() == 42.);
+  CHECK(plugin.GetParam(0)->Value() == 11.);
+  CHECK(plugin.mNumPresetRecalls == 2);
+}
+
+int main()
+{
+  TestProcessorNeverWaits();
+  TestPresetHammer();
+  TestHostValueWins();
+  TestRestoreWithoutProcessing();
+
+  return testutils::ReportResults("ParamSnapshotTest");
+}
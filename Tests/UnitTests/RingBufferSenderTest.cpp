@@ -0,0 +1,188 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+// Writes a numbered ramp into an IRingBufferSender from an audio thread in blocks of random size, while a reader thread copies the
+// newest window as fast as it can, for several history lengths. Checks that:
+// - every window that is read is consistent: each sample is the one its sequence number says, or is a sample the audio thread had
+//   to skip, which is silent and counted
+// - GetWriteCount() advances by every frame written, whether or not frames were skipped
+// - with no reader, nothing is skipped and a window that reaches back before the first write reads the cleared samples
+// Small histories make the audio thread overwrite the window being read often, which exercises the skip path.
+// Build with -fsanitize=thread to check the memory ordering as well.
+// See README.md for how to build and run it
+
+#include <atomic>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "IPlugEditorDelegate.h"
+#include "ISender.h"
+#include "TestUtils.h"
+
+using namespace iplug;
+
+// the value written for a sequence number, never 0 so that skipped samples can be told apart, and exact in float
+static float RampValue(uint64_t seq)
+{
+  return static_cast<float>(1 + seq % (1 << 20));
+}
+
+static void Stress(int historyLength, int nChans, uint64_t nFrames)
+{
+  constexpr int kMaxBlockSize = 300;
+  IRingBufferSender sender(nChans, historyLength);
+  const uint64_t firstCount = sender.GetWriteCount();
+  std::atomic<bool> done {false};
+
+  std::thread audio([&]() {
+    std::mt19937 rng(17);
+    std::vector<std::vector<sample>> buffers(nChans, std::vector<sample>(kMaxBlockSize));
+    std::vector<sample*> inputs(nChans);
+    uint64_t seq = 0;
+
+    for (int c = 0; c < nChans; c++)
+      inputs[c] = buffers[c].data();
+
+    while (seq < nFrames)
+    {
+      const int n = static_cast<int>(std::min<uint64_t>(1 + rng() % kMaxBlockSize, nFrames - seq));
+
+      for (int c = 0; c < nChans; c++)
+      {
+        for (int i = 0; i < n; i++)
+          buffers[c][i] = (c + 1) * RampValue(seq + i);
+      }
+
+      sender.ProcessBlock(inputs.data(), n);
+      seq += n;
+    }
+
+    done = true;
+  });
+
+  std::vector<std::vector<float>> window(nChans, std::vector<float>(historyLength));
+  std::vector<float*> pDest(nChans);
+  uint64_t nReads = 0, nFailedReads = 0, nSkipped = 0, nBad = 0;
+
+  for (int c = 0; c < nChans; c++)
+    pDest[c] = window[c].data();
+
+  while (!done.load())
+  {
+    uint64_t writeCount = 0;
+    int skipped = 0;
+
+    if (!sender.ReadLatest(pDest.data(), nChans, historyLength, writeCount, &skipped))
+    {
+      nFailedReads++;
+      continue;
+    }
+
+    int nSilent = 0;
+
+    for (int i = 0; i < historyLength; i++)
+    {
+      // counts start at one ring's worth, so the samples before the first write are the cleared ones
+      const uint64_t count = writeCount - historyLength + i;
+      const bool beforeFirst = count < firstCount;
+      const bool silent = window[0][i] == 0.f;
+      nSilent += (silent && !beforeFirst) ? 1 : 0;
+
+      for (int c = 0; c < nChans; c++)
+      {
+        const float expected = beforeFirst || silent ? 0.f : (c + 1) * RampValue(count - firstCount);
+        nBad += window[c][i] != expected ? 1 : 0;
+      }
+    }
+
+    nBad += nSilent != skipped ? 1 : 0;
+    nSkipped += skipped;
+    nReads++;
+  }
+
+  audio.join();
+
+  printf("history %4d, %d ch: %8llu reads, %6llu retried, %7llu skipped samples read, %llu bad\n", historyLength, nChans,
+         static_cast<unsigned long long>(nReads), static_cast<unsigned long long>(nFailedReads), static_cast<unsigned long long>(nSkipped),
+         static_cast<unsigned long long>(nBad));
+  CHECK(nBad == 0);
+  CHECK(nReads > 0);
+  CHECK(sender.GetWriteCount() == firstCount + nFrames);
+}
+
+static void TestNoReader()
+{
+  constexpr int kHistoryLength = 64;
+  IRingBufferSender sender(2, kHistoryLength);
+  const uint64_t firstCount = sender.GetWriteCount();
+  std::vector<sample> left(kHistoryLength), right(kHistoryLength);
+  sample* inputs[2] = {left.data(), right.data()};
+  std::vector<float> outLeft(kHistoryLength), outRight(kHistoryLength);
+  float* pDest[2] = {outLeft.data(), outRight.data()};
+  uint64_t writeCount = 0;
+  int skipped = -1;
+
+  // a first block shorter than the history: the rest of the window is the cleared samples
+  for (int i = 0; i < 10; i++)
+  {
+    left[i] = RampValue(i);
+    right[i] = -RampValue(i);
+  }
+
+  sender.ProcessBlock(inputs, 10);
+  CHECK(sender.ReadLatest(pDest, 2, kHistoryLength, writeCount, &skipped));
+  CHECK(writeCount == firstCount + 10);
+  CHECK(skipped == 0);
+
+  bool ok = true;
+  for (int i = 0; i < kHistoryLength; i++)
+  {
+    const int s = i - (kHistoryLength - 10);
+    ok &= outLeft[i] == (s < 0 ? 0.f : RampValue(s)) && outRight[i] == (s < 0 ? 0.f : -RampValue(s));
+  }
+
+  // many blocks later, longer ones than the ring, the window is the newest samples
+  uint64_t seq = 10;
+  for (int block = 0; block < 100; block++)
+  {
+    const int n = 1 + (block * 37) % kHistoryLength;
+    for (int i = 0; i < n; i++)
+    {
+      left[i] = RampValue(seq + i);
+      right[i] = -RampValue(seq + i);
+    }
+    sender.ProcessBlock(inputs, n);
+    seq += n;
+  }
+
+  CHECK(sender.ReadLatest(pDest, 2, kHistoryLength, writeCount, &skipped));
+  CHECK(writeCount == firstCount + seq);
+  CHECK(skipped == 0);
+
+  for (int i = 0; i < kHistoryLength; i++)
+    ok &= outLeft[i] == RampValue(seq - kHistoryLength + i) && outRight[i] == -RampValue(seq - kHistoryLength + i);
+
+  CHECK(ok);
+}
+
+int main()
+{
+  TestNoReader();
+
+  for (int historyLength : {8, 16, 512})
+  {
+    for (int nChans : {1, 2})
+      Stress(historyLength, nChans, 20000000);
+  }
+
+  return testutils::ReportResults("RingBufferSenderTest");
+}
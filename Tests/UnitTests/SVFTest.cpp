@@ -0,0 +1,238 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+// Checks SVF::ProcessBlockModulated() and SVF::FastTan() against the std::tan() based SVF::UpdateCoefficients():
+// - FastTan() is within 1e-12 relative of std::tan() from 10 Hz up to just below Nyquist
+// - in every mode, modulating the cutoff of each channel per sample gives the same output as mono filters whose cutoff is set
+//   with SetFreqCPS() before every sample
+// - with a constant cutoff, ProcessBlockModulated() gives the same output as ProcessBlock()
+// Then prints the time per channel and sample of modulating the cutoff per sample with SetFreqCPS(), of ProcessBlockModulated()
+// and of ProcessBlock() with a fixed cutoff. Build with and without IPLUG_SIMDE to check both paths.
+// See README.md for how to build and run it
+
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "IPlugConstants.h"
+#include "IPlugUtilities.h"
+#include "SVF.h"
+#include "TestUtils.h"
+
+using namespace iplug;
+
+static constexpr int kNumChans = 4;
+static constexpr int kNumFrames = 48000;
+static constexpr int kBlockSize = 64;
+static constexpr double kSampleRate = 48000.;
+
+using Buffers = std::vector<std::vector<double>>;
+
+static double MaxDifference(const Buffers& a, const Buffers& b)
+{
+  double maxDiff = 0.;
+
+  for (size_t c = 0; c < a.size(); c++)
+  {
+    for (size_t s = 0; s < a[c].size(); s++)
+      maxDiff = std::max(maxDiff, std::fabs(a[c][s] - b[c][s]));
+  }
+
+  return maxDiff;
+}
+
+static void TestFastTan()
+{
+  double maxError = 0.;
+
+  for (double sr : {44100., 48000., 96000., 192000.})
+  {
+    for (double freq = 10.; freq <= 20000.; freq *= 1.0005)
+    {
+      const double x = PI * freq / sr;
+      maxError = std::max(maxError, std::fabs(SVF<>::FastTan(x) / std::tan(x) - 1.));
+    }
+  }
+
+  for (double x = 1e-4; x < 0.98 * PI / 2.; x += 1e-4)
+    maxError = std::max(maxError, std::fabs(SVF<>::FastTan(x) / std::tan(x) - 1.));
+
+  printf("FastTan() max relative error %g\n", maxError);
+  CHECK(maxError < 1e-12);
+}
+
+static void TestModulated(const Buffers& input, const Buffers& cutoff)
+{
+  using Filter = SVF<double, kNumChans>;
+  using MonoFilter = SVF<double, 1>;
+  Buffers reference(kNumChans, std::vector<double>(kNumFrames));
+  Buffers output(kNumChans, std::vector<double>(kNumFrames));
+
+  for (int mode = 0; mode < Filter::kNumModes; mode++)
+  {
+    for (int c = 0; c < kNumChans; c++)
+    {
+      MonoFilter filter(static_cast<MonoFilter::EMode>(mode));
+      filter.SetSampleRate(kSampleRate);
+      filter.SetQ(2.);
+      filter.SetGain(6.);
+
+      for (int s = 0; s < kNumFrames; s++)
+      {
+        double* pIn = const_cast<double*>(&input[c][s]);
+        double* pOut = &reference[c][s];
+        filter.SetFreqCPS(cutoff[c][s]);
+        filter.ProcessBlock(&pIn, &pOut, 1, 1);
+      }
+    }
+
+    Filter filter(static_cast<Filter::EMode>(mode));
+    filter.SetSampleRate(kSampleRate);
+    filter.SetQ(2.);
+    filter.SetGain(6.);
+
+    double* pIn[kNumChans];
+    double* pOut[kNumChans];
+    const double* pCutoff[kNumChans];
+
+    for (int s = 0; s < kNumFrames; s += kBlockSize)
+    {
+      for (int c = 0; c < kNumChans; c++)
+      {
+        pIn[c] = const_cast<double*>(&input[c][s]);
+        pOut[c] = &output[c][s];
+        pCutoff[c] = &cutoff[c][s];
+      }
+
+      filter.ProcessBlockModulated(pIn, pOut, kNumChans, kBlockSize, pCutoff);
+    }
+
+    const double maxDiff = MaxDifference(reference, output);
+    printf("mode %d: max difference from per-sample SetFreqCPS() %g\n", mode, maxDiff);
+    CHECK(maxDiff < 1e-10);
+  }
+}
+
+static void TestConstantCutoff(const Buffers& input)
+{
+  SVF<double, kNumChans> fixed, modulated;
+  fixed.SetSampleRate(kSampleRate);
+  fixed.SetFreqCPS(1234.);
+  modulated.SetSampleRate(kSampleRate);
+
+  Buffers fixedOutput(kNumChans, std::vector<double>(kNumFrames));
+  Buffers modulatedOutput(kNumChans, std::vector<double>(kNumFrames));
+  const std::vector<double> cutoff(kNumFrames, 1234.);
+
+  double* pIn[kNumChans];
+  double* pFixedOut[kNumChans];
+  double* pModulatedOut[kNumChans];
+  const double* pCutoff[kNumChans];
+
+  for (int c = 0; c < kNumChans; c++)
+  {
+    pIn[c] = const_cast<double*>(input[c].data());
+    pFixedOut[c] = fixedOutput[c].data();
+    pModulatedOut[c] = modulatedOutput[c].data();
+    pCutoff[c] = cutoff.data();
+  }
+
+  fixed.ProcessBlock(pIn, pFixedOut, kNumChans, kNumFrames);
+  modulated.ProcessBlockModulated(pIn, pModulatedOut, kNumChans, kNumFrames, pCutoff);
+
+  const double maxDiff = MaxDifference(fixedOutput, modulatedOutput);
+  printf("constant cutoff: max difference from ProcessBlock() %g\n", maxDiff);
+  CHECK(maxDiff < 1e-12);
+}
+
+static void Benchmark(const Buffers& input, const Buffers& cutoff)
+{
+  constexpr int kNumReps = 10;
+  SVF<double, kNumChans> perSample, modulated, fixed;
+  perSample.SetSampleRate(kSampleRate);
+  modulated.SetSampleRate(kSampleRate);
+  fixed.SetSampleRate(kSampleRate);
+
+  Buffers output(kNumChans, std::vector<double>(kNumFrames));
+  double* pIn[kNumChans];
+  double* pOut[kNumChans];
+  const double* pCutoff[kNumChans];
+
+  auto setPointers = [&](int s) {
+    for (int c = 0; c < kNumChans; c++)
+    {
+      pIn[c] = const_cast<double*>(&input[c][s]);
+      pOut[c] = &output[c][s];
+      pCutoff[c] = &cutoff[c][s];
+    }
+  };
+
+  // the cutoff shared by all channels, since SetFreqCPS() can't set one per channel
+  const double t0 = testutils::Seconds();
+  for (int rep = 0; rep < kNumReps; rep++)
+  {
+    for (int s = 0; s < kNumFrames; s++)
+    {
+      setPointers(s);
+      perSample.SetFreqCPS(cutoff[0][s]);
+      perSample.ProcessBlock(pIn, pOut, kNumChans, 1);
+    }
+  }
+
+  const double t1 = testutils::Seconds();
+  for (int rep = 0; rep < kNumReps; rep++)
+  {
+    for (int s = 0; s < kNumFrames; s += kBlockSize)
+    {
+      setPointers(s);
+      modulated.ProcessBlockModulated(pIn, pOut, kNumChans, kBlockSize, pCutoff);
+    }
+  }
+
+  const double t2 = testutils::Seconds();
+  for (int rep = 0; rep < kNumReps; rep++)
+  {
+    for (int s = 0; s < kNumFrames; s += kBlockSize)
+    {
+      setPointers(s);
+      fixed.ProcessBlock(pIn, pOut, kNumChans, kBlockSize);
+    }
+  }
+
+  const double t3 = testutils::Seconds();
+  const double scale = 1e9 / (static_cast<double>(kNumReps) * kNumFrames * kNumChans);
+  printf("ns per channel and sample: per-sample SetFreqCPS() %.2f, ProcessBlockModulated() %.2f, fixed cutoff ProcessBlock() %.2f\n",
+         (t1 - t0) * scale, (t2 - t1) * scale, (t3 - t2) * scale);
+}
+
+int main()
+{
+  std::mt19937 rng(5);
+  std::uniform_real_distribution<double> noise(-1., 1.);
+  Buffers input(kNumChans, std::vector<double>(kNumFrames));
+  Buffers cutoff(kNumChans, std::vector<double>(kNumFrames));
+
+  // white noise, and a cutoff sweeping between 220 Hz and 18 kHz at a different rate on each channel
+  for (int c = 0; c < kNumChans; c++)
+  {
+    for (int s = 0; s < kNumFrames; s++)
+    {
+      input[c][s] = noise(rng);
+      cutoff[c][s] = 2000. * std::pow(2., 3.2 * std::sin(s * 0.0007 * (c + 1)));
+    }
+  }
+
+  TestFastTan();
+  TestModulated(input, cutoff);
+  TestConstantCutoff(input);
+  Benchmark(input, cutoff);
+
+  return testutils::ReportResults("SVFTest");
+}
@@ -0,0 +1,324 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+// Plays notes through a VoiceAllocator rendering with a SinVoiceBank, as MidiSynth does. Checks that:
+// - the bank's output matches a per-voice model of the same envelope, oscillator and noise, one voice and one sample at a time,
+//   including voices that are released and stolen. Build with and without IPLUG_SIMDE to check both the SSE2 and the scalar path
+// - a stolen voice, in poly and in mono mode, is retriggered: it fades out rather than jumping to the start of the new note, so the
+//   largest step between two output samples just after the steal is no bigger than while the notes play on
+// See README.md for how to build and run it
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "VoiceAllocator.h"
+#include "VoiceBank.h"
+#include "TestUtils.h"
+
+using namespace iplug;
+
+static constexpr double kSampleRate = 48000.;
+static constexpr int kBlockSize = 64;
+
+// One voice of SinVoiceBank, written out per voice with std::sin() for the oscillator
+struct ModelVoice
+{
+  using Bank = SinVoiceBank<4>;
+
+  int stage = Bank::kIdle;
+  float env = 0.f, level = 0.f, newLevel = 0.f, releaseLevel = 0.f, prevResult = 0.f;
+  float phase = 0.f, phaseIncr = 0.f, pitch = 0.f;
+  uint32_t seed = 0;
+
+  void Trigger(float lvl, bool isRetrigger)
+  {
+    if (isRetrigger && stage != Bank::kIdle)
+    {
+      releaseLevel = prevResult;
+      env = 1.f;
+      newLevel = lvl;
+      stage = Bank::kReleasedToRetrigger;
+      return;
+    }
+
+    phase = 0.25f;
+    env = 0.f;
+    level = lvl;
+    prevResult = 0.f;
+    stage = Bank::kAttack;
+  }
+
+  void Release()
+  {
+    if (stage == Bank::kIdle)
+      return;
+
+    releaseLevel = prevResult;
+    env = 1.f;
+    stage = Bank::kRelease;
+  }
+
+  double Process(float attackIncr, float decayIncr, float releaseIncr, float retriggerIncr, float sustain, float timbre)
+  {
+    switch (stage)
+    {
+      case Bank::kAttack:
+        env += attackIncr;
+        if (env > Bank::ENV_VALUE_HIGH) { env = 1.f; stage = Bank::kDecay; }
+        break;
+      case Bank::kDecay:
+        env -= decayIncr * env;
+        if (env < Bank::ENV_VALUE_LOW) { env = 1.f; stage = Bank::kSustain; }
+        break;
+      case Bank::kRelease:
+        env -= releaseIncr * env;
+        if (env < Bank::ENV_VALUE_LOW) { env = 0.f; stage = Bank::kIdle; }
+        break;
+      case Bank::kReleasedToRetrigger:
+        env -= retriggerIncr;
+        if (env < Bank::ENV_VALUE_LOW) { env = 0.f; stage = Bank::kAttack; level = newLevel; phase = 0.25f; }
+        break;
+      default:
+        break;
+    }
+
+    float result = 0.f;
+    if (stage == Bank::kAttack) result = env;
+    else if (stage == Bank::kDecay) result = env * (1.f - sustain) + sustain;
+    else if (stage == Bank::kSustain) result = sustain;
+    else if (stage == Bank::kRelease || stage == Bank::kReleasedToRetrigger) result = env * releaseLevel;
+    prevResult = result;
+
+    seed = seed * 0x0019660Du + 0x3C6EF35Fu;
+    const double noise = static_cast<float>(seed >> 9) * (2.f / 8388608.f) - 1.f;
+    const double osc = std::sin(2. * PI * phase);
+    const float p = phase + phaseIncr;
+    phase = p >= 1.f ? p - 1.f : p;
+
+    return (osc + timbre * noise) * result * level;
+  }
+};
+
+// Plays a VoiceAllocator with a SinVoiceBank of NVoices voices, one block at a time
+template <int NVoices>
+class BankSynth
+{
+public:
+  BankSynth(VoiceAllocator::EPolyMode polyMode)
+  {
+    mAllocator.mPolyMode = polyMode;
+    mAllocator.SetSampleRateAndBlockSize(kSampleRate, kBlockSize);
+    mAllocator.SetVoiceBank(&mBank);
+    mBank.SetSampleRate(kSampleRate);
+
+    for (int v = 0; v < NVoices; v++)
+      mAllocator.AddVoice(mBank.GetVoice(v), 0);
+  }
+
+  void Note(int key, float velocity)
+  {
+    VoiceInputEvent event {};
+    event.mAddress = {0, 1, static_cast<uint8_t>(key), 0};
+    event.mAction = velocity > 0.f ? kNoteOnAction : kNoteOffAction;
+    event.mValue = velocity;
+    mAllocator.AddEvent(event);
+  }
+
+  void Timbre(float value)
+  {
+    VoiceInputEvent event {};
+    event.mAddress = {0, kAllChannels, kAllKeys, kVoicesAll};
+    event.mAction = kTimbreAction;
+    event.mValue = value;
+    mAllocator.AddEvent(event);
+  }
+
+  // render a block, appending it to mOutput
+  void ProcessBlock()
+  {
+    sample buffer[kBlockSize] = {};
+    sample* pOutputs[1] = {buffer};
+    mAllocator.ProcessEvents(kBlockSize, mSampleTime);
+    mAllocator.ProcessVoices(nullptr, pOutputs, 0, 1, 0, kBlockSize);
+    mOutput.insert(mOutput.end(), buffer, buffer + kBlockSize);
+    mSampleTime += kBlockSize;
+  }
+
+  // the largest step between two consecutive output samples in [start, end)
+  double LargestStep(size_t start, size_t end) const
+  {
+    double largest = 0.;
+    for (size_t s = std::max<size_t>(start, 1); s < end; s++)
+      largest = std::max(largest, std::fabs(mOutput[s] - mOutput[s - 1]));
+    return largest;
+  }
+
+  VoiceAllocator mAllocator;
+  SinVoiceBank<NVoices> mBank;
+  std::vector<double> mOutput;
+  int64_t mSampleTime = 0;
+};
+
+static void TestMatchesModel()
+{
+  constexpr int kNumVoices = 16;
+  constexpr float kTimbre = 0.25f;
+  using Bank = SinVoiceBank<kNumVoices>;
+  BankSynth<kNumVoices> synth(VoiceAllocator::kPolyModePoly);
+
+  ModelVoice model[kNumVoices];
+  for (int v = 0; v < kNumVoices; v++)
+    model[v].seed = static_cast<uint32_t>(v) * 0x9E3779B9u;
+
+  // the same stage increments as SinVoiceBank::SetStageTime(), for its default times of 10 ms and sustain of 0.5
+  const float attackIncr = static_cast<float>((1. / kSampleRate) / (10. / 1000.));
+  const float expIncr = static_cast<float>(std::min(-std::expm1(1000.0 * std::log(0.001) / (kSampleRate * 10.)), 1.));
+  const float retriggerIncr = static_cast<float>((1. / kSampleRate) / (Bank::RETRIGGER_RELEASE_TIME_MS / 1000.));
+
+  int voiceKeys[kNumVoices];
+  std::fill(voiceKeys, voiceKeys + kNumVoices, -1);
+  std::vector<double> expected;
+  double maxDiff = 0.;
+  int nNotes = 0;
+  int nReleases = 0;
+
+  // let the timbre glide settle before any note starts
+  synth.Timbre(kTimbre);
+  for (int block = 0; block < 20; block++)
+    synth.ProcessBlock();
+  expected.resize(synth.mOutput.size(), 0.);
+
+  const int kNumBlocks = 600;
+  for (int block = 0; block < kNumBlocks; block++)
+  {
+    const int64_t blockStart = synth.mSampleTime;
+    const int key = 40 + nNotes % 40;
+    const float velocity = 0.3f + 0.05f * (block % 13);
+    const bool noteOn = block % 3 == 0;
+
+    // a new note every 3 blocks, and a release of an older note every 5, so voices are stolen in every stage of the envelope
+    if (noteOn)
+    {
+      synth.Note(key, velocity);
+      nNotes++;
+    }
+
+    int releasedVoice = -1;
+    if (block % 5 == 2)
+    {
+      releasedVoice = (block / 5) % kNumVoices;
+      if (voiceKeys[releasedVoice] >= 0)
+      {
+        synth.Note(voiceKeys[releasedVoice], 0.f);
+        voiceKeys[releasedVoice] = -1;
+        nReleases++;
+      }
+      else
+        releasedVoice = -1;
+    }
+
+    synth.ProcessBlock();
+
+    // events apply at the start of the block. The allocator tells which voice it started
+    if (releasedVoice >= 0)
+      model[releasedVoice].Release();
+
+    for (int v = 0; v < kNumVoices && noteOn; v++)
+    {
+      if (synth.mAllocator.GetVoice(v)->GetLastTriggeredTime() == blockStart)
+      {
+        model[v].Trigger(velocity, true);
+        model[v].pitch = static_cast<float>((key - 69.) / 12.);
+        voiceKeys[v] = key;
+      }
+    }
+
+    // as SinVoiceBank::ProcessVoiceBank(), only groups with a busy voice are rendered, and advance their phase and noise
+    bool groupActive[kNumVoices / Bank::kLaneWidth] = {};
+    for (int v = 0; v < kNumVoices; v++)
+    {
+      groupActive[v / Bank::kLaneWidth] |= model[v].stage != Bank::kIdle;
+      model[v].phaseIncr = static_cast<float>(440. * std::pow(2., model[v].pitch) / kSampleRate);
+    }
+
+    for (int s = 0; s < kBlockSize; s++)
+    {
+      double sum = 0.;
+      for (int v = 0; v < kNumVoices; v++)
+      {
+        if (groupActive[v / Bank::kLaneWidth])
+          sum += model[v].Process(attackIncr, expIncr, expIncr, retriggerIncr, 0.5f, kTimbre);
+      }
+      expected.push_back(sum);
+    }
+  }
+
+  for (size_t s = 0; s < expected.size(); s++)
+    maxDiff = std::max(maxDiff, std::fabs(synth.mOutput[s] - expected[s]));
+
+  printf("%d voices, %d notes, %d releases: max difference from the per-voice model %g\n", kNumVoices, nNotes, nReleases, maxDiff);
+  CHECK(maxDiff < 1e-4);
+}
+
+// hold the notes until they sustain, then play another and compare the largest sample step just after it with the one before it.
+// without the retrigger fade, the stolen voice drops to the start of its attack at the first sample of the block, so the steal is
+// tried at several points in the cycle of the stolen voice
+template <int NVoices>
+static void TestSteal(VoiceAllocator::EPolyMode polyMode, const char* name)
+{
+  constexpr int kSettleBlocks = 40;
+  constexpr int kMeasureBlocks = 8;
+  constexpr int kStealSamples = 16;
+  constexpr int kNumTrials = 8;
+  double before = 0., atSteal = 0., atRelease = 0.;
+
+  for (int trial = 0; trial < kNumTrials; trial++)
+  {
+    BankSynth<NVoices> synth(polyMode);
+
+    for (int key : {57, 60, 64, 67})
+      synth.Note(key, 1.f);
+
+    for (int block = 0; block < kSettleBlocks + trial; block++)
+      synth.ProcessBlock();
+
+    const size_t stealStart = synth.mOutput.size();
+    synth.Note(72, 1.f);
+
+    for (int block = 0; block < kMeasureBlocks; block++)
+      synth.ProcessBlock();
+
+    before = std::max(before, synth.LargestStep(stealStart - kMeasureBlocks * kBlockSize, stealStart));
+    atSteal = std::max(atSteal, synth.LargestStep(stealStart, stealStart + kStealSamples));
+
+    // in mono mode, releasing the new note goes back to the held one, which is a retrigger as well
+    const size_t releaseStart = synth.mOutput.size();
+    synth.Note(72, 0.f);
+
+    for (int block = 0; block < kMeasureBlocks; block++)
+      synth.ProcessBlock();
+
+    atRelease = std::max(atRelease, synth.LargestStep(releaseStart, releaseStart + kStealSamples));
+  }
+
+  printf("%s: largest sample step while playing %.4f, just after the steal %.4f, after the note off %.4f\n", name, before, atSteal, atRelease);
+  CHECK(atSteal < 1.5 * before);
+  CHECK(atRelease < 1.5 * before);
+}
+
+int main()
+{
+  TestMatchesModel();
+  TestSteal<4>(VoiceAllocator::kPolyModePoly, "poly steal");
+  TestSteal<4>(VoiceAllocator::kPolyModeMono, "mono");
+
+  return testutils::ReportResults("SinVoiceBankTest");
+}
@@ -0,0 +1,43 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+#pragma once
+
+// Shared scaffolding for the stand-alone checks in this folder: CHECK() reports a failed condition and counts it,
+// ReportResults() prints the outcome and returns the exit code for main()
+
+#include <chrono>
+#include <cstdio>
+
+namespace testutils
+{
+  inline int gFailures = 0;
+
+  /** @return The time in seconds from a steady clock, for timing benchmarks */
+  inline double Seconds()
+  {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  /** Print whether the checks of a test program passed
+   * @param testName The name of the program
+   * @return The exit code for main(), non-zero if any CHECK() failed */
+  inline int ReportResults(const char* testName)
+  {
+    if (gFailures)
+      printf("%s: %d failures\n", testName, gFailures);
+    else
+      printf("%s: passed\n", testName);
+
+    return gFailures ? 1 : 0;
+  }
+}
+
+#define CHECK(cond) do { if (!(cond)) { printf("FAILED: %s (line %d)\n", #cond, __LINE__); testutils::gFailures++; } } while (0)
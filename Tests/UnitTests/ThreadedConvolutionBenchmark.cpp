@@ -0,0 +1,236 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+// Convolves noise with long impulses, one audio callback at a time and paced like a real audio device, with ThreadedConvolutionEngine and
+// with a single WDL_ConvolutionEngine_Div, and prints the mean, 99.9th percentile and worst time per callback of each. Checks that:
+// - the output matches the single engine's, and no tail block is late, when the worker keeps up
+// - when the worker can't keep up (callbacks with no time between them), late tail blocks are output as silence and counted, the worst
+//   callback is still faster than the single engine's worst, and once the worker has caught up no more blocks are late and the output
+//   matches the single engine's again after one impulse length
+// The callbacks run on a thread with the priority of an audio thread, as the worker does, so that on a single core the worker only runs
+// between callbacks
+// See README.md for how to build and run it
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "convoengine.h"
+#include "ThreadedConvolutionEngine.h"
+#include "TestUtils.h"
+
+using namespace iplug;
+
+static constexpr double kSampleRate = 48000.;
+static constexpr int kNumChans = 2;
+
+struct Timing
+{
+  std::vector<double> callbackSeconds;
+
+  void Print(const char* name) const
+  {
+    std::vector<double> sorted = callbackSeconds;
+    std::sort(sorted.begin(), sorted.end());
+    double total = 0.;
+    for (double t : sorted)
+      total += t;
+
+    printf("  %-26s mean %7.1f us, 99.9%% %7.1f us, worst %7.1f us per callback\n", name, 1e6 * total / sorted.size(),
+           1e6 * sorted[static_cast<size_t>(sorted.size() * 0.999)], 1e6 * sorted.back());
+  }
+};
+
+static void MakeImpulse(WDL_ImpulseBuffer& impulse, int length)
+{
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<double> noise(-1., 1.);
+  impulse.samplerate = kSampleRate;
+  impulse.SetNumChannels(kNumChans);
+  impulse.SetLength(length);
+
+  // decaying noise, like a reverb
+  for (int c = 0; c < kNumChans; c++)
+  {
+    for (int s = 0; s < length; s++)
+      impulse.impulses[c].Get()[s] = noise(rng) * std::exp(-5. * s / length) * 0.05;
+  }
+}
+
+// Run one callback of blockSize samples through an engine, appending the output. Returns the time it took
+template <class Engine>
+static double Callback(Engine& engine, std::vector<WDL_FFT_REAL>* pInputs, int pos, int blockSize, std::vector<WDL_FFT_REAL>* pOutputs)
+{
+  WDL_FFT_REAL* ins[kNumChans];
+  for (int c = 0; c < kNumChans; c++)
+    ins[c] = pInputs[c].data() + pos;
+
+  const double start = testutils::Seconds();
+  engine.Add(ins, blockSize, kNumChans);
+  const int n = engine.Avail(blockSize);
+  WDL_FFT_REAL** outs = engine.Get();
+
+  for (int c = 0; c < kNumChans; c++)
+    pOutputs[c].insert(pOutputs[c].end(), outs[c], outs[c] + n);
+
+  engine.Advance(n);
+  return testutils::Seconds() - start;
+}
+
+// Convolve nFrames of input, sleeping between callbacks as an audio device would, unless paced is false
+template <class Engine>
+static Timing Run(Engine& engine, std::vector<WDL_FFT_REAL>* pInputs, int startFrame, int nFrames, int blockSize, bool paced,
+                  std::vector<WDL_FFT_REAL>* pOutputs)
+{
+  Timing timing;
+  const auto period = std::chrono::duration<double>(blockSize / kSampleRate);
+  auto next = std::chrono::steady_clock::now();
+
+  for (int pos = startFrame; pos + blockSize <= startFrame + nFrames; pos += blockSize)
+  {
+    if (paced)
+    {
+      next += std::chrono::duration_cast<std::chrono::steady_clock::duration>(period);
+      std::this_thread::sleep_until(next);
+    }
+
+    timing.callbackSeconds.push_back(Callback(engine, pInputs, pos, blockSize, pOutputs));
+  }
+
+  return timing;
+}
+
+static double MaxDifference(const std::vector<WDL_FFT_REAL>* a, const std::vector<WDL_FFT_REAL>* b, size_t start)
+{
+  double maxDiff = 0.;
+  for (int c = 0; c < kNumChans; c++)
+  {
+    for (size_t s = start; s < std::min(a[c].size(), b[c].size()); s++)
+      maxDiff = std::max(maxDiff, static_cast<double>(std::fabs(a[c][s] - b[c][s])));
+  }
+  return maxDiff;
+}
+
+// Run f on a thread with the priority of an audio thread, as a host would call the plug-in
+template <class F>
+static void OnAudioThread(F&& f)
+{
+  std::thread thread([&]() {
+    SetCurrentThreadRealtimePriority(1000. * 64. / kSampleRate);
+    f();
+  });
+  thread.join();
+}
+
+static void Compare(int impulseLength, int blockSize, std::vector<WDL_FFT_REAL>* pInputs, int nFrames)
+{
+  WDL_ImpulseBuffer impulse;
+  MakeImpulse(impulse, impulseLength);
+
+  ThreadedConvolutionEngine threaded;
+  threaded.SetImpulse(&impulse, blockSize, 0, kNumChans);
+  WDL_ConvolutionEngine_Div single;
+  single.SetImpulse(&impulse, 0, blockSize);
+
+  std::vector<WDL_FFT_REAL> threadedOut[kNumChans], singleOut[kNumChans];
+  Timing threadedTiming, singleTiming;
+  OnAudioThread([&]() {
+    threadedTiming = Run(threaded, pInputs, 0, nFrames, blockSize, true, threadedOut);
+    singleTiming = Run(single, pInputs, 0, nFrames, blockSize, true, singleOut);
+  });
+
+  printf("%.1f s impulse, %d sample callbacks, tail blocks of %d, %d late:\n", impulseLength / kSampleRate, blockSize, threaded.TailBlockSize(),
+         threaded.GetNumLateBlocks());
+  threadedTiming.Print("ThreadedConvolutionEngine");
+  singleTiming.Print("WDL_ConvolutionEngine_Div");
+
+  // the impulse is stored as float, and the engines split it differently
+  CHECK(threaded.GetNumLateBlocks() == 0);
+  CHECK(MaxDifference(threadedOut, singleOut, 0) < 1e-5);
+}
+
+static void TestOverload(std::vector<WDL_FFT_REAL>* pInputs)
+{
+  constexpr int kImpulseLength = static_cast<int>(2. * kSampleRate);
+  constexpr int kBurstFrames = static_cast<int>(kSampleRate);
+  constexpr int kRecoveryFrames = static_cast<int>(kSampleRate);
+  constexpr int kCheckFrames = kImpulseLength + static_cast<int>(2. * kSampleRate);
+  constexpr int kBlockSize = 64;
+  constexpr double kMaxWaitUs = 50.;
+  WDL_ImpulseBuffer impulse;
+  MakeImpulse(impulse, kImpulseLength);
+
+  ThreadedConvolutionEngine threaded;
+  threaded.SetImpulse(&impulse, kBlockSize, 0, kNumChans);
+  threaded.SetMaxWait(kMaxWaitUs);
+  WDL_ConvolutionEngine_Div single;
+  single.SetImpulse(&impulse, 0, kBlockSize);
+
+  // a burst of callbacks with no time between them, which the worker can't keep up with, then paced callbacks while it catches up,
+  // then paced callbacks for longer than the impulse, which should all be on time
+  std::vector<WDL_FFT_REAL> threadedOut[kNumChans], singleOut[kNumChans];
+  Timing burst, singleTiming;
+  int lateInBurst = 0, lateInRecovery = 0;
+  OnAudioThread([&]() {
+    burst = Run(threaded, pInputs, 0, kBurstFrames, kBlockSize, false, threadedOut);
+    lateInBurst = threaded.GetNumLateBlocks();
+    Run(threaded, pInputs, kBurstFrames, kRecoveryFrames, kBlockSize, true, threadedOut);
+    lateInRecovery = threaded.GetNumLateBlocks() - lateInBurst;
+    Run(threaded, pInputs, kBurstFrames + kRecoveryFrames, kCheckFrames, kBlockSize, true, threadedOut);
+    singleTiming = Run(single, pInputs, 0, kBurstFrames + kRecoveryFrames + kCheckFrames, kBlockSize, false, singleOut);
+  });
+
+  const int lateAfter = threaded.GetNumLateBlocks() - lateInBurst - lateInRecovery;
+  printf("overload: %d late tail blocks in the burst, %d while catching up, %d after that\n", lateInBurst, lateInRecovery, lateAfter);
+  burst.Print("burst");
+  singleTiming.Print("WDL_ConvolutionEngine_Div");
+
+  // input dropped in the burst is heard for one impulse length
+  const double maxDiff = MaxDifference(threadedOut, singleOut, kBurstFrames + kRecoveryFrames + kImpulseLength);
+  printf("  max difference from the single engine one impulse length after catching up %g\n", maxDiff);
+  CHECK(lateInBurst > 0);
+  CHECK(lateAfter == 0);
+  CHECK(maxDiff < 1e-5);
+
+  // a callback in the burst does the head convolution and waits for at most kMaxWaitUs, where the single engine sometimes does a
+  // whole large FFT
+  const double worstBurst = *std::max_element(burst.callbackSeconds.begin(), burst.callbackSeconds.end());
+  const double worstSingle = *std::max_element(singleTiming.callbackSeconds.begin(), singleTiming.callbackSeconds.end());
+  CHECK(worstBurst < worstSingle);
+}
+
+int main()
+{
+  const int nFrames = static_cast<int>(6. * kSampleRate);
+  const int nOverloadFrames = static_cast<int>(8. * kSampleRate);
+  std::mt19937 rng(3);
+  std::uniform_real_distribution<double> noise(-1., 1.);
+  std::vector<WDL_FFT_REAL> inputs[kNumChans];
+
+  for (int c = 0; c < kNumChans; c++)
+  {
+    for (int s = 0; s < nOverloadFrames; s++)
+      inputs[c].push_back(noise(rng));
+  }
+
+  for (int impulseSeconds : {1, 4})
+  {
+    for (int blockSize : {64, 256})
+      Compare(static_cast<int>(impulseSeconds * kSampleRate), blockSize, inputs, nFrames);
+  }
+
+  TestOverload(inputs);
+
+  return testutils::ReportResults("ThreadedConvolutionBenchmark");
+}
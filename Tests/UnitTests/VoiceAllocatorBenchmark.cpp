@@ -0,0 +1,262 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+// Replays dense, random MPE MIDI (note on/off, pitch bend, pressure, CC, sustain and most-recent timbre events) through a
+// VoiceAllocator with 16 to 1024 voices, and prints the time VoiceAllocator::ProcessEvents() takes per event. Checks that:
+// - every voice is used, including with more than 255 voices
+// - every voice becomes idle after an all notes off message
+// - the steal mode can be changed from another thread while events are processed. Build with -fsanitize=thread to check for races
+// The trace of voice triggers, releases and controls is hashed, so runs can be compared before and after a change to the allocator.
+// Pass a voice count, events per block and optionally a steal mode to run a single configuration.
+// See README.md for how to build and run it
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "VoiceAllocator.h"
+#include "TestUtils.h"
+
+using namespace iplug;
+
+static uint64_t gHash = 1469598103934665603ull;
+static void Hash(uint64_t v) { gHash = (gHash ^ v) * 1099511628211ull; }
+
+// a voice that records what the allocator does to it, and plays on for a while after it is released
+class TestVoice : public SynthVoice
+{
+public:
+  TestVoice(int id) : mId(id) {}
+
+  bool GetBusy() const override { return mRemaining > 0; }
+  void Trigger(double level, bool isRetrigger) override { mRemaining = INT64_MAX; mTriggered = true; Hash(1); Hash(mId); Hash(mKey); Hash(mChannel); }
+  void Release() override { if (mRemaining > 0) mRemaining = 200 + (mId * 37) % 600; Hash(2); Hash(mId); }
+  void SetControl(int controlNumber, float value) override { Hash(3); Hash(mId); Hash(controlNumber); }
+  void SetProgramNumber(int programNumber) override { Hash(4); Hash(mId); Hash(programNumber); }
+  void ProcessSamplesAccumulating(sample** inputs, sample** outputs, int nInputs, int nOutputs, int startIdx, int nFrames) override { mRemaining -= nFrames; }
+
+  bool GetTriggered() const { return mTriggered; }
+  uint64_t GetState() const { return static_cast<uint64_t>(mGain * 1000.) ^ static_cast<uint64_t>(mLastTriggeredTime); }
+
+private:
+  int mId;
+  int64_t mRemaining = 0;
+  bool mTriggered = false;
+};
+
+static void Replay(int nVoices, int eventsPerBlock, int stealMode)
+{
+  constexpr int kNumBlocks = 20000;
+  constexpr int kBlockSize = 64;
+
+  VoiceAllocator allocator;
+  allocator.SetVoiceStealMode(static_cast<VoiceAllocator::EVoiceStealMode>(stealMode));
+  allocator.SetSampleRateAndBlockSize(48000., kBlockSize);
+
+  std::vector<std::unique_ptr<TestVoice>> voices;
+  for (int i = 0; i < nVoices; i++)
+  {
+    voices.emplace_back(new TestVoice(i));
+    allocator.AddVoice(voices.back().get(), 0);
+  }
+
+  gHash = 1469598103934665603ull;
+  std::mt19937 rng(1234);
+  std::vector<std::pair<int, int>> held; // channel, key
+  double eventSeconds = 0.;
+  int64_t sampleTime = 0;
+
+  auto processBlock = [&]() {
+    const auto start = std::chrono::steady_clock::now();
+    allocator.ProcessEvents(kBlockSize, sampleTime);
+    eventSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    allocator.ProcessVoices(nullptr, nullptr, 0, 0, 0, kBlockSize);
+
+    for (auto& pVoice : voices)
+      Hash(pVoice->GetState());
+
+    sampleTime += kBlockSize;
+  };
+
+  for (int block = 0; block < kNumBlocks; block++)
+  {
+    for (int e = 0; e < eventsPerBlock; e++)
+    {
+      VoiceInputEvent event {};
+      event.mSampleOffset = static_cast<int>(rng() % kBlockSize);
+      const int r = rng() % 100;
+
+      if (r < 35 || held.empty())
+      {
+        const int channel = 1 + rng() % 15;
+        const int key = 24 + rng() % 80;
+        event.mAddress = {0, static_cast<uint8_t>(channel), static_cast<uint8_t>(key), 0};
+        event.mAction = kNoteOnAction;
+        event.mValue = 0.7f;
+        held.push_back({channel, key});
+      }
+      else if (r < 70)
+      {
+        const size_t i = rng() % held.size();
+        event.mAddress = {0, static_cast<uint8_t>(held[i].first), static_cast<uint8_t>(held[i].second), 0};
+        event.mAction = kNoteOffAction;
+        held.erase(held.begin() + i);
+      }
+      else if (r < 85)
+      {
+        event.mAddress = {0, static_cast<uint8_t>(1 + rng() % 15), kAllKeys, 0};
+        event.mAction = kPitchBendAction;
+        event.mValue = 0.1f;
+      }
+      else if (r < 93)
+      {
+        event.mAddress = {0, static_cast<uint8_t>(1 + rng() % 15), kAllKeys, 0};
+        event.mAction = kPressureAction;
+        event.mValue = 0.3f;
+      }
+      else if (r < 97)
+      {
+        event.mAddress = {0, kAllChannels, kAllKeys, 0};
+        event.mAction = kControllerAction;
+        event.mControllerNumber = 1;
+        event.mValue = 0.5f;
+      }
+      else if (r < 99)
+      {
+        event.mAddress = {0, kAllChannels, kAllKeys, 0};
+        event.mAction = kSustainAction;
+        event.mValue = (rng() & 1) ? 1.f : 0.f;
+      }
+      else
+      {
+        event.mAddress = {0, static_cast<uint8_t>(1 + rng() % 15), kAllKeys, kVoicesMostRecent};
+        event.mAction = kTimbreAction;
+        event.mValue = 0.2f;
+      }
+
+      allocator.AddEvent(event);
+    }
+
+    processBlock();
+  }
+
+  // as a host sends when playback stops, then let the voices play out
+  VoiceInputEvent allNotesOff {};
+  allNotesOff.mAddress = {0, kAllChannels, kAllKeys, kVoicesAll};
+  allNotesOff.mAction = kNoteOffAction;
+  allocator.AddEvent(allNotesOff);
+
+  for (int block = 0; block < 20; block++)
+    processBlock();
+
+  int nBusy = 0;
+  int nTriggered = 0;
+  for (auto& pVoice : voices)
+  {
+    nBusy += pVoice->GetBusy() ? 1 : 0;
+    nTriggered += pVoice->GetTriggered() ? 1 : 0;
+  }
+
+  CHECK(nBusy == 0);
+  CHECK(nTriggered == nVoices);
+
+  printf("steal mode %d, %4d voices, %3d events/block: %7.1f ns/event, hash %016llx\n", stealMode, nVoices, eventsPerBlock,
+         1e9 * eventSeconds / (static_cast<double>(kNumBlocks) * eventsPerBlock), static_cast<unsigned long long>(gHash));
+}
+
+// Play more notes than there are voices while another thread switches the steal mode, as a parameter change from the UI would
+static void TestChangeStealMode()
+{
+  constexpr int kNumVoices = 8;
+  constexpr int kBlockSize = 64;
+  VoiceAllocator allocator;
+  allocator.SetSampleRateAndBlockSize(48000., kBlockSize);
+
+  std::vector<std::unique_ptr<TestVoice>> voices;
+  for (int i = 0; i < kNumVoices; i++)
+  {
+    voices.emplace_back(new TestVoice(i));
+    allocator.AddVoice(voices.back().get(), 0);
+  }
+
+  std::atomic<bool> done {false};
+  std::atomic<int> nChanges {0};
+  std::thread ui([&]() {
+    for (int mode = 0; !done.load(); mode = (mode + 1) % VoiceAllocator::kNumVoiceStealModes)
+    {
+      allocator.SetVoiceStealMode(static_cast<VoiceAllocator::EVoiceStealMode>(mode));
+      nChanges++;
+      std::this_thread::yield();
+    }
+  });
+
+  std::mt19937 rng(99);
+  int64_t sampleTime = 0;
+
+  for (int block = 0; block < 20000 || nChanges < 100; block++)
+  {
+    VoiceInputEvent event {};
+    event.mAddress = {0, 1, static_cast<uint8_t>(36 + rng() % 48), 0};
+    event.mAction = (rng() % 3) ? kNoteOnAction : kNoteOffAction;
+    event.mValue = 0.7f;
+    event.mSampleOffset = static_cast<int>(rng() % kBlockSize);
+    allocator.AddEvent(event);
+    allocator.ProcessEvents(kBlockSize, sampleTime);
+    allocator.ProcessVoices(nullptr, nullptr, 0, 0, 0, kBlockSize);
+    sampleTime += kBlockSize;
+  }
+
+  done = true;
+  ui.join();
+
+  VoiceInputEvent allNotesOff {};
+  allNotesOff.mAddress = {0, kAllChannels, kAllKeys, kVoicesAll};
+  allNotesOff.mAction = kNoteOffAction;
+  allocator.AddEvent(allNotesOff);
+
+  for (int block = 0; block < 20; block++)
+  {
+    allocator.ProcessEvents(kBlockSize, sampleTime);
+    allocator.ProcessVoices(nullptr, nullptr, 0, 0, 0, kBlockSize);
+    sampleTime += kBlockSize;
+  }
+
+  int nBusy = 0;
+  for (auto& pVoice : voices)
+    nBusy += pVoice->GetBusy() ? 1 : 0;
+
+  printf("steal mode changed %d times while playing\n", nChanges.load());
+  CHECK(nBusy == 0);
+}
+
+int main(int argc, char** argv)
+{
+  if (argc > 2)
+  {
+    Replay(atoi(argv[1]), atoi(argv[2]), argc > 3 ? atoi(argv[3]) : VoiceAllocator::kStealOldest);
+  }
+  else
+  {
+    const int configs[][2] = {{16, 32}, {64, 32}, {254, 32}, {254, 4}, {512, 32}, {1024, 32}};
+
+    for (auto& config : configs)
+      Replay(config[0], config[1], VoiceAllocator::kStealOldest);
+
+    for (int mode = VoiceAllocator::kStealQuietest; mode < VoiceAllocator::kNumVoiceStealModes; mode++)
+      Replay(254, 32, mode);
+
+    TestChangeStealMode();
+  }
+
+  return testutils::ReportResults("VoiceAllocatorBenchmark");
+}
@@ -0,0 +1,167 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+// Renders voices that each sum a few sine partials through a VoiceThreadPool, for 8 to 256 voices on 1 to 8 threads, and prints the
+// mean and worst time per block. Checks that:
+// - the output matches rendering on one thread, within rounding, and is the same from run to run
+// - workers that have blocked between bursts of blocks are woken without missing a block
+// The scaling depends on the number of cores, so compare runs on the same machine. Pass a voice count and thread count to run a
+// single configuration.
+// See README.md for how to build and run it
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "VoiceThreadPool.h"
+#include "TestUtils.h"
+
+using namespace iplug;
+
+static constexpr int kBlockSize = 128;
+static constexpr int kNumOutputs = 2;
+static constexpr int kNumPartials = 8;
+
+// a voice that costs about as much as a simple additive synth voice
+class PartialsVoice : public SynthVoice
+{
+public:
+  PartialsVoice(int id)
+  {
+    for (int p = 0; p < kNumPartials; p++)
+      mIncr[p] = 2. * PI * (110. + 37. * id) * (p + 1) / 48000.;
+  }
+
+  bool GetBusy() const override { return true; }
+
+  void ProcessSamplesAccumulating(sample** inputs, sample** outputs, int nInputs, int nOutputs, int startIdx, int nFrames) override
+  {
+    for (int s = startIdx; s < startIdx + nFrames; s++)
+    {
+      double sum = 0.;
+      for (int p = 0; p < kNumPartials; p++)
+      {
+        sum += std::sin(mPhase[p]) / (p + 1);
+        mPhase[p] += mIncr[p];
+      }
+
+      for (int c = 0; c < nOutputs; c++)
+        outputs[c][s] += sum * (c + 1);
+    }
+  }
+
+private:
+  double mPhase[kNumPartials] = {};
+  double mIncr[kNumPartials];
+};
+
+struct Result
+{
+  std::vector<double> output;
+  double meanSeconds = 0.;
+  double worstSeconds = 0.;
+};
+
+// render nBlocks blocks. Every burstLength blocks the audio thread sleeps long enough for the workers to block
+static Result Render(int nVoices, int nThreads, int nBlocks, int burstLength)
+{
+  std::vector<std::unique_ptr<PartialsVoice>> voices;
+  std::vector<SynthVoice*> voicePtrs;
+  for (int v = 0; v < nVoices; v++)
+  {
+    voices.emplace_back(new PartialsVoice(v));
+    voicePtrs.push_back(voices.back().get());
+  }
+
+  VoiceThreadPool pool(nThreads);
+  pool.Resize(nVoices, kNumOutputs, kBlockSize);
+
+  Result result;
+  std::vector<sample> buffers(kNumOutputs * kBlockSize);
+  sample* outputs[kNumOutputs] = {buffers.data(), buffers.data() + kBlockSize};
+  double totalSeconds = 0.;
+
+  for (int block = 0; block < nBlocks; block++)
+  {
+    if (burstLength && block % burstLength == 0)
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    std::fill(buffers.begin(), buffers.end(), 0.);
+    const double start = testutils::Seconds();
+    pool.ProcessVoices(voicePtrs.data(), nVoices, nullptr, outputs, 0, kNumOutputs, 0, kBlockSize);
+    const double elapsed = testutils::Seconds() - start;
+
+    totalSeconds += elapsed;
+    result.worstSeconds = std::max(result.worstSeconds, elapsed);
+    result.output.insert(result.output.end(), buffers.begin(), buffers.end());
+  }
+
+  result.meanSeconds = totalSeconds / nBlocks;
+  return result;
+}
+
+static double MaxDifference(const std::vector<double>& a, const std::vector<double>& b)
+{
+  double maxDiff = 0.;
+  for (size_t s = 0; s < a.size(); s++)
+    maxDiff = std::max(maxDiff, std::fabs(a[s] - b[s]));
+  return maxDiff;
+}
+
+static void Scale(int nVoices, int nThreads)
+{
+  constexpr int kNumBlocks = 400;
+  const Result reference = Render(nVoices, 1, kNumBlocks, 0);
+  const Result result = Render(nVoices, nThreads, kNumBlocks, 0);
+  const Result again = Render(nVoices, nThreads, kNumBlocks, 0);
+
+  CHECK(MaxDifference(reference.output, result.output) < 1e-9);
+  CHECK(result.output == again.output);
+
+  printf("%4d voices, %d threads: mean %7.1f us/block (%.2fx one thread), worst %7.1f us/block\n", nVoices, nThreads,
+         1e6 * result.meanSeconds, reference.meanSeconds / result.meanSeconds, 1e6 * result.worstSeconds);
+}
+
+static void TestWakeAfterBlocking()
+{
+  constexpr int kNumVoices = 32;
+  constexpr int kNumBlocks = 40;
+  const Result reference = Render(kNumVoices, 1, kNumBlocks, 0);
+  const Result result = Render(kNumVoices, 4, kNumBlocks, 4);
+
+  CHECK(MaxDifference(reference.output, result.output) < 1e-9);
+  printf("woken after blocking: worst %.1f us/block\n", 1e6 * result.worstSeconds);
+}
+
+int main(int argc, char** argv)
+{
+  printf("%u hardware threads\n", std::thread::hardware_concurrency());
+
+  if (argc > 2)
+  {
+    Scale(atoi(argv[1]), atoi(argv[2]));
+  }
+  else
+  {
+    for (int nVoices : {8, 32, 256})
+    {
+      for (int nThreads : {2, 4, 8})
+        Scale(nVoices, nThreads);
+    }
+
+    TestWakeAfterBlocking();
+  }
+
+  return testutils::ReportResults("VoiceThreadPoolBenchmark");
+}
@@ -0,0 +1,346 @@
+/*
+ ==============================================================================
+
+ This file is part of the iPlug 2 library. Copyright (C) the iPlug 2 developers.
+
+ See LICENSE.txt for  more info.
+
+ ==============================================================================
+*/
+
+// Renders the shared wavetables with WavetableOscillator and WavetableOscillatorBank, measures their aliasing with a windowed DFT
+// against a naive saw, and prints the throughput of the bank. Checks that:
+// - GetLevelForIncrement() picks the level with the most harmonics that are all at or below Nyquist, for every frequency
+// - every level of the saw table holds its harmonics and nothing above them
+// - a saw at a range of frequencies up to 10 kHz, and a detuned unison saw, alias at least 55 dB below their harmonics
+// - the kernel matches a scalar reference, so the SSE2 and AVX2 paths are checked, and Process() matches ProcessBlock()
+// - the sine table is close to std::sin, and LoadFromBuffer() gives back the waveform it was given
+// Build with and without IPLUG_SIMDE, and with -mavx2, to check each kernel.
+// See README.md for how to build and run it
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "WavetableOscillator.h"
+#include "TestUtils.h"
+
+using namespace iplug;
+
+static constexpr double kSampleRate = 44100.;
+static constexpr int kDFTSize = 8192;
+
+static void TestLevelSelection()
+{
+  bool highestBelowNyquist = true;
+
+  // a log sweep up to just below Nyquist, and the increments at which the level changes
+  std::vector<double> increments;
+  for (double incr = 1e-6; incr < 0.5; incr *= 1.01)
+    increments.push_back(incr);
+
+  for (int level = 0; level < Wavetable::kNumLevels; level++)
+  {
+    const double boundary = 0.5 / Wavetable::GetLevelHarmonics(level);
+    increments.insert(increments.end(), {boundary, std::nextafter(boundary, 0.)});
+    if (level < Wavetable::kNumLevels - 1)
+      increments.push_back(std::nextafter(boundary, 1.));
+  }
+
+  for (double incr : increments)
+  {
+    for (double sign : {1., -1.})
+    {
+      const int level = Wavetable::GetLevelForIncrement(sign * incr);
+      const bool belowNyquist = Wavetable::GetLevelHarmonics(level) * incr <= 0.5;
+      const bool previousAliases = level == 0 || Wavetable::GetLevelHarmonics(level - 1) * incr > 0.5;
+
+      if (!(belowNyquist && previousAliases) && highestBelowNyquist)
+        printf("increment %.17g: level %d with %d harmonics\n", sign * incr, level, Wavetable::GetLevelHarmonics(level));
+
+      highestBelowNyquist &= level >= 0 && level < Wavetable::kNumLevels && belowNyquist && previousAliases;
+    }
+  }
+
+  CHECK(highestBelowNyquist);
+}
+
+// The amplitude of harmonic h of a table, as the magnitude of one DFT bin
+static double Harmonic(const float* pTable, int size, int h)
+{
+  double re = 0., im = 0.;
+  for (int i = 0; i < size; i++)
+  {
+    re += pTable[i] * std::cos(2. * PI * h * i / size);
+    im += pTable[i] * std::sin(2. * PI * h * i / size);
+  }
+  return 2. * std::sqrt(re * re + im * im) / size;
+}
+
+static void TestLevelContents()
+{
+  const Wavetable& saw = Wavetable::GetShape(Wavetable::kSaw);
+  double worstMissing = 0., worstAbove = 0.;
+
+  for (int level = 0; level < Wavetable::kNumLevels; level++)
+  {
+    const float* pTable = saw.GetLevel(level);
+    const int size = Wavetable::GetLevelSize(level);
+    const int nHarmonics = Wavetable::GetLevelHarmonics(level);
+
+    CHECK(pTable[size] == pTable[0]);
+
+    // the fundamental and the top harmonic are there, at 2 / (pi h)
+    for (int h : {1, nHarmonics})
+      worstMissing = std::max(worstMissing, std::fabs(Harmonic(pTable, size, h) - 2. / (PI * h)));
+
+    // nothing above the top harmonic, up to the Nyquist of the table
+    for (int h = nHarmonics + 1; h < size / 2; h++)
+      worstAbove = std::max(worstAbove, Harmonic(pTable, size, h));
+  }
+
+  printf("saw table levels: worst harmonic amplitude error %g, worst harmonic above the top one %g\n", worstMissing, worstAbove);
+  CHECK(worstMissing < 1e-5);
+  CHECK(worstAbove < 1e-5);
+}
+
+// The power of the non-harmonic part of a signal relative to its harmonics, in dB, with a Blackman-Harris window. Bins within the
+// main lobe of the window (4 bins) of a multiple of one of the fundamentals are harmonic
+static double AliasingDB(const std::vector<double>& signal, const std::vector<double>& fundamentals)
+{
+  const int n = kDFTSize;
+  std::vector<double> windowed(n), cosTable(n), sinTable(n);
+
+  for (int i = 0; i < n; i++)
+  {
+    const double x = 2. * PI * i / n;
+    windowed[i] = signal[i] * (0.35875 - 0.48829 * std::cos(x) + 0.14128 * std::cos(2. * x) - 0.01168 * std::cos(3. * x));
+    cosTable[i] = std::cos(x);
+    sinTable[i] = std::sin(x);
+  }
+
+  double harmonicPower = 0., aliasPower = 0.;
+
+  for (int k = 1; k < n / 2; k++)
+  {
+    double re = 0., im = 0.;
+    for (int i = 0, idx = 0; i < n; i++, idx = (idx + k) & (n - 1))
+    {
+      re += windowed[i] * cosTable[idx];
+      im += windowed[i] * sinTable[idx];
+    }
+
+    const double freq = k * kSampleRate / n;
+    bool harmonic = false;
+    for (double f0 : fundamentals)
+    {
+      const double h = std::max(1., std::round(freq / f0));
+      harmonic |= std::fabs(freq - h * f0) <= 4. * kSampleRate / n;
+    }
+
+    (harmonic ? harmonicPower : aliasPower) += re * re + im * im;
+  }
+
+  return 10. * std::log10(aliasPower / harmonicPower);
+}
+
+static void TestAliasing()
+{
+  for (double f0 : {220., 1760., 4186., 7040., 9973.})
+  {
+    WavetableOscillator<double> osc;
+    osc.SetSampleRate(kSampleRate);
+    osc.SetFreqCPS(f0);
+    std::vector<double> signal(kDFTSize), naive(kDFTSize);
+    osc.ProcessBlock(signal.data(), kDFTSize);
+
+    for (int i = 0; i < kDFTSize; i++)
+    {
+      const double phase = i * f0 / kSampleRate;
+      naive[i] = 2. * (phase - std::floor(phase)) - 1.;
+    }
+
+    // at low frequencies the floor is the images of the linear interpolation of the table rather than aliasing
+    const double aliasing = AliasingDB(signal, {f0});
+    printf("saw %5.0f Hz: aliasing %6.1f dB, naive saw %6.1f dB\n", f0, aliasing, AliasingDB(naive, {f0}));
+    CHECK(aliasing < -55.);
+  }
+
+  // a voice of the bank with 5 detuned oscillators, whose harmonics are all different. The outermost are at +-15 cents
+  constexpr int kUnison = 5;
+  constexpr double kDetuneCents = 30.;
+  constexpr double f0 = 2637.;
+  WavetableOscillatorBank<double> bank(1, kUnison);
+  bank.SetSampleRate(kSampleRate);
+  bank.SetUnison(kUnison, kDetuneCents);
+  bank.SetFreqCPS(0, f0);
+  bank.ResetVoice(0);
+  std::vector<double> signal(kDFTSize);
+  double* outputs[1] = {signal.data()};
+  bank.ProcessBlock(outputs, kDFTSize);
+
+  std::vector<double> fundamentals;
+  for (int u = 0; u < kUnison; u++)
+    fundamentals.push_back(f0 * std::pow(2., (2. * u / (kUnison - 1) - 1.) * kDetuneCents / 1200.));
+
+  const double aliasing = AliasingDB(signal, fundamentals);
+  printf("saw %5.0f Hz, unison of %d: aliasing %6.1f dB\n", f0, kUnison, aliasing);
+  CHECK(aliasing < -55.);
+}
+
+// WavetableKernel::Render() one sample at a time, in double
+static void ReferenceRender(const Wavetable& table, int level, uint32_t phase, uint32_t phaseIncr, double gain, double* pOutput, int nFrames)
+{
+  const float* pTable = table.GetLevel(level);
+  const int fracBits = 32 - Wavetable::GetLevelLog2Size(level);
+
+  for (int s = 0; s < nFrames; s++, phase += phaseIncr)
+  {
+    const uint32_t idx = phase >> fracBits;
+    const double frac = static_cast<double>(phase & ((1u << fracBits) - 1u)) / (1u << fracBits);
+    pOutput[s] = gain * (pTable[idx] + frac * (pTable[idx + 1] - pTable[idx]));
+  }
+}
+
+template <typename T>
+static void TestKernel()
+{
+  static const int kBlockSizes[] = {64, 1, 3, 17, 8, 256, 5};
+  std::mt19937 rng(13);
+  std::uniform_real_distribution<double> unit(0., 1.);
+  double maxDiff = 0.;
+  bool phaseMatches = true;
+
+  for (int shape = 0; shape < Wavetable::kNumShapes; shape++)
+  {
+    const Wavetable& table = Wavetable::GetShape(static_cast<Wavetable::EShape>(shape));
+
+    for (int trial = 0; trial < 40; trial++)
+    {
+      // increments from a few Hz up to Nyquist, and a phase that starts anywhere, so every level is used and the phase wraps
+      const double incr = 0.5 * std::pow(1e-4, unit(rng));
+      const int level = Wavetable::GetLevelForIncrement(incr);
+      const uint32_t fixedIncr = WavetableKernel<T>::ToFixedPhase(incr);
+      const float gain = static_cast<float>(0.25 + unit(rng));
+      uint32_t phase = WavetableKernel<T>::ToFixedPhase(unit(rng));
+
+      for (int n : kBlockSizes)
+      {
+        // rendering, then accumulating a second copy, gives twice the reference
+        std::vector<T> output(n);
+        std::vector<double> expected(n);
+        const uint32_t startPhase = phase;
+        uint32_t secondPhase = phase;
+        ReferenceRender(table, level, startPhase, fixedIncr, gain, expected.data(), n);
+        WavetableKernel<T>::template Render<false>(table, level, phase, fixedIncr, gain, output.data(), n);
+        WavetableKernel<T>::template Render<true>(table, level, secondPhase, fixedIncr, gain, output.data(), n);
+        phaseMatches &= phase == secondPhase && phase == startPhase + static_cast<uint32_t>(n) * fixedIncr;
+
+        for (int s = 0; s < n; s++)
+          maxDiff = std::max(maxDiff, std::fabs(output[s] - 2. * expected[s]));
+      }
+    }
+  }
+
+  // Process() and ProcessBlock() of the oscillator
+  WavetableOscillator<T> a, b;
+  a.SetSampleRate(kSampleRate);
+  b.SetSampleRate(kSampleRate);
+  b.SetFreqCPS(3000.);
+  bool processMatches = true;
+  std::vector<T> block(1);
+
+  for (int s = 0; s < 1000; s++)
+  {
+    b.ProcessBlock(block.data(), 1);
+    processMatches &= a.Process(3000.) == block[0];
+  }
+
+  printf("%-6s kernel: max difference from the reference %g\n", sizeof(T) == 4 ? "float" : "double", maxDiff);
+  CHECK(maxDiff < 1e-5);
+  CHECK(phaseMatches);
+  CHECK(processMatches);
+}
+
+static void TestAccuracy()
+{
+  // a 1 kHz sine against std::sin
+  WavetableOscillator<double> sine(Wavetable::GetShape(Wavetable::kSine));
+  sine.SetSampleRate(kSampleRate);
+  sine.SetFreqCPS(1000.);
+  std::vector<double> output(kDFTSize);
+  sine.ProcessBlock(output.data(), kDFTSize);
+  double sineDiff = 0.;
+
+  for (int i = 0; i < kDFTSize; i++)
+    sineDiff = std::max(sineDiff, std::fabs(output[i] - std::sin(2. * PI * WavetableKernel<double>::FromFixedPhase(i * WavetableKernel<double>::ToFixedPhase(1000. / kSampleRate)))));
+
+  // a band-limited waveform with a DC offset and cosine terms, through LoadFromBuffer(), comes back out of level 0
+  constexpr int kBufferSize = 2048;
+  std::vector<float> buffer(kBufferSize);
+  for (int i = 0; i < kBufferSize; i++)
+  {
+    const double x = 2. * PI * i / kBufferSize;
+    buffer[i] = static_cast<float>(0.1 + 0.5 * std::sin(x) - 0.3 * std::cos(3. * x) + 0.2 * std::sin(17. * x + 1.));
+  }
+
+  Wavetable loaded;
+  loaded.LoadFromBuffer(buffer.data(), kBufferSize);
+  const float* pLevel = loaded.GetLevel(0);
+  const int step = Wavetable::GetLevelSize(0) / kBufferSize;
+  double loadDiff = 0.;
+
+  for (int i = 0; i < kBufferSize; i++)
+    loadDiff = std::max(loadDiff, static_cast<double>(std::fabs(pLevel[i * step] - buffer[i])));
+
+  printf("sine table: max difference from std::sin %g. LoadFromBuffer(): max difference from the buffer %g\n", sineDiff, loadDiff);
+  CHECK(sineDiff < 1e-4);
+  CHECK(loadDiff < 1e-5);
+}
+
+template <typename T>
+static void Time(int nUnison)
+{
+  constexpr int kNumVoices = 16;
+  constexpr int kBlockSize = 64;
+  constexpr int kNumBlocks = 5000;
+  WavetableOscillatorBank<T> bank(kNumVoices, nUnison);
+  bank.SetSampleRate(kSampleRate);
+  bank.SetUnison(nUnison, 20.);
+  std::vector<std::vector<T>> buffers(kNumVoices, std::vector<T>(kBlockSize));
+  std::vector<T*> outputs(kNumVoices);
+
+  for (int v = 0; v < kNumVoices; v++)
+  {
+    bank.SetFreqCPS(v, 55. * std::pow(2., v / 3.));
+    bank.ResetVoice(v);
+    outputs[v] = buffers[v].data();
+  }
+
+  const double start = testutils::Seconds();
+  for (int block = 0; block < kNumBlocks; block++)
+    bank.ProcessBlock(outputs.data(), kBlockSize);
+  const double seconds = testutils::Seconds() - start;
+
+  printf("%-6s %d voices, unison of %d: %5.2f ns per oscillator per sample\n", sizeof(T) == 4 ? "float" : "double", kNumVoices, nUnison,
+         1e9 * seconds / (static_cast<double>(kNumBlocks) * kBlockSize * kNumVoices * nUnison));
+}
+
+int main()
+{
+  TestLevelSelection();
+  TestLevelContents();
+  TestAliasing();
+  TestKernel<float>();
+  TestKernel<double>();
+  TestAccuracy();
+
+  for (int nUnison : {1, 7})
+  {
+    Time<float>(nUnison);
+    Time<double>(nUnison);
+  }
+
+  return testutils::ReportResults("WavetableTest");
+}